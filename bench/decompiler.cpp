@@ -0,0 +1,710 @@
+///
+/// Decompiler Throughput Benchmark
+///
+/// Measures `decompile` on golden images: large synthetic SCM images built by the compiler itself (many missions,
+/// streamed scripts, OATC headers, SWITCH tables, arrays), plus any user-provided image.
+///
+/// Each stage of the decompilation is timed separately (header parsing, analysis, disassembly and IR2 emission), both
+/// by linear sweep and by recursive traversal, and in MB/s and instructions/s. The images are also decompiled by many
+/// threads at once, each on its own copy of the work, to measure how the throughput scales.
+///
+/// The results are written as JSON, so regressions can be tracked per commit.
+///
+/// Usage: gta3sc-bench-decompiler [--images=<dir>] [--scale=<n>] [--iterations=<n>] [--threads=<n,...>] [-o <file>]
+///
+/// User images are found at `<dir>/<config>/*.scm` (e.g. `images/gtasa/main.scm`). A `script.img` next to a
+/// `main.scm` is used as its streamed scripts.
+///
+#include <stdinc.h>
+#include <chrono>
+#include <thread>
+#include "driver.hpp"
+#include "disassembler.hpp"
+#include "decompiler_ir2.hpp"
+
+#ifdef GTA3SC_USING_GIT_DESCRIBE
+extern const char* GTA3SC_GIT_SHA1;
+#else
+const char* GTA3SC_GIT_SHA1 = "";
+#endif
+
+/// Composition of a synthetic image.
+struct SyntheticImage
+{
+    const char*                 name;
+    const char*                 config;
+    std::vector<std::string>    args;           //< Options besides `--config`.
+    bool                        switches;
+    bool                        arrays;
+    size_t                      num_missions;
+    size_t                      num_streams;
+    size_t                      main_blocks;    //< Number of statement blocks in the main script.
+    size_t                      script_blocks;  //< Ditto for each mission and streamed script.
+};
+
+struct Image
+{
+    std::string                 name;
+    std::string                 config;
+    std::vector<std::string>    args;
+    std::vector<uint8_t>        main_scm;
+    optional<std::vector<uint8_t>> script_img;
+
+    size_t size() const { return main_scm.size() + (script_img? script_img->size() : 0); }
+};
+
+struct StageTimes
+{
+    double header       = 0.0;
+    double analysis     = 0.0;
+    double disassembly  = 0.0;
+    double ir2          = 0.0;
+
+    size_t instructions = 0;
+
+    StageTimes& operator+=(const StageTimes& rhs)
+    {
+        header += rhs.header;
+        analysis += rhs.analysis;
+        disassembly += rhs.disassembly;
+        ir2 += rhs.ir2;
+        instructions += rhs.instructions;
+        return *this;
+    }
+
+    double total() const { return header + analysis + disassembly + ir2; }
+};
+
+/// Writes the GTA3script sources of a synthetic image.
+class ScriptWriter
+{
+public:
+    explicit ScriptWriter(const SyntheticImage& image, uint32_t seed) :
+        image(image), seed(seed)
+    {}
+
+    /// `name` prefixes the labels of the script, and `subroutine` is called by GOSUB (if not empty).
+    /// `ints` and `floats` are the variables visible to the blocks.
+    std::string blocks(const std::string& name, const std::string& subroutine, size_t count,
+                       const std::vector<std::string>& ints, const std::vector<std::string>& floats,
+                       const std::string& array)
+    {
+        this->out.clear();
+        this->label_prefix = name;
+        this->subroutine = subroutine;
+        this->ints = &ints;
+        this->floats = &floats;
+        this->array = &array;
+
+        for(size_t i = 0; i < count; ++i)
+            block(0);
+
+        return std::move(this->out);
+    }
+
+private:
+    uint32_t rand(uint32_t n)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        return (seed >> 8) % n;
+    }
+
+    const std::string& any_int()   { return (*ints)[rand(ints->size())]; }
+    const std::string& any_float() { return (*floats)[rand(floats->size())]; }
+
+    void line(size_t depth, const std::string& text)
+    {
+        out.append(4 * (depth + 1), ' ');
+        out += text;
+        out.push_back('\n');
+    }
+
+    void condition(size_t depth, const char* keyword)
+    {
+        switch(rand(4))
+        {
+            case 0: line(depth, fmt::format("{} IS_BUTTON_PRESSED 0 {}", keyword, rand(16))); break;
+            case 1: line(depth, fmt::format("{} {} > {}", keyword, any_int(), rand(1000))); break;
+            case 2: line(depth, fmt::format("{} {} = {}", keyword, any_int(), rand(8))); break;
+            case 3: line(depth, fmt::format("{} {} > {}.5", keyword, any_float(), rand(3000))); break;
+        }
+    }
+
+    void statements(size_t depth, size_t count)
+    {
+        for(size_t i = 0; i < count; ++i)
+        {
+            if(depth < 2 && rand(3) == 0)
+                block(depth);
+            else
+                simple(depth);
+        }
+    }
+
+    void simple(size_t depth)
+    {
+        switch(rand(8))
+        {
+            case 0: line(depth, fmt::format("WAIT {}", rand(3) * 250)); break;
+            case 1: line(depth, fmt::format("GET_GAME_TIMER {}", any_int())); break;
+            case 2: line(depth, fmt::format("SET_TIME_OF_DAY {} {}", rand(24), rand(60))); break;
+            case 3: line(depth, fmt::format("GENERATE_RANDOM_INT_IN_RANGE 0 {} {}", 1 + rand(1000), any_int())); break;
+            case 4: line(depth, fmt::format("GENERATE_RANDOM_FLOAT_IN_RANGE 0.0 {}.0 {}", 1 + rand(100), any_float())); break;
+            case 5: { auto& f = any_float(); line(depth, fmt::format("{} = {} + {}.25", f, f, rand(100))); break; }
+            case 6: { auto& n = any_int(); line(depth, fmt::format("{} += {}", n, 1 + rand(100))); break; }
+            case 7:
+                if(!array->empty())
+                    line(depth, fmt::format("{}[{}] = {}", *array, rand(8), rand(100000)));
+                else
+                    line(depth, "CLEAR_PRINTS");
+                break;
+        }
+    }
+
+    void block(size_t depth)
+    {
+        switch(rand(image.switches? 5 : 4))
+        {
+            case 0:
+            {
+                condition(depth, "IF");
+                auto num_conds = rand(3);
+                auto keyword = rand(2)? "AND" : "OR";
+                for(size_t i = 0; i < num_conds; ++i)
+                    condition(depth, keyword);
+                statements(depth + 1, 1 + rand(4));
+                if(rand(2))
+                {
+                    line(depth, "ELSE");
+                    statements(depth + 1, 1 + rand(3));
+                }
+                line(depth, "ENDIF");
+                break;
+            }
+            case 1:
+            {
+                condition(depth, "WHILE");
+                line(depth + 1, "WAIT 0");
+                statements(depth + 1, 1 + rand(3));
+                line(depth, "ENDWHILE");
+                break;
+            }
+            case 2:
+            {
+                line(depth, fmt::format("REPEAT {} {}", 2 + rand(8), any_int()));
+                statements(depth + 1, 1 + rand(3));
+                line(depth, "ENDREPEAT");
+                break;
+            }
+            case 3:
+            {
+                auto label = fmt::format("{}_{}", label_prefix, label_id++);
+                if(!subroutine.empty())
+                    line(depth, fmt::format("GOSUB {}", subroutine));
+                statements(depth, 1 + rand(3));
+                line(depth, fmt::format("GOTO {}", label));
+                line(depth, "WAIT 0");
+                out += label + ":\n";
+                break;
+            }
+            case 4:
+            {
+                line(depth, fmt::format("SWITCH {}", any_int()));
+                auto num_cases = 4 + rand(12);
+                auto value = rand(100);
+                for(size_t i = 0; i < num_cases; ++i)
+                {
+                    line(depth, fmt::format("CASE {}", value += 1 + rand(40)));
+                    statements(depth + 1, 1 + rand(2));
+                    line(depth + 1, "BREAK");
+                }
+                if(rand(2))
+                {
+                    line(depth, "DEFAULT");
+                    statements(depth + 1, 1);
+                    line(depth + 1, "BREAK");
+                }
+                line(depth, "ENDSWITCH");
+                break;
+            }
+        }
+    }
+
+private:
+    const SyntheticImage&           image;
+    uint32_t                        seed;
+    std::string                     out;
+    std::string                     label_prefix;
+    std::string                     subroutine;
+    size_t                          label_id = 0;
+    const std::vector<std::string>* ints = nullptr;
+    const std::vector<std::string>* floats = nullptr;
+    const std::string*              array = nullptr;
+};
+
+/// Runs `gta3sc args...` in-process. The game configs are loaded once.
+static int run_gta3sc(std::vector<std::string> args, std::string* output = nullptr,
+                      optional<Invocation>* parsed = nullptr, shared_ptr<const GameConfig>* parsed_config = nullptr)
+{
+    static std::map<std::string, shared_ptr<const GameConfig>> configs;
+
+    auto log = [](const std::string& msg) { fprintf(stderr, "%s\n", msg.c_str()); };
+    auto out = [&](const std::string& text) { if(output) *output += text; };
+
+    std::vector<char*> argv;
+    for(auto& arg : args) argv.emplace_back(&arg[0]);
+    argv.emplace_back(nullptr);
+
+    Invocation invocation;
+    if(!parse_invocation(argv.data(), invocation, log) || !validate_invocation(invocation, log))
+        return EXIT_FAILURE;
+
+    auto& config = configs[config_key(invocation)];
+    try
+    {
+        if(!config)
+            config = std::make_shared<const GameConfig>(load_config(invocation));
+    }
+    catch(const ConfigError& e)
+    {
+        log(fmt::format("gta3sc: error: {}", e.what()));
+        return EXIT_FAILURE;
+    }
+
+    if(parsed) parsed->emplace(invocation);
+    if(parsed_config) *parsed_config = config;
+
+    return output? run_invocation(invocation, *config, out, log) : EXIT_SUCCESS;
+}
+
+/// Writes the sources of a synthetic image into `dir` and compiles them.
+static optional<Image> build_synthetic(const SyntheticImage& synthetic, const fs::path& dir, size_t scale)
+{
+    std::error_code ec;
+    fs::remove_all(dir, ec);
+    fs::create_directories(dir / "main");
+
+    ScriptWriter writer(synthetic, 0x2A2A2A2A);
+
+    auto write = [&](const std::string& filename, const std::string& source)
+    {
+        // Scripts other than the main one must be in the subdirectory named after it.
+        auto path = filename == "main.sc"? dir / filename : dir / "main" / filename;
+        FILE* f = u8fopen(path, "wb");
+        if(!f) throw std::runtime_error(fmt::format("could not write '{}'", path.generic_u8string()));
+        fwrite(source.data(), 1, source.size(), f);
+        fclose(f);
+    };
+
+    const std::vector<std::string> global_ints = { "g_counter", "g_timer", "g_state" };
+    const std::vector<std::string> global_floats = { "g_x", "g_y", "g_z" };
+    const std::vector<std::string> local_ints = { "l_i", "l_j", "g_counter" };
+    const std::vector<std::string> local_floats = { "l_f", "g_x" };
+    const std::string global_array = synthetic.arrays? "g_flags" : "";
+    const std::string local_array = synthetic.arrays? "l_arr" : "";
+
+    auto script_body = [&](const std::string& name, size_t num_blocks)
+    {
+        std::string source;
+        source += fmt::format("GOTO {}_body\n{}_sub:\n", name, name);
+        source += writer.blocks(name + "_s", "", 4, global_ints, global_floats, global_array);
+        source += fmt::format("RETURN\n{}_body:\n{{\n", name);
+        source += fmt::format("    LVAR_INT l_i l_j{}\n    LVAR_FLOAT l_f\n", synthetic.arrays? " l_arr[8]" : "");
+        source += writer.blocks(name, name + "_sub", num_blocks, local_ints, local_floats, local_array);
+        source += "}\n";
+        return source;
+    };
+
+    std::string main;
+    main += fmt::format("VAR_INT g_counter g_timer g_state{}\n", synthetic.arrays? " g_flags[16]" : "");
+    main += "VAR_FLOAT g_x g_y g_z\n";
+
+    for(size_t i = 0; i < synthetic.num_missions * scale; ++i)
+    {
+        auto name = fmt::format("m{}", i);
+        main += fmt::format("LOAD_AND_LAUNCH_MISSION {}.sc\n", name);
+        write(name + ".sc", fmt::format("MISSION_START\nSCRIPT_NAME {}\n{}MISSION_END\n",
+                                                  name, script_body(name, synthetic.script_blocks)));
+    }
+
+    for(size_t i = 0; i < synthetic.num_streams * scale; ++i)
+    {
+        auto name = fmt::format("s{}", i);
+        main += fmt::format("REGISTER_STREAMED_SCRIPT {} {}.sc\n", name, name);
+        write(name + ".sc", fmt::format("SCRIPT_START\nSCRIPT_NAME {}\n{}SCRIPT_END\n",
+                                                  name, script_body(name, synthetic.script_blocks)));
+    }
+
+    main += "main_loop:\nWAIT 0\n";
+    main += script_body("main", synthetic.main_blocks * scale);
+    main += "GOTO main_loop\n";
+    write("main.sc", main);
+
+    std::vector<std::string> args = { "compile", (dir / "main.sc").u8string(), "-o", (dir / "main.scm").u8string(),
+                                      fmt::format("--config={}", synthetic.config), "-Wno-expect-var" };
+    args.insert(args.end(), synthetic.args.begin(), synthetic.args.end());
+
+    std::string ignored;
+    if(run_gta3sc(args, &ignored) != EXIT_SUCCESS)
+        return nullopt;
+
+    Image image;
+    image.name = synthetic.name;
+    image.config = synthetic.config;
+    image.args = synthetic.args;
+    image.main_scm = read_file_binary(dir / "main.scm").value();
+    if(fs::exists(dir / "script.img"))
+        image.script_img = read_file_binary(dir / "script.img").value();
+    return image;
+}
+
+/// Finds the user images at `<dir>/<config>/*.scm`.
+static std::vector<Image> find_user_images(const fs::path& dir)
+{
+    std::vector<Image> images;
+
+    for(auto& config_entry : fs::directory_iterator(dir))
+    {
+        if(!fs::is_directory(config_entry.path()))
+            continue;
+
+        for(auto& entry : fs::directory_iterator(config_entry.path()))
+        {
+            auto& path = entry.path();
+            if(!iequal_to()(path.extension().u8string(), ".scm"))
+                continue;
+
+            Image image;
+            image.name = (config_entry.path().filename() / path.filename()).generic_u8string();
+            image.config = config_entry.path().filename().u8string();
+            image.args = { "--guesser" };
+            image.main_scm = read_file_binary(path).value();
+
+            auto img_path = fs::path(path).replace_filename("script.img");
+            if(iequal_to()(path.filename().u8string(), "main.scm") && fs::exists(img_path))
+                image.script_img = read_file_binary(img_path).value();
+
+            images.emplace_back(std::move(image));
+        }
+    }
+
+    std::sort(images.begin(), images.end(), [](const Image& a, const Image& b) { return a.name < b.name; });
+    return images;
+}
+
+template<typename Func>
+static double measure(Func func)
+{
+    auto start = std::chrono::steady_clock::now();
+    func();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(end - start).count();
+}
+
+/// Decompiles `image` into IR2 the way `decompile` does, timing each step.
+///
+/// \throws ProgramFailure if the image fails to decompile.
+static StageTimes decompile_image(const Image& image, const GameConfig& config, const Options& options)
+{
+    StageTimes times;
+    ProgramContext program(options, config.commands, TextSink());
+
+    const void* bytecode = image.main_scm.data();
+    size_t bytecode_size = image.main_scm.size();
+
+    optional<DecompiledScmHeader> opt_header;
+    size_t ignore_stream_id = -1;
+    std::vector<BinaryFetcher> mission_segments;
+    std::vector<BinaryFetcher> stream_segments;
+
+    auto scan_type = options.linear_sweep? Disassembler::Type::LinearSweep : Disassembler::Type::RecursiveTraversal;
+
+    times.header = measure([&] {
+        if(!options.headerless)
+        {
+            opt_header = DecompiledScmHeader::from_bytecode(bytecode, bytecode_size,
+                                                            options.get_header<DecompiledScmHeader::Version>());
+            if(!opt_header)
+                program.fatal_error(nocontext, "corrupted scm header");
+
+            auto it = std::find_if(opt_header->streamed_scripts.begin(), opt_header->streamed_scripts.end(), [](const auto& s) {
+                return iequal_to()(s.name, "AAA");
+            });
+            if(it != opt_header->streamed_scripts.end())
+                ignore_stream_id = (it - opt_header->streamed_scripts.begin());
+
+            mission_segments = mission_scripts_fetcher(bytecode, bytecode_size, *opt_header, program);
+            if(options.streamed_scripts && image.script_img)
+                stream_segments = streamed_scripts_fetcher(image.script_img->data(), image.script_img->size(), *opt_header, program);
+        }
+    });
+
+    if(program.has_error())
+        throw ProgramFailure();
+
+    BinaryFetcher main_segment{ bytecode, std::min<size_t>(bytecode_size, opt_header? opt_header->main_size : bytecode_size) };
+    Disassembler main_asm(program, main_segment, scan_type);
+    std::vector<Disassembler> segments_asm;
+    std::vector<std::pair<std::string, size_t>> segments_info; // block name and size
+
+    times.analysis = measure([&] {
+        segments_asm.reserve(mission_segments.size() + stream_segments.size());
+
+        for(size_t i = 0; i < mission_segments.size(); ++i)
+        {
+            segments_asm.emplace_back(program, mission_segments[i], main_asm, scan_type);
+            segments_asm.back().run_analyzer();
+            segments_info.emplace_back(fmt::format("MISSION_{}", i), mission_segments[i].size);
+        }
+
+        for(size_t i = 0; i < stream_segments.size(); ++i)
+        {
+            if(i != ignore_stream_id)
+            {
+                segments_asm.emplace_back(program, stream_segments[i], main_asm, scan_type);
+                segments_asm.back().run_analyzer();
+                segments_info.emplace_back(fmt::format("STREAM_{}", i), stream_segments[i].size);
+            }
+        }
+
+        main_asm.run_analyzer(opt_header? opt_header->code_offset : 0);
+    });
+
+    times.disassembly = measure([&] {
+        main_asm.disassembly(opt_header? opt_header->code_offset : 0);
+        for(auto& segment_asm : segments_asm)
+            segment_asm.disassembly();
+    });
+
+    if(program.has_error())
+        throw ProgramFailure();
+
+    auto count_instructions = [](const std::vector<DecompiledData>& data) {
+        return std::count_if(data.begin(), data.end(), [](const DecompiledData& d) { return is<DecompiledCommand>(d.data); });
+    };
+
+    times.instructions = count_instructions(main_asm.get_data());
+    for(auto& segment_asm : segments_asm)
+        times.instructions += count_instructions(segment_asm.get_data());
+
+    size_t output_size = 0;
+    auto callback = [&](const std::string& line) { output_size += line.size() + 1; };
+
+    times.ir2 = measure([&] {
+        if(opt_header)
+        {
+            for(size_t i = 0; i < opt_header->models.size(); ++i)
+                callback(fmt::format("#DEFINE_MODEL {} -{}", opt_header->models[i], i+1));
+            for(size_t i = 0; i < opt_header->streamed_scripts.size(); ++i)
+                callback(fmt::format("#DEFINE_STREAM {} {}", opt_header->streamed_scripts[i].name, i));
+        }
+
+        auto main_ir2 = DecompilerIR2(program.commands, main_asm.get_data(), 0, main_segment.size, "MAIN", true);
+        main_ir2.decompile(callback);
+
+        for(size_t i = 0; i < segments_asm.size(); ++i)
+        {
+            DecompilerIR2 ir2(program.commands, segments_asm[i].get_data(), 0, segments_info[i].second,
+                              segments_info[i].first, false, main_ir2);
+            ir2.decompile(callback);
+        }
+    });
+
+    if(output_size == 0)
+        throw ProgramFailure();
+
+    return times;
+}
+
+static std::string json_string(const std::string& s)
+{
+    std::string out = "\"";
+    for(char c : s)
+    {
+        if(c == '"' || c == '\\')
+            out.push_back('\\');
+        if(static_cast<unsigned char>(c) < 0x20)
+            out += fmt::format("\\u{:04x}", c);
+        else
+            out.push_back(c);
+    }
+    return out + '"';
+}
+
+static std::string json_rates(double bytes, double instructions, double seconds)
+{
+    return fmt::format(R"({{"seconds": {:.6f}, "mb_per_s": {:.3f}, "instructions_per_s": {:.0f}}})",
+                       seconds, seconds > 0.0? (bytes / (1024.0 * 1024.0)) / seconds : 0.0,
+                       seconds > 0.0? instructions / seconds : 0.0);
+}
+
+int main(int argc, char* argv[])
+{
+    optional<fs::path> images_dir;
+    optional<fs::path> output_path;
+    size_t scale = 1;
+    size_t iterations = 3;
+    std::vector<size_t> thread_counts;
+
+    for(int i = 1; i < argc; ++i)
+    {
+        string_view arg = argv[i];
+        auto value = [&](const char* prefix) -> const char* {
+            return arg.substr(0, strlen(prefix)) == prefix? argv[i] + strlen(prefix) : nullptr;
+        };
+
+        if(auto dir = value("--images="))
+            images_dir = fs::u8path(dir);
+        else if(auto n = value("--scale="))
+            from_chars(n, n + strlen(n), scale);
+        else if(auto n = value("--iterations="))
+            from_chars(n, n + strlen(n), iterations);
+        else if(auto list = value("--threads="))
+        {
+            for(const char* it = list, *end = list + strlen(list); it < end; ++it)
+            {
+                size_t count = 0;
+                it = from_chars(it, end, count).ptr;
+                if(count) thread_counts.emplace_back(count);
+            }
+        }
+        else if(arg == "-o" && i + 1 < argc)
+            output_path = fs::u8path(argv[++i]);
+        else
+            return fprintf(stderr, "unrecognized argument '%s'\n", argv[i]), EXIT_FAILURE;
+    }
+
+    scale = std::max<size_t>(scale, 1);
+    iterations = std::max<size_t>(iterations, 1);
+
+    if(thread_counts.empty())
+    {
+        auto max_threads = std::max(1u, std::thread::hardware_concurrency());
+        for(size_t n = 1; n < max_threads; n *= 2)
+            thread_counts.emplace_back(n);
+        thread_counts.emplace_back(max_threads);
+    }
+
+    const SyntheticImage synthetics[] = {
+        { "synthetic-gtavc",      "gtavc", {},                                 false, false, 40,  0, 600, 60 },
+        { "synthetic-gtasa",      "gtasa", { "--guesser" },                    true,  true,  80, 40, 400, 60 },
+        { "synthetic-gtasa-oatc", "gtasa", { "--guesser", "-fcleo", "-moatc" }, true,  true,  80, 40, 400, 60 },
+    };
+
+    std::vector<Image> images;
+
+    auto work_dir = fs::temp_directory_path() / "gta3sc-bench-decompiler";
+    for(auto& synthetic : synthetics)
+    {
+        fprintf(stderr, "building %s...\n", synthetic.name);
+        if(auto image = build_synthetic(synthetic, work_dir / synthetic.name, scale))
+            images.emplace_back(std::move(*image));
+        else
+            return fprintf(stderr, "failed to build %s\n", synthetic.name), EXIT_FAILURE;
+    }
+
+    if(images_dir)
+    {
+        auto user_images = find_user_images(*images_dir);
+        std::move(user_images.begin(), user_images.end(), std::back_inserter(images));
+    }
+
+    std::string json = fmt::format("{{\n  \"commit\": {},\n  \"scale\": {},\n  \"iterations\": {},\n  \"images\": [",
+                                   json_string(GTA3SC_GIT_SHA1), scale, iterations);
+
+    for(size_t image_id = 0; image_id < images.size(); ++image_id)
+    {
+        auto& image = images[image_id];
+
+        std::vector<std::string> args = { "decompile", image.name + ".scm", fmt::format("--config={}", image.config),
+                                          "-emit-ir2", "-o", "-" };
+        args.insert(args.end(), image.args.begin(), image.args.end());
+
+        optional<Invocation> invocation;
+        shared_ptr<const GameConfig> config;
+        if(run_gta3sc(args, nullptr, &invocation, &config) != EXIT_SUCCESS)
+            return fprintf(stderr, "failed to setup %s\n", image.name.c_str()), EXIT_FAILURE;
+
+        json += fmt::format("{}\n    {{\n      \"name\": {},\n      \"config\": {},\n      \"bytes\": {},\n      \"runs\": [",
+                            image_id? "," : "", json_string(image.name), json_string(image.config), image.size());
+
+        bool first_run = true;
+        for(bool linear_sweep : { true, false })
+        {
+            Options options = invocation->options;
+            options.linear_sweep = linear_sweep;
+
+            for(auto num_threads : thread_counts)
+            {
+                fprintf(stderr, "decompiling %s (%s, %zu threads)...\n", image.name.c_str(),
+                        linear_sweep? "linear sweep" : "recursive traversal", num_threads);
+
+                std::vector<StageTimes> thread_times(num_threads);
+                std::atomic<bool> failed {false};
+
+                double wall = measure([&] {
+                    std::vector<std::thread> threads;
+                    for(size_t t = 0; t < num_threads; ++t)
+                    {
+                        threads.emplace_back([&, t] {
+                            try
+                            {
+                                for(size_t i = 0; i < iterations; ++i)
+                                    thread_times[t] += decompile_image(image, *config, options);
+                            }
+                            catch(const ProgramFailure&)
+                            {
+                                failed = true;
+                            }
+                        });
+                    }
+                    for(auto& thread : threads)
+                        thread.join();
+                });
+
+                if(failed)
+                    return fprintf(stderr, "failed to decompile %s\n", image.name.c_str()), EXIT_FAILURE;
+
+                StageTimes sum;
+                for(auto& times : thread_times)
+                    sum += times;
+
+                // The stage rates are per thread, the overall rate is of all threads together.
+                double bytes = double(image.size()) * iterations * num_threads;
+                double instructions = double(sum.instructions);
+
+                json += fmt::format("{}\n        {{\"analysis\": {}, \"threads\": {}, \"instructions\": {},"
+                                    "\n         \"overall\": {},"
+                                    "\n         \"stages\": {{\"header\": {}, \"analysis\": {}, \"disassembly\": {}, \"ir2\": {}, \"total\": {}}}}}",
+                                    first_run? "" : ",", json_string(linear_sweep? "linear-sweep" : "recursive-traversal"),
+                                    num_threads, sum.instructions / (iterations * num_threads),
+                                    json_rates(bytes, instructions, wall),
+                                    json_rates(bytes, instructions, sum.header),
+                                    json_rates(bytes, instructions, sum.analysis),
+                                    json_rates(bytes, instructions, sum.disassembly),
+                                    json_rates(bytes, instructions, sum.ir2),
+                                    json_rates(bytes, instructions, sum.total()));
+                first_run = false;
+            }
+        }
+
+        json += "\n      ]\n    }";
+    }
+
+    json += "\n  ]\n}\n";
+
+    if(output_path)
+    {
+        FILE* f = u8fopen(*output_path, "wb");
+        if(!f)
+            return fprintf(stderr, "could not write '%s'\n", output_path->generic_u8string().c_str()), EXIT_FAILURE;
+        fputs(json.c_str(), f);
+        fclose(f);
+    }
+    else
+    {
+        fputs(json.c_str(), stdout);
+    }
+
+    return 0;
+}
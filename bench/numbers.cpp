@@ -0,0 +1,171 @@
+///
+/// Number Parsing Microbenchmark
+///
+/// Measures the conversion of numeric literals of a literal-heavy script, comparing the `std::stoi`/`std::stof`
+/// approach (which builds a `std::string` for every token) against `from_chars`.
+///
+/// Usage: gta3sc-bench-numbers [file.sc] [iterations]
+///
+/// Without a file, a synthetic mission script dense with coordinates is used.
+///
+#include <stdinc.h>
+#include <chrono>
+
+/// Builds a mission-like script with lots of coordinates, headings and model/timer integers.
+static std::string synthetic_script(size_t num_lines)
+{
+    std::string output;
+    uint32_t seed = 0x2A2A2A2A;
+
+    auto rand = [&] {
+        seed = seed * 1664525u + 1013904223u;
+        return seed >> 8;
+    };
+
+    auto coord = [&] {
+        return fmt::format("{}{}.{:04}", (rand() % 2)? "-" : "", rand() % 3000, rand() % 10000);
+    };
+
+    for(size_t i = 0; i < num_lines; ++i)
+    {
+        switch(i % 4)
+        {
+            case 0:
+                output += fmt::format("CREATE_CAR {} {} {} {} car\n", 400 + rand() % 200, coord(), coord(), coord());
+                break;
+            case 1:
+                output += fmt::format("SET_CAR_HEADING car {}\n", coord());
+                break;
+            case 2:
+                output += fmt::format("IS_CHAR_IN_AREA_3D scplayer {} {} {} {} {} {} 0\n",
+                                      coord(), coord(), coord(), coord(), coord(), coord());
+                break;
+            case 3:
+                output += fmt::format("WAIT {}\nlocal_timer = 0x{:X}\n", rand() % 5000, rand());
+                break;
+        }
+    }
+
+    return output;
+}
+
+/// Collects the numeric tokens of the script, classifying them the way the lexer does.
+static void collect_numbers(const std::string& script,
+                            std::vector<string_view>& integers, std::vector<string_view>& floats)
+{
+    auto is_white = [](char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == ','; };
+
+    for(auto it = script.begin(); it != script.end(); )
+    {
+        auto begin = std::find_if_not(it, script.end(), is_white);
+        auto end = std::find_if(begin, script.end(), is_white);
+        it = end;
+
+        if(begin == end || !((*begin >= '0' && *begin <= '9') || *begin == '-' || *begin == '.'))
+            continue;
+
+        string_view token(&*begin, size_t(end - begin));
+
+        if(std::all_of(token.begin(), token.end(), [](char c) { return (c >= '0' && c <= '9') || c == '-'; })
+        || (token.size() > 2 && token[0] == '0' && (token[1] == 'x' || token[1] == 'X')))
+            integers.emplace_back(token);
+        else if(std::all_of(token.begin(), token.end(), [](char c) { return (c >= '0' && c <= '9') || c == '-' || c == '.' || c == 'f' || c == 'F'; }))
+            floats.emplace_back(token);
+    }
+}
+
+template<typename Func>
+static double measure(size_t iterations, Func func)
+{
+    auto start = std::chrono::steady_clock::now();
+    for(size_t i = 0; i < iterations; ++i)
+        func();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(end - start).count();
+}
+
+int main(int argc, char* argv[])
+{
+    std::string script;
+    size_t iterations = 20;
+
+    if(argc > 1)
+    {
+        if(auto opt = read_file_utf8(argv[1]))
+            script = std::move(*opt);
+        else
+            return fprintf(stderr, "could not read '%s'\n", argv[1]), EXIT_FAILURE;
+    }
+    else
+    {
+        script = synthetic_script(100000);
+    }
+
+    if(argc > 2)
+        from_chars(argv[2], argv[2] + strlen(argv[2]), iterations);
+
+    std::vector<string_view> integers, floats;
+    collect_numbers(script, integers, floats);
+
+    size_t num_tokens = integers.size() + floats.size();
+    size_t num_bytes = 0;
+    for(auto& t : integers) num_bytes += t.size();
+    for(auto& t : floats) num_bytes += t.size();
+
+    volatile int64_t sink = 0;
+
+    double legacy = measure(iterations, [&] {
+        for(auto& t : integers)
+        {
+            try { sink = std::stoll(t.to_string(), nullptr, 0); } catch(const std::exception&) {}
+        }
+        for(auto& t : floats)
+        {
+            try { sink = int64_t(std::stof(t.to_string())); } catch(const std::exception&) {}
+        }
+    });
+
+    double charconv = measure(iterations, [&] {
+        for(auto& t : integers)
+        {
+            int64_t value = 0;
+            from_chars_prefixed(t.data(), t.data() + t.size(), value);
+            sink = value;
+        }
+        for(auto& t : floats)
+        {
+            float value = 0.0f;
+            from_chars(t.data(), t.data() + t.size(), value);
+            sink = int64_t(value);
+        }
+    });
+
+    size_t mismatches = 0;
+    for(auto& t : floats)
+    {
+        float value = 0.0f;
+        from_chars(t.data(), t.data() + t.size(), value);
+        if(value != std::strtof(t.to_string().c_str(), nullptr))
+            ++mismatches;
+    }
+
+    auto report = [&](const char* name, double seconds) {
+        double total_tokens = double(num_tokens) * iterations;
+        double total_bytes = double(num_bytes) * iterations;
+        fprintf(stdout, "%-12s %10.2f ns/literal %10.2f MB/s\n", name,
+                (seconds * 1e9) / total_tokens, (total_bytes / (1024.0 * 1024.0)) / seconds);
+    };
+
+    fprintf(stdout, "%zu integer literals, %zu float literals, %zu iterations\n", integers.size(), floats.size(), iterations);
+    report("stoi/stof", legacy);
+    report("from_chars", charconv);
+    fprintf(stdout, "speedup: %.2fx\n", legacy / charconv);
+
+    if(mismatches != 0)
+    {
+        fprintf(stderr, "%zu float literals were not parsed as strtof does\n", mismatches);
+        return EXIT_FAILURE;
+    }
+
+    return 0;
+}
@@ -0,0 +1,207 @@
+///
+/// Variable Table Benchmark
+///
+/// Measures `compile` on a synthetic mission-heavy project: many missions with frames of hundreds of locals, which
+/// call procedures (CLEO_CALL) passing dozens of arguments into other large frames, plus thousands of global variables.
+///
+/// This stresses the variable tables of the compiler, that is, the offset to variable lookups of the script inputs,
+/// the size of the global variable space, and the local frame sizes of the missions in the SCM header.
+///
+/// The results are written as JSON, so regressions can be tracked per commit.
+///
+/// Usage: gta3sc-bench-symbols [--scale=<n>] [--iterations=<n>] [-o <file>]
+///
+#include <stdinc.h>
+#include <chrono>
+#include "driver.hpp"
+
+#ifdef GTA3SC_USING_GIT_DESCRIBE
+extern const char* GTA3SC_GIT_SHA1;
+#else
+const char* GTA3SC_GIT_SHA1 = "";
+#endif
+
+/// Composition of the synthetic project.
+struct SyntheticProject
+{
+    size_t globals;             //< Global variables in main.sc.
+    size_t missions;            //< Missions, each with a frame of `locals` variables.
+    size_t locals;              //< Local variables of each frame (SA allows 990 in missions).
+    size_t procedures;          //< Procedures of each mission, each with its own frame.
+    size_t calls;               //< CLEO_CALL commands per procedure.
+    size_t arguments;           //< Arguments of each CLEO_CALL.
+};
+
+/// Writes the GTA3script sources of `project` into `dir`.
+static void write_project(const SyntheticProject& project, const fs::path& dir)
+{
+    std::error_code ec;
+    fs::remove_all(dir, ec);
+    fs::create_directories(dir / "main");
+
+    auto write = [&](const fs::path& path, const std::string& source)
+    {
+        FILE* f = u8fopen(path, "wb");
+        if(!f) throw std::runtime_error(fmt::format("could not write '{}'", path.generic_u8string()));
+        fwrite(source.data(), 1, source.size(), f);
+        fclose(f);
+    };
+
+    auto declare = [](std::string& out, const char* keyword, const char* prefix, size_t count)
+    {
+        for(size_t i = 0; i < count; i += 16)
+        {
+            out += keyword;
+            for(size_t k = i; k < std::min(count, i + 16); ++k)
+                out += fmt::format(" {}{}", prefix, k);
+            out += '\n';
+        }
+    };
+
+    std::string main;
+    declare(main, "VAR_INT", "g_", project.globals);
+    main += "{\nLVAR_INT i\n";
+    for(size_t m = 0; m < project.missions; ++m)
+        main += fmt::format("LOAD_AND_LAUNCH_MISSION m{}.sc\n", m);
+    main += "main_loop:\nWAIT 0\ng_0 = i\nGOTO main_loop\n}\n";
+    write(dir / "main.sc", main);
+
+    for(size_t m = 0; m < project.missions; ++m)
+    {
+        std::string mission = "MISSION_START\n{\n";
+        declare(mission, "LVAR_INT", "l", project.locals);
+
+        for(size_t p = 0; p < project.procedures; ++p)
+        {
+            for(size_t c = 0; c < project.calls; ++c)
+            {
+                mission += fmt::format("CLEO_CALL m{}_proc{} 0", m, p);
+                for(size_t a = 0; a < project.arguments; ++a)
+                    mission += fmt::format(" l{}", (c * project.arguments + a) % project.locals);
+                mission += '\n';
+            }
+        }
+
+        mission += fmt::format("g_{} = l0\nMISSION_END\n}}\n", m % project.globals);
+
+        for(size_t p = 0; p < project.procedures; ++p)
+        {
+            mission += fmt::format("{{\nm{}_proc{}:\n", m, p);
+            declare(mission, "LVAR_INT", "p", project.locals);
+            mission += "CLEO_RETURN 0\n}\n";
+        }
+
+        write(dir / "main" / fmt::format("m{}.sc", m), mission);
+    }
+}
+
+static std::string json_string(const std::string& s)
+{
+    std::string out = "\"";
+    for(char c : s)
+    {
+        if(c == '"' || c == '\\')
+            out.push_back('\\');
+        if(static_cast<unsigned char>(c) < 0x20)
+            out += fmt::format("\\u{:04x}", c);
+        else
+            out.push_back(c);
+    }
+    return out + '"';
+}
+
+int main(int argc, char* argv[])
+{
+    optional<fs::path> output_path;
+    size_t scale = 1;
+    size_t iterations = 5;
+
+    for(int i = 1; i < argc; ++i)
+    {
+        string_view arg = argv[i];
+        auto value = [&](const char* prefix) -> const char* {
+            return arg.substr(0, strlen(prefix)) == prefix? argv[i] + strlen(prefix) : nullptr;
+        };
+
+        if(auto n = value("--scale="))
+            from_chars(n, n + strlen(n), scale);
+        else if(auto n = value("--iterations="))
+            from_chars(n, n + strlen(n), iterations);
+        else if(arg == "-o" && i + 1 < argc)
+            output_path = fs::u8path(argv[++i]);
+        else
+            return fprintf(stderr, "unrecognized argument '%s'\n", argv[i]), EXIT_FAILURE;
+    }
+
+    scale = std::max<size_t>(scale, 1);
+    iterations = std::max<size_t>(iterations, 1);
+
+    SyntheticProject project = { 4000, 40 * scale, 900, 4, 20, 30 };
+
+    auto dir = fs::temp_directory_path() / "gta3sc-bench-symbols";
+    fprintf(stderr, "writing %zu missions...\n", project.missions);
+    write_project(project, dir);
+
+    auto log = [](const std::string& msg) { fprintf(stderr, "%s\n", msg.c_str()); };
+    auto out = [](const std::string&) {};
+
+    std::string input = (dir / "main.sc").u8string();
+    std::string output = (dir / "main.scm").u8string();
+    std::vector<std::string> args = { "compile", input, "--config=gtasa", "--guesser", "-fcleo", "-Wno-expect-var", "-o", output };
+
+    std::vector<char*> cargs;
+    for(auto& arg : args) cargs.emplace_back(&arg[0]);
+    cargs.emplace_back(nullptr);
+
+    Invocation invocation;
+    if(!parse_invocation(cargs.data(), invocation, log) || !validate_invocation(invocation, log))
+        return EXIT_FAILURE;
+
+    optional<GameConfig> config;
+    try
+    {
+        config = load_config(invocation);
+    }
+    catch(const ConfigError& e)
+    {
+        return fprintf(stderr, "gta3sc: error: %s\n", e.what()), EXIT_FAILURE;
+    }
+
+    std::vector<double> times;
+    for(size_t i = 0; i < iterations; ++i)
+    {
+        fprintf(stderr, "compiling (%zu/%zu)...\n", i + 1, iterations);
+        auto start = std::chrono::steady_clock::now();
+        if(run_invocation(invocation, *config, out, log) != EXIT_SUCCESS)
+            return fprintf(stderr, "failed to compile the synthetic project\n"), EXIT_FAILURE;
+        auto end = std::chrono::steady_clock::now();
+        times.emplace_back(std::chrono::duration<double>(end - start).count());
+    }
+
+    std::sort(times.begin(), times.end());
+    double total = std::accumulate(times.begin(), times.end(), 0.0);
+
+    std::string json = fmt::format("{{\n  \"commit\": {},\n  \"scale\": {},\n  \"iterations\": {},\n"
+                                   "  \"project\": {{\"globals\": {}, \"missions\": {}, \"locals\": {}, "
+                                   "\"procedures\": {}, \"calls\": {}, \"arguments\": {}}},\n"
+                                   "  \"compile\": {{\"min_seconds\": {:.6f}, \"median_seconds\": {:.6f}, \"mean_seconds\": {:.6f}}}\n}}\n",
+                                   json_string(GTA3SC_GIT_SHA1), scale, iterations,
+                                   project.globals, project.missions, project.locals,
+                                   project.procedures, project.calls, project.arguments,
+                                   times.front(), times[times.size() / 2], total / times.size());
+
+    if(output_path)
+    {
+        FILE* f = u8fopen(*output_path, "wb");
+        if(!f)
+            return fprintf(stderr, "could not write '%s'\n", output_path->generic_u8string().c_str()), EXIT_FAILURE;
+        fputs(json.c_str(), f);
+        fclose(f);
+    }
+    else
+    {
+        fputs(json.c_str(), stdout);
+    }
+
+    return 0;
+}
@@ -0,0 +1,900 @@
+///
+/// Decompiler Fuzzer
+///
+/// Mutates SCM images and decompiles them in-process, looking for inputs the decompiler can't cope with. The seed
+/// images are built by the compiler itself (missions, streamed scripts, arrays, SWITCH tables, OATC headers), plus any
+/// user-provided image. No external fuzzing engine is needed.
+///
+/// Each input is a seed with a few stacked mutations: random bytes, truncations, splices, tweaks to the fields of the
+/// SCM header (found by its layout, see `ScmHeaderLayout`), bogus OATC tables and absurd SWITCH case counts. The input
+/// is then decompiled, by linear sweep or recursive traversal, into IR2 or GTA3script. The following are found:
+///
+///  + Crashes, that is, exceptions escaping `decompile` (e.g. a `bad_optional_access`, or a broken contract), and
+///    signals (e.g. a segmentation fault), after which the fuzzer stops.
+///  + Timeouts, inputs taking longer than `--timeout`, after which the fuzzer stops as well.
+///  + Slow inputs, taking more than `--slow-factor` times as long as their seed, and at least `--slow` milliseconds.
+///
+/// Crashes by exception and slow inputs are minimized before being written. Every reproducer is written into its own
+/// directory inside `--artifacts` as a `main.scm` (and `script.img`), so it can be ran by `gta3sc decompile` directly.
+/// A summary is written as JSON at the end, with the number of executions per second. It's not written when a signal or
+/// a timeout stops the fuzzer, which then exits with 1 or 2 respectively.
+///
+/// Usage: gta3sc-fuzz-decompiler [--images=<dir>] [--seed=<n>] [--runs=<n>] [--max-time=<s>] [--timeout=<ms>]
+///                               [--slow=<ms>] [--slow-factor=<n>] [--artifacts=<dir>] [-o <file>]
+///
+/// User images are found at `<dir>/<config>/*.scm` (e.g. `images/gtasa/main.scm`). A `script.img` next to a
+/// `main.scm` is used as its streamed scripts.
+///
+#include <stdinc.h>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <random>
+#include <thread>
+#include "driver.hpp"
+#include "disassembler.hpp"
+#include "scm_header.hpp"
+
+#ifdef GTA3SC_USING_GIT_DESCRIBE
+extern const char* GTA3SC_GIT_SHA1;
+#else
+const char* GTA3SC_GIT_SHA1 = "";
+#endif
+
+/// A image to be decompiled.
+struct Input
+{
+    std::vector<uint8_t>    main_scm;
+    std::vector<uint8_t>    script_img;     //< Empty if the image has no streamed scripts.
+
+    size_t size() const { return main_scm.size() + script_img.size(); }
+};
+
+/// A seed image and the way to decompile it.
+struct Seed
+{
+    std::string                     name;
+    std::string                     config;
+    std::vector<std::string>        args;       //< Options besides `--config`.
+    Input                           input;
+    optional<Invocation>            invocation;
+    shared_ptr<const GameConfig>    game;
+    double                          baseline = 0.0; //< Seconds taken to decompile the unmutated seed.
+};
+
+/// The way a input is decompiled.
+struct Variant
+{
+    bool            linear_sweep;
+    Options::Lang   lang;
+};
+
+struct ExecResult
+{
+    bool        crashed = false;
+    std::string what;               //< Description of the crash.
+    double      seconds = 0.0;
+};
+
+struct Finding
+{
+    std::string kind;               //< "crash" or "slow".
+    std::string what;
+    std::string seed;
+    std::string directory;          //< Where the reproducer is.
+    size_t      size;               //< Size of the minimized input.
+    double      seconds;
+};
+
+// The state the signal handler and the watchdog need to write a reproducer.
+static const Input*             current_input = nullptr;
+static const Seed*              current_seed = nullptr;
+static Variant                  current_variant;
+static fs::path                 artifacts_dir;
+static std::atomic<int64_t>     exec_started_at {0};    //< In nanoseconds since the epoch of steady_clock, or zero.
+
+static int64_t now_ns()
+{
+    auto since_epoch = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(since_epoch).count();
+}
+
+/// Runs `gta3sc args...` in-process. The game configs are loaded once.
+static int run_gta3sc(std::vector<std::string> args, std::string* output = nullptr,
+                      optional<Invocation>* parsed = nullptr, shared_ptr<const GameConfig>* parsed_config = nullptr)
+{
+    static std::map<std::string, shared_ptr<const GameConfig>> configs;
+
+    auto log = [](const std::string& msg) { fprintf(stderr, "%s\n", msg.c_str()); };
+    auto out = [&](const std::string& text) { if(output) *output += text; };
+
+    std::vector<char*> argv;
+    for(auto& arg : args) argv.emplace_back(&arg[0]);
+    argv.emplace_back(nullptr);
+
+    Invocation invocation;
+    if(!parse_invocation(argv.data(), invocation, log) || !validate_invocation(invocation, log))
+        return EXIT_FAILURE;
+
+    auto& config = configs[config_key(invocation)];
+    try
+    {
+        if(!config)
+            config = std::make_shared<const GameConfig>(load_config(invocation));
+    }
+    catch(const ConfigError& e)
+    {
+        log(fmt::format("gta3sc: error: {}", e.what()));
+        return EXIT_FAILURE;
+    }
+
+    if(parsed) parsed->emplace(invocation);
+    if(parsed_config) *parsed_config = config;
+
+    return output? run_invocation(invocation, *config, out, log) : EXIT_SUCCESS;
+}
+
+/// Compiles the seed `name` from `sources` (the main script first) in `dir`.
+static optional<Seed> build_seed(const std::string& name, const std::string& config, std::vector<std::string> args,
+                                 const std::vector<std::pair<std::string, std::string>>& sources, const fs::path& dir)
+{
+    std::error_code ec;
+    fs::remove_all(dir, ec);
+    fs::create_directories(dir / "main");
+
+    for(auto& source : sources)
+    {
+        // Scripts other than the main one must be in the subdirectory named after it.
+        auto path = (&source == &sources.front())? dir / source.first : dir / "main" / source.first;
+        FILE* f = u8fopen(path, "wb");
+        if(!f) throw std::runtime_error(fmt::format("could not write '{}'", path.generic_u8string()));
+        fwrite(source.second.data(), 1, source.second.size(), f);
+        fclose(f);
+    }
+
+    std::vector<std::string> compile_args = { "compile", (dir / sources.front().first).u8string(),
+                                              "-o", (dir / "main.scm").u8string(),
+                                              fmt::format("--config={}", config), "-Wno-expect-var" };
+    compile_args.insert(compile_args.end(), args.begin(), args.end());
+
+    std::string ignored;
+    if(run_gta3sc(compile_args, &ignored) != EXIT_SUCCESS)
+        return nullopt;
+
+    Seed seed;
+    seed.name = name;
+    seed.config = config;
+    seed.args = { "--guesser" };
+    seed.input.main_scm = read_file_binary(dir / "main.scm").value();
+    if(fs::exists(dir / "script.img"))
+        seed.input.script_img = read_file_binary(dir / "script.img").value();
+    return seed;
+}
+
+/// Builds the seeds from the compiler.
+static std::vector<Seed> build_seeds(const fs::path& dir)
+{
+    auto main_source = [](bool sa) {
+        return fmt::format(
+            "VAR_INT g_state g_obj{}\n"
+            "VAR_FLOAT g_x\n"
+            "LOAD_AND_LAUNCH_MISSION m0.sc\n"
+            "LOAD_AND_LAUNCH_MISSION m1.sc\n"
+            "{}"
+            "CREATE_OBJECT lhouse 0.0 0.0 0.0 g_obj\n"
+            "main_loop:\n"
+            "WAIT 0\n"
+            "GOSUB sub\n"
+            "{{\n"
+            "    LVAR_INT i j\n"
+            "    IF IS_BUTTON_PRESSED 0 1\n"
+            "    OR g_state > 3\n"
+            "        PRINT_HELP HELP1\n"
+            "    ELSE\n"
+            "        GET_GAME_TIMER j\n"
+            "    ENDIF\n"
+            "    WHILE g_x < 100.0\n"
+            "        WAIT 0\n"
+            "        g_x += 1.5\n"
+            "    ENDWHILE\n"
+            "    REPEAT 8 i\n"
+            "        {}\n"
+            "    ENDREPEAT\n"
+            "{}"
+            "}}\n"
+            "GOTO main_loop\n"
+            "sub:\n"
+            "GENERATE_RANDOM_INT_IN_RANGE 0 10 g_state\n"
+            "RETURN\n",
+            sa? " g_flags[8]" : "",
+            sa? "REGISTER_STREAMED_SCRIPT s0 s0.sc\n" : "",
+            sa? "g_flags[i] = i" : "g_state += i",
+            sa? "    SWITCH g_state\n"
+                "    CASE 1\n"
+                "        PRINT_HELP CASE1\n"
+                "        BREAK\n"
+                "    CASE 7\n"
+                "    CASE 9\n"
+                "        g_state = 0\n"
+                "        BREAK\n"
+                "    DEFAULT\n"
+                "        WAIT 10\n"
+                "        BREAK\n"
+                "    ENDSWITCH\n" : "");
+    };
+
+    auto mission_source = [](int id) {
+        return fmt::format(
+            "MISSION_START\n"
+            "SCRIPT_NAME m{}\n"
+            "{{\n"
+            "    LVAR_INT k\n"
+            "    LVAR_FLOAT f\n"
+            "    REPEAT {} k\n"
+            "        f += 2.0\n"
+            "        WAIT 0\n"
+            "    ENDREPEAT\n"
+            "}}\n"
+            "MISSION_END\n", id, 2 + id);
+    };
+
+    const std::string stream_source =
+        "SCRIPT_START\n"
+        "SCRIPT_NAME s0\n"
+        "{\n"
+        "    LVAR_INT s\n"
+        "    WHILE s < 10\n"
+        "        WAIT 250\n"
+        "        s += 1\n"
+        "    ENDWHILE\n"
+        "}\n"
+        "SCRIPT_END\n";
+
+    auto sources = [&](bool sa) {
+        std::vector<std::pair<std::string, std::string>> files = {
+            { "main.sc", main_source(sa) }, { "m0.sc", mission_source(0) }, { "m1.sc", mission_source(1) },
+        };
+        if(sa) files.emplace_back("s0.sc", stream_source);
+        return files;
+    };
+
+    struct { const char* name; const char* config; std::vector<std::string> args; bool sa; } recipes[] = {
+        { "seed-gta3",       "gta3",  {},                                   false },
+        { "seed-gtavc",      "gtavc", {},                                   false },
+        { "seed-gtasa",      "gtasa", { "--guesser" },                      true },
+        { "seed-gtasa-oatc", "gtasa", { "--guesser", "-fcleo", "-moatc" },  true },
+    };
+
+    std::vector<Seed> seeds;
+    for(auto& recipe : recipes)
+    {
+        auto seed = build_seed(recipe.name, recipe.config, recipe.args, sources(recipe.sa), dir / recipe.name);
+        if(!seed)
+            throw std::runtime_error(fmt::format("failed to build {}", recipe.name));
+        seeds.emplace_back(std::move(*seed));
+    }
+    return seeds;
+}
+
+/// Finds the user images at `<dir>/<config>/*.scm`.
+static std::vector<Seed> find_user_images(const fs::path& dir)
+{
+    std::vector<Seed> seeds;
+
+    for(auto& config_entry : fs::directory_iterator(dir))
+    {
+        if(!fs::is_directory(config_entry.path()))
+            continue;
+
+        for(auto& entry : fs::directory_iterator(config_entry.path()))
+        {
+            auto& path = entry.path();
+            if(!iequal_to()(path.extension().u8string(), ".scm"))
+                continue;
+
+            Seed seed;
+            seed.name = (config_entry.path().filename() / path.filename()).generic_u8string();
+            seed.config = config_entry.path().filename().u8string();
+            seed.args = { "--guesser" };
+            seed.input.main_scm = read_file_binary(path).value();
+
+            auto img_path = fs::path(path).replace_filename("script.img");
+            if(iequal_to()(path.filename().u8string(), "main.scm") && fs::exists(img_path))
+                seed.input.script_img = read_file_binary(img_path).value();
+
+            seeds.emplace_back(std::move(seed));
+        }
+    }
+
+    std::sort(seeds.begin(), seeds.end(), [](const Seed& a, const Seed& b) { return a.name < b.name; });
+    return seeds;
+}
+
+/// Decompiles `input` the way `seed` is decompiled.
+static ExecResult execute(const Seed& seed, const Input& input, const Variant& variant)
+{
+    Options options = seed.invocation->options;
+    options.linear_sweep = variant.linear_sweep;
+
+    // The streamed scripts are only decompiled if there's a script.img, as `decompile` requires it.
+    options.streamed_scripts = options.streamed_scripts && !input.script_img.empty();
+
+    current_input = &input;
+    current_seed = &seed;
+    current_variant = variant;
+
+    ExecResult result;
+    auto start = now_ns();
+    exec_started_at = start;
+
+    try
+    {
+        ProgramContext program(options, seed.game->commands, TextSink());
+        decompile(input.main_scm.data(), input.main_scm.size(),
+                  input.script_img.empty()? nullptr : input.script_img.data(), input.script_img.size(),
+                  program, variant.lang, [](const std::string&) {});
+    }
+    catch(const std::exception& e)
+    {
+        result.crashed = true;
+        result.what = fmt::format("uncaught exception: {}", e.what());
+    }
+    catch(...)
+    {
+        result.crashed = true;
+        result.what = "uncaught exception of unknown type";
+    }
+
+    exec_started_at = 0;
+    result.seconds = double(now_ns() - start) / 1e9;
+    return result;
+}
+
+/// Writes `input` into `dir` as a `main.scm` (and `script.img`), and how to decompile it.
+static void write_reproducer(const fs::path& dir, const Input& input, const Seed& seed, const Variant& variant,
+                             const std::string& what)
+{
+    std::error_code ec;
+    fs::create_directories(dir, ec);
+
+    auto write = [&](const fs::path& path, const void* data, size_t size) {
+        if(FILE* f = u8fopen(path, "wb"))
+        {
+            fwrite(data, 1, size, f);
+            fclose(f);
+        }
+    };
+
+    write(dir / "main.scm", input.main_scm.data(), input.main_scm.size());
+    if(!input.script_img.empty())
+        write(dir / "script.img", input.script_img.data(), input.script_img.size());
+
+    std::string command = fmt::format("gta3sc decompile main.scm --config={}", seed.config);
+    for(auto& arg : seed.args) command += " " + arg;
+    if(!variant.linear_sweep) command += " --recursive-traversal";
+    if(variant.lang == Options::Lang::IR2) command += " -emit-ir2";
+    if(input.script_img.empty() && seed.config == "gtasa") command += " -fno-streamed-scripts";
+    command += " -o -\n";
+
+    std::string readme = fmt::format("{}\n\n{}", what, command);
+    write(dir / "README.txt", readme.data(), readme.size());
+}
+
+/// Directory name for a reproducer of `input`.
+static std::string artifact_name(const char* kind, const Input& input)
+{
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for(auto b : input.main_scm) hash = (hash ^ b) * 16777619u;
+    for(auto b : input.script_img) hash = (hash ^ b) * 16777619u;
+    return fmt::format("{}-{:08x}", kind, hash);
+}
+
+/// Writes the reproducer of the input being decompiled, from a signal handler or the watchdog, then exits.
+///
+/// This isn't async-signal-safe, but the process is going down anyway.
+[[noreturn]] static void die_with_reproducer(const char* kind, const std::string& what)
+{
+    if(current_input && current_seed)
+    {
+        auto dir = artifacts_dir / artifact_name(kind, *current_input);
+        write_reproducer(dir, *current_input, *current_seed, current_variant, what);
+        fprintf(stderr, "%s: %s (seed %s), reproducer written into '%s'\n", kind, what.c_str(),
+                current_seed->name.c_str(), dir.generic_u8string().c_str());
+    }
+    fflush(stderr);
+    std::_Exit(kind == std::string("timeout")? 2 : 1);
+}
+
+extern "C" void on_fatal_signal(int sig)
+{
+    die_with_reproducer("crash", fmt::format("signal {}", sig));
+}
+
+/// Mutates images.
+class Mutator
+{
+public:
+    explicit Mutator(uint32_t seed) :
+        rng(seed)
+    {}
+
+    uint32_t rand(uint32_t n) { return n? std::uniform_int_distribution<uint32_t>(0, n - 1)(rng) : 0; }
+
+    /// Applies one to four mutations to `input`, whose header has the given `layout`. Pieces of `other` may be
+    /// spliced into it.
+    void mutate(Input& input, const ScmHeaderLayout& layout, const Commands& commands, const Seed& other)
+    {
+        auto num_mutations = 1 + rand(4);
+        for(size_t i = 0; i < num_mutations; ++i)
+        {
+            auto& bytes = (!input.script_img.empty() && rand(10) == 0)? input.script_img : input.main_scm;
+            if(bytes.empty())
+                return;
+
+            switch(rand(8))
+            {
+                case 0: random_bytes(bytes); break;
+                case 1: interesting_value(bytes, rand(uint32_t(bytes.size()))); break;
+                case 2: truncate(bytes); break;
+                case 3: splice(bytes, other.input.main_scm); break;
+                case 4: case 5: header_field(input.main_scm, layout); break;
+                case 6: oatc_table(input.main_scm); break;
+                case 7: switch_cases(input.main_scm, commands); break;
+            }
+        }
+    }
+
+private:
+    std::mt19937 rng;
+
+    /// Writes `size` bytes of `value` (little endian) at `offset`, as far as `bytes` goes.
+    static void put(std::vector<uint8_t>& bytes, size_t offset, uint32_t value, size_t size)
+    {
+        for(size_t i = 0; i < size && offset + i < bytes.size(); ++i)
+            bytes[offset + i] = uint8_t(value >> (8 * i));
+    }
+
+    static uint32_t get_u32(const std::vector<uint8_t>& bytes, size_t offset)
+    {
+        uint32_t value = 0;
+        for(size_t i = 0; i < 4 && offset + i < bytes.size(); ++i)
+            value |= uint32_t(bytes[offset + i]) << (8 * i);
+        return value;
+    }
+
+    /// \returns a value likely to break a size, count or offset in `bytes`.
+    uint32_t interesting(const std::vector<uint8_t>& bytes)
+    {
+        const uint32_t size = uint32_t(bytes.size());
+        const uint32_t values[] = {
+            0, 1, 0x7F, 0x80, 0xFF, 0x7FFF, 0x8000, 0xFFFF, 0x7FFFFFFF, 0x80000000, 0xFFFFFFFF,
+            size - 1, size, size + 1, size / 2,
+        };
+        if(rand(4) == 0)
+            return uint32_t(rng());
+        return values[rand(uint32_t(std::extent<decltype(values)>::value))];
+    }
+
+    void random_bytes(std::vector<uint8_t>& bytes)
+    {
+        auto count = 1 + rand(8);
+        for(size_t i = 0; i < count; ++i)
+        {
+            auto& byte = bytes[rand(uint32_t(bytes.size()))];
+            byte = rand(2)? uint8_t(byte ^ (1 << rand(8))) : uint8_t(rng());
+        }
+    }
+
+    void interesting_value(std::vector<uint8_t>& bytes, size_t offset)
+    {
+        const size_t sizes[] = { 1, 2, 4 };
+        put(bytes, offset, interesting(bytes), sizes[rand(3)]);
+    }
+
+    void truncate(std::vector<uint8_t>& bytes)
+    {
+        bytes.resize(rand(uint32_t(bytes.size())));
+    }
+
+    /// Copies a piece of `other` over `bytes`.
+    void splice(std::vector<uint8_t>& bytes, const std::vector<uint8_t>& other)
+    {
+        if(other.empty())
+            return;
+        auto from = rand(uint32_t(other.size()));
+        auto to = rand(uint32_t(bytes.size()));
+        auto count = std::min<size_t>({ 1 + rand(64), other.size() - from, bytes.size() - to });
+        std::copy_n(other.begin() + from, count, bytes.begin() + to);
+    }
+
+    /// Tweaks a field of the header, or the jump over a segment.
+    void header_field(std::vector<uint8_t>& bytes, const ScmHeaderLayout& layout)
+    {
+        auto opt_view = ScmHeaderView::from_bytecode(bytes.data(), bytes.size(), layout);
+        if(!opt_view)
+            return random_bytes(bytes);
+
+        if(rand(4) == 0)
+        {
+            // the target of the jump over a segment
+            size_t offset = 0;
+            for(auto n = rand(uint32_t(layout.segments.size())); n > 0; --n)
+                offset = get_u32(bytes, offset + 3);
+            return put(bytes, offset + 3, interesting(bytes), 4);
+        }
+
+        std::vector<ScmHeaderField> fields;
+        for(auto& segment : layout.segments)
+        {
+            for(auto* list : { &segment.fields, &segment.record })
+            {
+                for(auto& field : *list)
+                {
+                    if(field.id != ScmHeaderField::None && field.type != ScmHeaderLayout::Type::Padding)
+                        fields.emplace_back(field.id);
+                }
+            }
+        }
+
+        auto field = fields[rand(uint32_t(fields.size()))];
+        auto loc = layout.find(field).value();
+        if(loc.in_record && opt_view->count(field) == 0)
+            return;
+
+        auto index = loc.in_record? rand(uint32_t(opt_view->count(field))) : 0;
+        auto offset = opt_view->offset(field, index);
+
+        if(loc.type == ScmHeaderLayout::Type::Chars)
+        {
+            // a name without its null terminator
+            for(size_t i = 0; i < loc.size; ++i)
+                bytes[offset + i] = uint8_t('A' + rand(26));
+        }
+        else
+        {
+            put(bytes, offset, interesting(bytes), loc.size);
+        }
+    }
+
+    /// Tweaks the table of a OATC header.
+    void oatc_table(std::vector<uint8_t>& bytes)
+    {
+        static const uint8_t fourcc[] = { 'O', 'A', 'T', 'C' };
+        auto it = std::search(bytes.begin(), bytes.end(), std::begin(fourcc), std::end(fourcc));
+        if(it == bytes.end())
+            return random_bytes(bytes);
+
+        size_t oatc = it - bytes.begin();
+        size_t num_ordinals = get_u32(bytes, oatc + 6) & 0xFFFF;
+
+        switch(rand(4))
+        {
+            case 0: // number of ordinals
+                put(bytes, oatc + 6, interesting(bytes), 2);
+                break;
+            case 1: // the jump over the custom header
+                if(oatc >= 12) put(bytes, oatc - 12 + 3, interesting(bytes), 4);
+                break;
+            case 2: // the hash or the name offset of a ordinal
+            case 3:
+                if(num_ordinals)
+                {
+                    auto entry = oatc + 8 + 12 * rand(uint32_t(num_ordinals));
+                    put(bytes, entry + 4 + 4 * rand(2), interesting(bytes), 4);
+                }
+                break;
+        }
+    }
+
+    /// Tweaks the arguments of a `SWITCH_START` or `SWITCH_CONTINUED`, usually the number of cases.
+    void switch_cases(std::vector<uint8_t>& bytes, const Commands& commands)
+    {
+        std::vector<size_t> offsets;
+        for(auto& command : { commands.switch_start, commands.switch_continued })
+        {
+            if(!command || !command->id)
+                continue;
+
+            for(size_t i = 0; i + 2 <= bytes.size(); ++i)
+            {
+                if(bytes[i] == uint8_t(*command->id) && bytes[i + 1] == uint8_t(*command->id >> 8))
+                    offsets.emplace_back(i);
+            }
+        }
+
+        if(offsets.empty())
+            return random_bytes(bytes);
+
+        auto offset = offsets[rand(uint32_t(offsets.size()))] + 2;
+
+        // Skips the variable (SWITCH_START) to reach the number of cases, or a random number of arguments.
+        for(auto skip = rand(3) == 0? rand(8) : 1; skip > 0 && offset < bytes.size(); --skip)
+        {
+            switch(bytes[offset])
+            {
+                case 0x01: case 0x06: offset += 5; break;   // int32, float
+                case 0x02: case 0x03: case 0x05: offset += 3; break;   // variables, int16
+                case 0x04: offset += 2; break;              // int8
+                default: offset += 1 + rand(4); break;
+            }
+        }
+
+        if(offset + 1 >= bytes.size())
+            return;
+
+        if(rand(4) == 0)
+            bytes[offset] = uint8_t(rand(0x10));    // the data type
+        else
+            put(bytes, offset + 1, interesting(bytes), bytes[offset] == 0x04? 1 : bytes[offset] == 0x05? 2 : 4);
+    }
+};
+
+/// Shrinks `input` while `still_fails` it, with at most `max_execs` attempts.
+template<typename Pred>
+static Input minimize(Input input, Pred still_fails, size_t max_execs)
+{
+    size_t execs = 0;
+    auto attempt = [&](const Input& candidate) {
+        return ++execs <= max_execs && still_fails(candidate);
+    };
+
+    for(auto bytes_ptr : { &Input::main_scm, &Input::script_img })
+    {
+        // shortest failing prefix
+        size_t low = 0, high = (input.*bytes_ptr).size();
+        while(low < high && execs < max_execs)
+        {
+            auto mid = low + (high - low) / 2;
+            Input candidate = input;
+            (candidate.*bytes_ptr).resize(mid);
+            if(attempt(candidate))
+                high = mid, input = std::move(candidate);
+            else
+                low = mid + 1;
+        }
+
+        // remove chunks, halving their size
+        for(size_t chunk = (input.*bytes_ptr).size() / 2; chunk > 0 && execs < max_execs; chunk /= 2)
+        {
+            for(size_t begin = 0; begin + chunk <= (input.*bytes_ptr).size() && execs < max_execs; )
+            {
+                Input candidate = input;
+                auto& bytes = candidate.*bytes_ptr;
+                bytes.erase(bytes.begin() + begin, bytes.begin() + begin + chunk);
+                if(attempt(candidate))
+                    input = std::move(candidate);
+                else
+                    begin += chunk;
+            }
+        }
+    }
+
+    return input;
+}
+
+static std::string json_string(const std::string& s)
+{
+    std::string out = "\"";
+    for(char c : s)
+    {
+        if(c == '"' || c == '\\')
+            out.push_back('\\');
+        if(static_cast<unsigned char>(c) < 0x20)
+            out += fmt::format("\\u{:04x}", c);
+        else
+            out.push_back(c);
+    }
+    return out + '"';
+}
+
+int main(int argc, char* argv[])
+{
+    optional<fs::path> images_dir;
+    optional<fs::path> output_path;
+    uint32_t rng_seed = 1;
+    size_t max_runs = 0;            // unlimited
+    double max_time = 60.0;
+    double timeout = 5.0;
+    double slow_min = 0.05;
+    double slow_factor = 20.0;
+    artifacts_dir = fs::u8path("fuzz-artifacts");
+
+    for(int i = 1; i < argc; ++i)
+    {
+        string_view arg = argv[i];
+        auto value = [&](const char* prefix) -> const char* {
+            return arg.substr(0, strlen(prefix)) == prefix? argv[i] + strlen(prefix) : nullptr;
+        };
+        auto number = [](const char* s) {
+            float n = 0.0f;
+            from_chars(s, s + strlen(s), n);
+            return double(n);
+        };
+
+        auto integer = [&](const char* s, auto& n) {
+            auto result = from_chars(s, s + strlen(s), n);
+            return result.ec == std::errc() && result.ptr == s + strlen(s);
+        };
+
+        if(auto dir = value("--images="))
+            images_dir = fs::u8path(dir);
+        else if(auto n = value("--seed="))
+        {
+            if(!integer(n, rng_seed))
+                return fprintf(stderr, "invalid seed '%s'\n", n), EXIT_FAILURE;
+        }
+        else if(auto n = value("--runs="))
+        {
+            if(!integer(n, max_runs))
+                return fprintf(stderr, "invalid number of runs '%s'\n", n), EXIT_FAILURE;
+        }
+        else if(auto n = value("--max-time="))
+            max_time = number(n);
+        else if(auto n = value("--timeout="))
+            timeout = number(n) / 1000.0;
+        else if(auto n = value("--slow="))
+            slow_min = number(n) / 1000.0;
+        else if(auto n = value("--slow-factor="))
+            slow_factor = number(n);
+        else if(auto dir = value("--artifacts="))
+            artifacts_dir = fs::u8path(dir);
+        else if(arg == "-o" && i + 1 < argc)
+            output_path = fs::u8path(argv[++i]);
+        else
+            return fprintf(stderr, "unrecognized argument '%s'\n", argv[i]), EXIT_FAILURE;
+    }
+
+    std::vector<Seed> seeds;
+    try
+    {
+        fprintf(stderr, "building seeds...\n");
+        seeds = build_seeds(fs::temp_directory_path() / "gta3sc-fuzz-decompiler");
+        if(images_dir)
+        {
+            auto user_images = find_user_images(*images_dir);
+            std::move(user_images.begin(), user_images.end(), std::back_inserter(seeds));
+        }
+    }
+    catch(const std::exception& e)
+    {
+        return fprintf(stderr, "%s\n", e.what()), EXIT_FAILURE;
+    }
+
+    for(auto& seed : seeds)
+    {
+        std::vector<std::string> args = { "decompile", "main.scm", fmt::format("--config={}", seed.config), "-o", "-" };
+        args.insert(args.end(), seed.args.begin(), seed.args.end());
+        if(run_gta3sc(args, nullptr, &seed.invocation, &seed.game) != EXIT_SUCCESS)
+            return fprintf(stderr, "failed to setup %s\n", seed.name.c_str()), EXIT_FAILURE;
+
+        // The unmutated seeds must decompile fine, and give the baseline for slow inputs.
+        seed.baseline = std::numeric_limits<double>::infinity();
+        for(auto linear_sweep : { false, true })
+        {
+            for(auto lang : { Options::Lang::IR2, Options::Lang::GTA3Script })
+            {
+                auto result = execute(seed, seed.input, Variant { linear_sweep, lang });
+                if(result.crashed)
+                    return fprintf(stderr, "seed %s crashes: %s\n", seed.name.c_str(), result.what.c_str()), EXIT_FAILURE;
+                seed.baseline = std::min(seed.baseline, result.seconds);
+            }
+        }
+    }
+
+    std::signal(SIGSEGV, on_fatal_signal);
+    std::signal(SIGABRT, on_fatal_signal);
+    std::signal(SIGFPE, on_fatal_signal);
+    std::signal(SIGILL, on_fatal_signal);
+
+    std::thread watchdog([timeout] {
+        while(true)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            auto started_at = exec_started_at.load();
+            if(started_at && double(now_ns() - started_at) / 1e9 > timeout)
+                die_with_reproducer("timeout", fmt::format("decompilation took longer than {} ms", timeout * 1000.0));
+        }
+    });
+    watchdog.detach();
+
+    Mutator mutator(rng_seed);
+    std::vector<Finding> findings;
+    std::set<std::string> known_crashes;
+    size_t num_slow = 0;
+    size_t runs = 0;
+
+    auto start = now_ns();
+    auto last_status = start;
+    auto elapsed = [&] { return double(now_ns() - start) / 1e9; };
+
+    auto status = [&] {
+        fprintf(stderr, "#%zu  exec/s: %.0f  crashes: %zu  slow: %zu  seeds: %zu\n", runs, runs / std::max(elapsed(), 1e-9),
+                known_crashes.size(), num_slow, seeds.size());
+    };
+
+    while((!max_runs || runs < max_runs) && elapsed() < max_time)
+    {
+        auto& seed = seeds[mutator.rand(uint32_t(seeds.size()))];
+        auto& other = seeds[mutator.rand(uint32_t(seeds.size()))];
+        Variant variant { mutator.rand(2) == 0, mutator.rand(2)? Options::Lang::IR2 : Options::Lang::GTA3Script };
+
+        Input input = seed.input;
+        mutator.mutate(input, ScmHeaderLayout::of(seed.invocation->options.get_header<DecompiledScmHeader::Version>()),
+                       *seed.game->commands, other);
+
+        auto result = execute(seed, input, variant);
+        ++runs;
+
+        const double slow_threshold = std::max(slow_min, slow_factor * seed.baseline);
+
+        if(result.crashed && known_crashes.insert(result.what).second)
+        {
+            fprintf(stderr, "crash: %s (seed %s), minimizing...\n", result.what.c_str(), seed.name.c_str());
+            auto minimized = minimize(input, [&](const Input& candidate) {
+                auto r = execute(seed, candidate, variant);
+                return r.crashed && r.what == result.what;
+            }, 4000);
+
+            auto dir = artifacts_dir / artifact_name("crash", minimized);
+            write_reproducer(dir, minimized, seed, variant, result.what);
+            fprintf(stderr, "reproducer of %zu bytes written into '%s'\n", minimized.size(), dir.generic_u8string().c_str());
+            findings.push_back({ "crash", result.what, seed.name, dir.generic_u8string(), minimized.size(), result.seconds });
+        }
+        else if(!result.crashed && result.seconds > slow_threshold && num_slow < 16)
+        {
+            ++num_slow;
+            fprintf(stderr, "slow: %.3fs (seed %s takes %.3fs), minimizing...\n", result.seconds, seed.name.c_str(), seed.baseline);
+            auto minimized = minimize(input, [&](const Input& candidate) {
+                return execute(seed, candidate, variant).seconds > slow_threshold;
+            }, 200);
+
+            auto what = fmt::format("decompilation took {:.3f} seconds, {:.0f} times as long as its seed",
+                                    result.seconds, result.seconds / seed.baseline);
+            auto dir = artifacts_dir / artifact_name("slow", minimized);
+            write_reproducer(dir, minimized, seed, variant, what);
+            fprintf(stderr, "reproducer of %zu bytes written into '%s'\n", minimized.size(), dir.generic_u8string().c_str());
+            findings.push_back({ "slow", what, seed.name, dir.generic_u8string(), minimized.size(), result.seconds });
+        }
+
+        if(now_ns() - last_status > 2000000000)
+        {
+            status();
+            last_status = now_ns();
+        }
+    }
+
+    current_input = nullptr;
+    status();
+
+    std::string json = fmt::format("{{\n  \"commit\": {},\n  \"seed\": {},\n  \"runs\": {},\n  \"seconds\": {:.3f},"
+                                   "\n  \"exec_per_s\": {:.1f},\n  \"crashes\": {},\n  \"slow\": {},"
+                                   "\n  \"findings\": [",
+                                   json_string(GTA3SC_GIT_SHA1), rng_seed, runs, elapsed(), runs / std::max(elapsed(), 1e-9),
+                                   known_crashes.size(), num_slow);
+
+    for(size_t i = 0; i < findings.size(); ++i)
+    {
+        auto& f = findings[i];
+        json += fmt::format("{}\n    {{\"kind\": {}, \"what\": {}, \"seed\": {}, \"reproducer\": {}, \"bytes\": {}, \"seconds\": {:.6f}}}",
+                            i? "," : "", json_string(f.kind), json_string(f.what), json_string(f.seed),
+                            json_string(f.directory), f.size, f.seconds);
+    }
+
+    json += findings.empty()? "]\n}\n" : "\n  ]\n}\n";
+
+    if(output_path)
+    {
+        FILE* f = u8fopen(*output_path, "wb");
+        if(!f)
+            return fprintf(stderr, "could not write '%s'\n", output_path->generic_u8string().c_str()), EXIT_FAILURE;
+        fputs(json.c_str(), f);
+        fclose(f);
+    }
+    else
+    {
+        fputs(json.c_str(), stdout);
+    }
+
+    return known_crashes.empty()? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,1283 @@
+///
+/// Front End Fuzzer
+///
+/// Feeds scripts to the compiler in-process, looking for inputs the lexer, the parser and the semantic passes can't
+/// cope with. No external fuzzing engine is needed. The scripts come from two sources:
+///
+///  + A generator of random but well-formed programs, built from the grammar: globals and scopes with local variables
+///    and arrays, nested `IF` (with `AND`/`OR` lists), `WHILE`, `REPEAT` and `SWITCH`, labels with `GOTO`, subroutines
+///    with `GOSUB`, `CLEO_CALL` functions, and `#ifdef`/`#ifndef` blocks. Sometimes deeply nested.
+///  + Mutations of existing scripts (`--corpus`, e.g. the test directory): deleted, duplicated, swapped and spliced
+///    lines, replaced tokens, stray keywords and directives, random bytes, truncations and deep nesting.
+///
+/// Each script is parsed (`TokenStream::tokenize` and `SyntaxTree::compile`) and compiled into IR2 twice, checking
+/// the following:
+///
+///  + Crashes, that is, exceptions escaping the compiler (e.g. a `bad_optional_access`, or a broken contract), and
+///    signals (e.g. a segmentation fault), after which the fuzzer stops.
+///  + Timeouts, scripts taking longer than `--timeout`, after which the fuzzer stops as well.
+///  + Nondeterminism, when both compilations give a different output or diagnostics.
+///  + Generated programs the compiler rejects, since they are well-formed by construction.
+///  + Round trip failures, when a generated program compiled into a SCM and decompiled into IR2 doesn't give the same
+///    IR2 as compiling it into IR2 directly.
+///  + Slow scripts, whose parse or compile time per byte is more than `--slow-factor` times the median of the scripts
+///    seen so far, and that take at least `--slow` milliseconds.
+///  + Superlinear scripts. Every so often, the same generator is run for a small and a large budget of statements,
+///    and the time taken to parse and compile both is compared. A growth exponent above `--max-exponent` is flagged.
+///
+/// Crashes, rejections, round trip failures and slow scripts are minimized line by line before being written. Every
+/// reproducer is written into its own directory inside `--artifacts` as a `main.sc`, with a `README.txt` describing
+/// the problem and how to reproduce it. A summary is written as JSON at the end, with the number of executions per
+/// second.
+///
+/// Usage: gta3sc-fuzz-frontend [--corpus=<dir>] [--seed=<n>] [--runs=<n>] [--max-time=<s>] [--timeout=<ms>]
+///                             [--slow=<ms>] [--slow-factor=<n>] [--max-exponent=<n>] [--artifacts=<dir>]
+///                             [--generate] [-o <file>]
+///
+/// Scripts in the corpus are found recursively as `<dir>/**/*.sc`, and are compiled with the `--config`, `--guesser`,
+/// `--cs`, `--cm`, `-D`, `-f` and `-m` options of their `RUN` line, if any. `--generate` prints a generated program
+/// and exits.
+///
+#include <stdinc.h>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <random>
+#include <thread>
+#include "driver.hpp"
+#include "parser.hpp"
+
+#ifdef GTA3SC_USING_GIT_DESCRIBE
+extern const char* GTA3SC_GIT_SHA1;
+#else
+const char* GTA3SC_GIT_SHA1 = "";
+#endif
+
+/// Timings below this many seconds are too noisy to tell how the time grows.
+static constexpr double min_scaling_time = 0.010;
+
+/// Statements in the small program of the superlinearity check, and how many times larger the large one is.
+static constexpr size_t scaling_budget = 250;
+static constexpr size_t scaling_factor = 16;
+
+/// A script to be compiled.
+struct Source
+{
+    std::string                 origin;     //< "generated", or the path of the mutated script.
+    std::string                 text;
+    std::vector<std::string>    args;       //< Options to compile it with, besides the input and output.
+    bool                        generated = false;
+};
+
+struct ExecResult
+{
+    bool        crashed = false;
+    std::string what;               //< Description of the crash.
+    bool        compiled = false;   //< Whether the compilation succeeded.
+    std::string ir2;
+    std::string diagnostics;
+    double      parse_seconds = 0.0;
+    double      compile_seconds = 0.0;
+};
+
+struct Finding
+{
+    std::string kind;               //< "crash", "nondeterministic", "rejected", "round-trip", "slow" or "superlinear".
+    std::string what;
+    std::string origin;
+    std::string directory;          //< Where the reproducer is.
+    size_t      size;               //< Size of the minimized script.
+    double      seconds;
+};
+
+// The state the signal handler and the watchdog need to write a reproducer.
+static const Source*            current_source = nullptr;
+static fs::path                 artifacts_dir;
+static fs::path                 work_dir;
+static std::atomic<int64_t>     exec_started_at {0};    //< In nanoseconds since the epoch of steady_clock, or zero.
+
+static int64_t now_ns()
+{
+    auto since_epoch = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(since_epoch).count();
+}
+
+static void write_text(const fs::path& path, const std::string& text)
+{
+    FILE* f = u8fopen(path, "wb");
+    if(!f) throw std::runtime_error(fmt::format("could not write '{}'", path.generic_u8string()));
+    fwrite(text.data(), 1, text.size(), f);
+    fclose(f);
+}
+
+/// Runs `gta3sc args...` in-process, appending its output and log into `output` and `log`. The game configs are
+/// loaded once.
+///
+/// Exceptions escaping the compiler are propagated.
+static int run_gta3sc(std::vector<std::string> args, std::string* output = nullptr, std::string* log = nullptr,
+                      optional<Invocation>* parsed = nullptr, shared_ptr<const GameConfig>* parsed_config = nullptr)
+{
+    static std::map<std::string, shared_ptr<const GameConfig>> configs;
+
+    auto err = [&](const std::string& msg) { if(log) *log += msg + '\n'; };
+    auto out = [&](const std::string& text) { if(output) *output += text; };
+
+    std::vector<char*> argv;
+    for(auto& arg : args) argv.emplace_back(&arg[0]);
+    argv.emplace_back(nullptr);
+
+    Invocation invocation;
+    if(!parse_invocation(argv.data(), invocation, err) || !validate_invocation(invocation, err))
+        return EXIT_FAILURE;
+
+    auto& config = configs[config_key(invocation)];
+    try
+    {
+        if(!config)
+            config = std::make_shared<const GameConfig>(load_config(invocation));
+    }
+    catch(const ConfigError& e)
+    {
+        err(fmt::format("gta3sc: error: {}", e.what()));
+        return EXIT_FAILURE;
+    }
+
+    if(parsed) parsed->emplace(invocation);
+    if(parsed_config) *parsed_config = config;
+
+    return output? run_invocation(invocation, *config, out, err) : EXIT_SUCCESS;
+}
+
+/// The command line compiling `source` from `main.sc` into `output`.
+static std::vector<std::string> compile_args(const Source& source, const std::string& input, const std::string& output,
+                                             bool emit_ir2)
+{
+    std::vector<std::string> args = { "compile", input, "-o", output, "-Wno-expect-var" };
+    args.insert(args.end(), source.args.begin(), source.args.end());
+    if(emit_ir2) args.emplace_back("-emit-ir2");
+    return args;
+}
+
+/// The command line decompiling a generated program from `input` into IR2.
+static std::vector<std::string> decompile_args(const std::string& input)
+{
+    return { "decompile", input, "--config=gtasa", "--guesser", "-fcleo", "-emit-ir2", "-o", "-" };
+}
+
+static std::string join_args(const std::vector<std::string>& args)
+{
+    std::string command = "gta3sc";
+    for(auto& arg : args) command += " " + arg;
+    return command;
+}
+
+/// Parses and compiles `source` into IR2.
+static ExecResult execute(const Source& source)
+{
+    const auto input = (work_dir / "main.sc").u8string();
+    write_text(input, source.text);
+
+    current_source = &source;
+
+    ExecResult result;
+    auto start = now_ns();
+    exec_started_at = start;
+
+    try
+    {
+        optional<Invocation> invocation;
+        shared_ptr<const GameConfig> config;
+        if(run_gta3sc(compile_args(source, input, "-", true), nullptr, &result.diagnostics, &invocation, &config)
+            == EXIT_SUCCESS)
+        {
+            // The parse alone, to tell its time apart from the rest of the compilation.
+            ProgramContext program(invocation->options, config->commands, TextSink());
+            auto parse_start = now_ns();
+            try
+            {
+                if(auto tstream = TokenStream::tokenize(program, source.text, "main.sc"))
+                    SyntaxTree::compile(program, *tstream);
+            }
+            catch(const ProgramFailure&)
+            {
+            }
+            result.parse_seconds = double(now_ns() - parse_start) / 1e9;
+
+            auto compile_start = now_ns();
+            result.compiled = run_gta3sc(compile_args(source, input, "-", true), &result.ir2, &result.diagnostics)
+                              == EXIT_SUCCESS;
+            result.compile_seconds = double(now_ns() - compile_start) / 1e9;
+        }
+    }
+    catch(const std::exception& e)
+    {
+        result.crashed = true;
+        result.what = fmt::format("uncaught exception: {}", e.what());
+    }
+    catch(...)
+    {
+        result.crashed = true;
+        result.what = "uncaught exception of unknown type";
+    }
+
+    exec_started_at = 0;
+    return result;
+}
+
+/// Compiles the generated program `source` into a SCM, and decompiles it back into IR2.
+static optional<std::string> round_trip(const Source& source, std::string& diagnostics)
+{
+    const auto input = (work_dir / "main.sc").u8string();
+    const auto scm = (work_dir / "main.scm").u8string();
+    write_text(input, source.text);
+
+    current_source = &source;
+    exec_started_at = now_ns();
+
+    std::string ir2;
+    std::string ignored;
+    bool ok = run_gta3sc(compile_args(source, input, scm, false), &ignored, &diagnostics) == EXIT_SUCCESS
+           && run_gta3sc(decompile_args(scm), &ir2, &diagnostics) == EXIT_SUCCESS;
+
+    exec_started_at = 0;
+    return ok? optional<std::string>(std::move(ir2)) : nullopt;
+}
+
+/// Strips the trailing whitespace of `ir2`, which only differs by its last line terminator between the compiler and
+/// the decompiler.
+static std::string normalize_ir2(std::string ir2)
+{
+    while(!ir2.empty() && isspace(static_cast<unsigned char>(ir2.back())))
+        ir2.pop_back();
+    return ir2;
+}
+
+/// \returns the first line in which `a` and `b` differ, as a description.
+static std::string first_difference(const std::string& a, const std::string& b)
+{
+    size_t line = 1, begin = 0;
+    for(size_t i = 0; i < std::min(a.size(), b.size()) && a[i] == b[i]; ++i)
+    {
+        if(a[i] == '\n')
+            ++line, begin = i + 1;
+    }
+
+    auto line_of = [&](const std::string& s) {
+        auto end = s.find('\n', begin);
+        return begin < s.size()? s.substr(begin, end == std::string::npos? end : end - begin) : std::string("<eof>");
+    };
+
+    return fmt::format("line {}: '{}' versus '{}'", line, line_of(a), line_of(b));
+}
+
+/// \returns the message of the first error in `diagnostics`, without its location.
+static std::string first_error(const std::string& diagnostics)
+{
+    auto begin = diagnostics.find("error: ");
+    if(begin == std::string::npos)
+        return diagnostics.substr(0, diagnostics.find('\n'));
+    return diagnostics.substr(begin, diagnostics.find('\n', begin) - begin);
+}
+
+/// Writes `source` into `dir` as a `main.sc`, and how to reproduce the problem.
+static void write_reproducer(const fs::path& dir, const Source& source, const std::string& what,
+                             bool round_trip = false)
+{
+    std::error_code ec;
+    fs::create_directories(dir, ec);
+
+    try
+    {
+        write_text(dir / "main.sc", source.text);
+
+        std::string readme = fmt::format("{}\n\nfrom {}\n\n{}\n", what, source.origin,
+                                         join_args(compile_args(source, "main.sc", "-", true)));
+        if(round_trip)
+        {
+            readme += fmt::format("{}\n{}\n", join_args(compile_args(source, "main.sc", "main.scm", false)),
+                                  join_args(decompile_args("main.scm")));
+        }
+
+        write_text(dir / "README.txt", readme);
+    }
+    catch(const std::exception& e)
+    {
+        fprintf(stderr, "%s\n", e.what());
+    }
+}
+
+/// Directory name for a reproducer of `source`.
+static std::string artifact_name(const char* kind, const Source& source)
+{
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for(auto c : source.text) hash = (hash ^ uint8_t(c)) * 16777619u;
+    return fmt::format("{}-{:08x}", kind, hash);
+}
+
+/// Writes the reproducer of the script being compiled, from a signal handler or the watchdog, then exits.
+///
+/// This isn't async-signal-safe, but the process is going down anyway.
+[[noreturn]] static void die_with_reproducer(const char* kind, const std::string& what)
+{
+    if(current_source)
+    {
+        auto dir = artifacts_dir / artifact_name(kind, *current_source);
+        write_reproducer(dir, *current_source, what);
+        fprintf(stderr, "%s: %s (from %s), reproducer written into '%s'\n", kind, what.c_str(),
+                current_source->origin.c_str(), dir.generic_u8string().c_str());
+    }
+    fflush(stderr);
+    std::_Exit(kind == std::string("timeout")? 2 : 1);
+}
+
+extern "C" void on_fatal_signal(int sig)
+{
+    die_with_reproducer("crash", fmt::format("signal {}", sig));
+}
+
+/// Generates random well-formed programs for San Andreas with `-fcleo -D FUZZ_A`.
+class Generator
+{
+public:
+    explicit Generator(uint32_t seed) :
+        rng(seed)
+    {}
+
+    uint32_t rand(uint32_t n) { return n? std::uniform_int_distribution<uint32_t>(0, n - 1)(rng) : 0; }
+
+    /// Generates a program of about `budget` statements.
+    ///
+    /// The shape of the program (its nesting, number of scopes, subroutines and functions) is chosen from the random
+    /// state only, thus the same state gives programs of the same shape for any budget.
+    std::string program(size_t budget)
+    {
+        out.clear();
+        labels.clear();
+        label_count = 0;
+
+        const uint32_t shape = rand(8);
+        max_depth = (shape == 0)? 24 + rand(40) : 2 + rand(6);
+        num_subs = 1 + rand(4);
+        num_funcs = 1 + rand(4);
+        func_params.clear();
+        for(size_t i = 0; i < num_funcs; ++i)
+            func_params.emplace_back(rand(4), rand(3));
+
+        out += "SCRIPT_NAME fuzz\n";
+        out += "VAR_INT g0 g1 g2 g3 garr[8]\n";
+        out += "VAR_FLOAT gf0 gf1\n";
+        out += "main_loop:\n";
+        out += "WAIT 0\n";
+
+        // Half the budget goes into the main loop, the rest into the subroutines and functions.
+        this->budget = budget / 2 + 1;
+        while(this->budget > 0)
+        {
+            if(rand(3) == 0)
+                scope_block();
+            else
+                statements(Context { false, false, 0, true }, 1 + rand(4));
+        }
+        out += "GOTO main_loop\n";
+
+        for(size_t i = 0; i < num_subs; ++i)
+        {
+            this->budget = budget / (4 * num_subs) + 1;
+            out += fmt::format("sub{}:\n", i);
+            statements(Context { false, false, 0, true }, 1 + rand(6));
+            out += "RETURN\n";
+        }
+
+        for(size_t i = 0; i < num_funcs; ++i)
+        {
+            this->budget = budget / (4 * num_funcs) + 1;
+            function(i);
+        }
+
+        return std::move(out);
+    }
+
+private:
+    /// Where statements are generated.
+    struct Context
+    {
+        bool        has_locals;     //< Whether the locals `i0 i1 i2 f0 f1 larr[4]` are in scope.
+        bool        in_function;    //< Whether it's the body of a `CLEO_CALL` function, which can't leave it.
+        size_t      depth;          //< Nesting of the control flow.
+        bool        in_main;        //< Whether the labels of the main loop can be jumped to.
+    };
+
+    std::mt19937                rng;
+    std::string                 out;
+    size_t                      budget;
+    size_t                      max_depth;
+    size_t                      num_subs;
+    size_t                      num_funcs;
+    size_t                      label_count;
+    size_t                      current_func;
+    std::vector<std::pair<uint32_t, uint32_t>>  func_params;    //< Number of inputs and outputs of each function.
+    std::vector<std::string>    labels;                         //< Labels that can be jumped back to.
+
+    void line(const Context& ctx, const std::string& text)
+    {
+        out.append(4 * (ctx.depth + ctx.has_locals), ' ');
+        out += text;
+        out += '\n';
+    }
+
+    std::string int_var(const Context& ctx)
+    {
+        if(ctx.in_function)
+        {
+            auto num_in = func_params[current_func].first;
+            auto n = rand(num_in + 2);
+            return n < num_in? fmt::format("p{}", n) : fmt::format("r{}", n - num_in);
+        }
+
+        switch(rand(ctx.has_locals? 5 : 3))
+        {
+            case 0: return fmt::format("g{}", rand(4));
+            case 1: return fmt::format("garr[{}]", rand(2)? std::to_string(rand(8)) : std::string("g0"));
+            case 2: return fmt::format("g{}", rand(4));
+            case 3: return fmt::format("i{}", rand(3));
+            case 4: return fmt::format("larr[{}]", rand(2)? std::to_string(rand(4)) : fmt::format("i{}", rand(3)));
+            default: Unreachable();
+        }
+    }
+
+    std::string float_var(const Context& ctx)
+    {
+        if(ctx.has_locals && rand(2))
+            return fmt::format("f{}", rand(2));
+        return fmt::format("gf{}", rand(2));
+    }
+
+    std::string int_value(const Context& ctx)
+    {
+        const int32_t values[] = { 0, 1, -1, 7, 127, 128, -129, 32767, 32768, 2147483647, -2147483647 };
+        return rand(2)? int_var(ctx) : std::to_string(values[rand(uint32_t(std::extent<decltype(values)>::value))]);
+    }
+
+    std::string float_value()
+    {
+        return fmt::format("{}.{}", int32_t(rand(2000)) - 1000, rand(100));
+    }
+
+    std::string condition(const Context& ctx)
+    {
+        const char* ops[] = { "=", ">", ">=", "<", "<=" };
+        std::string cond = rand(5) == 0? "NOT " : "";
+        switch(ctx.in_function? rand(2) : rand(4))
+        {
+            case 0: return cond + fmt::format("{} {} {}", int_var(ctx), ops[rand(5)], int_value(ctx));
+            case 1: return cond + fmt::format("{} = {}", int_var(ctx), int_var(ctx));
+            case 2: return cond + fmt::format("{} {} {}", float_var(ctx), ops[1 + rand(4)], float_value());
+            case 3: return cond + fmt::format("IS_BUTTON_PRESSED 0 {}", rand(19));
+            default: Unreachable();
+        }
+    }
+
+    /// Generates the conditions of a `IF` or `WHILE`, up to eight of them joined by `AND` or `OR`.
+    void conditions(Context ctx, const char* keyword)
+    {
+        auto count = rand(3) == 0? 1 + rand(8) : 1;
+        auto joiner = rand(2)? "AND " : "OR ";
+        line(ctx, keyword + std::string(" ") + condition(ctx));
+        for(size_t i = 1; i < count; ++i)
+            line(ctx, joiner + condition(ctx));
+    }
+
+    void simple_statement(const Context& ctx)
+    {
+        switch(rand(ctx.in_function? 6 : 12))
+        {
+            case 0: return line(ctx, fmt::format("{} = {}", int_var(ctx), int_value(ctx)));
+            case 1: return line(ctx, fmt::format("{} += {}", int_var(ctx), int_value(ctx)));
+            case 2:
+            {
+                // `VAR1 = THING - VAR1` can't be done, only commutative operations can.
+                auto dest = int_var(ctx), rhs = int_value(ctx);
+                return line(ctx, fmt::format("{} = {} {} {}", dest, int_var(ctx), "+-*/"[rand(4)],
+                                             rhs == dest? std::string("3") : rhs));
+            }
+            case 3: return line(ctx, fmt::format("{} {}= {}", float_var(ctx), "+-*/"[rand(4)], float_value()));
+            case 4: return line(ctx, fmt::format("{} = {} * {}", float_var(ctx), float_var(ctx), float_var(ctx)));
+            case 5: return line(ctx, fmt::format("GENERATE_RANDOM_INT_IN_RANGE 0 {} {}", 1 + rand(100), int_var(ctx)));
+            case 6: return line(ctx, fmt::format("WAIT {}", rand(3)? 0 : rand(5000)));
+            case 7: return line(ctx, fmt::format("PRINT_HELP HELP{}", rand(10)));
+            case 8: return line(ctx, fmt::format("GET_GAME_TIMER {}", int_var(ctx)));
+            case 9: return line(ctx, fmt::format("SAVE_STRING_TO_DEBUG_FILE \"fuzz {}\"", rand(1000)));
+            case 10: return line(ctx, fmt::format("GOSUB sub{}", rand(uint32_t(num_subs))));
+            case 11:
+                if(!labels.empty() && ctx.in_main)
+                    return line(ctx, fmt::format("GOTO {}", labels[rand(uint32_t(labels.size()))]));
+                return line(ctx, "WAIT 0");
+            default: Unreachable();
+        }
+    }
+
+    void cleo_call(const Context& ctx)
+    {
+        // A function only calls the ones before it, so there's no recursion.
+        auto limit = ctx.in_function? current_func : num_funcs;
+        if(limit == 0)
+            return simple_statement(ctx);
+
+        auto func = rand(uint32_t(limit));
+        std::string call = fmt::format("CLEO_CALL func{} 0", func);
+        for(size_t i = 0; i < func_params[func].first; ++i)
+            call += " " + int_value(ctx);
+        for(size_t i = 0; i < func_params[func].second; ++i)
+            call += " " + int_var(ctx);
+        line(ctx, call);
+    }
+
+    void statement(const Context& ctx)
+    {
+        if(budget == 0)
+            return;
+        --budget;
+
+        Context inner = ctx;
+        inner.depth = ctx.depth + 1;
+        const bool can_nest = (ctx.depth < max_depth);
+
+        switch(can_nest? rand(16) : rand(5))
+        {
+            case 0: case 1: case 2:
+                return simple_statement(ctx);
+            case 3:
+                return cleo_call(ctx);
+            case 4:
+                if(ctx.in_main && !ctx.in_function)
+                {
+                    labels.emplace_back(fmt::format("lbl{}", label_count++));
+                    out += labels.back() + ":\n";
+                    return;
+                }
+                return simple_statement(ctx);
+            case 5: case 6: case 7:
+                conditions(ctx, "IF");
+                statements(inner, 1 + rand(4));
+                if(rand(2))
+                {
+                    line(ctx, "ELSE");
+                    statements(inner, 1 + rand(4));
+                }
+                return line(ctx, "ENDIF");
+            case 8: case 9:
+                conditions(ctx, "WHILE");
+                statements(inner, 1 + rand(4));
+                return line(ctx, "ENDWHILE");
+            case 10: case 11:
+            {
+                auto var = ctx.in_function? int_var(ctx) : ctx.has_locals && rand(2)? fmt::format("i{}", rand(3))
+                                                                                     : fmt::format("g{}", rand(4));
+                line(ctx, fmt::format("REPEAT {} {}", rand(10), var));
+                statements(inner, 1 + rand(4));
+                return line(ctx, "ENDREPEAT");
+            }
+            case 12: case 13:
+            {
+                line(ctx, fmt::format("SWITCH {}", int_var(ctx)));
+                std::set<int32_t> cases;
+                for(auto n = 1 + rand(12); n > 0; --n)
+                    cases.emplace(int32_t(rand(200)) - 100);
+                for(auto value : cases)
+                {
+                    line(ctx, fmt::format("CASE {}", value));
+                    if(rand(3))
+                    {
+                        statements(inner, 1 + rand(2));
+                        line(inner, "BREAK");
+                    }
+                }
+                if(rand(2))
+                {
+                    line(ctx, "DEFAULT");
+                    statements(inner, 1 + rand(2));
+                    line(inner, "BREAK");
+                }
+                return line(ctx, "ENDSWITCH");
+            }
+            case 14: case 15:
+            {
+                // The labels in a branch may be left out, thus can't be jumped to after it.
+                auto outer_labels = labels;
+                const char* directive = rand(2)? "#ifdef FUZZ_A" : rand(2)? "#ifndef FUZZ_A" : "#ifdef FUZZ_B";
+                out += fmt::format("{}\n", directive);
+                statements(ctx, 1 + rand(3));
+                if(rand(2))
+                {
+                    out += "#else\n";
+                    labels = outer_labels;
+                    statements(ctx, 1 + rand(3));
+                }
+                out += "#endif\n";
+                labels = std::move(outer_labels);
+                return;
+            }
+            default:
+                Unreachable();
+        }
+    }
+
+    void statements(const Context& ctx, size_t count)
+    {
+        for(size_t i = 0; i < count && budget > 0; ++i)
+            statement(ctx);
+    }
+
+    /// Generates a scope with locals in the main loop. Its labels can't be jumped to from outside.
+    void scope_block()
+    {
+        auto outer_labels = labels;
+        out += "{\n";
+        out += "    LVAR_INT i0 i1 i2 larr[4]\n";
+        out += "    LVAR_FLOAT f0 f1\n";
+        statements(Context { true, false, 0, true }, 1 + rand(8));
+        out += "}\n";
+        labels = std::move(outer_labels);
+    }
+
+    void function(size_t index)
+    {
+        current_func = index;
+        auto num_in = func_params[index].first;
+        auto num_out = func_params[index].second;
+
+        std::string vars;
+        for(size_t i = 0; i < num_in; ++i) vars += fmt::format(" p{}", i);
+        vars += " r0 r1";
+
+        out += "{\n";
+        out += fmt::format("func{}:\n", index);
+        out += fmt::format("    LVAR_INT{}\n", vars);
+        statements(Context { false, true, 0, false }, 1 + rand(6));
+
+        std::string ret = "    CLEO_RETURN 0";
+        for(size_t i = 0; i < num_out; ++i) ret += fmt::format(" r{}", i);
+        out += ret + "\n";
+        out += "}\n";
+    }
+};
+
+/// Mutates scripts.
+class Mutator
+{
+public:
+    explicit Mutator(uint32_t seed) :
+        rng(seed)
+    {}
+
+    uint32_t rand(uint32_t n) { return n? std::uniform_int_distribution<uint32_t>(0, n - 1)(rng) : 0; }
+
+    /// Applies one to four mutations to `text`. Lines of `other` may be spliced into it.
+    void mutate(std::string& text, const std::string& other)
+    {
+        auto lines = split_lines(text);
+        auto other_lines = split_lines(other);
+
+        auto num_mutations = 1 + rand(4);
+        for(size_t i = 0; i < num_mutations; ++i)
+        {
+            if(lines.empty())
+                lines.emplace_back();
+
+            auto& line = lines[rand(uint32_t(lines.size()))];
+            switch(rand(10))
+            {
+                case 0: // delete lines
+                {
+                    auto begin = rand(uint32_t(lines.size()));
+                    auto count = std::min<size_t>(1 + rand(4), lines.size() - begin);
+                    lines.erase(lines.begin() + begin, lines.begin() + begin + count);
+                    break;
+                }
+                case 1: // duplicate a line
+                    lines.insert(lines.begin() + rand(uint32_t(lines.size())), line);
+                    break;
+                case 2: // swap lines
+                    std::swap(line, lines[rand(uint32_t(lines.size()))]);
+                    break;
+                case 3: // splice lines of another script
+                    if(!other_lines.empty())
+                    {
+                        auto begin = rand(uint32_t(other_lines.size()));
+                        auto count = std::min<size_t>(1 + rand(8), other_lines.size() - begin);
+                        lines.insert(lines.begin() + rand(uint32_t(lines.size())),
+                                     other_lines.begin() + begin, other_lines.begin() + begin + count);
+                    }
+                    break;
+                case 4: // replace a token
+                    replace_token(line);
+                    break;
+                case 5: // insert a line made of tokens
+                {
+                    std::string stray;
+                    for(auto n = 1 + rand(3); n > 0; --n)
+                        stray += (stray.empty()? "" : " ") + token();
+                    lines.insert(lines.begin() + rand(uint32_t(lines.size())), stray);
+                    break;
+                }
+                case 6: // random bytes
+                    for(auto n = 1 + rand(4); n > 0; --n)
+                    {
+                        const char bytes[] = { '\0', '\t', '\r', '"', '\'', '\\', '/', '*', '#', '{', ':', '\x80', '\xFF' };
+                        auto pos = rand(uint32_t(line.size() + 1));
+                        line.insert(line.begin() + pos, rand(2)? bytes[rand(uint32_t(sizeof(bytes)))] : char(rng()));
+                    }
+                    break;
+                case 7: // truncate
+                    line.resize(rand(uint32_t(line.size() + 1)));
+                    if(rand(4) == 0)
+                        lines.resize(rand(uint32_t(lines.size())) + 1);
+                    break;
+                case 8: // deep nesting around a line
+                    nest(lines, rand(uint32_t(lines.size())));
+                    break;
+                case 9: // a long token
+                    line += " " + std::string(1 + rand(512), "A9_.-$"[rand(6)]);
+                    break;
+            }
+        }
+
+        text.clear();
+        for(auto& line : lines)
+            text += line + '\n';
+    }
+
+private:
+    std::mt19937 rng;
+
+    static std::vector<std::string> split_lines(const std::string& text)
+    {
+        std::vector<std::string> lines;
+        for(size_t begin = 0; begin < text.size(); )
+        {
+            auto end = text.find('\n', begin);
+            if(end == std::string::npos) end = text.size();
+            lines.emplace_back(text.substr(begin, end - begin));
+            begin = end + 1;
+        }
+        return lines;
+    }
+
+    std::string token()
+    {
+        static const char* tokens[] = {
+            "IF", "IFNOT", "ENDIF", "ELSE", "WHILE", "WHILENOT", "ENDWHILE", "REPEAT", "ENDREPEAT", "SWITCH", "CASE",
+            "DEFAULT", "BREAK", "CONTINUE", "ENDSWITCH", "AND", "OR", "NOT", "{", "}", "GOTO", "GOSUB", "RETURN",
+            "VAR_INT", "LVAR_INT", "VAR_FLOAT", "LVAR_FLOAT", "VAR_TEXT_LABEL", "LVAR_TEXT_LABEL16", "CONST_INT",
+            "CLEO_CALL", "CLEO_RETURN", "MISSION_START", "MISSION_END", "SCRIPT_START", "SCRIPT_END",
+            "LOAD_AND_LAUNCH_MISSION", "LAUNCH_MISSION", "GOSUB_FILE", "REQUIRE", "START_NEW_SCRIPT", "WAIT",
+            "#ifdef", "#ifndef", "#else", "#endif", "#ifdef FUZZ", "label:", "x:", "\"", "\"str", "\"\"",
+            "2147483648", "-2147483649", "99999999999", "1.0.0", ".5", "-.", "1e10", "0x10", "-0", "1.", "1.f",
+            "=", "+=", "-=", "=#", "==", "<=", ">", "--", "++", "[", "]", "x[0]", "x[-1]", "x[999999]", "x[", "$", "&",
+            "@", "//", "/*", "*/", "\\", "'", "(", ")", ",", ";", "g0", "i0", "$g0", "TIMERA", "&8", "@0", "0@",
+        };
+        return tokens[rand(uint32_t(std::extent<decltype(tokens)>::value))];
+    }
+
+    void replace_token(std::string& line)
+    {
+        std::vector<std::pair<size_t, size_t>> words;
+        for(size_t i = 0; i < line.size(); )
+        {
+            auto begin = line.find_first_not_of(" \t", i);
+            if(begin == std::string::npos) break;
+            auto end = line.find_first_of(" \t", begin);
+            if(end == std::string::npos) end = line.size();
+            words.emplace_back(begin, end);
+            i = end;
+        }
+
+        if(words.empty())
+        {
+            line += token();
+            return;
+        }
+
+        auto word = words[rand(uint32_t(words.size()))];
+        line.replace(word.first, word.second - word.first, token());
+    }
+
+    /// Wraps the line `index` in a few dozens of nested blocks.
+    void nest(std::vector<std::string>& lines, size_t index)
+    {
+        static const std::pair<const char*, const char*> blocks[] = {
+            { "IF g0 = 0", "ENDIF" }, { "WHILE g0 = 0", "ENDWHILE" }, { "REPEAT 2 g0", "ENDREPEAT" },
+            { "#ifndef FUZZ_NEST", "#endif" }, { "{", "}" },
+        };
+
+        auto& block = blocks[rand(uint32_t(std::extent<decltype(blocks)>::value))];
+        auto depth = 8 + rand(120);
+        lines.insert(lines.begin() + index + 1, depth, block.second);
+        lines.insert(lines.begin() + index, depth, block.first);
+    }
+};
+
+/// Shrinks `source` line by line while `still_fails` it, with at most `max_execs` attempts.
+template<typename Pred>
+static Source minimize(Source source, Pred still_fails, size_t max_execs)
+{
+    std::vector<std::string> lines;
+    for(size_t begin = 0; begin < source.text.size(); )
+    {
+        auto end = source.text.find('\n', begin);
+        if(end == std::string::npos) end = source.text.size();
+        lines.emplace_back(source.text.substr(begin, end - begin));
+        begin = end + 1;
+    }
+
+    auto join = [](const std::vector<std::string>& lines) {
+        std::string text;
+        for(auto& line : lines) text += line + '\n';
+        return text;
+    };
+
+    size_t execs = 0;
+    for(size_t chunk = lines.size() / 2; chunk > 0 && execs < max_execs; chunk /= 2)
+    {
+        for(size_t begin = 0; begin + chunk <= lines.size() && execs < max_execs; )
+        {
+            auto candidate_lines = lines;
+            candidate_lines.erase(candidate_lines.begin() + begin, candidate_lines.begin() + begin + chunk);
+
+            Source candidate = source;
+            candidate.text = join(candidate_lines);
+            ++execs;
+            if(still_fails(candidate))
+                lines = std::move(candidate_lines), source = std::move(candidate);
+            else
+                begin += chunk;
+        }
+    }
+
+    return source;
+}
+
+/// Finds the scripts at `<dir>/**/*.sc`, along with the options of their `RUN` line.
+static std::vector<Source> find_corpus(const fs::path& dir)
+{
+    std::vector<Source> corpus;
+
+    for(auto& entry : fs::recursive_directory_iterator(dir))
+    {
+        auto& path = entry.path();
+        if(!fs::is_regular_file(path) || !iequal_to()(path.extension().u8string(), ".sc"))
+            continue;
+
+        Source source;
+        source.origin = path.generic_u8string();
+        source.text = read_file_utf8(path).value_or("");
+        source.args = { "--config=gtasa", "--guesser" };
+
+        auto run = source.text.find("%gta3sc ");
+        if(run != std::string::npos)
+        {
+            source.args.clear();
+
+            std::vector<std::string> words;
+            auto end = source.text.find('\n', run);
+            auto line = source.text.substr(run, end == std::string::npos? end : end - run);
+            for(size_t i = 0; i < line.size(); )
+            {
+                auto begin = line.find_first_not_of(' ', i);
+                if(begin == std::string::npos) break;
+                auto word_end = std::min(line.find(' ', begin), line.size());
+                words.emplace_back(line.substr(begin, word_end - begin));
+                i = word_end;
+            }
+
+            for(size_t i = 0; i < words.size() && words[i] != "|"; ++i)
+            {
+                auto& word = words[i];
+                if(word == "-D" && i + 1 < words.size())
+                    source.args.insert(source.args.end(), { word, words[++i] });
+                else if(word == "--guesser" || word == "--cs" || word == "--cm" || word.substr(0, 9) == "--config="
+                        || (word.substr(0, 2) == "-f" && word != "-fsyntax-only") || word.substr(0, 2) == "-m")
+                    source.args.emplace_back(word);
+            }
+
+            if(std::none_of(source.args.begin(), source.args.end(), [](const std::string& a) {
+                return a.substr(0, 9) == "--config="; }))
+                source.args.emplace_back("--config=gtasa");
+        }
+
+        corpus.emplace_back(std::move(source));
+    }
+
+    std::sort(corpus.begin(), corpus.end(), [](const Source& a, const Source& b) { return a.origin < b.origin; });
+    return corpus;
+}
+
+static std::string json_string(const std::string& s)
+{
+    std::string out = "\"";
+    for(char c : s)
+    {
+        if(c == '"' || c == '\\')
+            out.push_back('\\');
+        if(static_cast<unsigned char>(c) < 0x20)
+            out += fmt::format("\\u{:04x}", c);
+        else
+            out.push_back(c);
+    }
+    return out + '"';
+}
+
+/// Median of the last samples of a rate.
+class RateTracker
+{
+public:
+    void add(double rate)
+    {
+        if(samples.size() < 1024)
+            samples.emplace_back(rate);
+        else
+            samples[next++ % samples.size()] = rate;
+    }
+
+    double median() const
+    {
+        if(samples.empty())
+            return std::numeric_limits<double>::infinity();
+        auto copy = samples;
+        std::nth_element(copy.begin(), copy.begin() + copy.size() / 2, copy.end());
+        return copy[copy.size() / 2];
+    }
+
+    size_t size() const { return samples.size(); }
+
+private:
+    std::vector<double> samples;
+    size_t              next = 0;
+};
+
+int main(int argc, char* argv[])
+{
+    optional<fs::path> corpus_dir;
+    optional<fs::path> output_path;
+    uint32_t rng_seed = 1;
+    size_t max_runs = 0;            // unlimited
+    double max_time = 60.0;
+    double timeout = 5.0;
+    double slow_min = 0.05;
+    double slow_factor = 20.0;
+    double max_exponent = 1.5;
+    bool generate_only = false;
+    artifacts_dir = fs::u8path("fuzz-artifacts");
+
+    for(int i = 1; i < argc; ++i)
+    {
+        string_view arg = argv[i];
+        auto value = [&](const char* prefix) -> const char* {
+            return arg.substr(0, strlen(prefix)) == prefix? argv[i] + strlen(prefix) : nullptr;
+        };
+        auto number = [](const char* s) {
+            float n = 0.0f;
+            from_chars(s, s + strlen(s), n);
+            return double(n);
+        };
+
+        if(auto dir = value("--corpus="))
+            corpus_dir = fs::u8path(dir);
+        else if(auto n = value("--seed="))
+            rng_seed = uint32_t(number(n));
+        else if(auto n = value("--runs="))
+            max_runs = size_t(number(n));
+        else if(auto n = value("--max-time="))
+            max_time = number(n);
+        else if(auto n = value("--timeout="))
+            timeout = number(n) / 1000.0;
+        else if(auto n = value("--slow="))
+            slow_min = number(n) / 1000.0;
+        else if(auto n = value("--slow-factor="))
+            slow_factor = number(n);
+        else if(auto n = value("--max-exponent="))
+            max_exponent = number(n);
+        else if(auto dir = value("--artifacts="))
+            artifacts_dir = fs::u8path(dir);
+        else if(arg == "--generate")
+            generate_only = true;
+        else if(arg == "-o" && i + 1 < argc)
+            output_path = fs::u8path(argv[++i]);
+        else
+            return fprintf(stderr, "unrecognized argument '%s'\n", argv[i]), EXIT_FAILURE;
+    }
+
+    Generator generator(rng_seed);
+    Mutator mutator(rng_seed);
+    const std::vector<std::string> generated_args = { "--config=gtasa", "--guesser", "-fcleo", "-D", "FUZZ_A" };
+
+    if(generate_only)
+        return fputs(generator.program(100 + generator.rand(400)).c_str(), stdout), EXIT_SUCCESS;
+
+    std::vector<Source> corpus;
+    try
+    {
+        work_dir = fs::temp_directory_path() / "gta3sc-fuzz-frontend";
+        std::error_code ec;
+        fs::remove_all(work_dir, ec);
+        fs::create_directories(work_dir);
+
+        if(corpus_dir)
+            corpus = find_corpus(*corpus_dir);
+    }
+    catch(const std::exception& e)
+    {
+        return fprintf(stderr, "%s\n", e.what()), EXIT_FAILURE;
+    }
+
+    std::signal(SIGSEGV, on_fatal_signal);
+    std::signal(SIGABRT, on_fatal_signal);
+    std::signal(SIGFPE, on_fatal_signal);
+    std::signal(SIGILL, on_fatal_signal);
+
+    std::thread watchdog([timeout] {
+        while(true)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            auto started_at = exec_started_at.load();
+            if(started_at && double(now_ns() - started_at) / 1e9 > timeout)
+                die_with_reproducer("timeout", fmt::format("compilation took longer than {} ms", timeout * 1000.0));
+        }
+    });
+    watchdog.detach();
+
+    std::vector<Finding> findings;
+    std::map<std::string, size_t> counts;   // findings of each kind
+    std::set<std::string> known_problems;
+    RateTracker parse_rates, compile_rates;
+    size_t runs = 0;
+
+    auto start = now_ns();
+    auto last_status = start;
+    auto elapsed = [&] { return double(now_ns() - start) / 1e9; };
+
+    auto status = [&] {
+        fprintf(stderr, "#%zu  exec/s: %.0f  crashes: %zu  nondeterministic: %zu  rejected: %zu  round-trip: %zu  "
+                        "slow: %zu  superlinear: %zu\n", runs, runs / std::max(elapsed(), 1e-9),
+                counts["crash"], counts["nondeterministic"], counts["rejected"], counts["round-trip"], counts["slow"],
+                counts["superlinear"]);
+    };
+
+    auto report = [&](const char* kind, const std::string& what, const Source& source, double seconds,
+                      bool round_trip = false) {
+        ++counts[kind];
+        auto dir = artifacts_dir / artifact_name(kind, source);
+        write_reproducer(dir, source, what, round_trip);
+        fprintf(stderr, "%s: %s (from %s), reproducer of %zu bytes written into '%s'\n", kind, what.c_str(),
+                source.origin.c_str(), source.text.size(), dir.generic_u8string().c_str());
+        findings.push_back({ kind, what, source.origin, dir.generic_u8string(), source.text.size(), seconds });
+    };
+
+    // Whether a problem is reported. Crashes are told apart by their message, other kinds are capped.
+    auto is_new = [&](const std::string& kind, const std::string& what) {
+        return kind == "crash"? known_problems.insert(what).second : counts[kind] < 8;
+    };
+
+    auto generate = [&](size_t budget) {
+        Source source;
+        source.origin = "generated";
+        source.text = generator.program(budget);
+        source.args = generated_args;
+        source.generated = true;
+        return source;
+    };
+
+    while((!max_runs || runs < max_runs) && elapsed() < max_time)
+    {
+        Source source;
+        if(corpus.empty() || mutator.rand(2))
+        {
+            source = generate(10 + generator.rand(300));
+        }
+        else
+        {
+            source = corpus[mutator.rand(uint32_t(corpus.size()))];
+            mutator.mutate(source.text, corpus[mutator.rand(uint32_t(corpus.size()))].text);
+        }
+
+        auto result = execute(source);
+        ++runs;
+
+        if(result.crashed)
+        {
+            if(is_new("crash", result.what))
+            {
+                fprintf(stderr, "crash: %s (from %s), minimizing...\n", result.what.c_str(), source.origin.c_str());
+                auto minimized = minimize(source, [&](const Source& candidate) {
+                    auto r = execute(candidate);
+                    return r.crashed && r.what == result.what;
+                }, 2000);
+                report("crash", result.what, minimized, 0.0);
+            }
+            continue;
+        }
+
+        auto again = execute(source);
+        if(again.crashed || again.compiled != result.compiled || again.ir2 != result.ir2
+            || again.diagnostics != result.diagnostics)
+        {
+            // Nondeterminism may not survive minimization, thus it isn't minimized.
+            auto what = again.crashed? fmt::format("crashed only the second time: {}", again.what) :
+                        again.ir2 != result.ir2? "different IR2, " + first_difference(result.ir2, again.ir2) :
+                        "different diagnostics, " + first_difference(result.diagnostics, again.diagnostics);
+            if(is_new("nondeterministic", what))
+                report("nondeterministic", what, source, result.compile_seconds);
+        }
+
+        if(source.generated && !result.compiled)
+        {
+            if(is_new("rejected", ""))
+            {
+                auto what = "generated program rejected: " + first_error(result.diagnostics);
+                auto minimized = minimize(source, [&](const Source& candidate) {
+                    auto r = execute(candidate);
+                    return !r.crashed && !r.compiled && first_error(r.diagnostics) == first_error(result.diagnostics);
+                }, 500);
+                report("rejected", what, minimized, result.compile_seconds);
+            }
+        }
+        else if(source.generated)
+        {
+            std::string diagnostics;
+            auto decompiled = round_trip(source, diagnostics);
+            auto expected = normalize_ir2(result.ir2);
+            if(!decompiled || normalize_ir2(*decompiled) != expected)
+            {
+                if(is_new("round-trip", ""))
+                {
+                    auto what = decompiled? "decompiled IR2 differs, " + first_difference(expected, normalize_ir2(*decompiled))
+                                          : "compile and decompile failed: " + diagnostics.substr(0, diagnostics.find('\n'));
+                    auto minimized = minimize(source, [&](const Source& candidate) {
+                        auto r = execute(candidate);
+                        if(r.crashed || !r.compiled)
+                            return false;
+                        std::string ignored;
+                        auto d = round_trip(candidate, ignored);
+                        return !d || normalize_ir2(*d) != normalize_ir2(r.ir2);
+                    }, 300);
+                    report("round-trip", what, minimized, result.compile_seconds, true);
+                }
+            }
+        }
+
+        // Time per byte, compared with the median of the scripts seen so far.
+        const double size = double(std::max<size_t>(source.text.size(), 1));
+        for(auto phase : { std::make_tuple("parse", result.parse_seconds, &parse_rates),
+                           std::make_tuple("compile", result.compile_seconds, &compile_rates) })
+        {
+            auto seconds = std::get<1>(phase);
+            auto& rates = *std::get<2>(phase);
+            auto median = rates.median();
+            auto rate = seconds / size;
+            rates.add(rate);
+
+            if(rates.size() >= 64 && seconds > slow_min && rate > slow_factor * median && is_new("slow", ""))
+            {
+                auto what = fmt::format("{} took {:.3f} seconds, {:.0f} ns per byte, {:.0f} times the median",
+                                        std::get<0>(phase), seconds, rate * 1e9, rate / median);
+                auto minimized = minimize(source, [&](const Source& candidate) {
+                    auto r = execute(candidate);
+                    auto t = std::get<0>(phase) == std::string("parse")? r.parse_seconds : r.compile_seconds;
+                    return t > slow_min && t / double(std::max<size_t>(candidate.text.size(), 1)) > slow_factor * median;
+                }, 100);
+                report("slow", what, minimized, seconds);
+                break;
+            }
+        }
+
+        // Every so often, how the time grows with the size of the program.
+        if(runs % 64 == 0)
+        {
+            std::seed_seq seq { rng_seed, uint32_t(runs) };
+            uint32_t shape_seed;
+            seq.generate(&shape_seed, &shape_seed + 1);
+
+            Generator small_gen(shape_seed), large_gen(shape_seed);
+            Source small = generate(0), large = generate(0);
+            small.text = small_gen.program(scaling_budget);
+            large.text = large_gen.program(scaling_budget * scaling_factor);
+
+            auto best_of = [&](const Source& s) {
+                ExecResult best = execute(s);
+                for(int i = 0; i < 2 && !best.crashed; ++i)
+                {
+                    auto r = execute(s);
+                    best.parse_seconds = std::min(best.parse_seconds, r.parse_seconds);
+                    best.compile_seconds = std::min(best.compile_seconds, r.compile_seconds);
+                }
+                return best;
+            };
+
+            auto rs = best_of(small), rl = best_of(large);
+            auto growth = std::log(double(large.text.size()) / double(small.text.size()));
+
+            for(auto phase : { std::make_tuple("parse", rs.parse_seconds, rl.parse_seconds),
+                               std::make_tuple("compile", rs.compile_seconds, rl.compile_seconds) })
+            {
+                auto ts = std::max(std::get<1>(phase), 1e-6), tl = std::get<2>(phase);
+                auto exponent = std::log(tl / ts) / growth;
+                if(!rs.crashed && !rl.crashed && tl > min_scaling_time && exponent > max_exponent
+                    && is_new("superlinear", ""))
+                {
+                    auto what = fmt::format("{} time grows as size^{:.2f}: {:.3f}s for {} bytes, {:.3f}s for {} bytes",
+                                            std::get<0>(phase), exponent, ts, small.text.size(), tl, large.text.size());
+                    report("superlinear", what, large, tl);
+                    break;
+                }
+            }
+        }
+
+        if(now_ns() - last_status > 2000000000)
+        {
+            status();
+            last_status = now_ns();
+        }
+    }
+
+    current_source = nullptr;
+    status();
+
+    size_t num_problems = 0;
+    for(auto& pair : counts) num_problems += pair.second;
+
+    std::string json = fmt::format("{{\n  \"commit\": {},\n  \"seed\": {},\n  \"runs\": {},\n  \"seconds\": {:.3f},"
+                                   "\n  \"exec_per_s\": {:.1f},\n  \"corpus\": {},\n  \"timeouts\": 0",
+                                   json_string(GTA3SC_GIT_SHA1), rng_seed, runs, elapsed(),
+                                   runs / std::max(elapsed(), 1e-9), corpus.size());
+
+    for(auto kind : { "crash", "nondeterministic", "rejected", "round-trip", "slow", "superlinear" })
+        json += fmt::format(",\n  {}: {}", json_string(kind), counts[kind]);
+
+    json += ",\n  \"findings\": [";
+    for(size_t i = 0; i < findings.size(); ++i)
+    {
+        auto& f = findings[i];
+        json += fmt::format("{}\n    {{\"kind\": {}, \"what\": {}, \"origin\": {}, \"reproducer\": {}, \"bytes\": {}, \"seconds\": {:.6f}}}",
+                            i? "," : "", json_string(f.kind), json_string(f.what), json_string(f.origin),
+                            json_string(f.directory), f.size, f.seconds);
+    }
+
+    json += findings.empty()? "]\n}\n" : "\n  ]\n}\n";
+
+    if(output_path)
+    {
+        FILE* f = u8fopen(*output_path, "wb");
+        if(!f)
+            return fprintf(stderr, "could not write '%s'\n", output_path->generic_u8string().c_str()), EXIT_FAILURE;
+        fputs(json.c_str(), f);
+        fclose(f);
+    }
+    else
+    {
+        fputs(json.c_str(), stdout);
+    }
+
+    return num_problems == 0? EXIT_SUCCESS : EXIT_FAILURE;
+}
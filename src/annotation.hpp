@@ -72,8 +72,8 @@ struct ReplacedCommandAnnotation
     std::vector<any> params;
 };
 
-// Assigned to the node during parse.
+// Assigned to the node during parse. The bytes are shared with the compiled IR, never copied.
 struct DumpAnnotation
 {
-    std::vector<uint8_t> bytes;
+    shared_ptr<const std::vector<uint8_t>> bytes;
 };
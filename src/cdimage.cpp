@@ -0,0 +1,51 @@
+#include <stdinc.h>
+#include "cdimage.hpp"
+
+auto CdImage::from_memory(const void* bytes_, size_t size) -> optional<CdImage>
+{
+    BinaryFetcher bf { bytes_, size };
+
+    char magic[4];
+    if(!bf.fetch_bytes(0, sizeof(magic), magic) || memcmp(magic, "VER2", 4) != 0)
+        return nullopt;
+
+    auto opt_num_entries = bf.fetch_u32(4);
+    if(!opt_num_entries || *opt_num_entries > (size - sizeof(CdHeader)) / sizeof(CdEntry))
+        return nullopt;
+
+    CdImage image(bf.bytes, size);
+    image.entries.reserve(*opt_num_entries);
+    image.index.reserve(*opt_num_entries);
+
+    for(size_t i = 0; i < *opt_num_entries; ++i)
+    {
+        // Read field by field, the directory mayn't be aligned nor in our endianess.
+        size_t entry_offset = sizeof(CdHeader) + i * sizeof(CdEntry);
+        const char* filename = reinterpret_cast<const char*>(bf.bytes + entry_offset + offsetof(CdEntry, filename));
+
+        CdImageEntry entry;
+        entry.name = string_view(filename, strnlen(filename, sizeof(CdEntry::filename)));
+        entry.offset = size_t(*bf.fetch_u32(entry_offset + offsetof(CdEntry, offset))) * cd_sector_size;
+        entry.size   = size_t(*bf.fetch_u16(entry_offset + offsetof(CdEntry, streaming_size))) * cd_sector_size;
+
+        image.index.emplace(entry.name, image.entries.size()); // does not replace former entries of same name
+        image.entries.emplace_back(std::move(entry));
+    }
+
+    return image;
+}
+
+auto CdImage::find(const string_view& filename) const -> optional<const CdImageEntry&>
+{
+    auto it = this->index.find(filename);
+    if(it != this->index.end())
+        return this->entries[it->second];
+    return nullopt;
+}
+
+auto CdImage::fetch(const CdImageEntry& entry, size_t size) const -> optional<BinaryFetcher>
+{
+    if(entry.offset > this->archive_size || size > this->archive_size - entry.offset)
+        return nullopt;
+    return BinaryFetcher { this->archive_bytes + entry.offset, size };
+}
@@ -1,5 +1,15 @@
+///
+/// IMG Archives
+///
+/// Layout and reading of VER2 IMG archives (e.g. script.img, gta3.img).
+///
 #pragma once
-#include <cstdint>
+#include <stdinc.h>
+#include <unordered_map>
+#include "binary_fetcher.hpp"
+
+/// Size of a sector of a IMG archive. Offsets and sizes in the directory are given in sectors.
+constexpr size_t cd_sector_size = 2048;
 
 struct alignas(4) CdHeader
 {
@@ -14,3 +24,64 @@ struct alignas(4) CdEntry
     uint16_t size_in_archive = 0;   // in sectors
     char     filename[24];
 };
+
+static_assert(sizeof(CdHeader) == 8, "CdHeader must match the on-disk layout");
+static_assert(sizeof(CdEntry) == 32, "CdEntry must match the on-disk layout");
+
+/// Directory entry of a `CdImage`.
+struct CdImageEntry
+{
+    string_view name;   //< Filename (in the archive bytes), bounded to the directory field even if it has no null terminator.
+    size_t      offset; //< Offset of the data in the archive, in bytes.
+    size_t      size;   //< Streaming size of the data, in bytes (i.e. padded to `cd_sector_size`).
+};
+
+/// Read-only view over a VER2 IMG archive.
+///
+/// The directory is read once into a case-insensitive index. Neither the names nor the data of the entries
+/// are copied, they are viewed straight from the archive bytes (which are usually a `MappedFile`).
+class CdImage
+{
+public:
+    /// Indexes the directory of the archive in the specified bytes.
+    ///
+    /// \returns nullopt if the archive is not a VER2 archive or its directory is truncated.
+    /// \warning the bytes must be alive as long as this object.
+    static optional<CdImage> from_memory(const void* bytes, size_t size);
+
+    auto begin() const  { return entries.begin(); }
+    auto end() const    { return entries.end(); }
+
+    /// Gets the number of entries in the directory.
+    size_t num_entries() const { return entries.size(); }
+
+    /// Gets the size of the whole archive.
+    size_t size() const { return this->archive_size; }
+
+    /// Finds the entry with the specified filename (case-insensitive).
+    ///
+    /// If many entries have the same name, the first one in the directory is found.
+    optional<const CdImageEntry&> find(const string_view& filename) const;
+
+    /// Gets a view of the first `size` bytes of the data of the specified entry.
+    ///
+    /// \returns nullopt if the range goes past the end of the archive.
+    optional<BinaryFetcher> fetch(const CdImageEntry& entry, size_t size) const;
+
+    /// Gets a view of the data of the specified entry.
+    optional<BinaryFetcher> fetch(const CdImageEntry& entry) const
+    {
+        return fetch(entry, entry.size);
+    }
+
+private:
+    explicit CdImage(const uint8_t* bytes, size_t size) :
+        archive_bytes(bytes), archive_size(size)
+    {}
+
+private:
+    const uint8_t*                  archive_bytes;
+    size_t                          archive_size;
+    std::vector<CdImageEntry>       entries;
+    std::unordered_map<string_view, size_t, ihash, iequal_to> index; //< filename -> entries[i]
+};
@@ -0,0 +1,216 @@
+#include <stdinc.h>
+#include "code_graph.hpp"
+
+static bool is_entry(ScriptType type)
+{
+    switch(type)
+    {
+        case ScriptType::Main:
+        case ScriptType::Subscript:
+        case ScriptType::Mission:
+        case ScriptType::StreamedScript:
+        case ScriptType::CustomScript:
+        case ScriptType::CustomMission:
+            return true;
+        case ScriptType::MainExtension: // only entered with GOSUB_FILE
+        case ScriptType::Required:
+            return false;
+        default:
+            Unreachable();
+    }
+}
+
+CodeGraph CodeGraph::from_ir(const std::vector<CodeGenerator>& gens)
+{
+    CodeGraph graph;
+    std::unordered_map<const Label*, uint32_t> label_nodes;
+
+    // The labels which have no command after them (e.g. at the end of the script) are left out of `label_nodes`.
+    std::vector<const Label*> pending_labels;
+    for(auto& gen : gens)
+    {
+        for(auto& data : gen.ir())
+        {
+            if(is<CompiledLabelDef>(data.data))
+            {
+                pending_labels.emplace_back(get<CompiledLabelDef>(data.data).label.get());
+            }
+            else if(is<CompiledCommand>(data.data))
+            {
+                for(auto label : pending_labels)
+                    label_nodes.emplace(label, graph.size());
+                pending_labels.clear();
+                graph.commands.emplace_back(&get<CompiledCommand>(data.data));
+            }
+            else
+            {
+                pending_labels.clear();
+            }
+        }
+        pending_labels.clear();
+    }
+
+    auto node_of = [&](const ArgVariant& arg) -> uint32_t {
+        if(is<shared_ptr<Label>>(arg))
+        {
+            auto it = label_nodes.find(get<shared_ptr<Label>>(arg).get());
+            if(it != label_nodes.end())
+                return it->second;
+        }
+        return no_node;
+    };
+
+    graph.edge_begin.reserve(graph.size() + 1);
+    graph.edges.reserve(graph.size() + graph.size() / 4);
+
+    uint32_t node = 0;
+    for(auto& gen : gens)
+    {
+        auto& ir = gen.ir();
+        bool is_first = true;
+
+        for(size_t i = 0; i < ir.size(); ++i)
+        {
+            if(!is<CompiledCommand>(ir[i].data))
+                continue;
+
+            auto& compiled = get<CompiledCommand>(ir[i].data);
+            const Command& command = compiled.command;
+
+            graph.edge_begin.push_back(static_cast<uint32_t>(graph.edges.size()));
+
+            if(is_first && is_entry(gen.script->type))
+                graph.entry_points.push_back(Entry { node, gen.script.get(), compiled.where, nullptr });
+            is_first = false;
+
+            const bool is_switch = (command.special == SpecialCommand::SwitchStart
+                                    || command.special == SpecialCommand::SwitchContinued);
+
+            // Falls into the next command of the same script, unless there's data in between.
+            if(command.falls_through())
+            {
+                auto next = std::find_if(ir.begin() + i + 1, ir.end(), [](const CompiledData& data) {
+                    return !is<CompiledLabelDef>(data.data);
+                });
+                if(next != ir.end() && is<CompiledCommand>(next->data))
+                {
+                    // The game branches after the last SWITCH_START/SWITCH_CONTINUED (as does `Disassembler::explore_opcode`).
+                    const Command& next_command = get<CompiledCommand>(next->data).command;
+                    if(!is_switch || next_command.special == SpecialCommand::SwitchContinued)
+                        graph.edges.push_back(Edge { node + 1, EdgeKind::Flow });
+                }
+            }
+
+            if(command.has_flow(ControlFlow::Branch | ControlFlow::ConditionalBranch | ControlFlow::Call))
+            {
+                auto kind = !command.has_flow(ControlFlow::Call)? EdgeKind::Flow :
+                            command.special == SpecialCommand::CleoCall? EdgeKind::Call : EdgeKind::Gosub;
+                for(auto& arg : compiled.args)
+                {
+                    auto target = node_of(arg);
+                    if(target != no_node)
+                        graph.edges.push_back(Edge { target, kind });
+                }
+            }
+            else if(is_switch)
+            {
+                // Branches into each case and into the default label.
+                for(auto& arg : compiled.args)
+                {
+                    auto target = node_of(arg);
+                    if(target != no_node)
+                        graph.edges.push_back(Edge { target, EdgeKind::Flow });
+                }
+            }
+            else if(command.special == SpecialCommand::StartNewScript && !compiled.args.empty())
+            {
+                auto target = node_of(compiled.args[0]);
+                if(target != no_node)
+                {
+                    auto& label = get<shared_ptr<Label>>(compiled.args[0]);
+                    graph.entry_points.push_back(Entry { target, label->script.lock().get(), compiled.where, label });
+                }
+            }
+
+            ++node;
+        }
+    }
+
+    graph.edge_begin.push_back(static_cast<uint32_t>(graph.edges.size()));
+    assert(graph.edge_begin.size() == graph.size() + 1);
+
+    graph.sccs = graph.find_components();
+    return graph;
+}
+
+auto CodeGraph::find_components() const -> Components
+{
+    const uint32_t num_nodes = this->size();
+
+    Components result;
+    result.component.assign(num_nodes, no_node);
+    result.members.reserve(num_nodes);
+    result.members_begin.push_back(0);
+
+    std::vector<uint32_t> index(num_nodes, no_node);
+    std::vector<uint32_t> lowlink(num_nodes, 0);
+    std::vector<uint32_t> stack;
+    std::vector<std::pair<uint32_t, const Edge*>> calls; // The nodes being visited and their next edge.
+    uint32_t next_index = 0;
+
+    for(uint32_t root = 0; root < num_nodes; ++root)
+    {
+        if(index[root] != no_node)
+            continue;
+
+        calls.emplace_back(root, this->begin(root));
+        index[root] = lowlink[root] = next_index++;
+        stack.push_back(root);
+
+        while(!calls.empty())
+        {
+            auto node = calls.back().first;
+            auto& it = calls.back().second;
+
+            if(it != this->end(node))
+            {
+                auto to = (it++)->to;
+                if(index[to] == no_node)
+                {
+                    index[to] = lowlink[to] = next_index++;
+                    stack.push_back(to);
+                    calls.emplace_back(to, this->begin(to));
+                }
+                else if(result.component[to] == no_node)
+                {
+                    lowlink[node] = std::min(lowlink[node], index[to]);
+                }
+                continue;
+            }
+
+            calls.pop_back();
+            if(!calls.empty())
+            {
+                auto parent = calls.back().first;
+                lowlink[parent] = std::min(lowlink[parent], lowlink[node]);
+            }
+
+            if(lowlink[node] != index[node])
+                continue;
+
+            // A component is completed after every component it reaches, which gives the numbering.
+            const auto id = result.size();
+            auto members_begin = std::find(stack.rbegin(), stack.rend(), node).base() - 1;
+            for(auto it_member = members_begin; it_member != stack.end(); ++it_member)
+            {
+                result.component[*it_member] = id;
+                result.members.push_back(*it_member);
+            }
+            result.members_begin.push_back(static_cast<uint32_t>(result.members.size()));
+
+            stack.erase(members_begin, stack.end());
+        }
+    }
+
+    return result;
+}
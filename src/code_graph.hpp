@@ -0,0 +1,92 @@
+///
+/// Code Graph
+///
+/// The control flow of the compiled IR of all scripts, for the whole program analyses run after the IR is generated
+/// (see gosub_depth.hpp, wait_loops.hpp and shared_globals.hpp).
+///
+/// Each node is a command, and its edges are the ways execution may continue from it, as given by the `Flow` of the
+/// command in the config:
+///
+///  + Into the next command of the same script, unless the command never falls through (e.g. `GOTO`, `RETURN`) or
+///    there's data (`DUMP`) after it.
+///  + Into the label arguments of branches (e.g. `GOTO_IF_FALSE`).
+///  + Into the cases and default label of `SWITCH_START`/`SWITCH_CONTINUED`, which only fall through into another
+///    `SWITCH_CONTINUED`.
+///  + Into the label arguments of calls. There's no edge back from the callee, as a call also falls through.
+///
+/// The strongly connected components are numbered so that every component reachable from another has a lower number,
+/// thus the analyses may summarize the components in order, each one solved once, in linear time.
+///
+#pragma once
+#include <stdinc.h>
+#include "codegen.hpp"
+
+class CodeGraph
+{
+public:
+    enum class EdgeKind : uint8_t
+    {
+        Flow,       //< Falls or branches into the target.
+        Call,       //< Calls the target without taking a slot on the GOSUB stack (e.g. `CLEO_CALL`).
+        Gosub,      //< Calls the target, pushing the return address into the GOSUB stack.
+    };
+
+    struct Edge
+    {
+        uint32_t to;
+        EdgeKind kind;
+    };
+
+    /// Where a script thread is started.
+    struct Entry
+    {
+        uint32_t                    node;
+        const Script*               script;     //< The script the thread starts in.
+        const SyntaxTree*           where;      //< The first statement of the thread, if any.
+        shared_ptr<const Label>     label;      //< The label the thread is started at, if any.
+    };
+
+    /// The strongly connected components of the graph.
+    struct Components
+    {
+        std::vector<uint32_t>   component;      //< Component of each node.
+        std::vector<uint32_t>   members;        //< Nodes of each component, one component after the other.
+        std::vector<uint32_t>   members_begin;  //< Index into `members` of each component, plus one past the end.
+
+        uint32_t size() const { return static_cast<uint32_t>(members_begin.size() - 1); }
+
+        const uint32_t* begin(uint32_t id) const { return members.data() + members_begin[id]; }
+        const uint32_t* end(uint32_t id) const   { return members.data() + members_begin[id + 1]; }
+    };
+
+    static constexpr uint32_t no_node = UINT32_MAX;
+
+public:
+    /// Builds the graph of the IR in `gens`.
+    ///
+    /// The threads are started at the beginning of the main script, of subscripts, missions, streamed scripts and
+    /// custom scripts, and at the label arguments of START_NEW_SCRIPT.
+    static CodeGraph from_ir(const std::vector<CodeGenerator>& gens);
+
+    /// \returns the strongly connected components of the graph.
+    const Components& components() const { return this->sccs; }
+
+    uint32_t size() const { return static_cast<uint32_t>(commands.size()); }
+
+    const CompiledCommand& command(uint32_t node) const { return *commands[node]; }
+
+    const Edge* begin(uint32_t node) const { return edges.data() + edge_begin[node]; }
+    const Edge* end(uint32_t node) const   { return edges.data() + edge_begin[node + 1]; }
+
+    const std::vector<Entry>& entries() const { return this->entry_points; }
+
+private:
+    std::vector<const CompiledCommand*> commands;
+    std::vector<uint32_t>               edge_begin;     //< Index into `edges` of the edges of each node.
+    std::vector<Edge>                   edges;
+    std::vector<Entry>                  entry_points;
+    Components                          sccs;
+
+    /// Finds the strongly connected components (Tarjan's algorithm, without recursion).
+    Components find_components() const;
+};
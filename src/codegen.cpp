@@ -2,6 +2,7 @@
 #include "compiler.hpp"
 #include "program.hpp"
 #include "codegen.hpp"
+#include "scm_header.hpp"
 
 /// Generates bytecode from the intermediate representation T.
 ///
@@ -33,19 +34,65 @@ uint32_t CodeGenerator::compute_labels()
         }
         else
         {
-            offset += compiled_size(op, *this);
+            offset += ::compiled_size(op, *this);
         }
     }
     return offset;
 }
 
+size_t CodeGenerator::compiled_size(const CompiledData& data) const
+{
+    return ::compiled_size(data, *this);
+}
+
+int32_t CodeGenerator::label_argument(const Label& label) const
+{
+    if(!this->script->uses_local_offsets())
+    {
+        if(this->program.opt.use_local_offsets)
+            return -static_cast<int32_t>(label.offset());
+        else
+            return static_cast<int32_t>(label.offset());
+    }
+    else // current script is mission/stream
+    {
+        if(label.script.lock()->uses_local_offsets())
+        {
+            assert(label.script.lock()->on_the_same_space_as(*this->script));
+            return -static_cast<int32_t>(label.distance_from_base());
+        }
+        else // label is within main block
+            return static_cast<int32_t>(label.offset());
+    }
+}
+
 void CodeGenerator::generate()
 {
-    this->bw = BinaryWriter(this->script->code_size.value());
+    size_t streamed_size = 0;
+    for(auto& op : this->compiled)
+    {
+        if(is<CompiledHex>(op.data) && get<CompiledHex>(op.data).data->size() >= streamed_hex_threshold)
+            streamed_size += get<CompiledHex>(op.data).data->size();
+    }
 
+    this->streamed_hex.clear();
+    this->statements.clear();
+    this->bw = BinaryWriter(this->script->code_size.value() - streamed_size);
+
+    size_t streamed_so_far = 0;
     for(auto& op : this->compiled)
     {
+        if(this->program.opt.debug_map && is<CompiledCommand>(op.data))
+        {
+            auto where = get<CompiledCommand>(op.data).where;
+            if(where && (this->statements.empty() || this->statements.back().second != where))
+                this->statements.emplace_back(uint32_t(this->bw.current_offset() + streamed_so_far), where);
+        }
+
         generate_code(op, *this);
+
+        if(is<CompiledHex>(op.data) && get<CompiledHex>(op.data).data->size() >= streamed_hex_threshold)
+            streamed_so_far += get<CompiledHex>(op.data).data->size();
     }
 }
 
@@ -191,28 +238,15 @@ inline size_t compiled_size(const CompiledCommand& cmd, const CodeGenerator& cod
 
 inline size_t CompiledScmHeader::compiled_size() const
 {
-    switch(this->version)
-    {
-        case CompiledScmHeader::Version::Liberty:
-        case CompiledScmHeader::Version::Miami:
-        {
-            auto size_globals = this->size_global_vars_space;
-            return 8 + (size_globals - 8) + 8 + 4 + (24 * (1 + this->models.size()))
-                + 8 + 4 + 4 + 2 + 2 + (4 * this->num_missions);
-            break;
-        }
-        case CompiledScmHeader::Version::SanAndreas:
+    return ScmHeaderLayout::of(this->version).size(this->size_global_vars_space, [this](ScmHeaderField count) -> size_t {
+        switch(count)
         {
-            auto size_globals = this->size_global_vars_space;
-            return 8 + (size_globals - 8) + 8 + 4 + (24 * (1 + this->models.size()))
-                + 8 + 4 + 4 + 2 + 2 + (4 * this->num_missions) + 4 //<SA
-                + 8 + 4 + 4 + (28 * (1 + this->num_streamed))
-                + 8 + 4 + 8 + 4 + 1 + 1 + 2;
-            break;
+            case ScmHeaderField::NumModels: return 1 + this->models.size();     // the first model is unused
+            case ScmHeaderField::NumMissions: return this->num_missions;
+            case ScmHeaderField::NumStreamed: return 1 + this->num_streamed;    // the AAA script
+            default: Unreachable();
         }
-        default:
-            Unreachable();
-    }
+    });
 }
 
 inline size_t CustomHeaderOATC::compiled_size() const
@@ -267,7 +301,7 @@ inline void generate_code(const float& value, CodeGenerator& codegen)
     else if(codegen.program.opt.use_half_float)
     {
         codegen.bw.emplace_u8(6);
-        codegen.bw.emplace_i16(static_cast<int16_t>(value * 16.0f));
+        codegen.bw.emplace_i16(to_half_float(value).value()); // out of range values are rejected before codegen
     }
     else
     {
@@ -281,46 +315,26 @@ inline void generate_code(const float& value, CodeGenerator& codegen)
 
 inline void generate_code(const shared_ptr<Label>& label_ptr, CodeGenerator& codegen)
 {
-    codegen.bw.emplace_u8(1);
+    int32_t value = codegen.label_argument(*label_ptr);
 
-    auto emplace_local_offset = [&](int32_t offset)
+    bool is_local_offset = codegen.script->uses_local_offsets()? label_ptr->script.lock()->uses_local_offsets() :
+                                                                 codegen.program.opt.use_local_offsets;
+
+    if(is_local_offset && value == 0)
     {
-        if(offset == 0)
-        {
-            codegen.program.error(nocontext, "compiled script references a label at the zero offset");
-            codegen.program.note(nocontext, "try using SCRIPT_NAME or NOP at the very top of your script");
-        }
-        codegen.bw.emplace_i32(-offset);
-    };
+        codegen.program.error(nocontext, "compiled script references a label at the zero offset");
+        codegen.program.note(nocontext, "try using SCRIPT_NAME or NOP at the very top of your script");
+    }
 
-    if(!codegen.script->uses_local_offsets())
+    if(codegen.script->uses_local_offsets() && !label_ptr->script.lock()->uses_local_offsets())
     {
+        // label is within main block
         if(codegen.program.opt.use_local_offsets)
-        {
-            int32_t absolute_offset = static_cast<int32_t>(label_ptr->offset());
-            emplace_local_offset(absolute_offset);
-        }
-        else
-        {
-            codegen.bw.emplace_i32(label_ptr->offset());
-        }
+            codegen.program.error(*codegen.script, "cannot branch from this script into main block using local offsets [-mlocal-offsets]");
     }
-    else // current script is mission/stream
-    {
-        if(label_ptr->script.lock()->uses_local_offsets())
-        {
-            assert(label_ptr->script.lock()->on_the_same_space_as(*codegen.script));
-            int32_t local_offset = static_cast<int32_t>(label_ptr->distance_from_base());
-            emplace_local_offset(local_offset);
-        }
-        else // label is within main block
-        {
-            if(codegen.program.opt.use_local_offsets)
-                codegen.program.error(*codegen.script, "cannot branch from this script into main block using local offsets [-mlocal-offsets]");
 
-            codegen.bw.emplace_i32(label_ptr->offset());
-        }
-    }
+    codegen.bw.emplace_u8(1);
+    codegen.bw.emplace_i32(value);
 }
 
 inline void generate_code(const CompiledString& str, CodeGenerator& codegen)
@@ -466,7 +480,10 @@ inline void generate_code(const CompiledLabelDef&, CodeGenerator&)
 
 inline void generate_code(const CompiledHex& hex, CodeGenerator& codegen)
 {
-    codegen.bw.emplace_bytes(hex.data.size(), hex.data.data());
+    if(hex.data->size() >= CodeGenerator::streamed_hex_threshold)
+        codegen.stream_hex(hex.data);
+    else
+        codegen.bw.emplace_bytes(hex.data->size(), hex.data->data());
 }
 
 static void generate_skipper(CodeGeneratorData& codegen, int32_t skip_bytes, bool force_global_offset)//+8 +12
@@ -502,18 +519,6 @@ inline void generate_code(const CompiledScmHeader& header, CodeGeneratorData& co
         || header.version == CompiledScmHeader::Version::Miami
         || header.version == CompiledScmHeader::Version::SanAndreas);
 
-    auto nextseg_id = [v = header.version, current_segid = 0u]() mutable
-    {
-        if(v == CompiledScmHeader::Version::SanAndreas)
-            return current_segid++;
-        return 0u;
-    };
-
-    auto goto_rel = [&codegen](int32_t skip_bytes)
-    {
-        return generate_skipper(codegen, 8 + skip_bytes, true);
-    };
-
     auto comp_largest_mission = [](const shared_ptr<const Script>& m1, const shared_ptr<const Script>& m2)
     {
         return m1->full_size() < m2->full_size();
@@ -528,11 +533,6 @@ inline void generate_code(const CompiledScmHeader& header, CodeGeneratorData& co
     std::vector<shared_ptr<const Script>> missions;
     std::vector<shared_ptr<const Script>> streameds;
 
-    char target_id = (header.version == CompiledScmHeader::Version::Liberty? '\0' : // original III main.scm doesn't use 'l' yet
-                      header.version == CompiledScmHeader::Version::Miami? 'm' :
-                      header.version == CompiledScmHeader::Version::SanAndreas? 's' :
-                      Unreachable());
-
     missions.reserve(header.num_missions);
     streameds.reserve(header.num_streamed);
 
@@ -566,86 +566,36 @@ inline void generate_code(const CompiledScmHeader& header, CodeGeneratorData& co
         }
     }
 
-    // Variables segment
-    auto size_globals = header.size_global_vars_space;
-    goto_rel(size_globals - 8);
-    codegen.bw.emplace_i8(target_id);
-    codegen.bw.emplace_fill(size_globals - 8, 0);
-
-    // Models segment
-    goto_rel(4 + (24 * (1 + header.models.size())));
-    codegen.bw.emplace_u8(nextseg_id());
-    codegen.bw.emplace_u32(1 + header.models.size());
-    codegen.bw.emplace_chars(24, "");
-    for(auto& model : header.models)
-        codegen.bw.emplace_chars(24, model.c_str(), true);
-
-    // SCM info segment
-    {
-        int32_t rel_offset = 4 + 4 + 2 + 2 + (4 * missions.size()) +
-                            (header.version == CompiledScmHeader::Version::SanAndreas? 4 : 0);
-        goto_rel(rel_offset);
-        codegen.bw.emplace_u8(nextseg_id());
-        codegen.bw.emplace_u32(main_size);
-        codegen.bw.emplace_u32(largest_mission_size);
-        codegen.bw.emplace_u16(static_cast<uint16_t>(missions.size()));
-        codegen.bw.emplace_u16(0); // number_of_exclusive_missions
-
-        if(header.version == CompiledScmHeader::Version::SanAndreas)
-        {
-            codegen.bw.emplace_u32(maximum_mission_local);
-        }
+    ScmHeaderData data;
+    data.size_globals = header.size_global_vars_space;
+    data.main_size = main_size;
+    data.largest_mission = largest_mission_size;
+    data.max_mission_locals = maximum_mission_local;
+    data.largest_streamed = largest_streamed_size;
 
-        for(auto& script_ptr : missions)
-            codegen.bw.emplace_i32(script_ptr->base.value());
-    }
+    data.models.reserve(1 + header.models.size());
+    data.models.emplace_back();
+    data.models.insert(data.models.end(), header.models.begin(), header.models.end());
+
+    data.mission_offsets.reserve(missions.size());
+    for(auto& script_ptr : missions)
+        data.mission_offsets.emplace_back(script_ptr->base.value());
 
-    // Streamed scripts segment
     if(header.version == CompiledScmHeader::Version::SanAndreas)
     {
         uint32_t virtual_offset = multifile_size;
 
-        goto_rel(4 + 4 + (28 * (1 + streameds.size())));
-        codegen.bw.emplace_u8(nextseg_id());
-        codegen.bw.emplace_u32(largest_streamed_size);
-        codegen.bw.emplace_u32(static_cast<uint32_t>(1 + streameds.size()));
-
+        data.streamed_scripts.reserve(1 + streameds.size());
         for(auto& script_ptr : streameds)
         {
-            auto name = script_ptr->path.stem().u8string();
-            codegen.bw.emplace_chars(20, name.c_str(), true);
-            codegen.bw.emplace_u32(virtual_offset);
-            codegen.bw.emplace_u32(script_ptr->full_size());
+            data.streamed_scripts.push_back({ script_ptr->path.stem().u8string(), virtual_offset, script_ptr->full_size() });
             virtual_offset += script_ptr->full_size();
         }
 
-        // AAA script
-        {
-            codegen.bw.emplace_chars(20, "AAA");
-            codegen.bw.emplace_u32(0);
-            codegen.bw.emplace_u32(8);
-        }
-    }
-
-    // Unknown segment
-    if(header.version == CompiledScmHeader::Version::SanAndreas)
-    {
-        goto_rel(4);
-        codegen.bw.emplace_u8(nextseg_id());
-        codegen.bw.emplace_u32(0);
-    }
-
-    // Unknown segment 2
-    if(header.version == CompiledScmHeader::Version::SanAndreas)
-    {
-        goto_rel(4 + 1 + 1 + 2);
-        codegen.bw.emplace_u8(nextseg_id());
-        codegen.bw.emplace_u32(size_globals - 8);
-        codegen.bw.emplace_u8(62); // Unknown / Unused
-        codegen.bw.emplace_u8(2);  // Unknown / Unused
-        codegen.bw.emplace_u16(0); // Unknown / Unused
+        data.streamed_scripts.push_back({ "AAA", 0, 8 });
     }
 
+    ScmHeaderLayout::of(header.version).write(data, codegen.bw, codegen.script_offset);
 }
 
 inline void CustomHeaderOATC::generate_code(CodeGeneratorData& codegen) const
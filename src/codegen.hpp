@@ -20,9 +20,18 @@ public:
     const shared_ptr<const Script>  script;
     const CustomHeaderOATC*         oatc; // may be null for nullopt
 
+    /// HEX data of at least this size isn't copied into `bw`, but written from its own buffer by `write_code`.
+    static constexpr size_t         streamed_hex_threshold = 64 * 1024;
+
 private:
     std::vector<CompiledData>       compiled;
 
+    /// HEX data to be written by `write_code`, and the offset in `bw` it goes before.
+    std::vector<std::pair<size_t, shared_ptr<const std::vector<uint8_t>>>> streamed_hex;
+
+    /// The code position of the commands of each statement, only with the `-g` option.
+    std::vector<std::pair<uint32_t, const SyntaxTree*>> statements;
+
 public:
     explicit CodeGenerator(shared_ptr<const Script> script_, std::vector<CompiledData>&& compiled, ProgramContext& program) :
         program(program), script(std::move(script_)), compiled(std::move(compiled)), oatc(nullptr)
@@ -51,17 +60,69 @@ public:
 
     /// Generates the code.
     void generate();
-    
-    /// Gets the resulting buffer of the generation.
-    const void* buffer() const { return this->bw.buffer(); }
 
-    /// Gets the size of the resulting buffer of the generation.
-    size_t buffer_size() const { return this->bw.buffer_size(); }
+    /// Places large HEX data at the current offset of the generation, to be written by `write_code`.
+    void stream_hex(shared_ptr<const std::vector<uint8_t>> data)
+    {
+        this->streamed_hex.emplace_back(this->bw.current_offset(), std::move(data));
+    }
+
+    /// Writes the generated code into `output` (a `FILE*` or `std::vector<uint8_t>`) at `offset`.
+    ///
+    /// \returns the size of the code.
+    template<typename Writeable>
+    size_t write_code(Writeable& output, size_t offset) const
+    {
+        auto buffer = static_cast<const uint8_t*>(this->bw.buffer());
+        size_t buffer_pos = 0;
+        size_t code_pos = 0;
+
+        auto write = [&](const void* data, size_t size) {
+            write_file(output, offset + code_pos, data, size);
+            code_pos += size;
+        };
+
+        for(auto& hex : this->streamed_hex)
+        {
+            write(buffer + buffer_pos, hex.first - buffer_pos);
+            write(hex.second->data(), hex.second->size());
+            buffer_pos = hex.first;
+        }
+        write(buffer + buffer_pos, this->bw.buffer_size() - buffer_pos);
+
+        return code_pos;
+    }
 
     ///
     const std::vector<CompiledData>& ir() const { return this->compiled; };
+
+    /// Gets the code position (relative to `script->code_offset`) in which each statement begins, sorted.
+    ///
+    /// \note Only available after generation and with the `-g` option.
+    const std::vector<std::pair<uint32_t, const SyntaxTree*>>& statement_offsets() const { return this->statements; }
+
+    /// Gets the size, in bytes, that the specified piece of data takes once generated by this code generator.
+    size_t compiled_size(const CompiledData& data) const;
+
+    /// Gets the immediate value generated for a label argument in this script.
+    ///
+    /// \warning Only available after offsets have been computed.
+    int32_t label_argument(const Label& label) const;
 };
 
+/// Encodes `value` into the q11.4 fixed point format of GTA III floats (see `-mq11.4`).
+///
+/// The fraction is truncated towards zero, as the original compiler does.
+///
+/// \returns `nullopt` if the value is out of the range of the format, which is [-2048.0, 2047.9375].
+inline optional<int16_t> to_half_float(float value)
+{
+    float fixed = value * 16.0f;
+    if(fixed > -32769.0f && fixed < 32768.0f)
+        return static_cast<int16_t>(fixed);
+    return nullopt;
+}
+
 /// Converts intermediate of pure-data things (such as the SCM header) into a bytecode.
 class CodeGeneratorData
 {
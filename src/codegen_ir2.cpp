@@ -0,0 +1,554 @@
+#include <stdinc.h>
+#include "codegen_ir2.hpp"
+#include "decompiler_ir2.hpp"
+#include "program.hpp"
+
+namespace
+{
+/// A code segment, as seen by the disassembler (i.e. the main block, a mission or a streamed script).
+struct IR2Segment
+{
+    std::string                 block_name;
+    size_t                      begin = 0;      //< Offset of this segment in its output file.
+    size_t                      size  = 0;      //< Size of this segment, including headers.
+
+    /// The generators in this segment, in the order they are laid out, with their local code offset.
+    std::vector<std::pair<size_t, const CodeGenerator*>> units;
+
+    /// The local offset of the labels referenced into this segment.
+    std::set<size_t>            label_offsets;
+
+    /// The lowered commands of this segment. Label definitions are added only after all segments are lowered,
+    /// since labels into the main segment may be referenced from anywhere.
+    std::vector<DecompiledData> decompiled;
+
+    /// Same as `Disassembler::switch_cases_left`.
+    size_t                      switch_cases_left = 0;
+
+    explicit IR2Segment(std::string block_name, size_t begin, size_t size) :
+        block_name(std::move(block_name)), begin(begin), size(size)
+    {}
+};
+
+/// Gets the data type byte the disassembler reads for the argument `varg`, or `nullopt` if there's no such byte.
+optional<uint8_t> arg_datatype(const ArgVariant& varg, const ProgramContext& program)
+{
+    if(is<EOAL>(varg))
+        return 0x00;
+    else if(is<int8_t>(varg))
+        return 0x04;
+    else if(is<int16_t>(varg))
+        return 0x05;
+    else if(is<int32_t>(varg) || is<shared_ptr<Label>>(varg))
+        return 0x01;
+    else if(is<float>(varg))
+        return (program.opt.optimize_zero_floats && get<float>(varg) == 0.0f)? 0x04 : 0x06;
+    else if(is<CompiledVar>(varg))
+    {
+        auto& v = get<CompiledVar>(varg);
+        bool global = v.var->global;
+        bool is_array = (v.index && is<shared_ptr<Var>>(*v.index));
+        switch(v.var->type)
+        {
+            case VarType::Int:
+            case VarType::Float:
+                return is_array? (global? 0x07 : 0x08) : (global? 0x02 : 0x03);
+            case VarType::TextLabel:
+                return is_array? (global? 0x0C : 0x0D) : (global? 0x0A : 0x0B);
+            case VarType::TextLabel16:
+                return is_array? (global? 0x12 : 0x13) : (global? 0x10 : 0x11);
+            default:
+                Unreachable();
+        }
+    }
+    else if(is<CompiledString>(varg))
+    {
+        auto& s = get<CompiledString>(varg);
+        switch(s.type)
+        {
+            case CompiledString::Type::TextLabel8:
+                if(program.opt.has_text_label_prefix)
+                    return 0x09;
+                // III/VC text labels have no data type, their first character takes its place.
+                return static_cast<uint8_t>(s.storage.empty()? '\0' :
+                                            s.preserve_case? s.storage[0] : toupper_ascii(s.storage[0]));
+            case CompiledString::Type::TextLabel16:
+                return 0x0F;
+            case CompiledString::Type::StringVar:
+                return 0x0E;
+            case CompiledString::Type::String128:
+                return nullopt;
+            default:
+                Unreachable();
+        }
+    }
+    Unreachable();
+}
+
+/// Gets the characters the disassembler fetches from a string field of `count` bytes generated from `str`.
+std::string fetch_string(const CompiledString& str, size_t count)
+{
+    std::string output(count, '\0');
+    for(size_t i = 0; i < count && i < str.storage.size() && str.storage[i] != '\0'; ++i)
+        output[i] = str.preserve_case? str.storage[i] : toupper_ascii(str.storage[i]);
+    return output;
+}
+
+/// Transforms an argument into what the disassembler would give out of its bytecode.
+ArgVariant2 lower_arg(const ArgVariant& varg, const CodeGenerator& codegen)
+{
+    auto& program = codegen.program;
+
+    if(is<float>(varg))
+    {
+        float value = get<float>(varg);
+        if(program.opt.optimize_zero_floats && value == 0.0f)
+            return int8_t(0);
+        else if(program.opt.use_half_float)
+            return to_half_float(value).value() / 16.0f;
+        else
+            return value;
+    }
+    else if(is<shared_ptr<Label>>(varg))
+    {
+        return codegen.label_argument(*get<shared_ptr<Label>>(varg));
+    }
+    else if(is<CompiledVar>(varg))
+    {
+        auto& v = get<CompiledVar>(varg);
+        bool global = v.var->global;
+        auto type = (v.var->type == VarType::Float? VarType::Int : v.var->type);
+
+        if(v.index == nullopt || is<int32_t>(*v.index))
+        {
+            auto actual_index = (v.index? get<int32_t>(*v.index) * Var::space_taken(v.var->type) : 0);
+            auto value = static_cast<uint16_t>(global? v.var->offset() + actual_index * 4 : v.var->index + actual_index);
+            return DecompiledVar { global, type, global? uint32_t(value) : uint32_t(value) * 4 };
+        }
+        else
+        {
+            auto& index_var = get<shared_ptr<Var>>(*v.index);
+            auto base_value = static_cast<uint16_t>(global? v.var->offset() : v.var->index);
+            auto index_value = static_cast<uint16_t>(index_var->global? index_var->offset() : index_var->index);
+
+            auto elem_type = v.var->type == VarType::Int? DecompiledVarArray::ElemType::Int :
+                             v.var->type == VarType::Float? DecompiledVarArray::ElemType::Float :
+                             v.var->type == VarType::TextLabel? DecompiledVarArray::ElemType::TextLabel :
+                             v.var->type == VarType::TextLabel16? DecompiledVarArray::ElemType::TextLabel16 :
+                             Unreachable();
+
+            return DecompiledVarArray {
+                DecompiledVar { global, type, uint32_t(base_value) * (global? 1 : 4) },
+                DecompiledVar { index_var->global, VarType::Int, uint32_t(index_value) * (index_var->global? 1 : 4) },
+                static_cast<uint8_t>(v.var->count.value()),
+                elem_type,
+            };
+        }
+    }
+    else if(is<CompiledString>(varg))
+    {
+        auto& s = get<CompiledString>(varg);
+        switch(s.type)
+        {
+            case CompiledString::Type::TextLabel8:
+                return DecompiledString { DecompiledString::Type::TextLabel8, fetch_string(s, 8) };
+            case CompiledString::Type::TextLabel16:
+                return DecompiledString { DecompiledString::Type::TextLabel16, fetch_string(s, 16) };
+            case CompiledString::Type::StringVar:
+                return DecompiledString { DecompiledString::Type::StringVar, fetch_string(s, s.storage.size()) };
+            case CompiledString::Type::String128:
+                return DecompiledString { DecompiledString::Type::String128, fetch_string(s, 128) };
+            default:
+                Unreachable();
+        }
+    }
+    else if(is<int8_t>(varg))
+        return get<int8_t>(varg);
+    else if(is<int16_t>(varg))
+        return get<int16_t>(varg);
+    else if(is<int32_t>(varg))
+        return get<int32_t>(varg);
+    else if(is<EOAL>(varg))
+        return EOAL{};
+    else
+        Unreachable();
+}
+
+/// Transforms a command into what the disassembler would give out of its bytecode, taking note of the labels it
+/// references in the same way `Disassembler::explore_opcode` does.
+///
+/// \returns `nullopt` if the bytecode of this command would not disassembly back into the same command.
+optional<DecompiledCommand> lower_command(const CompiledCommand& ccmd, const CodeGenerator& codegen,
+                                          IR2Segment& segment, IR2Segment& main_segment)
+{
+    auto& program = codegen.program;
+    auto& commands = program.commands;
+
+    // The disassembler only knows the command by its opcode.
+    optional<const Command&> opt_command;
+    if(codegen.oatc && codegen.oatc->find_opcode(ccmd.command))
+        opt_command = commands.find_command(ccmd.command.name);
+    else if(ccmd.command.id)
+        opt_command = commands.find_command(*ccmd.command.id);
+
+    if(!opt_command)
+        return nullopt;
+
+    const Command& command = *opt_command;
+
+    bool is_switch_start     = (command.special == SpecialCommand::SwitchStart);
+    bool is_switch_continued = (command.special == SpecialCommand::SwitchContinued);
+
+    if(is_switch_start)
+        segment.switch_cases_left = 0;
+
+    auto check_for_imm32 = [&](int32_t value, const Command::Arg& arg, size_t argument_id)
+    {
+        if(is_switch_start && argument_id == 1)
+            segment.switch_cases_left = value;
+
+        if(arg.type == ArgType::Label)
+        {
+            if(is_switch_start || is_switch_continued)
+            {
+                if(segment.switch_cases_left == 0)
+                    return; // don't take offset
+
+                if(is_switch_start && argument_id != 3) // not default label
+                    --segment.switch_cases_left;
+            }
+
+            if(value >= 0)
+                main_segment.label_offsets.emplace(value);
+            else
+                segment.label_offsets.emplace(-value);
+        }
+    };
+
+    DecompiledCommand dcmd { ccmd.not_flag, command, {} };
+    dcmd.args.reserve(ccmd.args.size());
+
+    bool stop_it = false;
+    size_t argument_id = 0;
+
+    for(auto it = command.args.begin();
+        !stop_it && it != command.args.end();
+        (it->optional? it : ++it), ++argument_id)
+    {
+        if(argument_id >= ccmd.args.size())
+            return nullopt;
+
+        auto& varg = ccmd.args[argument_id];
+        bool is_text_label8 = is<CompiledString>(varg) && get<CompiledString>(varg).type == CompiledString::Type::TextLabel8;
+
+        if(it->type == ArgType::TextLabel32)
+        {
+            if(std::distance(it, command.args.end()) < 4
+                || std::next(it, 1)->type != it->type
+                || std::next(it, 2)->type != it->type
+                || std::next(it, 3)->type != it->type)
+                return nullopt;
+
+            if(!is<CompiledString>(varg) || get<CompiledString>(varg).type != CompiledString::Type::String128)
+                return nullopt;
+
+            dcmd.args.emplace_back(lower_arg(varg, codegen));
+            it += 3;
+            continue;
+        }
+
+        auto opt_datatype = arg_datatype(varg, program);
+        if(!opt_datatype)
+            return nullopt;
+
+        if(!program.opt.has_text_label_prefix)
+        {
+            if(*opt_datatype > 0x06)
+            {
+                if(it->type == ArgType::TextLabel)
+                {
+                    if(!is_text_label8)
+                        return nullopt;
+                    dcmd.args.emplace_back(lower_arg(varg, codegen));
+                    continue;
+                }
+                else if(!(*opt_datatype == 0x0E && it->type == ArgType::String && program.opt.cleo))
+                {
+                    return nullopt;
+                }
+            }
+            else if(is_text_label8)
+            {
+                // the first character would be taken as a data type
+                return nullopt;
+            }
+        }
+
+        auto arg = lower_arg(varg, codegen);
+
+        switch(*opt_datatype)
+        {
+            case 0x00: // EOA (end of args)
+                if(!it->optional)
+                    return nullopt;
+                stop_it = true;
+                break;
+            case 0x01: // Int32
+            case 0x04: // Int8
+            case 0x05: // Int16
+                check_for_imm32(get_imm32(arg).value(), *it, argument_id);
+                break;
+            default:
+                break;
+        }
+
+        dcmd.args.emplace_back(std::move(arg));
+    }
+
+    if(argument_id != ccmd.args.size())
+        return nullopt;
+
+    return dcmd;
+}
+
+/// Lowers all the commands of `segment`.
+///
+/// \returns `false` if the segment is not laid out in the way the disassembler would see it, or if some of its
+/// pseudo-instructions cannot be lowered.
+bool lower_segment(IR2Segment& segment, IR2Segment& main_segment)
+{
+    size_t expected_offset = 0;
+
+    for(size_t i = 0; i < segment.units.size(); ++i)
+    {
+        auto& unit = segment.units[i];
+        auto& script = *unit.second->script;
+
+        // Only the headers at the very beginning of the segment are skipped by the disassembler.
+        if(i == 0 && unit.first != script.header_size())
+            return false;
+        if(i != 0 && (unit.first != expected_offset || script.header_size() != 0))
+            return false;
+
+        size_t offset = unit.first;
+        for(auto& op : unit.second->ir())
+        {
+            if(is<CompiledCommand>(op.data))
+            {
+                auto opt_dcmd = lower_command(get<CompiledCommand>(op.data), *unit.second, segment, main_segment);
+                if(!opt_dcmd)
+                    return false;
+                segment.decompiled.emplace_back(offset, std::move(*opt_dcmd));
+            }
+            else if(is<CompiledHex>(op.data))
+            {
+                // may disassembly into anything
+                return false;
+            }
+
+            offset += unit.second->compiled_size(op);
+        }
+
+        if(offset != unit.first + script.code_size.value())
+            return false;
+
+        expected_offset = offset;
+    }
+
+    return expected_offset == segment.size;
+}
+
+/// Gets the lowered data of `segment` with the label definitions in place.
+std::vector<DecompiledData> segment_data(IR2Segment& segment)
+{
+    std::vector<DecompiledData> output;
+    output.reserve(segment.decompiled.size() + segment.label_offsets.size());
+
+    auto label_it = segment.label_offsets.begin();
+    for(auto& data : segment.decompiled)
+    {
+        while(label_it != segment.label_offsets.end() && *label_it < data.offset)
+            ++label_it;
+
+        if(label_it != segment.label_offsets.end() && *label_it == data.offset)
+            output.emplace_back(DecompiledLabelDef{ data.offset });
+
+        output.emplace_back(std::move(data));
+    }
+
+    return output;
+}
+}
+
+bool generate_ir2(const std::vector<CodeGenerator>& gens, const MultiFileHeaderList& multi_headers,
+                  ProgramContext& program, const std::function<void(const std::string&)>& callback)
+{
+    Expects(!gens.empty() && gens[0].script->is_main_script());
+
+    // The recursive traversal mayn't reach some pieces of the code, emitting them as hex.
+    if(!program.opt.linear_sweep)
+        return false;
+
+    std::map<const Script*, const CodeGenerator*> gen_by_script;
+    for(auto& gen : gens)
+        gen_by_script.emplace(gen.script.get(), &gen);
+
+    std::vector<std::string> header_lines;
+    std::vector<IR2Segment> segments; // [0] is the main segment
+    size_t num_missions = 0;
+
+    size_t multifile_size = std::accumulate(gens.begin(), gens.end(), size_t(0), [&](size_t size, const auto& gen) {
+        if(gen.script->is_root_script() && gen.script->type != ScriptType::StreamedScript)
+            return size + gen.script->full_size();
+        return size;
+    });
+
+    auto find_segment = [&](size_t offset) -> IR2Segment*
+    {
+        for(size_t i = 0; i < 1 + num_missions; ++i)
+        {
+            if(offset >= segments[i].begin && offset < segments[i].begin + segments[i].size)
+                return &segments[i];
+        }
+        return nullptr;
+    };
+
+    if(program.opt.headerless)
+    {
+        segments.emplace_back("MAIN", 0, multifile_size);
+    }
+    else
+    {
+        auto scmheader = multi_headers.find_header<CompiledScmHeader>(gens[0].script);
+        if(!scmheader)
+            return false;
+
+        size_t main_size = 0;
+        std::vector<shared_ptr<const Script>> missions;
+        std::vector<shared_ptr<const Script>> streameds;
+
+        for(auto& sc : scmheader->base_scripts)
+        {
+            if(sc->type == ScriptType::Mission)
+                missions.emplace_back(sc);
+            else if(sc->type == ScriptType::StreamedScript)
+                streameds.emplace_back(sc);
+            else
+                main_size += sc->full_size();
+        }
+
+        for(size_t i = 0; i < scmheader->models.size(); ++i)
+        {
+            auto name = scmheader->models[i];
+            if(name.size() >= 24) // no null terminator in the header
+                return false;
+            std::transform(name.begin(), name.end(), name.begin(), toupper_ascii);
+            header_lines.emplace_back(fmt::format("#DEFINE_MODEL {} -{}", name, i+1));
+        }
+
+        if(scmheader->version == CompiledScmHeader::Version::SanAndreas)
+        {
+            insensitive_map<std::string, size_t> stream_names;
+            for(size_t i = 0; i < streameds.size(); ++i)
+            {
+                auto name = streameds[i]->path.stem().u8string();
+                std::transform(name.begin(), name.end(), name.begin(), toupper_ascii);
+                if(name.size() >= 20 || !stream_names.emplace(name, i).second || iequal_to()(name, "AAA"))
+                    return false;
+                header_lines.emplace_back(fmt::format("#DEFINE_STREAM {} {}", name, i));
+            }
+            header_lines.emplace_back(fmt::format("#DEFINE_STREAM {} {}", "AAA", streameds.size()));
+        }
+
+        std::vector<uint32_t> mission_offsets_sorted;
+        mission_offsets_sorted.reserve(missions.size());
+        for(auto& sc : missions)
+            mission_offsets_sorted.emplace_back(sc->base.value());
+        std::sort(mission_offsets_sorted.begin(), mission_offsets_sorted.end());
+
+        segments.reserve(1 + missions.size() + streameds.size());
+        segments.emplace_back("MAIN", 0, std::min(main_size, multifile_size));
+
+        for(size_t i = 0; i < missions.size(); ++i)
+        {
+            size_t mission_offset = missions[i]->base.value();
+            auto it = std::upper_bound(mission_offsets_sorted.begin(), mission_offsets_sorted.end(), mission_offset);
+            size_t next_mission_offset = (it != mission_offsets_sorted.end()? *it : multifile_size);
+
+            if(mission_offset < main_size || next_mission_offset > multifile_size
+                || std::count(mission_offsets_sorted.begin(), mission_offsets_sorted.end(), mission_offset) != 1)
+                return false;
+
+            segments.emplace_back(fmt::format("MISSION_{}", i), mission_offset, next_mission_offset - mission_offset);
+        }
+
+        num_missions = missions.size();
+
+        if(program.opt.streamed_scripts)
+        {
+            for(size_t i = 0; i < streameds.size(); ++i)
+            {
+                auto& sc = streameds[i];
+                segments.emplace_back(fmt::format("STREAM_{}", i), sc->base.value(), sc->full_size());
+
+                // streamed scripts are written into script.img followed by the code of its required scripts
+                auto& segment = segments.back();
+                size_t offset = sc->header_size();
+                segment.units.emplace_back(offset, gen_by_script.at(sc.get()));
+                offset += sc->code_size.value();
+
+                for(auto& child : sc->children_scripts)
+                {
+                    auto required = child.lock();
+                    if(required->code_offset.value() != sc->base.value() + offset)
+                        return false;
+                    segment.units.emplace_back(offset, gen_by_script.at(required.get()));
+                    offset += required->code_size.value();
+                }
+            }
+        }
+    }
+
+    for(auto& gen : gens)
+    {
+        if(!gen.script->is_child_of(ScriptType::StreamedScript))
+        {
+            auto segment = find_segment(gen.script->code_offset.value());
+            if(segment == nullptr)
+                return false;
+            segment->units.emplace_back(gen.script->code_offset.value() - segment->begin, &gen);
+        }
+    }
+
+    for(size_t i = 0; i < 1 + num_missions; ++i)
+    {
+        std::sort(segments[i].units.begin(), segments[i].units.end(), [](const auto& a, const auto& b) {
+            return a.first < b.first;
+        });
+    }
+
+    for(auto& segment : segments)
+    {
+        if(!lower_segment(segment, segments[0]))
+            return false;
+    }
+
+    for(auto& line : header_lines)
+        callback(line);
+
+    auto main_ir2 = DecompilerIR2(program.commands, segment_data(segments[0]), 0, segments[0].size, "MAIN", true);
+    main_ir2.decompile(callback);
+
+    for(size_t i = 1; i < segments.size(); ++i)
+    {
+        bool is_mission = (i < 1 + num_missions);
+        auto& segment = segments[i];
+        auto id = is_mission? (i - 1) : (i - 1 - num_missions);
+
+        callback(fmt::format(is_mission? "#MISSION_BLOCK_START {}" : "#STREAMED_BLOCK_START {}", id));
+        DecompilerIR2(program.commands, segment_data(segment), 0, segment.size, segment.block_name, false, main_ir2).decompile(callback);
+        callback(is_mission? "#MISSION_BLOCK_END" : "#STREAMED_BLOCK_END");
+    }
+
+    return true;
+}
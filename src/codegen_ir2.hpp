@@ -0,0 +1,22 @@
+///
+/// IR2 Code Generator
+///
+/// Transforms the intermediate representation of the code generators (vector of pseudo-instructions, see *compiler.hpp*)
+/// straight into IR2, without building and disassemblying the SCM bytecode.
+///
+/// The output is the same as the one given by `decompile` on the bytecode generated by the code generators.
+///
+#pragma once
+#include <stdinc.h>
+#include "codegen.hpp"
+
+/// Emits IR2 lines for the specified code generators into `callback`.
+///
+/// This must be called after the offsets have been computed (i.e. `CodeGenerator::compute_labels` and
+/// `Script::compute_script_offsets`), but does not need `CodeGenerator::generate`.
+///
+/// \returns `false`, without emitting anything, if the IR2 of some of the pseudo-instructions cannot be known
+/// without disassemblying the bytecode (e.g. DUMP data, or code that would not decode back into itself).
+/// In such a case, the bytecode should be decompiled instead.
+bool generate_ir2(const std::vector<CodeGenerator>& gens, const MultiFileHeaderList& multi_headers,
+                  ProgramContext& program, const std::function<void(const std::string&)>& callback);
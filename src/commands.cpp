@@ -8,20 +8,40 @@ Commands::Commands(transparent_set<Command>&& commands_,
                    transparent_map<std::string, EntityType>&& entities_,
                    transparent_map<std::string, shared_ptr<Enum>>&& enums_)
 
-    : commands(std::move(commands_)), alternators(std::move(alternators_)),
-      enums(std::move(enums_)), entities(std::move(entities_))
+    : Commands(nullptr, std::move(commands_), std::move(alternators_), std::move(entities_), std::move(enums_), {})
 {
-    auto it_defaultmodel = this->enums.find("DEFAULTMODEL");
-    auto it_model       = this->enums.find("MODEL");
-    auto it_scriptstream= this->enums.find("SCRIPTSTREAM");
+}
+
+Commands::Commands(shared_ptr<const Commands> base_,
+                   transparent_set<Command>&& commands_,
+                   insensitive_map<std::string, std::vector<const Command*>>&& alternators_,
+                   transparent_map<std::string, EntityType>&& entities_,
+                   transparent_map<std::string, shared_ptr<Enum>>&& enums_,
+                   std::map<const Enum*, shared_ptr<Enum>>&& extended_enums_)
+
+    : base(std::move(base_)), commands(std::move(commands_)), alternators(std::move(alternators_)),
+      enums(std::move(enums_)), entities(std::move(entities_)), extended_enums(std::move(extended_enums_))
+{
+    if(this->base)
+    {
+        this->enum_models = this->base->enum_models;
+        this->enum_defaultmodels = this->base->enum_defaultmodels;
+        this->enum_scriptstream = this->base->enum_scriptstream;
+    }
+    else
+    {
+        auto it_defaultmodel = this->enums.find("DEFAULTMODEL");
+        auto it_model       = this->enums.find("MODEL");
+        auto it_scriptstream= this->enums.find("SCRIPTSTREAM");
 
-    assert(it_model != this->enums.end());
-    assert(it_defaultmodel != this->enums.end());
-    assert(it_scriptstream != this->enums.end());
+        assert(it_model != this->enums.end());
+        assert(it_defaultmodel != this->enums.end());
+        assert(it_scriptstream != this->enums.end());
 
-    this->enum_models = it_model->second;
-    this->enum_defaultmodels = it_defaultmodel->second;
-    this->enum_scriptstream = it_scriptstream->second;
+        this->enum_models = it_model->second;
+        this->enum_defaultmodels = it_defaultmodel->second;
+        this->enum_scriptstream = it_scriptstream->second;
+    }
     
     for(auto& cmd : this->commands)
     {
@@ -29,51 +49,27 @@ Commands::Commands(transparent_set<Command>&& commands_,
             this->commands_by_id.emplace(*cmd.id, std::addressof(cmd));
     }
 
-    this->set_progress_total            = find_command("SET_PROGRESS_TOTAL");
-    this->set_total_number_of_missions  = find_command("SET_TOTAL_NUMBER_OF_MISSIONS");
-    this->set_collectable1_total        = find_command("SET_COLLECTABLE1_TOTAL");
-    this->set_mission_respect_total     = find_command("SET_MISSION_RESPECT_TOTAL");
-    this->register_mission_passed       = find_command("REGISTER_MISSION_PASSED");
-    this->register_oddjob_mission_passed= find_command("REGISTER_ODDJOB_MISSION_PASSED");
-    this->create_collectable1           = find_command("CREATE_COLLECTABLE1");
-    this->award_player_mission_respect  = find_command("AWARD_PLAYER_MISSION_RESPECT");
-    this->player_made_progress          = find_command("PLAYER_MADE_PROGRESS");
-    this->repeat                        = find_command("REPEAT");
-    this->switch_                       = find_command("SWITCH");
-    this->case_                         = find_command("CASE");
-    this->switch_start                  = find_command("SWITCH_START");
-    this->switch_continued              = find_command("SWITCH_CONTINUED");
-    this->gosub_file                    = find_command("GOSUB_FILE");
-    this->launch_mission                = find_command("LAUNCH_MISSION");
-    this->load_and_launch_mission_internal = find_command("LOAD_AND_LAUNCH_MISSION_INTERNAL");
-    this->start_new_script              = find_command("START_NEW_SCRIPT");
-    this->start_new_streamed_script     = find_command("START_NEW_STREAMED_SCRIPT");
-    this->terminate_this_script         = find_command("TERMINATE_THIS_SCRIPT");
-    this->script_name                   = find_command("SCRIPT_NAME");
-    this->return_                        = find_command("RETURN");
-    this->cleo_call                     = find_command("CLEO_CALL");
-    this->cleo_return                   = find_command("CLEO_RETURN");
-    this->terminate_this_custom_script  = find_command("TERMINATE_THIS_CUSTOM_SCRIPT");
-    this->goto_                          = find_command("GOTO");
-    this->goto_if_false                 = find_command("GOTO_IF_FALSE");
-    this->andor                         = find_command("ANDOR");
-    this->save_string_to_debug_file     = find_command("SAVE_STRING_TO_DEBUG_FILE");
-    this->skip_cutscene_start           = find_command("SKIP_CUTSCENE_START");
-    this->skip_cutscene_end             = find_command("SKIP_CUTSCENE_END");
-    this->skip_cutscene_start_internal  = find_command("SKIP_CUTSCENE_START_INTERNAL");
-    this->set                           = find_alternator("SET");
-    this->cset                          = find_alternator("CSET");
-    this->add_thing_to_thing            = find_alternator("ADD_THING_TO_THING");
-    this->sub_thing_from_thing          = find_alternator("SUB_THING_FROM_THING");
-    this->mult_thing_by_thing           = find_alternator("MULT_THING_BY_THING");
-    this->div_thing_by_thing            = find_alternator("DIV_THING_BY_THING");
-    this->add_thing_to_thing_timed      = find_alternator("ADD_THING_TO_THING_TIMED");
-    this->sub_thing_from_thing_timed    = find_alternator("SUB_THING_FROM_THING_TIMED");
-    this->is_thing_equal_to_thing       = find_alternator("IS_THING_EQUAL_TO_THING");
-    this->is_thing_greater_than_thing   = find_alternator("IS_THING_GREATER_THAN_THING");
-    this->is_thing_greater_or_equal_to_thing = find_alternator("IS_THING_GREATER_OR_EQUAL_TO_THING");
-    this->register_streamed_script_internal = find_command("REGISTER_STREAMED_SCRIPT_INTERNAL");
-    this->require                       = find_command("REQUIRE");
+#define GTA3SC_X(enumerator, member, name) this->member = find_command(name);
+    GTA3SC_SPECIAL_COMMANDS(GTA3SC_X)
+#undef GTA3SC_X
+
+#define GTA3SC_X(member, name) this->member = find_alternator(name);
+    GTA3SC_SPECIAL_ALTERNATORS(GTA3SC_X)
+#undef GTA3SC_X
+}
+
+SpecialCommand find_special_command(const string_view& name)
+{
+    static const insensitive_map<std::string, SpecialCommand> special_commands = {
+#define GTA3SC_X(enumerator, member, name) { name, SpecialCommand::enumerator },
+        GTA3SC_SPECIAL_COMMANDS(GTA3SC_X)
+#undef GTA3SC_X
+    };
+
+    auto it = special_commands.find(name);
+    if(it != special_commands.end())
+        return it->second;
+    return SpecialCommand::None;
 }
 
 optional<std::string> Commands::find_entity_name(EntityType type) const
@@ -87,19 +83,80 @@ optional<std::string> Commands::find_entity_name(EntityType type) const
             return pair.first;
     }
 
+    if(this->base)
+        return this->base->find_entity_name(type);
+
     return nullopt;
 }
 
-void Commands::add_default_models(const insensitive_map<std::string, uint32_t>& default_models)
+optional<EntityType> Commands::find_entity(const string_view& name) const
 {
-    for(auto& model_pair : default_models)
+    auto it = this->entities.find(name);
+    if(it != this->entities.end())
+        return it->second;
+    if(this->base)
+        return this->base->find_entity(name);
+    return nullopt;
+}
+
+shared_ptr<Enum> Commands::find_enum(const string_view& name) const
+{
+    if(this->base)
+    {
+        if(auto e = this->base->find_enum(name))
+            return e;
+    }
+
+    auto it = this->enums.find(name);
+    if(it != this->enums.end())
+        return it->second;
+    return nullptr;
+}
+
+optional<int32_t> Commands::find_constant_in(const Enum& e, const string_view& value) const
+{
+    if(this->base)
     {
-        this->enum_defaultmodels->values.emplace(model_pair);
+        if(auto opt = this->base->find_constant_in(e, value))
+            return opt;
     }
+    else
+    {
+        if(auto opt = e.find(value))
+            return opt;
+    }
+
+    auto it = this->extended_enums.find(&e);
+    if(it != this->extended_enums.end())
+        return it->second->find(value);
+
+    return nullopt;
+}
+
+insensitive_map<std::string, int32_t> Commands::get_default_models() const
+{
+    insensitive_map<std::string, int32_t> models;
+
+    if(this->base)
+        models = this->base->get_default_models();
+    else
+        models = this->enum_defaultmodels->values;
+
+    auto it = this->extended_enums.find(this->enum_defaultmodels.get());
+    if(it != this->extended_enums.end())
+        models.insert(it->second->values.begin(), it->second->values.end());
+
+    return models;
 }
 
 optional<int32_t> Commands::find_constant(const string_view& value, bool context_free_only) const
 {
+    if(this->base)
+    {
+        if(auto opt = this->base->find_constant(value, context_free_only))
+            return opt;
+    }
+
     for(auto& enum_pair : enums)
     {
         if(enum_pair.second->is_global == context_free_only)
@@ -108,22 +165,52 @@ optional<int32_t> Commands::find_constant(const string_view& value, bool context
                 return opt;
         }
     }
+
+    for(auto& enum_pair : extended_enums)
+    {
+        if(enum_pair.first->is_global == context_free_only)
+        {
+            if(auto opt = enum_pair.second->find(value))
+                return opt;
+        }
+    }
+
     return nullopt;
 }
 
 optional<int32_t> Commands::find_constant_all(const string_view& value) const
 {
     // See https://github.com/thelink2012/gta3sc/issues/60
-    if(auto opt = enum_defaultmodels->find(value))
+    if(auto opt = this->find_constant_in(*enum_defaultmodels, value))
         return opt;
 
+    return this->find_constant_all_but_defaultmodel(value);
+}
+
+optional<int32_t> Commands::find_constant_all_but_defaultmodel(const string_view& value) const
+{
+    if(this->base)
+    {
+        if(auto opt = this->base->find_constant_all_but_defaultmodel(value))
+            return opt;
+    }
+
     for(auto& enum_pair : enums)
     {
-        if(&enum_pair.second == &enum_defaultmodels)
+        if(enum_pair.second == enum_defaultmodels)
+            continue;
+        if(auto opt = enum_pair.second->find(value))
+            return opt;
+    }
+
+    for(auto& enum_pair : extended_enums)
+    {
+        if(enum_pair.first == enum_defaultmodels.get())
             continue;
         if(auto opt = enum_pair.second->find(value))
             return opt;
     }
+
     return nullopt;
 }
 
@@ -136,15 +223,19 @@ optional<int32_t> Commands::find_constant_for_arg(const string_view& value, cons
     }
     else
     {
-        if(auto opt_const = arg.find_constant(value)) // constants stricly related to this Arg
-            return opt_const;
+        // constants stricly related to this Arg
+        for(auto& e : arg.enums)
+        {
+            if(auto opt_const = this->find_constant_in(*e, value))
+                return opt_const;
+        }
     }
 
     // If the enum that the argument accepts is MODEL, and the above didn't find a match,
     // also try on the DEFAULTMODEL enum.
     if(arg.uses_enum(this->enum_models))
     {
-        if(auto opt_const = enum_defaultmodels->find(value))
+        if(auto opt_const = this->find_constant_in(*enum_defaultmodels, value))
             return opt_const;
     }
 
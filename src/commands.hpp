@@ -37,6 +37,98 @@ struct Enum
     }
 };
 
+/// The commands handled specially by the compiler, as `X(Enumerator, member, "NAME")`.
+///
+/// Each of them gets a enumerator in `SpecialCommand`, which tags the `Command` of such name when loaded, and a
+/// `Commands::member` with the command of such name.
+#define GTA3SC_SPECIAL_COMMANDS(X) \
+    X(SetProgressTotal,               set_progress_total,                "SET_PROGRESS_TOTAL") \
+    X(SetTotalNumberOfMissions,       set_total_number_of_missions,      "SET_TOTAL_NUMBER_OF_MISSIONS") \
+    X(SetCollectable1Total,           set_collectable1_total,            "SET_COLLECTABLE1_TOTAL") \
+    X(RegisterMissionPassed,          register_mission_passed,           "REGISTER_MISSION_PASSED") \
+    X(RegisterOddjobMissionPassed,    register_oddjob_mission_passed,    "REGISTER_ODDJOB_MISSION_PASSED") \
+    X(CreateCollectable1,             create_collectable1,               "CREATE_COLLECTABLE1") \
+    X(PlayerMadeProgress,             player_made_progress,              "PLAYER_MADE_PROGRESS") \
+    X(SetMissionRespectTotal,         set_mission_respect_total,         "SET_MISSION_RESPECT_TOTAL") \
+    X(AwardPlayerMissionRespect,      award_player_mission_respect,      "AWARD_PLAYER_MISSION_RESPECT") \
+    X(Repeat,                         repeat,                            "REPEAT") \
+    X(Switch,                         switch_,                           "SWITCH") \
+    X(Case,                           case_,                             "CASE") \
+    X(SwitchStart,                    switch_start,                      "SWITCH_START") \
+    X(SwitchContinued,                switch_continued,                  "SWITCH_CONTINUED") \
+    X(GosubFile,                      gosub_file,                        "GOSUB_FILE") \
+    X(Return,                         return_,                           "RETURN") \
+    X(LaunchMission,                  launch_mission,                    "LAUNCH_MISSION") \
+    X(LoadAndLaunchMissionInternal,   load_and_launch_mission_internal,  "LOAD_AND_LAUNCH_MISSION_INTERNAL") \
+    X(StartNewScript,                 start_new_script,                  "START_NEW_SCRIPT") \
+    X(StartNewStreamedScript,         start_new_streamed_script,         "START_NEW_STREAMED_SCRIPT") \
+    X(TerminateThisScript,            terminate_this_script,             "TERMINATE_THIS_SCRIPT") \
+    X(ScriptName,                     script_name,                       "SCRIPT_NAME") \
+    X(CleoCall,                       cleo_call,                         "CLEO_CALL") \
+    X(CleoReturn,                     cleo_return,                       "CLEO_RETURN") \
+    X(TerminateThisCustomScript,      terminate_this_custom_script,      "TERMINATE_THIS_CUSTOM_SCRIPT") \
+    X(Goto,                           goto_,                             "GOTO") \
+    X(GotoIfFalse,                    goto_if_false,                     "GOTO_IF_FALSE") \
+    X(Andor,                          andor,                             "ANDOR") \
+    X(RegisterStreamedScriptInternal, register_streamed_script_internal, "REGISTER_STREAMED_SCRIPT_INTERNAL") \
+    X(SaveStringToDebugFile,          save_string_to_debug_file,         "SAVE_STRING_TO_DEBUG_FILE") \
+    X(SkipCutsceneStart,              skip_cutscene_start,               "SKIP_CUTSCENE_START") \
+    X(SkipCutsceneEnd,                skip_cutscene_end,                 "SKIP_CUTSCENE_END") \
+    X(SkipCutsceneStartInternal,      skip_cutscene_start_internal,      "SKIP_CUTSCENE_START_INTERNAL") \
+    X(Require,                        require,                           "REQUIRE")
+
+/// The alternators handled specially by the compiler, as `X(member, "NAME")`.
+///
+/// Each of them gets a `Commands::member` with the alternator of such name.
+#define GTA3SC_SPECIAL_ALTERNATORS(X) \
+    X(set,                                "SET") \
+    X(cset,                               "CSET") \
+    X(add_thing_to_thing,                 "ADD_THING_TO_THING") \
+    X(sub_thing_from_thing,               "SUB_THING_FROM_THING") \
+    X(mult_thing_by_thing,                "MULT_THING_BY_THING") \
+    X(div_thing_by_thing,                 "DIV_THING_BY_THING") \
+    X(add_thing_to_thing_timed,           "ADD_THING_TO_THING_TIMED") \
+    X(sub_thing_from_thing_timed,         "SUB_THING_FROM_THING_TIMED") \
+    X(is_thing_equal_to_thing,            "IS_THING_EQUAL_TO_THING") \
+    X(is_thing_greater_than_thing,        "IS_THING_GREATER_THAN_THING") \
+    X(is_thing_greater_or_equal_to_thing, "IS_THING_GREATER_OR_EQUAL_TO_THING")
+
+/// Identifies the commands handled specially by the compiler (see `GTA3SC_SPECIAL_COMMANDS`).
+enum class SpecialCommand : uint8_t
+{
+    None,
+#define GTA3SC_X(enumerator, member, name) enumerator,
+    GTA3SC_SPECIAL_COMMANDS(GTA3SC_X)
+#undef GTA3SC_X
+};
+
+/// Finds the `SpecialCommand` of the command named `name`, or `SpecialCommand::None` if not special.
+SpecialCommand find_special_command(const string_view& name);
+
+/// How a command changes the flow of execution, as given by the `Flow` attribute of its `<Command>` node.
+///
+/// A command may have many of these, so `Command::flow` is a bitmask of them.
+enum class ControlFlow : uint8_t
+{
+    None              = 0,
+    Terminator        = 1 << 0,   //< Ends the execution of the script (e.g. `TERMINATE_THIS_SCRIPT`).
+    Branch            = 1 << 1,   //< Always jumps into its label argument (e.g. `GOTO`).
+    ConditionalBranch = 1 << 2,   //< May jump into its label argument, otherwise continues (e.g. `GOTO_IF_FALSE`).
+    Call              = 1 << 3,   //< Calls the subroutine at its label argument, then continues (e.g. `GOSUB`).
+    Return            = 1 << 4,   //< Returns from a subroutine (e.g. `RETURN`).
+    Yield             = 1 << 5,   //< Gives way to the other scripts, then continues (e.g. `WAIT`).
+};
+
+inline constexpr ControlFlow operator|(ControlFlow a, ControlFlow b)
+{
+    return ControlFlow(uint8_t(a) | uint8_t(b));
+}
+
+inline constexpr ControlFlow operator&(ControlFlow a, ControlFlow b)
+{
+    return ControlFlow(uint8_t(a) & uint8_t(b));
+}
+
 /// Stores command information.
 struct Command
 {
@@ -52,6 +144,8 @@ struct Command
         bool allow_text_label : 1;  //< Allow text labels (and its variables) [valid for PARAM arguments only].
         bool allow_pointer : 1;     //< Allow INT values in STRING arguments.
         bool preserve_case : 1;     //< Preserves the case of a string literal.
+        bool acquires : 1;          //< Whether this argument outputs a new entity handle, which must be released.
+        bool releases : 1;          //< Whether this argument gives back the entity handle in it.
         EntityType entity_type;     ///< Entity type of this argument. Zero means none.
         std::vector<shared_ptr<Enum>> enums;
         
@@ -61,7 +155,7 @@ struct Command
         explicit Arg(ArgType type) :
             type(type), optional(false),
             is_output(false), allow_constant(true), allow_global_var(true), allow_local_var(true),
-            preserve_case(false), allow_pointer(false), allow_text_label(false)
+            preserve_case(false), allow_pointer(false), allow_text_label(false), acquires(false), releases(false)
         {
         }
 
@@ -91,6 +185,20 @@ struct Command
     optional<uint32_t>      hash;       //< The command hash.
     small_vector<Arg, 12>   args;       //< The arguments of the command.
     const std::string       name;       //< The name of this command.
+    SpecialCommand          special;    //< How the compiler handles this command specially, if at all.
+    ControlFlow             flow;       //< How this command changes the flow of execution.
+
+    /// Checks whether this command has any of the specified control flow flags.
+    bool has_flow(ControlFlow flags) const
+    {
+        return (this->flow & flags) != ControlFlow::None;
+    }
+
+    /// Checks whether the execution may continue into the next command after this one.
+    bool falls_through() const
+    {
+        return !has_flow(ControlFlow::Terminator | ControlFlow::Branch | ControlFlow::Return);
+    }
 
     /// Checks if there's any optional argument on this command.
     bool has_optional() const
@@ -142,6 +250,13 @@ struct Command
 
 
 /// Stores the list of commands and alternators.
+///
+/// The database is layered. The base layer is built from the game config and shared by all sessions using it. Each
+/// session may put a overlay on top of it (see `Commands::overlay`), with its extra definitions and default models.
+///
+/// A layer is never modified after constructed, thus it can be used by many threads at once. Commands and alternators
+/// are looked up on the overlay first and then on the base. Constants are looked up on the base first, since a
+/// constant cannot be redefined.
 class Commands
 {
 public:
@@ -204,24 +319,52 @@ public:
                       transparent_map<std::string, EntityType>&& entities,
                       transparent_map<std::string, shared_ptr<Enum>>&& enums);
 
+    /// Constructs a overlay on top of `base`.
+    ///
+    /// The `extended_enums` are the constants this layer adds into the enums of the layers below.
+    explicit Commands(shared_ptr<const Commands> base,
+                      transparent_set<Command>&& commands,
+                      insensitive_map<std::string, std::vector<const Command*>>&& alternators,
+                      transparent_map<std::string, EntityType>&& entities,
+                      transparent_map<std::string, shared_ptr<Enum>>&& enums,
+                      std::map<const Enum*, shared_ptr<Enum>>&& extended_enums);
+
     Commands(const Commands&) = delete;
     Commands(Commands&&) = default;
 
+    /// Builds the base layer from the XML files.
+    ///
+    /// \throws ConfigError on failure.
     static Commands from_xml(const std::string& config_name, const std::vector<fs::path>& xml_list);
     // TODO ^ make the paths of xml_list absolute? i.e. move modifies to outside?
 
-    /// Adds the default models associated with the program context into the DEFAULTMODEL enum.
-    void add_default_models(const insensitive_map<std::string, uint32_t>&);
+    /// Builds a overlay on top of `base` from the XML files and the default models (from `default.dat`).
+    ///
+    /// The overlay only stores what it adds, thus it's cheap to build one for each session.
+    ///
+    /// \throws ConfigError on failure.
+    static Commands overlay(shared_ptr<const Commands> base,
+                            const std::string& config_name, const std::vector<fs::path>& xml_list,
+                            const insensitive_map<std::string, uint32_t>& default_models);
 
     /// Gets the MODEL enumeration.
     const shared_ptr<Enum>& get_models_enum() const { return this->enum_models; }
 
-    /// Gets the DEFAULTMODEL enumeration.
-    const shared_ptr<Enum>& get_defaultmodel_enum() const { return this->enum_defaultmodels; }
-
     /// Gets the SCRIPTSTREAM enumeration.
     const shared_ptr<Enum>& get_scriptstream_enum() const { return this->enum_scriptstream; }
 
+    /// Gets the constants of the DEFAULTMODEL enumeration, from all the layers.
+    insensitive_map<std::string, int32_t> get_default_models() const;
+
+    /// Finds the enumeration named `name`.
+    ///
+    /// Constants added by overlays into this enumeration are not in the returned object, see `find_constant_in`.
+    shared_ptr<Enum> find_enum(const string_view& name) const;
+
+    /// Finds the integer value of the string constant `value` in the enumeration `e`, including the constants
+    /// added by overlays into it.
+    optional<int32_t> find_constant_in(const Enum& e, const string_view& value) const;
+
     // Argument matching methods.
     expected<const Command*, MatchFailure> match(const SyntaxTree& cmdnode, const SymTable&, const shared_ptr<Scope>&, const Options&) const;
     expected<const Command*, MatchFailure> match(const Command&, const SyntaxTree& cmdnode, const SymTable&, const shared_ptr<Scope>&, const Options&) const;
@@ -252,12 +395,23 @@ public:
     /// Finds the name of the entity assigned to the id `type`.
     optional<std::string> find_entity_name(EntityType type) const;
 
+    /// Finds the id of the entity named `name`.
+    optional<EntityType> find_entity(const string_view& name) const;
+
+    /// Gets the number of entities in all the layers.
+    size_t num_entities() const
+    {
+        return this->entities.size() + (this->base? this->base->num_entities() : 0);
+    }
+
     /// Find a command based on its name.
     optional<const Command&> find_command(string_view name) const
     {
         auto it = this->commands.find(name);
         if(it != this->commands.end())
             return *it;
+        if(this->base)
+            return this->base->find_command(name);
         return nullopt;
     }
 
@@ -275,21 +429,19 @@ public:
         auto it = this->alternators.find(name);
         if(it != this->alternators.end())
             return it->second;
+        if(this->base)
+            return this->base->find_alternator(name);
         return nullopt;
     }
 
     /// Find a command based on its id.
+    ///
+    /// Language extensions are only returned if there's no other command with such id.
     optional<const Command&> find_command(uint16_t id) const
     {
-        auto range = this->commands_by_id.equal_range(id);
-        for(auto it = range.first; it != range.second; ++it)
-        {
-            if(!it->second->extension)
-                return *it->second;
-        }
-        if(range.first != range.second)
-            return *range.first->second;
-        return nullopt;
+        if(auto opt_command = this->find_command_by_id(id, false))
+            return opt_command;
+        return this->find_command_by_id(id, true);
     }
 
     //
@@ -321,60 +473,51 @@ public:
     }
 
 private:
+    static Commands from_xml(shared_ptr<const Commands> base,
+                             const std::string& config_name, const std::vector<fs::path>& xml_list,
+                             const insensitive_map<std::string, uint32_t>& default_models);
+
+    optional<int32_t> find_constant_all_but_defaultmodel(const string_view& value) const;
+
+    optional<const Command&> find_command_by_id(uint16_t id, bool extension) const
+    {
+        auto range = this->commands_by_id.equal_range(id);
+        for(auto it = range.first; it != range.second; ++it)
+        {
+            if(it->second->extension == extension)
+                return *it->second;
+        }
+        if(this->base)
+        {
+            // Unless the command found below has been redefined on this layer.
+            auto opt_command = this->base->find_command_by_id(id, extension);
+            if(opt_command && this->commands.find(opt_command->name) == this->commands.end())
+                return opt_command;
+        }
+        return nullopt;
+    }
+
+private:
+    shared_ptr<const Commands> base; //< The layer below this one, or null on the base layer.
+
     transparent_set<Command> commands;
     insensitive_map<std::string, std::vector<const Command*>> alternators;
     std::multimap<uint16_t, const Command*> commands_by_id;
     transparent_map<std::string, shared_ptr<Enum>> enums;
     transparent_map<std::string, EntityType> entities;
+    std::map<const Enum*, shared_ptr<Enum>> extended_enums;
 
+    // These are the enums of the base layer.
     shared_ptr<Enum> enum_models;
     shared_ptr<Enum> enum_defaultmodels;
     shared_ptr<Enum> enum_scriptstream;
 
 public:
-    optional<const Command&> set_progress_total;
-    optional<const Command&> set_total_number_of_missions;
-    optional<const Command&> set_collectable1_total;
-    optional<const Command&> register_mission_passed;
-    optional<const Command&> register_oddjob_mission_passed;
-    optional<const Command&> create_collectable1;
-    optional<const Command&> player_made_progress;
-    optional<const Command&> set_mission_respect_total;
-    optional<const Command&> award_player_mission_respect;
-    optional<const Command&> repeat;
-    optional<const Command&> switch_;
-    optional<const Command&> case_;
-    optional<const Command&> switch_start;
-    optional<const Command&> switch_continued;
-    optional<const Command&> gosub_file;
-    optional<const Command&> return_;
-    optional<const Command&> launch_mission;
-    optional<const Command&> load_and_launch_mission_internal;
-    optional<const Command&> start_new_script;
-    optional<const Command&> start_new_streamed_script;
-    optional<const Command&> terminate_this_script;
-    optional<const Command&> script_name;
-    optional<const Command&> cleo_call;
-    optional<const Command&> cleo_return;
-    optional<const Command&> terminate_this_custom_script;
-    optional<const Command&> goto_;
-    optional<const Command&> goto_if_false;
-    optional<const Command&> andor;
-    optional<const Command&> register_streamed_script_internal;
-    optional<const Command&> save_string_to_debug_file;
-    optional<const Command&> skip_cutscene_start;
-    optional<const Command&> skip_cutscene_end;
-    optional<const Command&> skip_cutscene_start_internal;
-    optional<const Command&> require;
-    optional<const Alternator&> set;
-    optional<const Alternator&> cset;
-    optional<const Alternator&> add_thing_to_thing;
-    optional<const Alternator&> sub_thing_from_thing;
-    optional<const Alternator&> mult_thing_by_thing;
-    optional<const Alternator&> div_thing_by_thing;
-    optional<const Alternator&> add_thing_to_thing_timed;
-    optional<const Alternator&> sub_thing_from_thing_timed;
-    optional<const Alternator&> is_thing_equal_to_thing;
-    optional<const Alternator&> is_thing_greater_than_thing;
-    optional<const Alternator&> is_thing_greater_or_equal_to_thing;
+#define GTA3SC_X(enumerator, member, name) optional<const Command&> member;
+    GTA3SC_SPECIAL_COMMANDS(GTA3SC_X)
+#undef GTA3SC_X
+
+#define GTA3SC_X(member, name) optional<const Alternator&> member;
+    GTA3SC_SPECIAL_ALTERNATORS(GTA3SC_X)
+#undef GTA3SC_X
 };
@@ -59,7 +59,7 @@ void CompilerContext::compile_command(const Command& command, ArgList args, bool
         args.emplace_back(EOAL{});
     }
 
-    this->compiled.emplace_back(CompiledCommand{ not_flag, command, std::move(args) });
+    this->compiled.emplace_back(CompiledCommand{ not_flag, command, std::move(args), this->current_statement });
 }
 
 void CompilerContext::compile_command(const SyntaxTree& command_node, bool not_flag)
@@ -72,7 +72,7 @@ void CompilerContext::compile_command(const SyntaxTree& command_node, bool not_f
     {
         const Command& command = opt_annot->command;
 
-        if(commands.equal(command, commands.skip_cutscene_start_internal))
+        if(command.special == SpecialCommand::SkipCutsceneStartInternal)
         {
             this->label_skip_cutscene_end = any_cast<shared_ptr<Label>>(opt_annot->params[0]);
         }
@@ -83,7 +83,7 @@ void CompilerContext::compile_command(const SyntaxTree& command_node, bool not_f
     {
         const Command& command = command_node.annotation<std::reference_wrapper<const Command>>();
 
-        if(commands.equal(command, commands.skip_cutscene_end) && this->label_skip_cutscene_end)
+        if(command.special == SpecialCommand::SkipCutsceneEnd && this->label_skip_cutscene_end)
         {
             compile_label(this->label_skip_cutscene_end);
             this->label_skip_cutscene_end = nullptr;
@@ -107,6 +107,12 @@ void CompilerContext::compile_statements(const SyntaxTree& parent, size_t from_i
 
 void CompilerContext::compile_statement(const SyntaxTree& node, bool not_flag)
 {
+    auto guard = make_scope_guard([&, old_statement = this->current_statement] {
+        this->current_statement = old_statement;
+    });
+
+    this->current_statement = &node;
+
     switch(node.type())
     {
         case NodeType::Block:
@@ -117,6 +123,7 @@ void CompilerContext::compile_statement(const SyntaxTree& node, bool not_flag)
             compile_statement(node.child(0), !not_flag);
             break;
         case NodeType::Command:
+            program.check_budget(node);
             compile_command(node, not_flag);
             break;
         case NodeType::MISSION_START:
@@ -419,7 +426,7 @@ void CompilerContext::compile_switch_withop(const SyntaxTree& swnode, std::vecto
     for(auto it = cases.begin(); it != cases.end(); ++it)
     {
         compile_label(it->target);
-        if(std::next(it) == cases.end() || !std::next(it)->same_body_as(*it))
+        if(!it->is_empty() && (std::next(it) == cases.end() || !std::next(it)->same_body_as(*it)))
         {
             compile_statements(swnode.child(1), it->first_statement_id, it->last_statement_id);
         }
@@ -470,7 +477,10 @@ void CompilerContext::compile_switch_ifchain(const SyntaxTree& swnode, std::vect
 
         compile_label(body_ptr);
         std::for_each(it, next_it, [&](Case& c) { c.target = body_ptr; });
-        compile_statements(swnode.child(1), it->first_statement_id, it->last_statement_id);
+        if(it->is_empty())
+            compile_command(*commands.goto_, { break_ptr }); // must not fall into the default case
+        else
+            compile_statements(swnode.child(1), it->first_statement_id, it->last_statement_id);
         compile_label(next_ptr);
     }
 
@@ -484,7 +494,8 @@ void CompilerContext::compile_switch_ifchain(const SyntaxTree& swnode, std::vect
         {
             default_case->target = make_internal_label();
             compile_label(default_case->target);
-            compile_statements(swnode.child(1), default_case->first_statement_id, default_case->last_statement_id);
+            if(!default_case->is_empty())
+                compile_statements(swnode.child(1), default_case->first_statement_id, default_case->last_statement_id);
         }
     }
 
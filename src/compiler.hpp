@@ -59,6 +59,7 @@ struct CompiledCommand
     bool                    not_flag;
     const Command&          command;
     std::vector<ArgVariant> args;
+    const SyntaxTree*       where = nullptr;    //< The statement this command was compiled from (may be null).
 };
 
 /// IR for label **definitions**.
@@ -77,11 +78,11 @@ struct CompiledLabelDef
 /// IR for HEX data.
 struct CompiledHex
 {
-    std::vector<uint8_t> data;
+    shared_ptr<const std::vector<uint8_t>> data; //< Same buffer as in the `DumpAnnotation`.
 
     size_t compiled_size() const
     {
-        return data.size();
+        return data->size();
     }
 };
 
@@ -138,7 +139,7 @@ struct CompiledData
         : data(std::move(x))
     {}
 
-    CompiledData(std::vector<uint8_t> x)
+    CompiledData(shared_ptr<const std::vector<uint8_t>> x)
         : data(CompiledHex { std::move(x) })
     {}
 
@@ -162,6 +163,7 @@ private:
     std::vector<shared_ptr<Label>> internal_labels;
     std::vector<LoopInfo>          loop_stack;
     shared_ptr<Label>              label_skip_cutscene_end;
+    const SyntaxTree*              current_statement = nullptr;
 
     // Inputs
     ProgramContext&                 program;
@@ -290,11 +292,10 @@ private:
             return this->first_statement_id == SIZE_MAX;
         }
 
+        /// Empty cases at the end of the switch (with no body after them) share no body with any case.
         bool same_body_as(const Case& rhs) const
         {
-            Expects(this->first_statement_id != SIZE_MAX);
-            Expects(rhs.first_statement_id != SIZE_MAX);
-            return this->first_statement_id == rhs.first_statement_id;
+            return !this->is_empty() && this->first_statement_id == rhs.first_statement_id;
         }
     };
 
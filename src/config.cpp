@@ -24,26 +24,20 @@ static uint32_t one_at_a_time(const char *key)
 
 static int xml_stoi(const char* string)
 {
-    try
-    {
-        return std::stoi(string, nullptr, 0);
-    }
-    catch(const std::exception& e)
-    {
-        throw ConfigError("couldn't convert string to int: {}", e.what());
-    }
+    int value;
+    auto result = from_chars_prefixed(string, string + strlen(string), value);
+    if(result.ec != std::errc())
+        throw ConfigError("couldn't convert string '{}' to int", string);
+    return value;
 }
 
 static unsigned int xml_stou(const char* string)
 {
-    try
-    {
-        return (unsigned int)(std::stoul(string, nullptr, 0));
-    }
-    catch(const std::exception& e)
-    {
-        throw ConfigError("couldn't convert string to unsigned int: {}", e.what());
-    }
+    unsigned int value;
+    auto result = from_chars_prefixed(string, string + strlen(string), value);
+    if(result.ec != std::errc())
+        throw ConfigError("couldn't convert string '{}' to unsigned int", string);
+    return value;
 }
 
 static bool xml_to_bool(const char* string)
@@ -61,6 +55,46 @@ static bool xml_to_bool(const rapidxml::xml_attribute<>* attrib, bool default_va
     return attrib? xml_to_bool(attrib->value()) : default_value;
 }
 
+/// Parses a whitespace separated list of control flow flags (e.g. `Flow="Call ConditionalBranch"`).
+static ControlFlow xml_to_control_flow(const rapidxml::xml_attribute<>* attrib)
+{
+    ControlFlow flow = ControlFlow::None;
+
+    if(attrib)
+    {
+        const char* it = attrib->value();
+        const char* end = it + attrib->value_size();
+        auto is_space = [](char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r'; };
+        while(it != end)
+        {
+            it = std::find_if_not(it, end, is_space);
+            auto word_end = std::find_if(it, end, is_space);
+            string_view word(it, word_end - it);
+
+            if(word.empty())
+                break;
+            else if(word == "Terminator")
+                flow = flow | ControlFlow::Terminator;
+            else if(word == "Branch")
+                flow = flow | ControlFlow::Branch;
+            else if(word == "ConditionalBranch")
+                flow = flow | ControlFlow::ConditionalBranch;
+            else if(word == "Call")
+                flow = flow | ControlFlow::Call;
+            else if(word == "Return")
+                flow = flow | ControlFlow::Return;
+            else if(word == "Yield")
+                flow = flow | ControlFlow::Yield;
+            else
+                throw ConfigError("unexpected 'Flow' attribute: {}", word.to_string());
+
+            it = word_end;
+        }
+    }
+
+    return flow;
+}
+
 static ArgType xml_to_argtype(const char* string)
 {
     if(!strcmp(string, "INT"))
@@ -85,7 +119,9 @@ static ArgType xml_to_argtype(const char* string)
         throw ConfigError("unexpected 'Type' attribute: {}", string);
 }
 
-static void parse_enum_node(transparent_map<std::string, shared_ptr<Enum>>& enums, const rapidxml::xml_node<>* enum_node)
+/// \param get_enum returns the `Enum&` which the constants of a enum (given its name and globalness) are stored into.
+template<typename GetEnum>
+static void parse_enum_node(const rapidxml::xml_node<>* enum_node, GetEnum get_enum)
 {
     using namespace rapidxml;
 
@@ -96,18 +132,8 @@ static void parse_enum_node(transparent_map<std::string, shared_ptr<Enum>>& enum
         throw ConfigError("missing 'Name' attribute on '<Enum>' node");
 
     bool is_global = xml_to_bool(enum_global_attrib, false);
-    auto eit = enums.find(enum_name_attrib->value());
-    if(eit == enums.end())
-    {
-        auto enum_ptr = std::make_shared<Enum>(Enum { {}, is_global });
-        eit = enums.emplace(enum_name_attrib->value(), std::move(enum_ptr)).first;
-    }
-    else
-    {
-        assert(is_global == eit->second->is_global);
-    }
 
-    insensitive_map<std::string, int32_t>& constant_map = eit->second->values;
+    insensitive_map<std::string, int32_t>& constant_map = get_enum(enum_name_attrib->value(), is_global).values;
     int32_t current_value = 0;
 
     for(auto value_node = enum_node->first_node(); value_node; value_node = value_node->next_sibling())
@@ -129,11 +155,14 @@ static void parse_enum_node(transparent_map<std::string, shared_ptr<Enum>>& enum
     }
 }
 
+/// \param get_entity returns the `EntityType` of a entity name, assigning a new one if needed.
+/// \param find_enum returns the `shared_ptr<Enum>` of a enum name, or null if there's no such enum.
+template<typename GetEntity, typename FindEnum>
 static Command
   parse_command_node(
       const rapidxml::xml_node<>* cmd_node,
-      transparent_map<std::string, EntityType>& entities,
-      const transparent_map<std::string, shared_ptr<Enum>>& enums)
+      GetEntity get_entity,
+      FindEnum find_enum)
 {
     using namespace rapidxml;
 
@@ -143,6 +172,7 @@ static Command
     xml_attribute<>* support_attrib = cmd_node->first_attribute("Supported");
     xml_attribute<>* internal_attrib = cmd_node->first_attribute("Internal");
     xml_attribute<>* extension_attrib = cmd_node->first_attribute("Extension");
+    xml_attribute<>* flow_attrib = cmd_node->first_attribute("Flow");
     xml_node<>*      args_node   = cmd_node->first_node("Args");
 
     if(!name_attrib || !(id_attrib || hash_attrib))
@@ -173,6 +203,8 @@ static Command
             auto allow_pointer_attrib= arg_node->first_attribute("AllowPointer");
             auto preserve_case_attrib= arg_node->first_attribute("PreserveCase");
             auto entity_attrib       = arg_node->first_attribute("Entity");
+            auto acquire_attrib      = arg_node->first_attribute("Acquire");
+            auto release_attrib      = arg_node->first_attribute("Release");
             auto enum_attrib         = arg_node->first_attribute("Enum");
 
             if(!type_attrib)
@@ -190,22 +222,22 @@ static Command
             arg.allow_text_label = xml_to_bool(allow_text_label_attrib, false);
             arg.allow_pointer = xml_to_bool(allow_pointer_attrib, false);
             arg.preserve_case = xml_to_bool(preserve_case_attrib, false);
+            arg.acquires = xml_to_bool(acquire_attrib, false);
+            arg.releases = xml_to_bool(release_attrib, false);
             arg.entity_type = 0;
 
             if(enum_attrib)
             {
-                auto eit = enums.find(enum_attrib->value());
-                if(eit != enums.end())
+                if(auto enum_ptr = find_enum(enum_attrib->value()))
                 {
-                    arg.enums.emplace_back(eit->second);
+                    arg.enums.emplace_back(std::move(enum_ptr));
                     arg.enums.shrink_to_fit();
                 }
             }
 
             if(entity_attrib)
             {
-                auto it = entities.emplace(entity_attrib->value(), EntityType(1 + entities.size())).first;
-                arg.entity_type = it->second;
+                arg.entity_type = get_entity(entity_attrib->value());
             }
 
             args.emplace_back(std::move(arg));
@@ -235,14 +267,19 @@ static Command
         std::move(hash),                                 // hash
         std::move(args),                                 // args
         name.to_string(),                                // name
+        find_special_command(name),                      // special
+        xml_to_control_flow(flow_attrib),                // flow
     };
 }
 
+/// \param get_alternator returns the `std::vector<const Command*>&` of the alternatives of a alternator name.
+/// \param find_command returns the `optional<const Command&>` of a command name.
+template<typename GetAlternator, typename FindCommand>
 static void
   parse_alternator_node(
-      insensitive_map<std::string, std::vector<const Command*>>& alternators,
       const rapidxml::xml_node<>* alt_node,
-      const transparent_set<Command>& commands)
+      GetAlternator get_alternator,
+      FindCommand find_command)
 {
     using namespace rapidxml;
 
@@ -251,11 +288,7 @@ static void
     if(!name_attrib)
         throw ConfigError("missing 'Name' attribute on '<Alternator>' node");
 
-    auto eit = alternators.find(name_attrib->value());
-    if(eit == alternators.end())
-    {
-        eit = alternators.emplace(name_attrib->value(), std::vector<const Command*>{}).first;
-    }
+    std::vector<const Command*>& alternatives = get_alternator(name_attrib->value());
 
     for(auto node = alt_node->first_node(); node; node = node->next_sibling())
     {
@@ -264,13 +297,27 @@ static void
         if(!attrib)
             throw ConfigError("missing 'Name' attribute on '<Alternative>' node");
 
-        auto it = commands.find(attrib->value());
-        if(it != commands.end())
-            eit->second.emplace_back(std::addressof(*it));
+        if(auto opt_command = find_command(attrib->value()))
+            alternatives.emplace_back(std::addressof(*opt_command));
     }
 }
 
 Commands Commands::from_xml(const std::string& config_name, const std::vector<fs::path>& xml_list)
+{
+    return Commands::from_xml(nullptr, config_name, xml_list, {});
+}
+
+Commands Commands::overlay(shared_ptr<const Commands> base,
+                           const std::string& config_name, const std::vector<fs::path>& xml_list,
+                           const insensitive_map<std::string, uint32_t>& default_models)
+{
+    Expects(base != nullptr);
+    return Commands::from_xml(std::move(base), config_name, xml_list, default_models);
+}
+
+Commands Commands::from_xml(shared_ptr<const Commands> base,
+                            const std::string& config_name, const std::vector<fs::path>& xml_list,
+                            const insensitive_map<std::string, uint32_t>& default_models)
 {
     using namespace rapidxml;
 
@@ -292,11 +339,82 @@ Commands Commands::from_xml(const std::string& config_name, const std::vector<fs
     insensitive_map<std::string, std::vector<const Command*>>   alternators;
     transparent_map<std::string, EntityType>                    entities;
     transparent_map<std::string, shared_ptr<Enum>>              enums;
+    std::map<const Enum*, shared_ptr<Enum>>                     extended_enums;
 
     // fundamental enums
-    enums.emplace("MODEL", std::make_shared<Enum>(Enum { {}, false, }));
-    enums.emplace("DEFAULTMODEL", std::make_shared<Enum>(Enum { {}, false, }));
-    enums.emplace("SCRIPTSTREAM", std::make_shared<Enum>(Enum { {}, false, }));
+    if(!base)
+    {
+        enums.emplace("MODEL", std::make_shared<Enum>(Enum { {}, false, }));
+        enums.emplace("DEFAULTMODEL", std::make_shared<Enum>(Enum { {}, false, }));
+        enums.emplace("SCRIPTSTREAM", std::make_shared<Enum>(Enum { {}, false, }));
+    }
+
+    // Enums of the layers below aren't modified, the constants added into them are stored in `extended_enums`.
+    auto get_enum = [&](const char* name, bool is_global) -> Enum&
+    {
+        auto base_enum = base? base->find_enum(name) : nullptr;
+        if(base_enum)
+        {
+            assert(is_global == base_enum->is_global);
+            auto& enum_ptr = extended_enums[base_enum.get()];
+            if(!enum_ptr) enum_ptr = std::make_shared<Enum>(Enum { {}, is_global });
+            return *enum_ptr;
+        }
+
+        auto eit = enums.find(name);
+        if(eit == enums.end())
+        {
+            auto enum_ptr = std::make_shared<Enum>(Enum { {}, is_global });
+            eit = enums.emplace(name, std::move(enum_ptr)).first;
+        }
+        else
+        {
+            assert(is_global == eit->second->is_global);
+        }
+        return *eit->second;
+    };
+
+    auto find_enum = [&](const char* name) -> shared_ptr<Enum>
+    {
+        if(auto base_enum = base? base->find_enum(name) : nullptr)
+            return base_enum;
+        auto eit = enums.find(name);
+        return eit != enums.end()? eit->second : nullptr;
+    };
+
+    auto get_entity = [&](const char* name) -> EntityType
+    {
+        if(auto opt_entity = base? base->find_entity(name) : nullopt)
+            return *opt_entity;
+        auto num_entities = entities.size() + (base? base->num_entities() : 0);
+        return entities.emplace(name, EntityType(1 + num_entities)).first->second;
+    };
+
+    auto get_alternator = [&](const char* name) -> std::vector<const Command*>&
+    {
+        auto eit = alternators.find(name);
+        if(eit == alternators.end())
+        {
+            // Alternators from the layers below are copied, so alternatives can be added to them.
+            auto opt_base_alternator = base? base->find_alternator(name) : nullopt;
+            eit = alternators.emplace(name, opt_base_alternator? *opt_base_alternator : std::vector<const Command*>{}).first;
+        }
+        return eit->second;
+    };
+
+    auto find_command = [&](const char* name) -> optional<const Command&>
+    {
+        auto it = commands.find(name);
+        if(it != commands.end())
+            return *it;
+        return base? base->find_command(name) : nullopt;
+    };
+
+    if(!default_models.empty())
+    {
+        auto& enum_defaultmodels = get_enum("DEFAULTMODEL", false);
+        enum_defaultmodels.values.insert(default_models.begin(), default_models.end());
+    }
 
     auto xml_parse = [](const fs::path& path) -> XmlData
     {
@@ -375,7 +493,7 @@ Commands Commands::from_xml(const std::string& config_name, const std::vector<fs
             {
                 if(!strcmp(cmd_node->name(), "Command"))
                 {
-                    auto command = parse_command_node(cmd_node, entities, enums);
+                    auto command = parse_command_node(cmd_node, get_entity, find_enum);
                     auto insert_pair = commands.insert(std::move(command));
                     if(!insert_pair.second)
                     {
@@ -391,7 +509,7 @@ Commands Commands::from_xml(const std::string& config_name, const std::vector<fs
             {
                 if(!strcmp(const_node->name(), "Enum"))
                 {
-                    parse_enum_node(enums, const_node);
+                    parse_enum_node(const_node, get_enum);
                 }
             }
         }
@@ -401,11 +519,35 @@ Commands Commands::from_xml(const std::string& config_name, const std::vector<fs
             {
                 if(!strcmp(alt_node->name(), "Alternator"))
                 {
-                    parse_alternator_node(alternators, alt_node, commands);
+                    parse_alternator_node(alt_node, get_alternator, find_command);
                 }
             }
         }
     }
 
-    return Commands { std::move(commands), std::move(alternators), std::move(entities), std::move(enums) };
+    if(!base)
+        return Commands { std::move(commands), std::move(alternators), std::move(entities), std::move(enums) };
+
+    // Alternators from the layers below must point to the commands redefined on this layer.
+    auto redefined = [&](const Command* command) { return commands.count(command->name) != 0; };
+    for(auto layer = base.get(); layer; layer = layer->base.get())
+    {
+        for(auto& alternator : layer->alternators)
+        {
+            if(std::any_of(alternator.second.begin(), alternator.second.end(), redefined))
+                get_alternator(alternator.first.c_str());
+        }
+    }
+
+    for(auto& alternator : alternators)
+    {
+        for(auto& command : alternator.second)
+        {
+            if(redefined(command))
+                command = std::addressof(*commands.find(command->name));
+        }
+    }
+
+    return Commands { std::move(base), std::move(commands), std::move(alternators),
+                      std::move(entities), std::move(enums), std::move(extended_enums) };
 }
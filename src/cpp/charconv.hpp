@@ -0,0 +1,264 @@
+/// Elementary String Conversions
+///
+/// http://en.cppreference.com/w/cpp/utility/from_chars
+///
+/// Parses numbers out of character ranges without allocating memory nor throwing exceptions,
+/// as opposed to `std::stoi`, `std::stof` and friends which need a `std::string`.
+///
+#pragma once
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cfloat>
+#include <string>
+#include <limits>
+#include <iterator>
+#include <algorithm>
+#include <system_error>
+#include <type_traits>
+
+struct from_chars_result
+{
+    const char* ptr;    //< One past the last character of the number, or `first` if nothing was matched.
+    std::errc   ec;     //< `std::errc()` on success.
+};
+
+namespace charconv_detail
+{
+    /// Gets the value of the digit `c` in a base up to 36, or 36 if `c` isn't a digit.
+    inline unsigned digit_value(char c)
+    {
+        if(c >= '0' && c <= '9') return unsigned(c - '0');
+        if(c >= 'a' && c <= 'z') return unsigned(c - 'a' + 10);
+        if(c >= 'A' && c <= 'Z') return unsigned(c - 'A' + 10);
+        return 36;
+    }
+
+    /// Parses the digits of a unsigned number in the specified base. All digits are consumed even on overflow.
+    template<typename U>
+    inline from_chars_result parse_unsigned(const char* first, const char* last, U& value, int base)
+    {
+        static_assert(std::is_unsigned<U>::value, "");
+
+        const U max_value = std::numeric_limits<U>::max();
+        bool overflow = false;
+        U result = 0;
+
+        const char* p = first;
+        for(unsigned digit; p != last && (digit = digit_value(*p)) < unsigned(base); ++p)
+        {
+            if(result > (max_value - digit) / U(base))
+                overflow = true;
+            else
+                result = result * U(base) + U(digit);
+        }
+
+        if(p == first)
+            return { first, std::errc::invalid_argument };
+        if(overflow)
+            return { p, std::errc::result_out_of_range };
+
+        value = result;
+        return { p, std::errc() };
+    }
+
+    /// Parses a unsigned magnitude with a optional minus sign into `T`.
+    template<typename T>
+    inline from_chars_result parse_integer(const char* first, const char* last, T& value, int base, bool negative)
+    {
+        using U = std::make_unsigned_t<T>;
+
+        if(negative && !std::is_signed<T>::value)
+            return { first, std::errc::invalid_argument };
+
+        U magnitude;
+        auto result = parse_unsigned(first, last, magnitude, base);
+        if(result.ec != std::errc())
+            return result;
+
+        if(!negative)
+        {
+            if(magnitude > U(std::numeric_limits<T>::max()))
+                return { result.ptr, std::errc::result_out_of_range };
+            value = T(magnitude);
+        }
+        else
+        {
+            // -(max+1) is representable, but cannot be negated in T.
+            if(magnitude > U(std::numeric_limits<T>::max()) + 1u)
+                return { result.ptr, std::errc::result_out_of_range };
+            value = magnitude == 0? T(0) : T(-T(magnitude - 1u) - 1);
+        }
+
+        return result;
+    }
+
+    /// Slow path of float parsing for numbers which cannot be correctly rounded by `from_chars`.
+    /// The range `[first, last)` must be a valid floating point number.
+    inline float strtof_range(const char* first, const char* last)
+    {
+        char buffer[64];
+        size_t length = size_t(last - first);
+        if(length < sizeof(buffer))
+        {
+            std::memcpy(buffer, first, length);
+            buffer[length] = '\0';
+            return std::strtof(buffer, nullptr);
+        }
+        return std::strtof(std::string(first, last).c_str(), nullptr);
+    }
+}
+
+/// Parses a integer in the specified base.
+///
+/// Like `std::from_chars`, no prefixes (e.g. `0x`), whitespaces nor plus signs are accepted, and
+/// minus signs are only accepted for signed types. On error, `value` is not modified.
+template<typename T, typename = std::enable_if_t<std::is_integral<T>::value>>
+inline from_chars_result from_chars(const char* first, const char* last, T& value, int base = 10)
+{
+    bool negative = (first != last && *first == '-');
+    auto result = charconv_detail::parse_integer(first + negative, last, value, base, negative);
+    if(result.ptr == first + negative && result.ec == std::errc::invalid_argument)
+        result.ptr = first;
+    return result;
+}
+
+/// Parses a integer deducing the base from its prefix, as `strtol` does with base 0.
+///
+/// That is, a optional minus sign, followed by `0x` or `0X` for hexadecimal, `0` for octal or otherwise decimal.
+/// On error, `value` is not modified.
+template<typename T, typename = std::enable_if_t<std::is_integral<T>::value>>
+inline from_chars_result from_chars_prefixed(const char* first, const char* last, T& value)
+{
+    const char* p = first;
+    bool negative = (p != last && *p == '-');
+    if(negative) ++p;
+
+    int base = 10;
+    if(p != last && *p == '0')
+    {
+        if(std::next(p) != last && (p[1] == 'x' || p[1] == 'X')
+        && std::next(p, 2) != last && charconv_detail::digit_value(p[2]) < 16)
+        {
+            base = 16;
+            p += 2;
+        }
+        else
+        {
+            base = 8; // the leading zero is a octal digit, so "0" and "0x" parse as zero.
+        }
+    }
+
+    auto result = charconv_detail::parse_integer(p, last, value, base, negative);
+    if(result.ec == std::errc::invalid_argument)
+        result.ptr = first;
+    return result;
+}
+
+/// Parses a floating point number in decimal notation, with a optional exponent.
+///
+/// The result is correctly rounded (i.e. same as `strtof`). On error, `value` is not modified, except when out of
+/// range, in which case it is set to the infinity or denormal `strtof` would give.
+inline from_chars_result from_chars(const char* first, const char* last, float& value)
+{
+    static const double exact_powers_of_ten[] = {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+    };
+
+    const char* p = first;
+    bool negative = (p != last && *p == '-');
+    if(negative) ++p;
+
+    uint64_t mantissa = 0;      // first 19 significant digits
+    int64_t exponent = 0;       // decimal exponent to apply to mantissa
+    size_t num_digits = 0;      // number of digits in mantissa
+    bool truncated = false;     // whether non-zero digits were left out of mantissa
+    bool any_digit = false;
+
+    auto add_digit = [&](unsigned digit, bool is_fraction)
+    {
+        any_digit = true;
+        if(num_digits < 19)
+        {
+            if(mantissa != 0 || digit != 0)
+            {
+                mantissa = mantissa * 10 + digit;
+                ++num_digits;
+            }
+            if(is_fraction) --exponent;
+        }
+        else
+        {
+            truncated |= (digit != 0);
+            if(!is_fraction) ++exponent;
+        }
+    };
+
+    for(; p != last && *p >= '0' && *p <= '9'; ++p)
+        add_digit(unsigned(*p - '0'), false);
+
+    if(p != last && *p == '.')
+    {
+        for(++p; p != last && *p >= '0' && *p <= '9'; ++p)
+            add_digit(unsigned(*p - '0'), true);
+    }
+
+    if(!any_digit)
+        return { first, std::errc::invalid_argument };
+
+    if(p != last && (*p == 'e' || *p == 'E'))
+    {
+        const char* q = std::next(p);
+        bool negative_exp = (q != last && (*q == '-' || *q == '+'))? (*q++ == '-') : false;
+        if(q != last && *q >= '0' && *q <= '9')
+        {
+            int64_t exp = 0;
+            for(; q != last && *q >= '0' && *q <= '9'; ++q)
+                exp = (std::min)(exp * 10 + (*q - '0'), int64_t(100000));
+            exponent += negative_exp? -exp : exp;
+            p = q;
+        }
+    }
+
+    float result;
+    bool exact_path = false;
+
+    if(mantissa == 0)
+    {
+        result = 0.0f;
+        exact_path = true;
+    }
+    else if(!truncated && mantissa <= (uint64_t(1) << 53) && exponent >= -22 && exponent <= 22)
+    {
+        // Both operands are exact doubles, so a single operation gives the correctly rounded double.
+        double d = double(mantissa);
+        d = (exponent < 0)? d / exact_powers_of_ten[-exponent] : d * exact_powers_of_ten[exponent];
+
+        // Rounding to double and then to float is only wrong when the double lies in the middle of two floats.
+        // Numbers past the float range are also left for strtof, to round them to either FLT_MAX or infinity.
+        uint64_t bits;
+        std::memcpy(&bits, &d, sizeof(d));
+        if(d <= FLT_MAX && (bits & 0x1FFFFFFF) != 0x10000000)
+        {
+            result = float(d);
+            exact_path = true;
+        }
+    }
+
+    if(!exact_path)
+        result = charconv_detail::strtof_range(negative? first + 1 : first, p);
+
+    if(negative)
+        result = -result;
+
+    if(result == std::numeric_limits<float>::infinity() || result == -std::numeric_limits<float>::infinity()
+        || (mantissa != 0 && result > -FLT_MIN && result < FLT_MIN))
+    {
+        value = result;
+        return { p, std::errc::result_out_of_range };
+    }
+
+    value = result;
+    return { p, std::errc() };
+}
@@ -44,3 +44,20 @@ struct iequal_to
         return strncasecmp(left.data(), right.data(), left.size()) == 0;
     }
 };
+
+/// std::hash<string_view> but case insensitive (FNV-1a over the ASCII uppercase of the string)
+struct ihash
+{
+    using is_transparent = int;
+
+    size_t operator()(const string_view& value) const
+    {
+        size_t hash = static_cast<size_t>(14695981039346656037ULL);
+        for(auto c : value)
+        {
+            if(c >= 'a' && c <= 'z') c = c - 'a' + 'A';
+            hash = (hash ^ static_cast<unsigned char>(c)) * static_cast<size_t>(1099511628211ULL);
+        }
+        return hash;
+    }
+};
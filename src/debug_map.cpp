@@ -0,0 +1,581 @@
+#include <stdinc.h>
+#include "debug_map.hpp"
+#include "codegen.hpp"
+#include "symtable.hpp"
+
+namespace
+{
+    static const char debug_map_magic[4] = { 'G', 'D', 'B', 'G' };
+
+    class MapWriter
+    {
+    public:
+        std::vector<uint8_t> data;
+
+        void u(uint64_t value)
+        {
+            do
+            {
+                uint8_t byte = value & 0x7F;
+                value >>= 7;
+                this->data.push_back(value? (byte | 0x80) : byte);
+            } while(value);
+        }
+
+        void s(int64_t value)
+        {
+            u((uint64_t(value) << 1) ^ uint64_t(value >> 63));
+        }
+
+        void string(const std::string& value)
+        {
+            u(value.size());
+            this->data.insert(this->data.end(), value.begin(), value.end());
+        }
+
+        void location(const DebugMap::SourceLocation& where, DebugMap::SourceLocation& last)
+        {
+            s(int64_t(where.file) - int64_t(last.file));
+            s(int64_t(where.line) - int64_t(last.line));
+            u(where.column);
+            last = where;
+        }
+    };
+
+    class MapReader
+    {
+    public:
+        explicit MapReader(const uint8_t* data, size_t size) :
+            it(data), end(data + size)
+        {}
+
+        bool eof() const { return this->it == this->end; }
+
+        optional<uint64_t> u()
+        {
+            uint64_t value = 0;
+            for(unsigned shift = 0; shift < 64; shift += 7)
+            {
+                if(this->it == this->end)
+                    return nullopt;
+                uint8_t byte = *this->it++;
+                value |= uint64_t(byte & 0x7F) << shift;
+                if(!(byte & 0x80))
+                    return value;
+            }
+            return nullopt;
+        }
+
+        optional<uint32_t> u32()
+        {
+            auto value = u();
+            if(value && *value <= UINT32_MAX)
+                return uint32_t(*value);
+            return nullopt;
+        }
+
+        optional<int64_t> s()
+        {
+            if(auto value = u())
+                return int64_t(*value >> 1) ^ -int64_t(*value & 1);
+            return nullopt;
+        }
+
+        optional<std::string> string()
+        {
+            auto size = u();
+            if(!size || *size > size_t(this->end - this->it))
+                return nullopt;
+            std::string value(reinterpret_cast<const char*>(this->it), size_t(*size));
+            this->it += *size;
+            return value;
+        }
+
+        /// Reads a count of entries, each taking at least `min_entry_size` bytes.
+        optional<size_t> count(size_t min_entry_size)
+        {
+            auto value = u();
+            if(!value || *value > size_t(this->end - this->it) / min_entry_size)
+                return nullopt;
+            return size_t(*value);
+        }
+
+        optional<uint32_t> offset(uint32_t& last)
+        {
+            auto delta = u();
+            if(!delta || *delta > UINT32_MAX - last)
+                return nullopt;
+            return last += uint32_t(*delta);
+        }
+
+        bool location(DebugMap::SourceLocation& where, DebugMap::SourceLocation& last, size_t num_files)
+        {
+            auto file = s();
+            auto line = s();
+            auto column = u32();
+            if(!file || !line || !column)
+                return false;
+
+            auto new_file = int64_t(last.file) + *file;
+            auto new_line = int64_t(last.line) + *line;
+            if(new_file < 0 || uint64_t(new_file) >= num_files || new_line < 0 || new_line > UINT32_MAX)
+                return false;
+
+            where = last = DebugMap::SourceLocation { uint32_t(new_file), uint32_t(new_line), *column };
+            return true;
+        }
+
+        bool magic()
+        {
+            if(size_t(this->end - this->it) < sizeof(debug_map_magic)
+                || memcmp(this->it, debug_map_magic, sizeof(debug_map_magic)) != 0)
+                return false;
+            this->it += sizeof(debug_map_magic);
+            return true;
+        }
+
+    private:
+        const uint8_t* it;
+        const uint8_t* end;
+    };
+
+    /// Finds the last entry of the sorted `entries` with a key at or before `offset`.
+    template<typename Entry, typename Key>
+    auto find_at_or_before(const std::vector<Entry>& entries, uint32_t offset, Key key) -> optional<const Entry&>
+    {
+        auto it = std::upper_bound(entries.begin(), entries.end(), offset, [&](uint32_t offset, const Entry& entry) {
+            return offset < key(entry);
+        });
+        if(it == entries.begin())
+            return nullopt;
+        return *std::prev(it);
+    }
+}
+
+auto DebugMap::from_generators(const std::vector<CodeGenerator>& gens, const SymTable& symbols,
+                               std::string main_image_name, const fs::path& source_dir) -> DebugMap
+{
+    DebugMap map;
+    std::map<std::string, uint32_t> file_ids;
+    std::map<const Script*, size_t> stream_images; // by root script
+
+    auto source_prefix = source_dir.generic_u8string();
+    if(!source_prefix.empty() && source_prefix.back() != '/')
+        source_prefix.push_back('/');
+
+    auto file_id = [&](const std::string& stream_name) -> uint32_t
+    {
+        auto it = file_ids.find(stream_name);
+        if(it == file_ids.end())
+        {
+            auto path = fs::u8path(stream_name).generic_u8string();
+            if(!source_prefix.empty() && path.compare(0, source_prefix.size(), source_prefix) == 0)
+                path.erase(0, source_prefix.size());
+
+            it = file_ids.emplace(stream_name, uint32_t(map.files.size())).first;
+            map.files.emplace_back(std::move(path));
+        }
+        return it->second;
+    };
+
+    auto location = [&](const SyntaxTree& node) -> optional<SourceLocation>
+    {
+        // the leftmost token of the statement (e.g. `x` rather than `=` in `x = 1`)
+        const SyntaxTree* context = node.has_text()? &node : nullptr;
+        for(auto& child : node)
+        {
+            if(child->has_text() && (!context || child->get_token().begin < context->get_token().begin))
+                context = child.get();
+        }
+
+        if(!context)
+            return nullopt;
+
+        auto tstream = context->token_stream().lock();
+        if(!tstream)
+            return nullopt;
+
+        auto linecol = tstream->text.linecol_from_offset(context->get_token().begin);
+        return SourceLocation { file_id(tstream->text.stream_name), uint32_t(linecol.first), uint32_t(linecol.second) };
+    };
+
+    auto scope_of = [](const SyntaxTree& node) -> shared_ptr<const SyntaxTree>
+    {
+        for(auto parent = node.parent(); parent; parent = parent->parent())
+        {
+            if(parent->type() == NodeType::Scope)
+                return parent;
+        }
+        return nullptr;
+    };
+
+    // Finds the image of `script` and the offset of the image relative to the scripts offsets.
+    auto image_of = [&](const Script& script) -> std::pair<Image&, uint32_t>
+    {
+        if(!script.is_child_of(ScriptType::StreamedScript))
+            return { map.images[0], 0 };
+
+        auto root = script.root_script();
+        auto it = stream_images.find(root.get());
+        if(it == stream_images.end())
+        {
+            it = stream_images.emplace(root.get(), map.images.size()).first;
+            map.images.emplace_back();
+            map.images.back().name = root->path.stem().u8string() + ".scm";
+        }
+        return { map.images[it->second], uint32_t(root->base.value()) };
+    };
+
+    map.images.emplace_back();
+    map.images[0].name = std::move(main_image_name);
+
+    for(auto& gen : gens)
+    {
+        auto image_pair = image_of(*gen.script);
+        auto& image = image_pair.first;
+        auto code_offset = uint32_t(gen.script->code_offset.value()) - image_pair.second;
+        auto code_end = code_offset + uint32_t(gen.script->code_size.value());
+
+        image.size = std::max(image.size, code_end);
+
+        // so offsets before the first label of a script aren't attributed to the labels of the previous script.
+        image.labels.push_back(LabelEntry { code_offset, gen.script->path.filename().u8string() });
+
+        shared_ptr<const SyntaxTree> last_scope;
+        for(auto& stmt : gen.statement_offsets())
+        {
+            auto offset = code_offset + stmt.first;
+
+            if(auto where = location(*stmt.second))
+            {
+                if(image.statements.empty() || image.statements.back().offset != offset)
+                    image.statements.push_back(StatementEntry { offset, *where });
+            }
+
+            auto scope = scope_of(*stmt.second);
+            if(scope != last_scope)
+            {
+                if(last_scope)
+                    image.scopes.back().end = offset;
+
+                if(scope)
+                {
+                    if(auto where = location(*scope))
+                        image.scopes.push_back(ScopeEntry { offset, code_end, *where });
+                    else
+                        scope = nullptr;
+                }
+
+                last_scope = std::move(scope);
+            }
+        }
+    }
+
+    for(auto& lpair : symbols.labels)
+    {
+        auto& label = *lpair.second;
+        auto script = label.script.lock();
+        if(!script || !label.code_position)
+            continue;
+
+        auto image_pair = image_of(*script);
+        auto offset = uint32_t(label.offset()) - image_pair.second;
+        image_pair.first.labels.push_back(LabelEntry { offset, lpair.first });
+    }
+
+    for(auto& image : map.images)
+    {
+        std::stable_sort(image.statements.begin(), image.statements.end(), [](const auto& a, const auto& b) {
+            return a.offset < b.offset;
+        });
+        std::stable_sort(image.labels.begin(), image.labels.end(), [](const auto& a, const auto& b) {
+            return a.offset < b.offset;
+        });
+        std::stable_sort(image.scopes.begin(), image.scopes.end(), [](const auto& a, const auto& b) {
+            return a.begin < b.begin;
+        });
+    }
+
+    return map;
+}
+
+std::vector<uint8_t> DebugMap::encode() const
+{
+    MapWriter w;
+
+    w.data.insert(w.data.end(), std::begin(debug_map_magic), std::end(debug_map_magic));
+    w.u(DebugMap::version);
+
+    w.u(this->files.size());
+    for(auto& file : this->files)
+        w.string(file);
+
+    w.u(this->images.size());
+    for(auto& image : this->images)
+    {
+        SourceLocation last_where = { 0, 0, 0 };
+        uint32_t last_offset = 0;
+
+        w.string(image.name);
+        w.u(image.size);
+
+        w.u(image.statements.size());
+        for(auto& stmt : image.statements)
+        {
+            w.u(stmt.offset - last_offset);
+            w.location(stmt.where, last_where);
+            last_offset = stmt.offset;
+        }
+
+        last_offset = 0;
+        w.u(image.labels.size());
+        for(auto& label : image.labels)
+        {
+            w.u(label.offset - last_offset);
+            w.string(label.name);
+            last_offset = label.offset;
+        }
+
+        last_offset = 0;
+        last_where = { 0, 0, 0 };
+        w.u(image.scopes.size());
+        for(auto& scope : image.scopes)
+        {
+            w.u(scope.begin - last_offset);
+            w.u(scope.end - scope.begin);
+            w.location(scope.where, last_where);
+            last_offset = scope.begin;
+        }
+    }
+
+    return std::move(w.data);
+}
+
+auto DebugMap::decode(const uint8_t* data, size_t size) -> optional<DebugMap>
+{
+    MapReader r(data, size);
+    DebugMap map;
+
+    if(!r.magic() || r.u() != uint64_t(DebugMap::version))
+        return nullopt;
+
+    auto num_files = r.count(1);
+    if(!num_files)
+        return nullopt;
+
+    map.files.reserve(*num_files);
+    for(size_t i = 0; i < *num_files; ++i)
+    {
+        auto file = r.string();
+        if(!file) return nullopt;
+        map.files.emplace_back(std::move(*file));
+    }
+
+    auto num_images = r.count(5);
+    if(!num_images)
+        return nullopt;
+
+    map.images.resize(*num_images);
+    for(auto& image : map.images)
+    {
+        SourceLocation last_where = { 0, 0, 0 };
+        uint32_t last_offset = 0;
+
+        auto name = r.string();
+        auto image_size = r.u32();
+        if(!name || !image_size)
+            return nullopt;
+
+        image.name = std::move(*name);
+        image.size = *image_size;
+
+        auto num_statements = r.count(4);
+        if(!num_statements)
+            return nullopt;
+
+        image.statements.resize(*num_statements);
+        for(auto& stmt : image.statements)
+        {
+            auto offset = r.offset(last_offset);
+            if(!offset || !r.location(stmt.where, last_where, map.files.size()))
+                return nullopt;
+            stmt.offset = *offset;
+        }
+
+        last_offset = 0;
+        auto num_labels = r.count(2);
+        if(!num_labels)
+            return nullopt;
+
+        image.labels.resize(*num_labels);
+        for(auto& label : image.labels)
+        {
+            auto offset = r.offset(last_offset);
+            auto label_name = r.string();
+            if(!offset || !label_name)
+                return nullopt;
+            label.offset = *offset;
+            label.name = std::move(*label_name);
+        }
+
+        last_offset = 0;
+        last_where = { 0, 0, 0 };
+        auto num_scopes = r.count(5);
+        if(!num_scopes)
+            return nullopt;
+
+        image.scopes.resize(*num_scopes);
+        for(auto& scope : image.scopes)
+        {
+            auto begin = r.offset(last_offset);
+            auto scope_size = r.u32();
+            if(!begin || !scope_size || *scope_size > UINT32_MAX - *begin
+                || !r.location(scope.where, last_where, map.files.size()))
+                return nullopt;
+            scope.begin = *begin;
+            scope.end = *begin + *scope_size;
+        }
+    }
+
+    if(!r.eof())
+        return nullopt;
+
+    return map;
+}
+
+auto DebugMap::find_image(const string_view& name) const -> optional<const Image&>
+{
+    auto it = std::find_if(this->images.begin(), this->images.end(), [&](const Image& image) {
+        return iequal_to()(image.name, name);
+    });
+    if(it != this->images.end())
+        return *it;
+    return nullopt;
+}
+
+auto DebugMap::symbolize(const Image& image, uint32_t offset) const -> Symbol
+{
+    Symbol symbol;
+
+    if(offset >= image.size)
+        return symbol;
+
+    symbol.statement = find_at_or_before(image.statements, offset, [](const StatementEntry& e) { return e.offset; });
+    symbol.label = find_at_or_before(image.labels, offset, [](const LabelEntry& e) { return e.offset; });
+
+    auto scope = find_at_or_before(image.scopes, offset, [](const ScopeEntry& e) { return e.begin; });
+    if(scope && offset < scope->end)
+        symbol.scope = scope;
+
+    return symbol;
+}
+
+int symbolize(const fs::path& input, const std::vector<std::string>& offsets,
+              const TextSink& stdout_sink, const TextSink& log)
+{
+    auto map_path = input;
+    if(!iequal_to()(input.extension().u8string(), ".dbg"))
+        map_path += ".dbg";
+
+    auto bytes = read_file_binary(map_path);
+    if(!bytes)
+    {
+        log(fmt::format("gta3sc: error: could not open debug map '{}'", map_path.generic_u8string()));
+        return EXIT_FAILURE;
+    }
+
+    auto map = DebugMap::decode(bytes->data(), bytes->size());
+    if(!map || map->images.empty())
+    {
+        log(fmt::format("gta3sc: error: malformed debug map '{}'", map_path.generic_u8string()));
+        return EXIT_FAILURE;
+    }
+
+    // @file arguments are replaced by the whitespace separated offsets in the file.
+    std::vector<std::string> queries;
+    for(auto& arg : offsets)
+    {
+        if(arg.empty() || arg[0] != '@')
+        {
+            queries.emplace_back(arg);
+            continue;
+        }
+
+        auto list = read_file_utf8(fs::u8path(arg.substr(1)));
+        if(!list)
+        {
+            log(fmt::format("gta3sc: error: could not open offset list '{}'", arg.substr(1)));
+            return EXIT_FAILURE;
+        }
+
+        auto is_space = [](char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r'; };
+        for(auto it = list->begin(); it != list->end(); )
+        {
+            it = std::find_if_not(it, list->end(), is_space);
+            auto word_end = std::find_if(it, list->end(), is_space);
+            if(it != word_end)
+                queries.emplace_back(it, word_end);
+            it = word_end;
+        }
+    }
+
+    if(queries.empty())
+    {
+        log("gta3sc: error: no offset to symbolize");
+        return EXIT_FAILURE;
+    }
+
+    std::string output;
+    for(auto& query : queries)
+    {
+        const DebugMap::Image* image = &map->images[0];
+        string_view offset_text = query;
+
+        auto colon = query.rfind(':');
+        if(colon != std::string::npos)
+        {
+            auto opt_image = map->find_image(string_view(query).substr(0, colon));
+            if(!opt_image)
+            {
+                log(fmt::format("gta3sc: error: no image named '{}' in the debug map", query.substr(0, colon)));
+                return EXIT_FAILURE;
+            }
+            image = &*opt_image;
+            offset_text = string_view(query).substr(colon + 1);
+        }
+
+        uint32_t offset = 0;
+        auto result = from_chars_prefixed(offset_text.begin(), offset_text.end(), offset);
+        if(result.ec != std::errc() || result.ptr != offset_text.end())
+        {
+            log(fmt::format("gta3sc: error: invalid offset '{}'", query));
+            return EXIT_FAILURE;
+        }
+
+        output += fmt::format("{}:0x{:X}", image->name, offset);
+
+        auto symbol = map->symbolize(*image, offset);
+        if(!symbol.statement)
+        {
+            output += " ??\n";
+            continue;
+        }
+
+        auto& where = symbol.statement->where;
+        output += fmt::format(" {}:{}:{}", map->files[where.file], where.line, where.column);
+
+        if(symbol.label)
+            output += fmt::format(" in {}+0x{:X}", symbol.label->name, offset - symbol.label->offset);
+
+        if(symbol.scope)
+        {
+            auto& scope_where = symbol.scope->where;
+            output += fmt::format(" (scope at {}:{}:{})", map->files[scope_where.file], scope_where.line, scope_where.column);
+        }
+
+        output.push_back('\n');
+    }
+
+    stdout_sink(output);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,108 @@
+///
+/// Debug Map
+///
+/// Maps the offsets of the compiled bytecode back into the source code, so that the offsets reported by the game
+/// (e.g. on a crash or a hanging script) can be symbolized. It is written next to the compiled output with the `-g`
+/// option (as `<output>.dbg`) and read by `gta3sc symbolize`.
+///
+/// There's a table for each image, that is, the main file (including missions) and each streamed script in the
+/// script.img. The offsets of the main file are relative to its beginning, while the ones of a streamed script are
+/// relative to the beginning of the streamed script, as the game reports them.
+///
+/// The file is a sequence of unsigned LEB128 integers (`u`), signed zig-zag LEB128 integers (`s`) and strings (`u`
+/// length then bytes). The offsets, files and lines of the tables are deltas from the previous entry.
+///
+///     "GDBG" u:version
+///     u:num_files  { string:path }
+///     u:num_images { string:name u:size
+///                    u:num_statements { u:offset s:file s:line u:column }
+///                    u:num_labels     { u:offset string:name }
+///                    u:num_scopes     { u:begin u:size s:file s:line u:column } }
+///
+#pragma once
+#include <stdinc.h>
+#include "program.hpp"
+
+class CodeGenerator;
+class SymTable;
+
+class DebugMap
+{
+public:
+    static constexpr uint32_t version = 1;
+
+    struct SourceLocation
+    {
+        uint32_t file;      //< Index into `files`.
+        uint32_t line;      //< 1-based.
+        uint32_t column;    //< 1-based.
+    };
+
+    struct StatementEntry
+    {
+        uint32_t       offset;  //< Where the code of the statement begins.
+        SourceLocation where;
+    };
+
+    struct LabelEntry
+    {
+        uint32_t    offset;
+        std::string name;
+    };
+
+    struct ScopeEntry
+    {
+        uint32_t       begin;   //< Where the code of the scope begins.
+        uint32_t       end;     //< Where the code of the scope ends (exclusive).
+        SourceLocation where;   //< The opening curly bracket.
+    };
+
+    struct Image
+    {
+        std::string                 name;       //< Name of the output file or of the streamed script (`name.scm`).
+        uint32_t                    size = 0;   //< Size of the code, including headers.
+        std::vector<StatementEntry> statements; //< Sorted by offset.
+        std::vector<LabelEntry>     labels;     //< Sorted by offset. The beginning of each script file is also a label.
+        std::vector<ScopeEntry>     scopes;     //< Sorted by offset, never overlapping.
+    };
+
+    /// The source of a offset, as given by `symbolize`.
+    struct Symbol
+    {
+        optional<const StatementEntry&> statement;  //< The statement at or before the offset.
+        optional<const LabelEntry&>     label;      //< The label at or before the offset.
+        optional<const ScopeEntry&>     scope;      //< The scope containing the offset.
+    };
+
+    std::vector<std::string>    files;      //< Source files, relative to the directory of the main script if inside it.
+    std::vector<Image>          images;     //< The main image comes first.
+
+public:
+    /// Builds the map of the code generated by `gens`.
+    ///
+    /// The labels come from `symbols`, and the sources paths are made relative to `source_dir`.
+    ///
+    /// \warning Only available after offsets have been computed and the code generated with the `-g` option.
+    static DebugMap from_generators(const std::vector<CodeGenerator>& gens, const SymTable& symbols,
+                                    std::string main_image_name, const fs::path& source_dir);
+
+    /// Encodes the map into its binary format.
+    std::vector<uint8_t> encode() const;
+
+    /// Decodes a map from its binary format, or returns `nullopt` if the data is malformed.
+    static optional<DebugMap> decode(const uint8_t* data, size_t size);
+
+    /// Finds the image named `name`, case insensitively.
+    optional<const Image&> find_image(const string_view& name) const;
+
+    /// Finds the source of `offset` in `image`, in logarithmic time.
+    Symbol symbolize(const Image& image, uint32_t offset) const;
+};
+
+/// Symbolizes `offsets` (each as `[image:]offset`) with the debug map `input`, printing a line for each into `stdout_sink`.
+///
+/// `input` may be the debug map or the compiled output it is next to.
+///
+/// \returns the exit code.
+int symbolize(const fs::path& input, const std::vector<std::string>& offsets,
+              const TextSink& stdout_sink, const TextSink& log);
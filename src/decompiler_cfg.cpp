@@ -0,0 +1,460 @@
+#include <stdinc.h>
+#include "commands.hpp"
+#include "decompiler_cfg.hpp"
+
+DominatorTree::DominatorTree(const std::vector<std::vector<size_t>>& succs, size_t root)
+{
+    const size_t num_nodes = succs.size();
+
+    Expects(root < num_nodes);
+
+    // Depth-first numbering of the nodes reachable from the root.
+    std::vector<size_t> dfnum(num_nodes, none);
+    std::vector<size_t> vertex;     // dfnum -> node
+    std::vector<size_t> parent;     // dfnum -> dfnum of parent in the depth-first spanning tree
+    {
+        std::vector<std::pair<size_t, size_t>> stack; // (node, next successor)
+        vertex.reserve(num_nodes);
+        parent.reserve(num_nodes);
+
+        dfnum[root] = 0;
+        vertex.emplace_back(root);
+        parent.emplace_back(none);
+        stack.emplace_back(root, 0);
+
+        while(!stack.empty())
+        {
+            auto& top = stack.back();
+            auto& top_succs = succs[top.first];
+            if(top.second < top_succs.size())
+            {
+                auto w = top_succs[top.second++];
+                if(dfnum[w] == none)
+                {
+                    dfnum[w] = vertex.size();
+                    parent.emplace_back(dfnum[top.first]);
+                    vertex.emplace_back(w);
+                    stack.emplace_back(w, 0);
+                }
+            }
+            else
+            {
+                stack.pop_back();
+            }
+        }
+    }
+
+    const size_t num_reachable = vertex.size();
+
+    // Predecessors in terms of depth-first numbers.
+    std::vector<std::vector<size_t>> preds(num_reachable);
+    for(size_t v = 0; v < num_reachable; ++v)
+    {
+        for(auto w : succs[vertex[v]])
+            preds[dfnum[w]].emplace_back(v);
+    }
+
+    std::vector<size_t> semi(num_reachable);
+    std::vector<size_t> label(num_reachable);
+    std::vector<size_t> ancestor(num_reachable, none);
+    std::vector<size_t> idom(num_reachable, none);
+    std::vector<std::vector<size_t>> bucket(num_reachable);
+    std::vector<size_t> path;
+
+    for(size_t v = 0; v < num_reachable; ++v)
+    {
+        semi[v] = v;
+        label[v] = v;
+    }
+
+    // The vertex with the minimum semidominator in the path from `v` to the root of its forest tree.
+    auto eval = [&](size_t v) -> size_t
+    {
+        if(ancestor[v] == none)
+            return v;
+
+        path.clear();
+        for(auto u = v; ancestor[ancestor[u]] != none; u = ancestor[u])
+            path.emplace_back(u);
+
+        for(auto it = path.rbegin(); it != path.rend(); ++it)
+        {
+            auto u = *it;
+            auto a = ancestor[u];
+            if(semi[label[a]] < semi[label[u]])
+                label[u] = label[a];
+            ancestor[u] = ancestor[a];
+        }
+
+        return label[v];
+    };
+
+    for(size_t w = num_reachable; w-- > 1; )
+    {
+        for(auto v : preds[w])
+        {
+            auto u = eval(v);
+            if(semi[u] < semi[w])
+                semi[w] = semi[u];
+        }
+
+        bucket[semi[w]].emplace_back(w);
+
+        auto p = parent[w];
+        ancestor[w] = p;
+
+        for(auto v : bucket[p])
+        {
+            auto u = eval(v);
+            idom[v] = (semi[u] < semi[v]? u : p);
+        }
+        bucket[p].clear();
+    }
+
+    for(size_t w = 1; w < num_reachable; ++w)
+    {
+        if(idom[w] != semi[w])
+            idom[w] = idom[idom[w]];
+    }
+
+    this->idoms.assign(num_nodes, none);
+    for(size_t w = 1; w < num_reachable; ++w)
+        this->idoms[vertex[w]] = vertex[idom[w]];
+
+    // Number the dominator tree, so dominance can be queried in constant time.
+    std::vector<std::vector<size_t>> children(num_nodes);
+    for(size_t w = 1; w < num_reachable; ++w)
+        children[this->idoms[vertex[w]]].emplace_back(vertex[w]);
+
+    this->tree_pre.assign(num_nodes, none);
+    this->tree_post.assign(num_nodes, none);
+
+    size_t pre_counter = 0, post_counter = 0;
+    std::vector<std::pair<size_t, size_t>> stack; // (node, next child)
+    this->tree_pre[root] = pre_counter++;
+    stack.emplace_back(root, 0);
+    while(!stack.empty())
+    {
+        auto& top = stack.back();
+        auto& top_children = children[top.first];
+        if(top.second < top_children.size())
+        {
+            auto child = top_children[top.second++];
+            this->tree_pre[child] = pre_counter++;
+            stack.emplace_back(child, 0);
+        }
+        else
+        {
+            this->tree_post[top.first] = post_counter++;
+            stack.pop_back();
+        }
+    }
+}
+
+ControlFlowGraph::ControlFlowGraph(const std::vector<DecompiledData>& data, const Commands& commands, bool is_main_segment,
+                                   const std::set<size_t>& external_labels) :
+    data_(&data), commands_(&commands), is_main_segment_(is_main_segment), external_labels(external_labels)
+{
+    this->build_blocks();
+
+    const size_t num_nodes = this->blocks.size() + 2;
+
+    std::vector<std::vector<size_t>> succs(num_nodes);
+    std::vector<std::vector<size_t>> preds(num_nodes);
+    for(size_t i = 0; i < this->blocks.size(); ++i)
+    {
+        succs[i] = this->blocks[i].succs;
+        preds[i] = this->blocks[i].preds;
+    }
+
+    for(size_t i = 0; i < this->blocks.size(); ++i)
+    {
+        for(auto s : this->blocks[i].succs)
+        {
+            if(s == this->exit())
+                preds[this->exit()].emplace_back(i);
+        }
+        for(auto p : this->blocks[i].preds)
+        {
+            if(p == this->entry())
+                succs[this->entry()].emplace_back(i);
+        }
+    }
+
+    // The exit must be reachable backwards from everywhere, even from infinite loops, for post-dominance to be
+    // meaningful. Such loops get a edge from their last block into the exit, as if they could leave from there.
+    std::vector<bool> reaches_exit(num_nodes, false);
+    std::vector<size_t> stack;
+
+    auto mark_reaching = [&](size_t node)
+    {
+        reaches_exit[node] = true;
+        stack.emplace_back(node);
+        while(!stack.empty())
+        {
+            auto v = stack.back();
+            stack.pop_back();
+            for(auto p : preds[v])
+            {
+                if(!reaches_exit[p])
+                {
+                    reaches_exit[p] = true;
+                    stack.emplace_back(p);
+                }
+            }
+        }
+    };
+
+    mark_reaching(this->exit());
+    for(size_t i = this->blocks.size(); i-- > 0; )
+    {
+        if(!reaches_exit[i])
+        {
+            succs[i].emplace_back(this->exit());
+            preds[this->exit()].emplace_back(i);
+            mark_reaching(i);
+        }
+    }
+
+    this->dom_tree.emplace(succs, this->entry());
+    this->pdom_tree.emplace(preds, this->exit());
+}
+
+void ControlFlowGraph::build_blocks()
+{
+    auto& data = *this->data_;
+
+    auto is_switch_command = [&](const DecompiledCommand& ccmd) {
+        return ccmd.command.special == SpecialCommand::SwitchStart
+            || ccmd.command.special == SpecialCommand::SwitchContinued;
+    };
+
+    // Calls the functor with the local offset of each label argument of the command.
+    auto for_each_label_arg = [&](const DecompiledCommand& ccmd, auto fn)
+    {
+        for(size_t i = 0; i < ccmd.args.size(); ++i)
+        {
+            auto opt_arg = ccmd.command.arg(i);
+            if(opt_arg && opt_arg->type == ArgType::Label)
+            {
+                if(auto opt_offset = this->label_offset(ccmd.args[i]))
+                    fn(*opt_offset);
+            }
+        }
+    };
+
+    std::vector<size_t> entry_offsets;      // offsets entered without a branch
+    std::set<size_t> referenced;            // offsets referenced by any label argument
+
+    // Split the data into blocks.
+    for(size_t i = 0; i < data.size(); ++i)
+    {
+        if(is<DecompiledLabelDef>(data[i].data) || this->blocks.empty() || this->blocks.back().end != SIZE_MAX)
+        {
+            if(!this->blocks.empty() && this->blocks.back().end == SIZE_MAX)
+                this->blocks.back().end = i;
+
+            this->blocks.emplace_back();
+            this->blocks.back().begin = i;
+            this->blocks.back().end = SIZE_MAX;
+            this->blocks.back().exit = BasicBlock::Exit::Fallthrough;
+            this->blocks.back().target = DominatorTree::none;
+            this->block_offsets.emplace_back(data[i].offset);
+        }
+
+        auto& block = this->blocks.back();
+
+        if(is<DecompiledHex>(data[i].data))
+        {
+            block.exit = BasicBlock::Exit::Unknown;
+            block.end = i + 1;
+        }
+        else if(is<DecompiledCommand>(data[i].data))
+        {
+            auto& ccmd = get<DecompiledCommand>(data[i].data);
+
+            for_each_label_arg(ccmd, [&](size_t offset) { referenced.emplace(offset); });
+
+            if(ccmd.command.has_flow(ControlFlow::Branch | ControlFlow::ConditionalBranch))
+            {
+                // only GOTO and GOTO_IF_FALSE are recovered into statements, other branches are just edges.
+                if(ccmd.command.special == SpecialCommand::Goto)
+                    block.exit = BasicBlock::Exit::Goto;
+                else if(ccmd.command.special == SpecialCommand::GotoIfFalse)
+                    block.exit = BasicBlock::Exit::GotoIfFalse;
+                else
+                    block.exit = BasicBlock::Exit::Branch;
+                block.end = i + 1;
+            }
+            else if(is_switch_command(ccmd))
+            {
+                auto next_command = this->command_at(i + 1);
+                if(!next_command || next_command->command.special != SpecialCommand::SwitchContinued)
+                {
+                    block.exit = BasicBlock::Exit::Switch;
+                    block.end = i + 1;
+                }
+            }
+            else if(!ccmd.command.falls_through())
+            {
+                block.exit = BasicBlock::Exit::Leave;
+                block.end = i + 1;
+            }
+            else
+            {
+                for_each_label_arg(ccmd, [&](size_t offset) { entry_offsets.emplace_back(offset); });
+            }
+        }
+    }
+
+    if(!this->blocks.empty() && this->blocks.back().end == SIZE_MAX)
+        this->blocks.back().end = data.size();
+
+    // Connect the blocks.
+    auto add_edge = [&](size_t from, size_t to)
+    {
+        if(from != this->entry())
+        {
+            auto& succs = this->blocks[from].succs;
+            if(std::find(succs.begin(), succs.end(), to) != succs.end())
+                return;
+            succs.emplace_back(to);
+        }
+        if(to != this->exit())
+        {
+            auto& preds = this->blocks[to].preds;
+            if(from == this->entry() && std::find(preds.begin(), preds.end(), from) != preds.end())
+                return;
+            preds.emplace_back(from);
+        }
+    };
+
+    auto add_label_edge = [&](size_t from, const ArgVariant2& arg)
+    {
+        auto opt_offset = this->label_offset(arg);
+        auto opt_block = opt_offset? this->block_at(*opt_offset) : nullopt;
+        add_edge(from, opt_block? *opt_block : this->exit());
+        return opt_block;
+    };
+
+    for(size_t b = 0; b < this->blocks.size(); ++b)
+    {
+        auto& block = this->blocks[b];
+        auto fallthrough = (b + 1 < this->blocks.size()? b + 1 : this->exit());
+
+        switch(block.exit)
+        {
+            case BasicBlock::Exit::Fallthrough:
+                add_edge(b, fallthrough);
+                break;
+
+            case BasicBlock::Exit::Goto:
+            case BasicBlock::Exit::GotoIfFalse:
+            {
+                auto& ccmd = get<DecompiledCommand>(data[block.end - 1].data);
+                if(!ccmd.args.empty())
+                {
+                    if(auto opt_target = add_label_edge(b, ccmd.args[0]))
+                        this->blocks[b].target = *opt_target;
+                }
+                if(block.exit == BasicBlock::Exit::GotoIfFalse)
+                    add_edge(b, fallthrough);
+                break;
+            }
+
+            case BasicBlock::Exit::Branch:
+            {
+                auto& ccmd = get<DecompiledCommand>(data[block.end - 1].data);
+                for(size_t i = 0; i < ccmd.args.size(); ++i)
+                {
+                    auto opt_arg = ccmd.command.arg(i);
+                    if(opt_arg && opt_arg->type == ArgType::Label)
+                        add_label_edge(b, ccmd.args[i]);
+                }
+                if(ccmd.command.falls_through())
+                    add_edge(b, fallthrough);
+                break;
+            }
+
+            case BasicBlock::Exit::Switch:
+            {
+                for(size_t i = block.end; i-- > block.begin; )
+                {
+                    auto opt_ccmd = this->command_at(i);
+                    if(!opt_ccmd || !is_switch_command(*opt_ccmd))
+                        break;
+
+                    for(size_t k = 0; k < opt_ccmd->args.size(); ++k)
+                    {
+                        auto opt_arg = opt_ccmd->command.arg(k);
+                        if(opt_arg && opt_arg->type == ArgType::Label)
+                            add_label_edge(b, opt_ccmd->args[k]);
+                    }
+                }
+                break;
+            }
+
+            case BasicBlock::Exit::Leave:
+            case BasicBlock::Exit::Unknown:
+                add_edge(b, this->exit());
+                break;
+
+            default:
+                Unreachable();
+        }
+    }
+
+    // Connect the entry.
+    if(!this->blocks.empty())
+        add_edge(this->entry(), 0);
+
+    for(auto offset : entry_offsets)
+    {
+        if(auto opt_block = this->block_at(offset))
+            add_edge(this->entry(), *opt_block);
+    }
+
+    for(auto offset : this->external_labels)
+    {
+        if(auto opt_block = this->block_at(offset))
+            add_edge(this->entry(), *opt_block);
+    }
+
+    for(size_t b = 0; b < this->blocks.size(); ++b)
+    {
+        auto& block = this->blocks[b];
+        bool is_unknown_label = is<DecompiledLabelDef>(data[block.begin].data)
+                             && !referenced.count(data[block.begin].offset);
+
+        // Labels referenced by nothing in this segment are referenced by other segments.
+        if(is_unknown_label)
+            add_edge(this->entry(), b);
+    }
+}
+
+optional<size_t> ControlFlowGraph::block_at(size_t local_offset) const
+{
+    auto it = std::lower_bound(this->block_offsets.begin(), this->block_offsets.end(), local_offset);
+    if(it != this->block_offsets.end() && *it == local_offset)
+        return size_t(it - this->block_offsets.begin());
+    return nullopt;
+}
+
+optional<size_t> ControlFlowGraph::label_offset(const ArgVariant2& arg) const
+{
+    if(auto opt_value = get_imm32(arg))
+    {
+        if(*opt_value < 0)
+            return size_t(-int64_t(*opt_value));
+        else if(this->is_main_segment_)
+            return size_t(*opt_value);
+    }
+    return nullopt;
+}
+
+optional<const DecompiledCommand&> ControlFlowGraph::command_at(size_t index) const
+{
+    if(index < this->data_->size() && is<DecompiledCommand>((*this->data_)[index].data))
+        return get<DecompiledCommand>((*this->data_)[index].data);
+    return nullopt;
+}
@@ -0,0 +1,137 @@
+///
+/// Control Flow Graph
+///
+/// Splits the data given by the disassembler (vector of pseudo-instructions, see *disassembler.hpp*) into basic blocks
+/// and connects them by their branches. The dominator and post-dominator trees of the graph are computed as well,
+/// those being the basis for structuring the code back into IF, WHILE, REPEAT and SWITCH (see *decompiler_gta3.hpp*).
+///
+/// Besides the basic blocks, the graph has two virtual nodes:
+///
+///  + The entry, which branches into the beggining of the segment and into any block reachable without a branch
+///    (e.g. the target of `GOSUB` or `START_NEW_SCRIPT`, or labels only known by other segments).
+///  + The exit, which all blocks leaving the segment branch into (e.g. `RETURN` or `TERMINATE_THIS_SCRIPT`).
+///
+/// Everything is built in near-linear time, so even the huge main segment of San Andreas takes little time.
+///
+#pragma once
+#include <stdinc.h>
+#include "disassembler.hpp"
+
+/// Dominator tree of a directed graph.
+///
+/// Computed by the Lengauer-Tarjan algorithm (with path compression only), which runs in O(E log V).
+class DominatorTree
+{
+public:
+    static constexpr size_t none = SIZE_MAX;
+
+    /// Computes the dominators of the nodes reachable from `root` in the graph given by the `succs` adjacency list.
+    explicit DominatorTree(const std::vector<std::vector<size_t>>& succs, size_t root);
+
+    /// Gets the immediate dominator of `node`, or `none` if `node` is the root or isn't reachable from the root.
+    size_t idom(size_t node) const
+    {
+        return this->idoms[node];
+    }
+
+    /// Checks whether `node` is reachable from the root.
+    bool reachable(size_t node) const
+    {
+        return this->tree_pre[node] != none;
+    }
+
+    /// Checks whether `a` dominates `b` in constant time. Reachable nodes dominate themselves.
+    bool dominates(size_t a, size_t b) const
+    {
+        return reachable(a) && reachable(b)
+            && this->tree_pre[a] <= this->tree_pre[b] && this->tree_post[b] <= this->tree_post[a];
+    }
+
+private:
+    std::vector<size_t> idoms;
+    std::vector<size_t> tree_pre;   //< Preorder number of each node in the dominator tree.
+    std::vector<size_t> tree_post;  //< Postorder number of each node in the dominator tree.
+};
+
+/// A sequence of pseudo-instructions with a single entry and a single exit.
+struct BasicBlock
+{
+    /// How control leaves the block.
+    enum class Exit : uint8_t
+    {
+        Fallthrough,    //< Continues into the next block.
+        Goto,           //< `GOTO target`.
+        GotoIfFalse,    //< `GOTO_IF_FALSE target`, otherwise continues into the next block.
+        Branch,         //< Any other branch into its label arguments, continuing into the next block if conditional.
+        Switch,         //< `SWITCH_START` and its `SWITCH_CONTINUED`s.
+        Leave,          //< Leaves the segment (e.g. `RETURN`, `TERMINATE_THIS_SCRIPT`, or a branch into another segment).
+        Unknown,        //< Data which isn't code.
+    };
+
+    size_t              begin;      //< Index of the first pseudo-instruction in the disassembled data.
+    size_t              end;        //< Index after the last pseudo-instruction in the disassembled data.
+    Exit                exit;
+    size_t              target;     //< Target block of `Goto` and `GotoIfFalse`, or `DominatorTree::none` if external.
+    std::vector<size_t> succs;      //< Successors, including the virtual exit.
+    std::vector<size_t> preds;      //< Predecessors, including the virtual entry.
+};
+
+class ControlFlowGraph
+{
+public:
+    /// Builds the graph of a disassembled segment.
+    ///
+    /// `external_labels` are local offsets which other segments refer to, thus are also entry points of this segment.
+    explicit ControlFlowGraph(const std::vector<DecompiledData>& data, const Commands& commands, bool is_main_segment,
+                              const std::set<size_t>& external_labels);
+
+    ControlFlowGraph(const ControlFlowGraph&) = delete;
+    ControlFlowGraph(ControlFlowGraph&&) = default;
+
+    /// Number of basic blocks. The virtual nodes are not included.
+    size_t num_blocks() const { return this->blocks.size(); }
+
+    /// Node id of the virtual entry.
+    size_t entry() const { return this->blocks.size(); }
+
+    /// Node id of the virtual exit.
+    size_t exit() const { return this->blocks.size() + 1; }
+
+    const BasicBlock& block(size_t id) const { return this->blocks[id]; }
+
+    const std::vector<DecompiledData>& data() const { return *this->data_; }
+
+    const Commands& commands() const { return *this->commands_; }
+
+    bool is_main_segment() const { return this->is_main_segment_; }
+
+    const DominatorTree& dominators() const { return this->dom_tree.value(); }
+
+    const DominatorTree& post_dominators() const { return this->pdom_tree.value(); }
+
+    /// Gets the block starting at the specified local offset.
+    optional<size_t> block_at(size_t local_offset) const;
+
+    /// Checks whether other segments refer to the specified local offset.
+    bool is_external_label(size_t local_offset) const { return this->external_labels.count(local_offset) != 0; }
+
+    /// Converts the value of a label argument into a local offset of this segment.
+    /// \returns `nullopt` if the label refers to another segment.
+    optional<size_t> label_offset(const ArgVariant2& arg) const;
+
+    /// Gets the command of the pseudo-instruction at the specified index, if it is a command.
+    optional<const DecompiledCommand&> command_at(size_t index) const;
+
+private:
+    void build_blocks();
+
+private:
+    const std::vector<DecompiledData>*  data_;
+    const Commands*                     commands_;
+    bool                                is_main_segment_;
+    std::set<size_t>                    external_labels;
+    std::vector<BasicBlock>             blocks;
+    std::vector<size_t>                 block_offsets;  //< Local offset of each block, for lookups.
+    optional<DominatorTree>             dom_tree;
+    optional<DominatorTree>             pdom_tree;
+};
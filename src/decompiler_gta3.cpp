@@ -0,0 +1,621 @@
+#include <stdinc.h>
+#include <thread>
+#include "commands.hpp"
+#include "decompiler_gta3.hpp"
+
+namespace
+{
+using Statement = StructuredStatement;
+
+/// Where `BREAK` and `CONTINUE` would jump to in the current statement.
+struct JumpTargets
+{
+    size_t break_target = DominatorTree::none;
+    size_t continue_target = DominatorTree::none;
+};
+
+/// The condition list at the end of a block which ends in `GOTO_IF_FALSE`.
+struct ConditionList
+{
+    size_t andor;           //< Index of the `ANDOR`, or `DominatorTree::none` if there's none.
+    size_t first;           //< Index of the first condition.
+    size_t last;            //< Index after the last condition (i.e. of the `GOTO_IF_FALSE`).
+    bool   is_or;
+};
+
+class Structurer
+{
+public:
+    explicit Structurer(const ControlFlowGraph& cfg) :
+        cfg(cfg), commands(cfg.commands()), data(cfg.data()),
+        consumed(cfg.data().size(), false), loop_done(cfg.num_blocks(), false)
+    {
+    }
+
+    std::vector<Statement> run()
+    {
+        this->output.reserve(this->data.size());
+        structure_range(0, cfg.num_blocks(), JumpTargets{});
+        remove_unused_labels();
+        return std::move(this->output);
+    }
+
+private:
+    void structure_range(size_t first, size_t last, const JumpTargets& jumps)
+    {
+        for(size_t b = first; b < last; )
+        {
+            if(!try_loop(b, last)
+            && !try_switch(b, last, jumps)
+            && !try_if(b, last, jumps))
+            {
+                emit_block(b, cfg.block(b).end, jumps);
+                ++b;
+            }
+        }
+    }
+
+    /// Emits the pseudo-instructions of the block `b` up to the index `end`.
+    void emit_block(size_t b, size_t end, const JumpTargets& jumps)
+    {
+        auto& block = cfg.block(b);
+        for(size_t i = block.begin; i < end; ++i)
+        {
+            if(this->consumed[i])
+                continue;
+
+            if(i + 1 == block.end && block.exit == BasicBlock::Exit::Goto && block.target != DominatorTree::none)
+            {
+                if(block.target == jumps.break_target)
+                {
+                    this->consumed[i] = true;
+                    emit(Statement::Type::Break);
+                    continue;
+                }
+                else if(block.target == jumps.continue_target)
+                {
+                    this->consumed[i] = true;
+                    emit(Statement::Type::Continue);
+                    continue;
+                }
+            }
+
+            emit(Statement::Type::Data, i);
+        }
+    }
+
+    /// Emits the labels at the beggining of block `b`.
+    /// \returns the index after the labels.
+    size_t emit_labels(size_t b)
+    {
+        auto& block = cfg.block(b);
+        size_t i = block.begin;
+        for(; i < block.end && is<DecompiledLabelDef>(data[i].data); ++i)
+            emit(Statement::Type::Data, i);
+        return i;
+    }
+
+    /// WHILE and REPEAT, with `b` being the loop header.
+    bool try_loop(size_t& b, size_t last)
+    {
+        if(this->loop_done[b])
+            return false;
+
+        auto& dom = cfg.dominators();
+        auto& header = cfg.block(b);
+
+        // The latch is the last block of the natural loop.
+        size_t latch = DominatorTree::none;
+        for(auto p : header.preds)
+        {
+            if(p >= b && p < last && p != cfg.entry() && dom.dominates(b, p))
+            {
+                if(latch == DominatorTree::none || p > latch)
+                    latch = p;
+            }
+        }
+
+        if(latch == DominatorTree::none)
+            return false;
+
+        auto& latch_block = cfg.block(latch);
+        auto follow = latch + 1;
+
+        // WHILE cond / body / GOTO header
+        if(header.exit == BasicBlock::Exit::GotoIfFalse && header.target == follow
+        && latch > b && latch_block.exit == BasicBlock::Exit::Goto && latch_block.target == b)
+        {
+            auto conds = find_conditions(b);
+            if(conds && first_non_label(b) == (conds->andor != DominatorTree::none? conds->andor : conds->first))
+            {
+                this->loop_done[b] = true;
+
+                emit_labels(b);
+                emit_conditions(Statement::Type::While, *conds);
+                this->consumed[latch_block.end - 1] = true;
+                structure_range(b + 1, follow, JumpTargets { follow, b });
+                emit(Statement::Type::EndWhile);
+
+                b = follow;
+                return true;
+            }
+        }
+
+        // SET var 0 / body / ADD var 1 / IS var >= times / GOTO_IF_FALSE header
+        if(latch_block.exit == BasicBlock::Exit::GotoIfFalse && latch_block.target == b
+        && latch_block.end >= latch_block.begin + 3
+        && !this->output.empty() && this->output.back().type == Statement::Type::Data
+        && this->output.back().index + 1 == header.begin)
+        {
+            auto gif = latch_block.end - 1;
+            auto set = cfg.command_at(this->output.back().index);
+            auto add = cfg.command_at(gif - 2);
+            auto cmp = cfg.command_at(gif - 1);
+
+            auto is_var = [](const ArgVariant2& arg) { return is<DecompiledVar>(arg); };
+            auto same_var = [](const ArgVariant2& a, const ArgVariant2& b) {
+                return is<DecompiledVar>(a) && is<DecompiledVar>(b) && get<DecompiledVar>(a) == get<DecompiledVar>(b);
+            };
+
+            if(set && add && cmp
+            && !set->not_flag && !add->not_flag && !cmp->not_flag
+            && set->args.size() == 2 && add->args.size() == 2 && cmp->args.size() == 2
+            && commands.is_alternator(set->command, commands.set)
+            && commands.is_alternator(add->command, commands.add_thing_to_thing)
+            && commands.is_alternator(cmp->command, commands.is_thing_greater_or_equal_to_thing)
+            && is_var(set->args[0]) && get_imm32(set->args[1]) == 0
+            && same_var(add->args[0], set->args[0]) && get_imm32(add->args[1]) == 1
+            && same_var(cmp->args[0], set->args[0]))
+            {
+                this->loop_done[b] = true;
+
+                this->consumed[this->output.back().index] = true;
+                this->output.pop_back();
+
+                this->consumed[gif - 2] = true;
+                this->consumed[gif - 1] = true;
+                this->consumed[gif] = true;
+
+                // CONTINUE jumps into the ADD, which needs to begin the latch for that.
+                auto continue_target = (latch != b && first_non_label(latch) == gif - 2? latch : DominatorTree::none);
+
+                emit(Statement::Type::Repeat, gif - 1);
+                structure_range(b, follow, JumpTargets { follow, continue_target });
+                emit(Statement::Type::EndRepeat);
+
+                b = follow;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    /// IF cond / then / [GOTO end / else:] else / end:
+    bool try_if(size_t& b, size_t last, const JumpTargets& jumps)
+    {
+        auto& block = cfg.block(b);
+        if(block.exit != BasicBlock::Exit::GotoIfFalse || block.target == DominatorTree::none)
+            return false;
+
+        auto false_target = block.target;
+        if(false_target <= b || false_target > last)
+            return false;
+
+        auto conds = find_conditions(b);
+        if(!conds)
+            return false;
+
+        // The end of the statement is where both branches meet, i.e. the immediate post-dominator. When that isn't
+        // the false branch, the then branch must jump over the else branch for this to be a IF/ELSE.
+        auto follow = cfg.post_dominators().idom(b);
+        size_t else_end = DominatorTree::none;
+
+        if(follow != false_target && false_target - 1 > b)
+        {
+            auto& then_last = cfg.block(false_target - 1);
+            if(then_last.exit == BasicBlock::Exit::Goto
+            && then_last.target != DominatorTree::none
+            && then_last.target > false_target && then_last.target <= last
+            && then_last.target != jumps.break_target
+            && then_last.target != jumps.continue_target
+            && !this->consumed[then_last.end - 1])
+            {
+                else_end = then_last.target;
+            }
+        }
+
+        emit_block(b, conds->andor != DominatorTree::none? conds->andor : conds->first, jumps);
+        emit_conditions(Statement::Type::If, *conds);
+
+        if(else_end == DominatorTree::none)
+        {
+            structure_range(b + 1, false_target, jumps);
+            emit(Statement::Type::EndIf);
+            b = false_target;
+        }
+        else
+        {
+            this->consumed[cfg.block(false_target - 1).end - 1] = true;
+            structure_range(b + 1, false_target, jumps);
+            emit(Statement::Type::Else);
+            structure_range(false_target, else_end, jumps);
+            emit(Statement::Type::EndIf);
+            b = else_end;
+        }
+
+        return true;
+    }
+
+    /// SWITCH_START var num_cases has_default default_label (value label)... [SWITCH_CONTINUED (value label)...]
+    bool try_switch(size_t& b, size_t last, const JumpTargets& jumps)
+    {
+        auto& block = cfg.block(b);
+        if(block.exit != BasicBlock::Exit::Switch)
+            return false;
+
+        // Find the SWITCH_START of the trailing switch commands.
+        size_t start = block.end - 1;
+        while(start > block.begin && is_command(start, SpecialCommand::SwitchContinued))
+            --start;
+        if(!is_command(start, SpecialCommand::SwitchStart))
+            return false;
+
+        auto& switch_start = *cfg.command_at(start);
+        if(switch_start.args.size() < 4)
+            return false;
+
+        auto opt_num_cases = get_imm32(switch_start.args[1]);
+        auto opt_has_default = get_imm32(switch_start.args[2]);
+        if(!opt_num_cases || !opt_has_default || *opt_num_cases < 0)
+            return false;
+
+        auto block_of_label = [&](const ArgVariant2& arg) -> size_t {
+            auto opt_offset = cfg.label_offset(arg);
+            auto opt_block = opt_offset? cfg.block_at(*opt_offset) : nullopt;
+            return opt_block? *opt_block : DominatorTree::none;
+        };
+
+        // (value, block) of the table entries, including the ones filling the unused slots.
+        std::vector<std::pair<int32_t, size_t>> entries;
+        for(size_t i = start; i < block.end; ++i)
+        {
+            auto& ccmd = *cfg.command_at(i);
+            for(size_t k = (i == start? 4 : 0); k + 1 < ccmd.args.size(); k += 2)
+            {
+                auto opt_value = get_imm32(ccmd.args[k]);
+                if(!opt_value)
+                    return false;
+                entries.emplace_back(*opt_value, block_of_label(ccmd.args[k+1]));
+            }
+        }
+
+        size_t num_cases = size_t(*opt_num_cases);
+        bool has_default = (*opt_has_default != 0);
+        if(num_cases > entries.size() || num_cases == 0)
+            return false;
+
+        auto default_block = block_of_label(switch_start.args[3]);
+
+        size_t follow;
+        if(!has_default)
+            follow = default_block;
+        else if(entries.size() > num_cases)
+            follow = entries[num_cases].second;
+        else
+            follow = cfg.post_dominators().idom(b);
+
+        if(follow == DominatorTree::none || follow <= b || follow > last)
+            return false;
+
+        std::vector<size_t> targets;
+        for(size_t i = 0; i < num_cases; ++i)
+            targets.emplace_back(entries[i].second);
+        if(has_default)
+            targets.emplace_back(default_block);
+
+        std::sort(targets.begin(), targets.end());
+        targets.erase(std::unique(targets.begin(), targets.end()), targets.end());
+
+        if(targets.front() != b + 1 || targets.back() >= follow)
+            return false;
+
+        emit_block(b, start, jumps);
+        emit(Statement::Type::Switch, start);
+        for(size_t i = start; i < block.end; ++i)
+            this->consumed[i] = true;
+
+        std::vector<std::pair<int32_t, size_t>> cases(entries.begin(), entries.begin() + num_cases);
+        std::sort(cases.begin(), cases.end());
+
+        for(size_t t = 0; t < targets.size(); ++t)
+        {
+            for(auto& c : cases)
+            {
+                if(c.second == targets[t])
+                    emit(Statement::Type::Case, DominatorTree::none, c.first);
+            }
+
+            if(has_default && default_block == targets[t])
+                emit(Statement::Type::Default);
+
+            auto body_end = (t + 1 < targets.size()? targets[t+1] : follow);
+            structure_range(targets[t], body_end, JumpTargets { follow, jumps.continue_target });
+        }
+
+        emit(Statement::Type::EndSwitch);
+
+        b = follow;
+        return true;
+    }
+
+    /// Finds the conditions before the `GOTO_IF_FALSE` at the end of block `b`.
+    optional<ConditionList> find_conditions(size_t b) const
+    {
+        auto& block = cfg.block(b);
+        auto gif = block.end - 1;
+
+        for(size_t i = gif; i-- > block.begin && gif - i <= 9; )
+        {
+            if(is<DecompiledLabelDef>(data[i].data))
+                break;
+
+            if(is_command(i, SpecialCommand::Andor))
+            {
+                auto& andor = *cfg.command_at(i);
+                auto opt_value = andor.args.empty()? nullopt : get_imm32(andor.args[0]);
+                if(!opt_value)
+                    return nullopt;
+
+                size_t num_conds;
+                bool is_or = false;
+                if(*opt_value == 0)
+                    num_conds = 1;
+                else if(*opt_value >= 1 && *opt_value <= 7)
+                    num_conds = size_t(*opt_value) + 1;
+                else if(*opt_value >= 21 && *opt_value <= 27)
+                    num_conds = size_t(*opt_value) - 19, is_or = true;
+                else
+                    return nullopt;
+
+                if(i + 1 + num_conds != gif)
+                    return nullopt;
+
+                return ConditionList { i, i + 1, gif, is_or };
+            }
+        }
+
+        // A single condition without a ANDOR (e.g. on -foptimize-andor).
+        if(gif > block.begin && cfg.command_at(gif - 1))
+            return ConditionList { DominatorTree::none, gif - 1, gif, false };
+
+        return nullopt;
+    }
+
+    void emit_conditions(Statement::Type type, const ConditionList& conds)
+    {
+        if(conds.andor != DominatorTree::none)
+            this->consumed[conds.andor] = true;
+        this->consumed[conds.last] = true;
+
+        emit(type, conds.first);
+        for(size_t i = conds.first + 1; i < conds.last; ++i)
+            emit(conds.is_or? Statement::Type::Or : Statement::Type::And, i);
+    }
+
+    /// Removes the labels which are no longer referenced after structuring.
+    void remove_unused_labels()
+    {
+        std::set<size_t> referenced, needed;
+
+        for(size_t i = 0; i < this->data.size(); ++i)
+        {
+            if(auto opt_ccmd = cfg.command_at(i))
+            {
+                for(size_t k = 0; k < opt_ccmd->args.size(); ++k)
+                {
+                    auto opt_arg = opt_ccmd->command.arg(k);
+                    if(opt_arg && opt_arg->type == ArgType::Label)
+                    {
+                        if(auto opt_offset = cfg.label_offset(opt_ccmd->args[k]))
+                        {
+                            referenced.emplace(*opt_offset);
+                            if(!this->consumed[i])
+                                needed.emplace(*opt_offset);
+                        }
+                    }
+                }
+            }
+        }
+
+        auto is_unused = [&](const Statement& st)
+        {
+            if(st.type != Statement::Type::Data || !is<DecompiledLabelDef>(data[st.index].data))
+                return false;
+
+            // Labels not referenced by this segment are used by other segments.
+            auto offset = data[st.index].offset;
+            return referenced.count(offset) && !needed.count(offset) && !cfg.is_external_label(offset);
+        };
+
+        this->output.erase(std::remove_if(this->output.begin(), this->output.end(), is_unused), this->output.end());
+    }
+
+    size_t first_non_label(size_t b) const
+    {
+        auto& block = cfg.block(b);
+        size_t i = block.begin;
+        while(i < block.end && is<DecompiledLabelDef>(data[i].data))
+            ++i;
+        return i;
+    }
+
+    bool is_command(size_t index, SpecialCommand special) const
+    {
+        auto opt_ccmd = cfg.command_at(index);
+        return opt_ccmd && opt_ccmd->command.special == special;
+    }
+
+    void emit(Statement::Type type, size_t index = DominatorTree::none, int32_t value = 0)
+    {
+        this->output.emplace_back(Statement { type, index, value });
+    }
+
+private:
+    const ControlFlowGraph&             cfg;
+    const Commands&                     commands;
+    const std::vector<DecompiledData>&  data;
+    std::vector<bool>                   consumed;   //< Pseudo-instructions turned into structure.
+    std::vector<bool>                   loop_done;  //< Loop headers already structured.
+    std::vector<Statement>              output;
+};
+}
+
+std::vector<StructuredStatement> structure_segment(const ControlFlowGraph& cfg)
+{
+    return Structurer(cfg).run();
+}
+
+std::vector<std::vector<StructuredStatement>> structure_segments(const std::vector<const std::vector<DecompiledData>*>& segments,
+                                                                 const Commands& commands)
+{
+    std::vector<std::vector<StructuredStatement>> results(segments.size());
+
+    if(segments.empty())
+        return results;
+
+    // Positive labels in the other segments refer to the main segment.
+    std::set<size_t> main_external_labels;
+    for(size_t i = 1; i < segments.size(); ++i)
+    {
+        for(auto& d : *segments[i])
+        {
+            if(is<DecompiledCommand>(d.data))
+            {
+                auto& ccmd = get<DecompiledCommand>(d.data);
+                for(size_t k = 0; k < ccmd.args.size(); ++k)
+                {
+                    auto opt_arg = ccmd.command.arg(k);
+                    auto opt_value = get_imm32(ccmd.args[k]);
+                    if(opt_arg && opt_arg->type == ArgType::Label && opt_value && *opt_value >= 0)
+                        main_external_labels.emplace(size_t(*opt_value));
+                }
+            }
+        }
+    }
+
+    const std::set<size_t> no_external_labels;
+    std::atomic<size_t> next_segment(0);
+
+    auto worker = [&]
+    {
+        for(size_t i; (i = next_segment++) < segments.size(); )
+        {
+            ControlFlowGraph cfg(*segments[i], commands, i == 0, i == 0? main_external_labels : no_external_labels);
+            results[i] = structure_segment(cfg);
+        }
+    };
+
+    size_t num_threads = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), segments.size());
+
+    std::vector<std::thread> threads;
+    threads.reserve(num_threads - 1);
+    for(size_t i = 1; i < num_threads; ++i)
+        threads.emplace_back(worker);
+
+    worker();
+
+    for(auto& thread : threads)
+        thread.join();
+
+    return results;
+}
+
+void decompile_gta3script(const std::vector<StructuredStatement>& statements, const std::vector<DecompiledData>& data,
+                          DecompilerIR2& context, const std::function<void(const std::string&)>& callback)
+{
+    size_t depth = 0;
+    std::string line;
+
+    auto print = [&](size_t depth, const char* keyword, optional<std::string> rest)
+    {
+        line.assign(depth * 4, ' ');
+        line += keyword;
+        if(rest)
+        {
+            if(!line.empty() && *keyword) line.push_back(' ');
+            line += *rest;
+        }
+        callback(line);
+    };
+
+    auto command = [&](size_t index) {
+        return ::decompile_data(data[index], context);
+    };
+
+    auto argument = [&](size_t index, size_t arg) {
+        return ::decompile_data(get<DecompiledCommand>(data[index].data).args[arg], context);
+    };
+
+    for(auto& st : statements)
+    {
+        switch(st.type)
+        {
+            case StructuredStatement::Type::Data:
+                if(is<DecompiledLabelDef>(data[st.index].data))
+                    print(0, "", command(st.index));
+                else
+                    print(depth, "", command(st.index));
+                break;
+            case StructuredStatement::Type::If:
+                print(depth++, "IF", command(st.index));
+                break;
+            case StructuredStatement::Type::While:
+                print(depth++, "WHILE", command(st.index));
+                break;
+            case StructuredStatement::Type::And:
+                print(depth - 1, "AND", command(st.index));
+                break;
+            case StructuredStatement::Type::Or:
+                print(depth - 1, "OR", command(st.index));
+                break;
+            case StructuredStatement::Type::Else:
+                print(depth - 1, "ELSE", nullopt);
+                break;
+            case StructuredStatement::Type::EndIf:
+                print(--depth, "ENDIF", nullopt);
+                break;
+            case StructuredStatement::Type::EndWhile:
+                print(--depth, "ENDWHILE", nullopt);
+                break;
+            case StructuredStatement::Type::Repeat:
+                print(depth++, "REPEAT", argument(st.index, 1) + " " + argument(st.index, 0));
+                break;
+            case StructuredStatement::Type::EndRepeat:
+                print(--depth, "ENDREPEAT", nullopt);
+                break;
+            case StructuredStatement::Type::Switch:
+                print(depth, "SWITCH", argument(st.index, 0));
+                depth += 2;
+                break;
+            case StructuredStatement::Type::Case:
+                print(depth - 1, "CASE", std::to_string(st.value));
+                break;
+            case StructuredStatement::Type::Default:
+                print(depth - 1, "DEFAULT", nullopt);
+                break;
+            case StructuredStatement::Type::EndSwitch:
+                depth -= 2;
+                print(depth, "ENDSWITCH", nullopt);
+                break;
+            case StructuredStatement::Type::Break:
+                print(depth, "BREAK", nullopt);
+                break;
+            case StructuredStatement::Type::Continue:
+                print(depth, "CONTINUE", nullopt);
+                break;
+            default:
+                Unreachable();
+        }
+    }
+}
@@ -0,0 +1,61 @@
+///
+/// GTA3script Decompiler
+///
+/// Structures the flat data given by the disassembler back into GTA3script statements. That is, IF/ELSE, WHILE,
+/// REPEAT and SWITCH, with their ANDOR condition lists and the BREAK/CONTINUE inside them.
+///
+/// The structuring is driven by the control flow graph of the segment (see *decompiler_cfg.hpp*): loops are natural
+/// loops (a back edge into a dominator), the end of a IF is its immediate post-dominator, and the layout of the code
+/// must match the one the compiler would give for the statement. Branches fitting none of those stay as labels and
+/// GOTOs, thus the output always keeps the control flow of the bytecode.
+///
+/// The arguments of the commands are still written in the IR2 notation (see *decompiler_ir2.hpp*), since the names
+/// of the variables are unknown.
+///
+#pragma once
+#include <stdinc.h>
+#include "decompiler_cfg.hpp"
+#include "decompiler_ir2.hpp"
+
+struct StructuredStatement
+{
+    enum class Type : uint8_t
+    {
+        Data,       //< A label or command of the disassembled data.
+        If,         //< `IF` with its first condition.
+        And,        //< Further condition of a `IF` or `WHILE`.
+        Or,         //< Ditto.
+        Else,
+        EndIf,
+        While,      //< `WHILE` with its first condition.
+        EndWhile,
+        Repeat,     //< `REPEAT` with the comparision that ends the loop.
+        EndRepeat,
+        Switch,     //< `SWITCH` with its `SWITCH_START`.
+        Case,
+        Default,
+        EndSwitch,
+        Break,
+        Continue,
+    };
+
+    Type    type;
+    size_t  index;  //< Index of the associated pseudo-instruction in the disassembled data, if any.
+    int32_t value;  //< Value of a `CASE`.
+};
+
+/// Structures the disassembled segment of the specified control flow graph.
+std::vector<StructuredStatement> structure_segment(const ControlFlowGraph& cfg);
+
+/// Builds the control flow graphs of the disassembled segments and structures them.
+///
+/// The first segment must be the main segment. Each segment is independent from the others, thus they are
+/// distributed over the available hardware threads.
+std::vector<std::vector<StructuredStatement>> structure_segments(const std::vector<const std::vector<DecompiledData>*>& segments,
+                                                                 const Commands& commands);
+
+/// Outputs the lines of structured GTA3script into `callback`.
+///
+/// The commands and labels are written by `context`, which must have been built from the same disassembled data.
+void decompile_gta3script(const std::vector<StructuredStatement>& statements, const std::vector<DecompiledData>& data,
+                          DecompilerIR2& context, const std::function<void(const std::string&)>& callback);
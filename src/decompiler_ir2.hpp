@@ -2,6 +2,7 @@
 ///
 /// IR2 is defined by https://gist.github.com/thelink2012/a60a06a581ea78558bd7b8427103609d
 ///
+#pragma once
 #include <stdinc.h>
 #include "disassembler.hpp"
 
@@ -2,6 +2,7 @@
 #include "disassembler.hpp"
 #include "program.hpp"
 #include "cdimage.hpp"
+#include "scm_header.hpp"
 
 optional<size_t> Disassembler::data_index(uint32_t local_offset) const
 {
@@ -162,9 +163,8 @@ optional<size_t> Disassembler::explore_opcode(size_t op_offset, const Command& c
     bool stop_it = false;
     size_t argument_id = 0;
 
-    auto& commands = this->program.commands;
-    bool is_switch_start     = commands.equal(command, commands.switch_start);
-    bool is_switch_continued = commands.equal(command, commands.switch_continued);
+    bool is_switch_start     = (command.special == SpecialCommand::SwitchStart);
+    bool is_switch_continued = (command.special == SpecialCommand::SwitchContinued);
 
     auto check_for_imm32 = [&](auto value, const Command::Arg& arg)
     {
@@ -375,28 +375,23 @@ optional<size_t> Disassembler::explore_opcode(size_t op_offset, const Command& c
     else if(this->type == Type::RecursiveTraversal)
     {
         // add next instruction as the next thing to be explored, if this isn't a instruction that
-        // terminates execution or jumps unconditionally to another offset.
-        // TODO would be nice if this was actually configurable.
-        if(!commands.equal(command, commands.goto_)
-        && !commands.equal(command, commands.return_)
-        && !commands.equal(command, commands.cleo_return)
-        && !commands.equal(command, commands.terminate_this_script)
-        && !commands.equal(command, commands.terminate_this_custom_script))
+        // terminates execution or jumps unconditionally to another offset (as given by its `Flow` in the config).
+        bool falls_through = command.falls_through();
+
+        if((is_switch_start || is_switch_continued) && this->switch_cases_left == 0)
         {
-            if((is_switch_start || is_switch_continued) && this->switch_cases_left == 0)
-            {
-                // we are at the last SWITCH_START/SWITCH_CONTINUED command, after this, the game will take a branch.
-            }
-            else
-            {
-                this->to_explore.emplace(offset);
-            }
+            // we are at the last SWITCH_START/SWITCH_CONTINUED command, after this, the game will take a branch.
+            falls_through = false;
         }
+
+        if(falls_through)
+            this->to_explore.emplace(offset);
     }
 
     // mark this area as explored
     for(size_t i = op_offset; i < offset; ++i)
         this->offset_explored[i] = true;
+    this->opcode_offsets[op_offset] = true;
 
     ++this->hint_num_ops;
 
@@ -614,7 +609,7 @@ void Disassembler::disassembly(size_t from_offset)
             output.emplace_back(DecompiledLabelDef{ offset });
         }
 
-        if(this->offset_explored[offset])
+        if(this->opcode_offsets[offset])
         {
             output.emplace_back(opcode_to_data(offset));
             // offset was received by ref and mutated ^
@@ -624,12 +619,15 @@ void Disassembler::disassembly(size_t from_offset)
             auto begin_offset = offset++;
             for(; offset < bf.size; ++offset)
             {
-                // repeat this loop until a label offset or a explored offset is found, then break.
+                // repeat this loop until a label offset or a opcode offset is found, then break.
                 //
                 // if a label offset is found, it'll be added at the beggining of the outer for loop,
                 // and then (maybe) this loop will continue.
+                //
+                // explored offsets which aren't the beginning of a opcode may be found in ill-formed bytecode, where
+                // opcodes overlap each other. those are taken as data.
 
-                if(this->offset_explored[offset] || this->label_offsets.count(offset))
+                if(this->opcode_offsets[offset] || this->label_offsets.count(offset))
                     break;
             }
 
@@ -644,68 +642,44 @@ optional<DecompiledScmHeader> DecompiledScmHeader::from_bytecode(const void* byt
         || version == DecompiledScmHeader::Version::Miami
         || version == DecompiledScmHeader::Version::SanAndreas);
 
-    bool is_sa = (version == DecompiledScmHeader::Version::SanAndreas);
-
-    try
+    auto opt_view = ScmHeaderView::from_bytecode(bytecode, bytecode_size, ScmHeaderLayout::of(version));
+    if(!opt_view)
     {
-        BinaryFetcher bf { bytecode, bytecode_size };
+        // the header is incorrect or broken
+        return nullopt;
+    }
 
-        auto seg1_offset = 0u;
-        auto seg2_offset = bf.fetch_u32(seg1_offset + 3).value();
-        auto seg3_offset = bf.fetch_u32(seg2_offset + 3).value();
-        auto seg4_offset = bf.fetch_u32(seg3_offset + 3).value();
-        auto code_offset = seg4_offset;
+    auto& view = *opt_view;
 
-        uint32_t size_globals = seg2_offset;
+    // the first model is unused
+    std::vector<std::string> models;
+    size_t num_models = view.count(ScmHeaderField::ModelName);
+    models.reserve(num_models? num_models - 1 : 0);
+    for(size_t i = 1; i < num_models; ++i)
+        models.emplace_back(view.chars(ScmHeaderField::ModelName, i).to_string());
 
-        std::vector<std::string> models;
-        size_t num_models = static_cast<size_t>((std::max)(1u, bf.fetch_u32(seg2_offset + 8 + 0).value()) - 1);
-        models.reserve(num_models);
-        for(size_t i = 0; i < num_models; ++i)
-        {
-            char buffer[32];
-            bf.fetch_chars(seg2_offset + 8 + 4 + 24 + (24 * i), 24, buffer).value();
-            models.emplace_back(buffer);
-        }
-
-        auto main_size    = bf.fetch_u32(seg3_offset + 8 + 0).value();
-        auto num_missions = bf.fetch_u16(seg3_offset + 8 + 8).value();
-        size_t incr       = is_sa? 4 : 0; // increment for u32 (num vars used in mission)
-
-        std::vector<uint32_t> mission_offsets;
-        for(size_t i = 0; i < num_missions; ++i)
-        {
-            mission_offsets.emplace_back(bf.fetch_u32(seg3_offset + 8 + 8 + 4 + incr + (4*i)).value());
-        }
+    std::vector<uint32_t> mission_offsets;
+    mission_offsets.reserve(view.count(ScmHeaderField::MissionOffset));
+    for(size_t i = 0; i < view.count(ScmHeaderField::MissionOffset); ++i)
+        mission_offsets.emplace_back(view.value(ScmHeaderField::MissionOffset, i));
 
-        std::vector<StreamedScript> streamed_scripts;
-        if(is_sa)
+    std::vector<StreamedScript> streamed_scripts;
+    if(version == DecompiledScmHeader::Version::SanAndreas)
+    {
+        streamed_scripts.reserve(view.count(ScmHeaderField::StreamedName));
+        for(size_t i = 0; i < view.count(ScmHeaderField::StreamedName); ++i)
         {
-            auto seg5_offset = bf.fetch_u32(seg4_offset + 3).value();
-            auto seg6_offset = bf.fetch_u32(seg5_offset + 3).value();
-            auto seg7_offset = bf.fetch_u32(seg6_offset + 3).value();
-            code_offset = seg7_offset;
-
-            auto num_scripts = bf.fetch_u32(seg4_offset + 8 + 4).value();
-            for(size_t i = 0; i < num_scripts; ++i)
-            {
-                char buffer[24];
-                auto name = bf.fetch_chars(seg4_offset + 8 + 4 + 4 + (28 * i), 20, buffer).value();
-                auto size = bf.fetch_u32(seg4_offset + 8 + 4 + 4 + (28 * i) + 20 + 4).value();
-                streamed_scripts.emplace_back(StreamedScript { buffer, size });
-            }
+            streamed_scripts.emplace_back(StreamedScript {
+                view.chars(ScmHeaderField::StreamedName, i).to_string(),
+                view.value(ScmHeaderField::StreamedSize, i),
+            });
         }
-
-        return DecompiledScmHeader {
-            version, code_offset, size_globals,
-            std::move(models), main_size, std::move(mission_offsets), std::move(streamed_scripts)
-        };
-    }
-    catch(const bad_optional_access&)
-    {
-        // the header is incorrect or broken
-        return nullopt;
     }
+
+    return DecompiledScmHeader {
+        version, view.size(), view.value(ScmHeaderField::GlobalsSize),
+        std::move(models), view.value(ScmHeaderField::MainSize), std::move(mission_offsets), std::move(streamed_scripts)
+    };
 }
 
 auto mission_scripts_fetcher(const void* bytecode_, size_t bytecode_size, const DecompiledScmHeader& header, ProgramContext& program)
@@ -723,7 +697,7 @@ auto mission_scripts_fetcher(const void* bytecode_, size_t bytecode_size, const
     {
         size_t mission_offset = header.mission_offsets[i];
 
-        if(mission_offset < header.main_size)
+        if(mission_offset < header.main_size || mission_offset > bytecode_size)
             program.fatal_error(nocontext, "corrupted scm header");
 
         auto it = std::lower_bound(mission_offsets_sorted.begin(), mission_offsets_sorted.end(), mission_offset);
@@ -741,44 +715,32 @@ auto mission_scripts_fetcher(const void* bytecode_, size_t bytecode_size, const
     return mission_segments;
 }
 
-auto streamed_scripts_fetcher(const void* img_bytes_, size_t img_size, const DecompiledScmHeader& header, ProgramContext& program)
+auto streamed_scripts_fetcher(const void* img_bytes, size_t img_size, const DecompiledScmHeader& header, ProgramContext& program)
     -> std::vector<BinaryFetcher>
 {
-    const uint8_t* img_bytes = reinterpret_cast<const uint8_t*>(img_bytes_);
-
     std::vector<BinaryFetcher> scripts;
 
-    if(img_size < sizeof(CdHeader))
-        program.fatal_error(nocontext, "corrupted img file");
-
-    auto& cdheader = reinterpret_cast<const CdHeader&>(*img_bytes);
-    if(memcmp(cdheader.magic, "VER2", 4) != 0 || img_size < cdheader.num_entries * sizeof(CdEntry))
+    auto opt_image = CdImage::from_memory(img_bytes, img_size);
+    if(!opt_image)
         program.fatal_error(nocontext, "corrupted img file");
 
-    auto entries = reinterpret_cast<const CdEntry*>(img_bytes + sizeof(CdHeader));
-    auto entries_end = entries + cdheader.num_entries;
+    scripts.reserve(header.streamed_scripts.size());
 
     for(auto& script_pair : header.streamed_scripts)
     {
         auto filename = script_pair.name + ".scm";
 
-        auto it = std::find_if(entries, entries_end, [&](const CdEntry& entry) {
-            // TODO entry.filenames mayn't have a null terminator!
-            return iequal_to()(filename, entry.filename);
-        });
-
-        if(it != entries_end)
+        if(auto entry = opt_image->find(filename))
         {
-            auto offset = size_t(it->offset) * 2048;
-            auto bsize  = size_t(it->streaming_size) * 2048; // <- this size contains useless 00s
-            auto size   = script_pair.size;                  // <- but this size doesn't
+            auto bsize  = entry->size;          // <- this size contains useless 00s
+            auto size   = script_pair.size;     // <- but this size doesn't
 
-            if(offset + bsize > img_size)
+            if(!opt_image->fetch(*entry, bsize))
                 program.error(nocontext, "entry for '{}' in img file is is sparse", filename);
-            else if(offset + size > img_size)
-                program.error(nocontext, "size for entry '{}' in img file does not match the size in the scm header", filename);
+            else if(auto bf = opt_image->fetch(*entry, size))
+                scripts.emplace_back(*bf);
             else
-                scripts.emplace_back(BinaryFetcher { img_bytes + offset, size });
+                program.error(nocontext, "size for entry '{}' in img file does not match the size in the scm header", filename);
         }
         else
         {
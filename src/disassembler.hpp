@@ -160,6 +160,9 @@ private:
     /// A bitset of the offsets explored and unexplored. Explored offsets are confirmed to be code.
     dynamic_bitset      offset_explored;
 
+    /// A bitset of the explored offsets in which a opcode begins.
+    dynamic_bitset      opcode_offsets;
+
     /// LIFO structure of offsets [mostly confirmed to be code] which still needs to be explored.
     std::stack<size_t>  to_explore;
 
@@ -193,6 +196,7 @@ public:
     {
         // This constructor **ALWAYS** run, put all common initialization here.
         this->offset_explored.resize(bf.size);
+        this->opcode_offsets.resize(bf.size);
     }
 
     /// Constructs assuming `*this` to be the main code segment.
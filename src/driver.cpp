@@ -0,0 +1,677 @@
+#include <stdinc.h>
+#include "driver.hpp"
+#include "system.hpp"
+#include "debug_map.hpp"
+#include "cpp/argv.hpp"
+
+static bool parse_args(char**& argv, fs::path& input, fs::path& output, DataInfo& data, ConfigInfo& conf, Options& options,
+                       const TextSink& log)
+{
+    try
+    {
+        bool flag;
+        int32_t temp_i32;
+
+        while(*argv)
+        {
+            if(**argv != '-')
+            {
+                if(!input.empty())
+                {
+                    log("gta3sc: error: input file appears twice");
+                    return false;
+                }
+
+                input = *argv;
+                ++argv;
+            }
+            else if(optget(argv, "-h", "--help", 0))
+            {
+                options.help = true;
+                return true;
+            }
+            else if(optget(argv, nullptr, "--version", 0))
+            {
+                options.version = true;
+                return true;
+            }
+            else if(const char* o = optget(argv, "-o", nullptr, 1))
+            {
+                output = o;
+            }
+            else if(optget(argv, nullptr, "-pedantic-errors", 0))
+            {
+                options.pedantic = true;
+                options.pedantic_errors = true;
+            }
+            else if(optget(argv, nullptr, "-pedantic", 0))
+            {
+                options.pedantic = true;
+            }
+            else if(optget(argv, nullptr, "--guesser", 0))
+            {
+                options.guesser = true;
+            }
+            else if(const char* info = optget(argv, nullptr, "--expect-var", 1))
+            {
+                if(!options.push_expect_var(info))
+                {
+                    log("gta3sc: error: failed to parse --expect-var entry");
+                    return false;
+                }
+            }
+            else if(optget(argv, nullptr, "--recursive-traversal", 0))
+            {
+                options.linear_sweep = false;
+            }
+            else if(const char* name = optget(argv, nullptr, "--config", 1))
+            {
+                // avoid infinite recursion of parse_args(...) calls
+                if(iequal_to()(conf.config_name, name))
+                    continue;
+
+                conf.config_name = name;
+
+                if(auto opt_cmdline = read_file_utf8(config_path() / conf.config_name / "commandline.txt"))
+                {
+                    auto& cmdline = *opt_cmdline;
+                    small_vector<char*, 128> args;
+
+                    auto it = !cmdline.empty()? &cmdline[0] : nullptr;
+                    auto end = it + cmdline.size();
+                    for(; it != end; )
+                    {
+                        it = std::find_if_not(it, end, ::isspace);
+                        args.emplace_back(it);
+                        it = std::find_if(it, end, ::isspace);
+                        if(it != end) *it++ = '\0';
+                    }
+                    args.emplace_back(nullptr);
+
+                    char** argv2 = args.data();
+                    if(!parse_args(argv2, input, output, data, conf, options, log))
+                        return false;
+                }
+                else
+                {
+                    log("gta3sc: error: config path is missing commandline.txt file");
+                    return false;
+                }
+            }
+            else if(const char* path = optget(argv, nullptr, "--add-config", 1))
+            {
+                conf.add_config_files.emplace_back(path);
+            }
+            else if(const char* path = optget(argv, nullptr, "--datadir", 1))
+            {
+                data.datadir = path;
+            }
+            else if(const char* name = optget(argv, nullptr, "--levelfile", 1))
+            {
+                data.levelfile = name;
+            }
+            else if(const char* name = optget(argv, nullptr, "--error-format", 1))
+            {
+                if(!strcmp(name, "default"))
+                    options.error_format = Options::ErrorFormat::Default;
+                else if(!strcmp(name, "json"))
+                    options.error_format = Options::ErrorFormat::JSON;
+                else
+                {
+                    log("gta3sc: error: invalid error-format");
+                    return false;
+                }
+            }
+            else if(const char* format = optget(argv, nullptr, "--frame-report", 1))
+            {
+                if(!strcmp(format, "table"))
+                    options.frame_report = Options::ReportFormat::Table;
+                else if(!strcmp(format, "json"))
+                    options.frame_report = Options::ReportFormat::JSON;
+                else
+                {
+                    log("gta3sc: error: invalid frame-report format");
+                    return false;
+                }
+            }
+            else if(const char* format = optget(argv, nullptr, "--shared-globals-report", 1))
+            {
+                if(!strcmp(format, "table"))
+                    options.shared_globals_report = Options::ReportFormat::Table;
+                else if(!strcmp(format, "json"))
+                    options.shared_globals_report = Options::ReportFormat::JSON;
+                else
+                {
+                    log("gta3sc: error: invalid shared-globals-report format");
+                    return false;
+                }
+            }
+            else if(const char* path = optget(argv, nullptr, "--layout-lock", 1))
+            {
+                options.layout_lock = fs::u8path(path);
+            }
+            else if(const char* ver = optget(argv, nullptr, "-mheader", 1))
+            {
+                if(!strcmp(ver, "gta3"))
+                    options.header = Options::HeaderVersion::GTA3;
+                else if(!strcmp(ver, "gtavc"))
+                    options.header = Options::HeaderVersion::GTAVC;
+                else if(!strcmp(ver, "gtasa"))
+                    options.header = Options::HeaderVersion::GTASA;
+                else
+                {
+                    log("gta3sc: error: invalid header version, must be 'gta3', 'gtavc' or 'gtasa'");
+                    return false;
+                }
+            }
+            else if(optflag(argv, "-mno-header", nullptr))
+            {
+                options.headerless = true;
+            }
+            else if(optflag(argv, "-moatc", &flag))
+            {
+                options.oatc = flag;
+            }
+            else if(optflag(argv, "-mq11.4", &flag))
+            {
+                options.use_half_float = flag;
+            }
+            else if(optflag(argv, "-mtyped-text-label", &flag))
+            {
+                options.has_text_label_prefix = flag;
+            }
+            else if(optflag(argv, "-moptimize-andor", &flag))
+            {
+                options.optimize_andor = flag;
+            }
+            else if(optflag(argv, "-moptimize-zero", &flag))
+            {
+                options.optimize_zero_floats = flag;
+            }
+            else if(optget(argv, nullptr, "-O", 0))
+            {
+                options.optimize_andor = true;
+                options.optimize_zero_floats = true;
+            }
+            else if(optflag(argv, "-fentity-tracking", &flag))
+            {
+                options.entity_tracking = flag;
+            }
+            else if(optflag(argv, "-fscript-name-check", &flag))
+            {
+                options.script_name_check = flag;
+            }
+            else if(optflag(argv, "-frelax-not", &flag))
+            {
+                options.relax_not = flag;
+            }
+            else if(optflag(argv, "-fswitch", &flag))
+            {
+                options.fswitch = flag;
+            }
+            else if(optflag(argv, "-fbreak-continue", nullptr))
+            {
+                options.allow_break_continue = true;
+            }
+            else if(optflag(argv, "-fscope-then-label", &flag))
+            {
+                options.scope_then_label = flag;
+            }
+            else if(optflag(argv, "-funderscore-idents", &flag))
+            {
+                options.allow_underscore_identifiers = flag;
+            }
+            else if(optflag(argv, "-farrays", &flag))
+            {
+                options.farrays = flag;
+            }
+            else if(optflag(argv, "-fconst", &flag))
+            {
+                options.fconst = flag;
+            }
+            else if(optflag(argv, "-fstreamed-scripts", &flag))
+            {
+                options.streamed_scripts = flag;
+            }
+            else if(optflag(argv, "-ftext-label-vars", &flag))
+            {
+                options.text_label_vars = flag;
+            }
+            else if(optflag(argv, "-fskip-cutscene", &flag))
+            {
+                options.skip_cutscene = flag;
+            }
+            else if(optflag(argv, "-mlocal-offsets", nullptr))
+            {
+                options.use_local_offsets = true;
+            }
+            else if(optint(argv, "-ftimer-index", &options.timer_index)) {}
+            else if(optint(argv, "-flocal-var-limit", &options.local_var_limit)) {}
+            else if(optint(argv, "-fmission-var-limit", &temp_i32))
+            {
+                options.mission_var_limit = temp_i32 < 0? nullopt : optional<uint32_t>(temp_i32);
+            }
+            else if(optint(argv, "-fmission-var-begin", &temp_i32))
+            {
+                options.mission_var_begin = std::max(0, temp_i32);
+            }
+            else if(optint(argv, "-fswitch-case-limit", &temp_i32))
+            {
+                options.switch_case_limit = temp_i32 < 0? nullopt : optional<uint32_t>(temp_i32);
+            }
+            else if(optint(argv, "-farray-elem-limit", &temp_i32))
+            {
+                options.array_elem_limit = temp_i32 < 0? nullopt : optional<uint32_t>(temp_i32);
+            }
+            else if(optint(argv, "-fgosub-depth-limit", &temp_i32))
+            {
+                options.gosub_depth_limit = temp_i32 < 0? nullopt : optional<uint32_t>(temp_i32);
+            }
+            else if(optint(argv, "-fmax-nodes", &temp_i32))
+            {
+                options.max_nodes = temp_i32 < 0? nullopt : optional<uint32_t>(temp_i32);
+            }
+            else if(optint(argv, "-fmax-nesting", &temp_i32))
+            {
+                options.max_nesting = temp_i32 < 0? nullopt : optional<uint32_t>(temp_i32);
+            }
+            else if(optint(argv, "-fmax-stage-time", &temp_i32))
+            {
+                options.max_stage_time = temp_i32 < 0? nullopt : optional<uint32_t>(temp_i32);
+            }
+            else if(optint(argv, "-fmax-memory", &temp_i32))
+            {
+                options.max_memory = temp_i32 < 0? nullopt : optional<uint32_t>(temp_i32);
+            }
+            else if(optflag(argv, "-fsyntax-only", nullptr))
+            {
+                options.fsyntax_only = true;
+            }
+            else if(optflag(argv, "-emit-ir2", nullptr))
+            {
+                options.emit_ir2 = true;
+            }
+            else if(optflag(argv, "-fcleo", nullptr))
+            {
+                options.cleo.emplace(0);
+            }
+            else if(optget(argv, nullptr, "--cs", 0))
+            {
+                options.cleo.emplace(0);
+                options.output_cleo = true;
+                options.mission_script = false;
+                options.headerless = true;
+                options.use_local_offsets = true;
+            }
+            else if(optget(argv, nullptr, "--cm", 0))
+            {
+                options.cleo.emplace(0);
+                options.output_cleo = true;
+                options.mission_script = true;
+                options.headerless = true;
+                options.use_local_offsets = true;
+            }
+            else if(optflag(argv, "-fmission-script", nullptr))
+            {
+                options.mission_script = true;
+            }
+            else if(optflag(argv, "-Werror", &flag))
+            {
+                options.warning_is_error = flag;
+            }
+            else if(optflag(argv, "-Wconflict-text-label-var", &flag))
+            {
+                options.warn_conflict_text_label_var = flag;
+            }
+            else if(optflag(argv, "-Wwait-free-loop", &flag))
+            {
+                options.warn_wait_free_loop = flag;
+            }
+            else if(optflag(argv, "-Wentity-leak", &flag))
+            {
+                options.warn_entity_leak = flag;
+            }
+            else if(optflag(argv, "-Wexpect-var", &flag))
+            {
+                options.warn_expect_var = flag;
+            }
+            else if(const char* value = optget(argv, nullptr, "-Wprecision-loss", 1))
+            {
+                float error;
+                auto end = value + strlen(value);
+                if(value == end || from_chars(value, end, error).ptr != end || !(error >= 0.0f))
+                {
+                    log(fmt::format("gta3sc: error: argument '-Wprecision-loss' expects a non-negative number, got '{}'", value));
+                    return false;
+                }
+                options.warn_precision_loss = error;
+            }
+            else if(optget(argv, "-g", nullptr, 0))
+            {
+                options.debug_map = true;
+            }
+            else if(optflag(argv, "-fconstant-checks", &flag))
+            {
+                options.constant_checks = flag;
+            }
+            else if(const char* name = optget(argv, "-D", "--define", 1))
+            {
+                options.define(name);
+            }
+            else if(const char* name = optget(argv, "-U", "--undefine", 1))
+            {
+                options.undefine(name);
+            }
+            else
+            {
+                log(fmt::format("gta3sc: error: unregonized argument '{}'", *argv));
+                return false;
+            }
+        }
+
+        return true;
+    }
+    catch(const invalid_opt& e)
+    {
+        log(fmt::format("gta3sc: error: {}", e.what()));
+        return false;
+    }
+}
+
+bool parse_invocation(char** argv, Invocation& invocation, const TextSink& log)
+{
+    if(*argv && **argv != '-')
+    {
+        if(!strcmp(*argv, "compile"))
+        {
+            ++argv;
+            invocation.action = Action::Compile;
+        }
+        else if(!strcmp(*argv, "decompile"))
+        {
+            ++argv;
+            invocation.action = Action::Decompile;
+        }
+        else if(!strcmp(*argv, "query-config-path"))
+        {
+            invocation.action = Action::QueryConfigPath;
+            return true;
+        }
+        else if(!strcmp(*argv, "query-models"))
+        {
+            ++argv;
+            invocation.action = Action::QueryModels;
+        }
+        else if(!strcmp(*argv, "symbolize"))
+        {
+            // symbolize <map or output> <offsets...>
+            invocation.action = Action::Symbolize;
+            for(++argv; *argv; ++argv)
+            {
+                if(invocation.input.empty())
+                    invocation.input = *argv;
+                else
+                    invocation.offsets.emplace_back(*argv);
+            }
+            return true;
+        }
+    }
+
+    return parse_args(argv, invocation.input, invocation.output, invocation.data, invocation.conf,
+                      invocation.options, log);
+}
+
+void rebase_invocation(Invocation& invocation, const fs::path& dir)
+{
+    auto rebase = [&](fs::path& path)
+    {
+        if(!path.empty() && !path.is_absolute())
+            path = dir / path;
+    };
+
+    if(invocation.action != Action::QueryModels)
+        rebase(invocation.input);
+
+    if(invocation.output != "-")
+        rebase(invocation.output);
+
+    rebase(invocation.data.datadir);
+
+    if(invocation.options.layout_lock)
+        rebase(*invocation.options.layout_lock);
+
+    for(auto& offset : invocation.offsets)
+    {
+        if(!offset.empty() && offset[0] == '@')
+        {
+            fs::path list = fs::u8path(offset.substr(1));
+            rebase(list);
+            offset = '@' + list.u8string();
+        }
+    }
+
+    for(auto& path : invocation.conf.add_config_files)
+    {
+        auto begin = path.begin();
+        if(begin != path.end() && (*begin == "." || *begin == ".."))
+            rebase(path);
+    }
+}
+
+bool validate_invocation(Invocation& invocation, const TextSink& log)
+{
+    auto& options = invocation.options;
+    auto& data = invocation.data;
+
+    if(invocation.input.empty())
+    {
+        log("gta3sc: error: no input file");
+        return false;
+    }
+
+    if(!needs_config(invocation))
+        return true;
+
+    if(invocation.conf.config_name.empty())
+    {
+        log("gta3sc: error: no game config specified [--config=<name>]");
+        return false;
+    }
+
+    if(invocation.action == Action::None)
+    {
+        std::string extension = invocation.input.extension().string();
+        if(iequal_to()(extension, ".sc"))
+            invocation.action = Action::Compile;
+        else if(iequal_to()(extension, ".scm"))
+            invocation.action = Action::Decompile;
+        else if(iequal_to()(extension, ".scc"))
+            invocation.action = Action::Decompile;
+        else if(iequal_to()(extension, ".cs"))
+            invocation.action = Action::Decompile;
+        else if(iequal_to()(extension, ".cm"))
+            invocation.action = Action::Decompile;
+        else
+        {
+            log("gta3sc: error: could not infer action from input extension (compile/decompile)");
+            return false;
+        }
+    }
+
+    if(invocation.action != Action::QueryModels)
+    {
+        if(!options.guesser && options.fswitch)
+        {
+            log("gta3sc: error: use of -fswitch only available in guesser mode [--guesser]");
+            return false;
+        }
+
+        if(!options.guesser && options.farrays)
+        {
+            log("gta3sc: error: use of -farrays only available in guesser mode [--guesser]");
+            return false;
+        }
+
+        if(!options.guesser && options.fconst)
+        {
+            log("gta3sc: error: use of -fconst only available in guesser mode [--guesser]");
+            return false;
+        }
+
+        if(!options.guesser && options.streamed_scripts)
+        {
+            log("gta3sc: error: use of -fstreamed_scripts only available in guesser mode [--guesser]");
+            return false;
+        }
+
+        if(!options.guesser && options.skip_cutscene)
+        {
+            log("gta3sc: error: use of -fskip-cutscene only available in guesser mode [--guesser]");
+            return false;
+        }
+    }
+
+    if(!data.datadir.empty() && data.levelfile.empty())
+    {
+        if(fs::exists(data.datadir / "gta.dat"))
+            data.levelfile = "gta.dat";
+        else if(fs::exists(data.datadir / "gta3.dat"))
+            data.levelfile = "gta3.dat";
+        else if(fs::exists(data.datadir / "gta_vc.dat"))
+            data.levelfile = "gta_vc.dat";
+        else
+        {
+            log(fmt::format("gta3sc: error: could not find level file (gta*.dat) in datadir '{}'",
+                            data.datadir.generic_u8string()));
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/// The config files of the base layer of the commands (i.e. without the `--add-config` files).
+static auto base_config_files(const Invocation& invocation) -> std::vector<fs::path>
+{
+    std::vector<fs::path> config_files;
+    config_files.reserve(6);
+
+    config_files.emplace_back(config_path() / "gta3sc.xml");
+    config_files.emplace_back("alternators.xml");
+    config_files.emplace_back("commands.xml");
+    config_files.emplace_back("constants.xml");
+    if(invocation.data.datadir.empty()) config_files.emplace_back("default.xml");
+    if(invocation.options.cleo) config_files.emplace_back("cleo.xml");
+
+    return config_files;
+}
+
+bool needs_config(const Invocation& invocation)
+{
+    return invocation.action != Action::Symbolize;
+}
+
+std::string base_config_key(const Invocation& invocation)
+{
+    std::string key = invocation.conf.config_name;
+    for(auto& path : base_config_files(invocation))
+    {
+        key.push_back('\n');
+        key += path.generic_u8string();
+    }
+    return key;
+}
+
+std::string config_key(const Invocation& invocation)
+{
+    std::string key = base_config_key(invocation);
+    for(auto& path : invocation.conf.add_config_files)
+    {
+        key.push_back('\n');
+        key += path.generic_u8string();
+    }
+
+    if(!invocation.data.datadir.empty())
+    {
+        key += "\n--datadir=";
+        key += (invocation.data.datadir / invocation.data.levelfile).generic_u8string();
+    }
+
+    return key;
+}
+
+auto load_base_commands(const Invocation& invocation) -> shared_ptr<const Commands>
+{
+    return std::make_shared<const Commands>(Commands::from_xml(invocation.conf.config_name,
+                                                               base_config_files(invocation)));
+}
+
+auto load_config(const Invocation& invocation, shared_ptr<const Commands> base) -> GameConfig
+{
+    GameConfig config;
+
+    if(!invocation.data.datadir.empty())
+    {
+        config.default_models = load_dat(invocation.data.datadir / "default.dat", true);
+        config.level_models   = load_dat(invocation.data.datadir / invocation.data.levelfile, false);
+    }
+
+    if(invocation.conf.add_config_files.empty() && config.default_models.empty())
+    {
+        config.commands = std::move(base);
+    }
+    else
+    {
+        config.commands = std::make_shared<const Commands>(Commands::overlay(std::move(base),
+                                                                             invocation.conf.config_name,
+                                                                             invocation.conf.add_config_files,
+                                                                             config.default_models));
+    }
+
+    return config;
+}
+
+auto load_config(const Invocation& invocation) -> GameConfig
+{
+    return load_config(invocation, load_base_commands(invocation));
+}
+
+int run_invocation(const Invocation& invocation, const GameConfig& config,
+                   const TextSink& stdout_sink, const TextSink& log)
+{
+    if(invocation.action == Action::Symbolize)
+        return symbolize(invocation.input, invocation.offsets, stdout_sink, log);
+
+    ProgramContext program(invocation.options, config.commands, log);
+    program.setup_models(config.default_models, config.level_models);
+
+    switch(invocation.action)
+    {
+        case Action::Compile:
+            return compile(invocation.input, invocation.output, program, stdout_sink);
+        case Action::Decompile:
+            return decompile(invocation.input, invocation.output, program, stdout_sink);
+        case Action::QueryModels:
+        {
+            if(invocation.input == "default" || invocation.input == "all")
+            {
+                stdout_sink("=DEFAULT\n");
+                for(auto& pair : program.commands.get_default_models())
+                {
+                    stdout_sink(fmt::format("{} {}\n", pair.first, pair.second));
+                }
+            }
+            if(invocation.input == "level" || invocation.input == "all")
+            {
+                stdout_sink("=LEVEL\n");
+                for(auto& pair : config.level_models)
+                {
+                    stdout_sink(fmt::format("{} {}\n", pair.first, pair.second));
+                }
+            }
+            return EXIT_SUCCESS;
+        }
+        default:
+            Unreachable();
+    }
+}
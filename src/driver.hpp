@@ -0,0 +1,104 @@
+///
+/// Compiler Driver
+///     The command line interface of the compiler as a library, so it can be embedded into other programs
+///     (e.g. the in-process test runner in *test/runner*).
+///
+///     Nothing in here writes into the standard streams of the process. Messages are sent to the given
+///     sinks instead, and relative paths can be rebased, so many invocations may run at once in different threads.
+///
+///     Loading the game configuration is the most expensive step of a invocation on small inputs, thus it is
+///     split from running the invocation. Invocations with the same `config_key` may share a `GameConfig`, and
+///     invocations with the same `base_config_key` may share the base layer of its `Commands`.
+///
+#pragma once
+#include <stdinc.h>
+#include "program.hpp"
+
+enum class Action
+{
+    None,
+    Compile,
+    Decompile,
+    QueryConfigPath,
+    QueryModels,
+    Symbolize,
+};
+
+struct DataInfo
+{
+    fs::path    datadir;
+    std::string levelfile;
+};
+
+struct ConfigInfo
+{
+    std::string           config_name;
+    std::vector<fs::path> add_config_files;
+};
+
+/// A invocation of the compiler as given in the command line.
+struct Invocation
+{
+    Action      action = Action::None;
+    fs::path    input;
+    fs::path    output;
+    DataInfo    data;
+    ConfigInfo  conf;
+    Options     options;
+    std::vector<std::string> offsets;   //< The offsets to symbolize, or `@file` lists of offsets.
+};
+
+/// The game configuration of a invocation. It's never modified by the compiler, thus can be shared.
+struct GameConfig
+{
+    shared_ptr<const Commands>              commands;
+    insensitive_map<std::string, uint32_t>  default_models;
+    insensitive_map<std::string, uint32_t>  level_models;
+};
+
+/// Parses the null-terminated list of arguments `argv` (not including the program name) into `invocation`.
+///
+/// Does not check whether the invocation is complete, see `validate_invocation`.
+bool parse_invocation(char** argv, Invocation& invocation, const TextSink& log);
+
+/// Makes the relative paths of `invocation` relative to `dir` instead of the working directory.
+///
+/// Paths relative to the config directory (e.g. `--add-config=name.xml`) are kept as is.
+void rebase_invocation(Invocation& invocation, const fs::path& dir);
+
+/// Checks the options of a parsed invocation and infers the missing information (e.g. the action from the
+/// input extension, or the level file in the data directory).
+bool validate_invocation(Invocation& invocation, const TextSink& log);
+
+/// Whether `run_invocation` uses the game configuration of the invocation (e.g. `symbolize` does not).
+bool needs_config(const Invocation& invocation);
+
+/// Invocations with the same key load the same game configuration.
+std::string config_key(const Invocation& invocation);
+
+/// Invocations with the same key load the same base layer of commands.
+std::string base_config_key(const Invocation& invocation);
+
+/// Loads the base layer of commands of a validated invocation, that is, the commands of its game config without
+/// the `--add-config` files and default models (see `Commands::overlay`).
+///
+/// \throws ConfigError on failure.
+auto load_base_commands(const Invocation& invocation) -> shared_ptr<const Commands>;
+
+/// Loads the game configuration of a validated invocation on top of the `base` given by `load_base_commands`.
+///
+/// \throws ConfigError on failure.
+auto load_config(const Invocation& invocation, shared_ptr<const Commands> base) -> GameConfig;
+
+/// Loads the game configuration of a validated invocation.
+///
+/// \throws ConfigError on failure.
+auto load_config(const Invocation& invocation) -> GameConfig;
+
+/// Runs a validated invocation, returning its exit code.
+///
+/// The output of the compiler is sent to `stdout_sink` when the output file is `-`.
+///
+/// If the invocation doesn't `needs_config`, `config` is not used and may be empty.
+int run_invocation(const Invocation& invocation, const GameConfig& config,
+                   const TextSink& stdout_sink, const TextSink& log);
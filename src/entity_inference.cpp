@@ -0,0 +1,906 @@
+#include <stdinc.h>
+#include "entity_inference.hpp"
+#include "program.hpp"
+
+/// Walks the scripts in program order, splitting their facts into blocks.
+///
+/// The facts were collected by a walk in the same order, thus the facts of each statement are the next ones.
+class EntityInference::FlowBuilder
+{
+public:
+    explicit FlowBuilder(EntityInference& inference) :
+        inference(inference)
+    {}
+
+    void build()
+    {
+        auto& facts = inference.facts;
+        for(this->script = 0; this->script < facts.size(); ++this->script)
+        {
+            this->cursor = 0;
+            this->current = new_block();
+            this->script_begin.push_back(this->current);
+            place(this->current);
+
+            statement(*inference.script_trees[script]);
+
+            // Leftovers shouldn't happen, but they are better evaluated somewhere than lost.
+            if(this->cursor != facts[script].size())
+            {
+                if(this->current == no_block)
+                    place(this->current = new_block());
+                inference.blocks[this->current].end = this->cursor = facts[script].size();
+            }
+        }
+
+        link_returns();
+        mark_entries();
+    }
+
+private:
+    /// Where `BREAK` and `CONTINUE` jump into.
+    struct Loop
+    {
+        uint32_t    continue_block; //< `no_block` for `SWITCH`.
+        uint32_t    break_block;
+    };
+
+    EntityInference&                                inference;
+    size_t                                          script = 0;
+    size_t                                          cursor = 0;     //< Next fact of the script.
+    uint32_t                                        current = no_block; //< Block being filled, or `no_block` if unreachable.
+    uint32_t                                        last = no_block;    //< Block filled last.
+    std::vector<Loop>                               loops;
+    std::vector<uint32_t>                           script_begin;
+    std::unordered_map<const Label*, uint32_t>      label_blocks;
+    std::vector<std::pair<uint32_t, uint32_t>>      calls;          //< Subroutine and the block after the GOSUB into it.
+
+    uint32_t new_block()
+    {
+        inference.blocks.emplace_back();
+        return static_cast<uint32_t>(inference.blocks.size() - 1);
+    }
+
+    uint32_t block_of(const Label& label)
+    {
+        auto it = label_blocks.find(&label);
+        if(it == label_blocks.end())
+            it = label_blocks.emplace(&label, new_block()).first;
+        return it->second;
+    }
+
+    /// The flow continues into `block`, if reachable.
+    void jump(uint32_t block)
+    {
+        if(current != no_block)
+            inference.blocks[current].next.push_back(block);
+    }
+
+    /// Begins filling `block`, which is fallen into from the current one.
+    void place(uint32_t block)
+    {
+        if(current != block)
+            jump(block);
+
+        auto& b = inference.blocks[block];
+        b.script = script;
+        b.begin = b.end = cursor;
+        current = last = block;
+    }
+
+    /// Begins a block fallen into from the current one.
+    void split()
+    {
+        place(new_block());
+    }
+
+    /// Takes the facts of the command or assignment `node` into the current block.
+    void take_facts(const SyntaxTree& node)
+    {
+        auto& facts = inference.facts[script];
+
+        // Code no path reaches is still checked, as if fallen into from the code above it.
+        if(current == no_block)
+        {
+            auto above = last;
+            place(new_block());
+            if(above != no_block)
+                inference.blocks[above].next.push_back(current);
+        }
+
+        while(cursor < facts.size()
+            && (facts[cursor].node == &node || facts[cursor].node->parent().get() == &node))
+        {
+            ++cursor;
+        }
+
+        inference.blocks[current].end = cursor;
+    }
+
+    static const Label* label_arg(const SyntaxTree& node)
+    {
+        for(auto it = std::next(node.begin()); it != node.end(); ++it)
+        {
+            if(auto opt_label = (*it)->maybe_annotation<const shared_ptr<Label>&>())
+                return opt_label->get();
+        }
+        return nullptr;
+    }
+
+    void statements(const SyntaxTree& parent)
+    {
+        for(auto& child : parent)
+            statement(*child);
+    }
+
+    void statement(const SyntaxTree& node)
+    {
+        switch(node.type())
+        {
+            case NodeType::Block:
+            case NodeType::ELSE:
+                statements(node);
+                break;
+            case NodeType::Scope:
+                statements(node.child(0));
+                break;
+            case NodeType::Label:
+                if(auto opt_label = node.maybe_annotation<const shared_ptr<Label>&>())
+                    place(block_of(**opt_label));
+                break;
+            case NodeType::Command:
+                command(node);
+                break;
+            case NodeType::Equal:
+                take_facts(node);
+                break;
+            case NodeType::MISSION_END:
+            case NodeType::SCRIPT_END:
+                current = no_block;
+                break;
+            case NodeType::IF:
+            {
+                auto end_block = new_block();
+                condition(node.child(0));
+                auto branch = current;
+                split();
+                statements(node.child(1));
+                jump(end_block);
+                current = branch;
+                if(node.child_count() == 3)
+                {
+                    split();
+                    statements(node.child(2));
+                }
+                place(end_block);
+                break;
+            }
+            case NodeType::WHILE:
+            {
+                auto head_block = new_block();
+                auto end_block = new_block();
+                place(head_block);
+                condition(node.child(0));
+                jump(end_block);
+                split();
+                loops.push_back(Loop { head_block, end_block });
+                statements(node.child(1));
+                loops.pop_back();
+                jump(head_block);
+                current = no_block;
+                place(end_block);
+                break;
+            }
+            case NodeType::REPEAT:
+            {
+                auto body_block = new_block();
+                auto continue_block = new_block();
+                auto end_block = new_block();
+                place(body_block);
+                loops.push_back(Loop { continue_block, end_block });
+                statements(node.child(2));
+                loops.pop_back();
+                place(continue_block);
+                jump(body_block);
+                place(end_block);
+                break;
+            }
+            case NodeType::SWITCH:
+            {
+                auto end_block = new_block();
+                auto branch = current;
+                bool has_default = false;
+                current = no_block;
+
+                loops.push_back(Loop { no_block, end_block });
+                for(auto& child : node.child(1))
+                {
+                    if(child->type() == NodeType::CASE || child->type() == NodeType::DEFAULT)
+                    {
+                        has_default = has_default || child->type() == NodeType::DEFAULT;
+                        auto case_block = new_block();
+                        if(branch != no_block)
+                            inference.blocks[branch].next.push_back(case_block);
+                        place(case_block);
+                    }
+                    else
+                    {
+                        statement(*child);
+                    }
+                }
+                loops.pop_back();
+
+                jump(end_block);
+                current = has_default? no_block : branch;
+                place(end_block);
+                break;
+            }
+            case NodeType::BREAK:
+            case NodeType::CONTINUE:
+            {
+                for(auto it = loops.rbegin(); it != loops.rend(); ++it)
+                {
+                    auto target = (node.type() == NodeType::BREAK? it->break_block : it->continue_block);
+                    if(target != no_block)
+                    {
+                        jump(target);
+                        break;
+                    }
+                }
+                current = no_block;
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
+    void condition(const SyntaxTree& node)
+    {
+        switch(node.type())
+        {
+            case NodeType::NOT:
+            case NodeType::AND:
+            case NodeType::OR:
+                for(auto& child : node)
+                    condition(*child);
+                break;
+            default:
+                statement(node);
+                break;
+        }
+    }
+
+    void command(const SyntaxTree& node)
+    {
+        take_facts(node);
+
+        auto opt_command = node.maybe_annotation<std::reference_wrapper<const Command>>();
+        if(!opt_command)
+            return;
+
+        const Command& command = *opt_command;
+        auto label = label_arg(node);
+
+        if(command.has_flow(ControlFlow::Call) && command.special != SpecialCommand::CleoCall)
+        {
+            auto gosub = current;
+            split();
+            if(label)
+            {
+                auto callee = block_of(*label);
+                auto& block = inference.blocks[gosub];
+                block.next = { callee };
+                block.continuation = current;
+                calls.emplace_back(callee, current);
+            }
+        }
+        else if(command.has_flow(ControlFlow::Branch | ControlFlow::ConditionalBranch))
+        {
+            if(label)
+                jump(block_of(*label));
+            if(command.has_flow(ControlFlow::Branch))
+                current = no_block;
+            else
+                split();
+        }
+        else if(command.has_flow(ControlFlow::Return))
+        {
+            inference.blocks[current].is_return = true;
+            current = no_block;
+        }
+        else if(command.has_flow(ControlFlow::Terminator))
+        {
+            current = no_block;
+        }
+    }
+
+    /// Links each RETURN into every block after a GOSUB into its subroutine.
+    void link_returns()
+    {
+        auto& blocks = inference.blocks;
+
+        std::sort(calls.begin(), calls.end());
+        calls.erase(std::unique(calls.begin(), calls.end()), calls.end());
+
+        std::vector<uint32_t> visited_by(blocks.size(), no_block);
+        std::vector<uint32_t> stack;
+        std::vector<uint32_t> returns;
+
+        for(auto it = calls.begin(); it != calls.end(); )
+        {
+            const auto callee = it->first;
+            auto it_end = std::find_if(it, calls.end(), [&](const auto& call) { return call.first != callee; });
+
+            returns.clear();
+            stack.assign(1, callee);
+            visited_by[callee] = callee;
+            while(!stack.empty())
+            {
+                auto b = stack.back();
+                stack.pop_back();
+
+                if(blocks[b].is_return)
+                {
+                    returns.push_back(b);
+                    continue;
+                }
+
+                // Nested calls are stepped over.
+                auto step = [&](uint32_t to) {
+                    if(visited_by[to] != callee)
+                    {
+                        visited_by[to] = callee;
+                        stack.push_back(to);
+                    }
+                };
+
+                if(blocks[b].continuation != no_block)
+                    step(blocks[b].continuation);
+                else
+                    std::for_each(blocks[b].next.begin(), blocks[b].next.end(), step);
+            }
+
+            for(auto ret : returns)
+            {
+                for(auto call = it; call != it_end; ++call)
+                    blocks[ret].next.push_back(call->second);
+            }
+
+            it = it_end;
+        }
+    }
+
+    void mark_entries()
+    {
+        auto& blocks = inference.blocks;
+
+        std::vector<bool> has_preds(blocks.size());
+        for(auto& block : blocks)
+        {
+            for(auto to : block.next)
+                has_preds[to] = true;
+        }
+
+        for(uint32_t b = 0; b < blocks.size(); ++b)
+            blocks[b].is_entry = !has_preds[b];
+
+        for(size_t i = 0; i < script_begin.size(); ++i)
+            blocks[script_begin[i]].is_entry = (i != 0);
+
+        for(auto label : inference.entry_labels)
+            blocks[block_of(*label)].is_entry = true;
+
+        for(auto& facts : inference.facts)
+        {
+            for(auto& fact : facts)
+            {
+                if(fact.type == FactType::Input)
+                {
+                    auto& inputs = blocks[block_of(*fact.label)].inputs;
+                    if(std::find(inputs.begin(), inputs.end(), fact.var_id) == inputs.end())
+                        inputs.push_back(fact.var_id);
+                }
+            }
+        }
+    }
+};
+
+
+EntityInference::EntityInference(const std::vector<shared_ptr<Script>>& scripts) :
+    script_trees(scripts.size()), facts(scripts.size())
+{
+    for(size_t i = 0; i < scripts.size(); ++i)
+        this->script_trees[i] = scripts[i]->tree.get();
+}
+
+void EntityInference::add_fact(size_t script, Fact fact)
+{
+    Expects(script < this->facts.size());
+    this->facts[script].emplace_back(std::move(fact));
+}
+
+void EntityInference::add_def(size_t script, const SyntaxTree& node, const shared_ptr<Var>& var, EntityType entity)
+{
+    add_fact(script, Fact { FactType::Def, &node, var, nullptr, entity, nullptr });
+}
+
+void EntityInference::add_use(size_t script, const SyntaxTree& node, const shared_ptr<Var>& var, EntityType entity)
+{
+    add_fact(script, Fact { FactType::Use, &node, var, nullptr, entity, nullptr });
+}
+
+void EntityInference::add_copy(size_t script, const SyntaxTree& node, const shared_ptr<Var>& dest, const shared_ptr<Var>& src)
+{
+    add_fact(script, Fact { FactType::Copy, &node, dest, src, 0, nullptr });
+}
+
+void EntityInference::add_arithmetic(size_t script, const SyntaxTree& node, const shared_ptr<Var>& dest, const shared_ptr<Var>& src)
+{
+    add_fact(script, Fact { FactType::Arithmetic, &node, dest, src, 0, nullptr });
+}
+
+void EntityInference::add_entry(const Label& label)
+{
+    this->entry_labels.push_back(&label);
+}
+
+void EntityInference::add_input(size_t script, const SyntaxTree& node, const Label& label,
+                                const shared_ptr<Var>& lvar, const shared_ptr<Var>& arg)
+{
+    add_fact(script, Fact { FactType::Input, &node, lvar, arg, 0, &label });
+}
+
+void EntityInference::add_output(size_t script, const SyntaxTree& node, const shared_ptr<Var>& var, const shared_ptr<Var>& output)
+{
+    add_fact(script, Fact { FactType::Output, &node, var, output, 0, nullptr });
+}
+
+void EntityInference::add_return(size_t script, const SyntaxTree& node, const shared_ptr<Var>& var, const shared_ptr<Var>& output)
+{
+    add_fact(script, Fact { FactType::Return, &node, var, output, 0, nullptr });
+}
+
+void EntityInference::number_vars()
+{
+    std::unordered_map<const Var*, uint32_t> ids;
+
+    auto id_of = [&](const shared_ptr<Var>& var) -> uint32_t {
+        if(!var)
+            return 0;
+        auto it = ids.emplace(var.get(), static_cast<uint32_t>(this->vars.size())).first;
+        if(it->second == this->vars.size())
+            this->vars.push_back(var.get());
+        return it->second;
+    };
+
+    for(auto& script_facts : this->facts)
+    {
+        for(auto& fact : script_facts)
+        {
+            fact.var_id = id_of(fact.var);
+            fact.other_id = id_of(fact.other);
+        }
+    }
+
+    this->globals.assign(this->vars.size(), 0);
+    this->outputs.assign(this->vars.size(), 0);
+    this->first_defs.assign(this->vars.size(), 0);
+
+    for(auto& script_facts : this->facts)
+    {
+        for(auto& fact : script_facts)
+        {
+            if(fact.type == FactType::Def && this->first_defs[fact.var_id] == 0)
+                this->first_defs[fact.var_id] = fact.entity;
+        }
+    }
+}
+
+auto EntityInference::held_in(const HeldVars& vars, uint32_t var, const Held& absent) -> Held
+{
+    auto it = std::lower_bound(vars.begin(), vars.end(), var, [](const auto& pair, uint32_t var) {
+        return pair.first < var;
+    });
+    return (it != vars.end() && it->first == var)? it->second : absent;
+}
+
+bool EntityInference::flow_into(uint32_t b, const State& from, const HeldVars* delta)
+{
+    auto& block = this->blocks[b];
+    auto& in = block.in;
+    const Held absent { 0, in.elsewhere };
+    bool changed = false;
+
+    if(!block.reached || (from.elsewhere && !in.elsewhere))
+        delta = nullptr;
+
+    if(delta)
+    {
+        for(auto& pair : *delta)
+        {
+            auto it = std::lower_bound(in.vars.begin(), in.vars.end(), pair.first, [](const auto& pair, uint32_t var) {
+                return pair.first < var;
+            });
+
+            auto old = (it != in.vars.end() && it->first == pair.first)? it->second : absent;
+            auto held = join(old, pair.second);
+            if(held != old)
+            {
+                if(it != in.vars.end() && it->first == pair.first)
+                    it->second = held;
+                else
+                    in.vars.emplace(it, pair.first, held);
+                block.changed.push_back(pair.first);
+                changed = true;
+            }
+        }
+    }
+    else
+    {
+        State result;
+        result.elsewhere = in.elsewhere || from.elsewhere;
+        result.vars.reserve(std::max(in.vars.size(), from.vars.size()));
+
+        const Held absent_from { 0, from.elsewhere };
+        const Held absent_result { 0, result.elsewhere };
+
+        auto it = in.vars.begin();
+        auto it_from = from.vars.begin();
+        while(it != in.vars.end() || it_from != from.vars.end())
+        {
+            uint32_t var;
+            Held old, other;
+            if(it_from == from.vars.end() || (it != in.vars.end() && it->first < it_from->first))
+            {
+                var = it->first, old = it->second, other = absent_from;
+                ++it;
+            }
+            else if(it == in.vars.end() || it_from->first < it->first)
+            {
+                var = it_from->first, old = absent, other = it_from->second;
+                ++it_from;
+            }
+            else
+            {
+                var = it->first, old = it->second, other = it_from->second;
+                ++it, ++it_from;
+            }
+
+            auto held = join(old, other);
+            if(held != old)
+                block.changed.push_back(var);
+            if(held != absent_result)
+                result.vars.emplace_back(var, held);
+        }
+
+        if(result.elsewhere != in.elsewhere || !block.reached)
+            block.changed_all = true;
+
+        changed = block.changed_all || !block.changed.empty();
+        block.reached = true;
+        in = std::move(result);
+    }
+
+    return changed;
+}
+
+void EntityInference::evaluate(uint32_t block, const State& in, HeldVars& written, Changes& changes,
+                               std::vector<Diagnostic>* diagnostics, const Commands& commands)
+{
+    auto name = [&](EntityType entity) {
+        return commands.find_entity_name(entity).value();
+    };
+
+    auto diagnostic = [&](const SyntaxTree& node, std::string message) {
+        if(diagnostics)
+            diagnostics->emplace_back(Diagnostic { &node, std::move(message) });
+    };
+
+    auto find_written = [&](uint32_t var) {
+        return std::find_if(written.begin(), written.end(), [&](const auto& pair) { return pair.first == var; });
+    };
+
+    auto entity_in = [&](uint32_t var) -> EntityType
+    {
+        auto it = find_written(var);
+        if(it != written.end())
+            return it->second.entity;
+        return entity_of(held_in(in.vars, var, Held { 0, in.elsewhere }), var);
+    };
+
+    auto store = [&](uint32_t var, EntityType entity)
+    {
+        auto it = find_written(var);
+        if(it != written.end())
+            it->second = Held { entity, false };
+        else
+            written.emplace_back(var, Held { entity, false });
+
+        if(this->vars[var]->global && join(this->globals[var], entity) != this->globals[var])
+        {
+            this->globals[var] = join(this->globals[var], entity);
+            changes.globals.push_back(var);
+        }
+    };
+
+    auto& b = this->blocks[block];
+    auto& facts = this->facts[b.script];
+
+    written.clear();
+    for(size_t i = b.begin; i < b.end; ++i)
+    {
+        auto& fact = facts[i];
+        switch(fact.type)
+        {
+            case FactType::Def:
+            {
+                // A creation on another path is only known by the first creation into the variable.
+                auto entity = entity_in(fact.var_id);
+                if(entity == 0 || entity == conflict)
+                    entity = this->first_defs[fact.var_id];
+                if(entity && entity != fact.entity)
+                    diagnostic(*fact.node, fmt::format("variable has already been used to create a entity of type {}", name(entity)));
+                store(fact.var_id, fact.entity);
+                break;
+            }
+
+            case FactType::Use:
+            {
+                auto entity = entity_in(fact.var_id);
+                if(entity != fact.entity && entity != conflict)
+                    diagnostic(*fact.node, fmt::format("expected variable of type {} but got {}", name(fact.entity), name(entity)));
+                break;
+            }
+
+            case FactType::Copy:
+            {
+                auto src_entity = entity_in(fact.other_id);
+                auto dest_entity = entity_in(fact.var_id);
+                if(dest_entity && dest_entity != src_entity && dest_entity != conflict && src_entity != conflict)
+                    diagnostic(*fact.node, fmt::format("assignment of variable of type {} into one of type {}", name(src_entity), name(dest_entity)));
+                store(fact.var_id, src_entity);
+                break;
+            }
+
+            case FactType::Arithmetic:
+            {
+                // The destination keeps its entity on conflicts, so its uses are not reported as well.
+                auto src_entity = fact.other? entity_in(fact.other_id) : 0;
+                auto dest_entity = entity_in(fact.var_id);
+                if(src_entity && src_entity != conflict)
+                    diagnostic(*fact.node, fmt::format("arithmetic on variable of type {}", name(src_entity)));
+                else if(dest_entity && dest_entity != conflict && !src_entity)
+                    diagnostic(*fact.node, fmt::format("arithmetic into variable of type {}", name(dest_entity)));
+                break;
+            }
+
+            case FactType::Input:
+            {
+                // Untyped arguments are compatible with any input, since they carry no information.
+                auto arg_entity = entity_in(fact.other_id);
+                if(arg_entity)
+                {
+                    auto origin = std::make_pair(b.script, i);
+                    auto it = this->inputs.find(fact.var_id);
+                    if(it == this->inputs.end() || origin < it->second.origin
+                        || (origin == it->second.origin && arg_entity != it->second.entity))
+                    {
+                        this->inputs[fact.var_id] = InputSummary { arg_entity, origin };
+                        changes.inputs.push_back(fact.var_id);
+                    }
+                    else if(it->second.entity != arg_entity && arg_entity != conflict && it->second.entity != conflict)
+                    {
+                        diagnostic(*fact.node, "entity type mismatch in target label");
+                    }
+                }
+                break;
+            }
+
+            case FactType::Output:
+            {
+                auto output_entity = this->outputs[fact.other_id];
+                auto entity = entity_in(fact.var_id);
+                if(entity && entity != output_entity && entity != conflict && output_entity != conflict)
+                    diagnostic(*fact.node, "entity type mismatch");
+                store(fact.var_id, output_entity);
+                break;
+            }
+
+            case FactType::Return:
+            {
+                auto entity = entity_in(fact.var_id);
+                if(fact.var == fact.other)
+                {
+                    auto& output_entity = this->outputs[fact.other_id];
+                    if(join(output_entity, entity) != output_entity)
+                    {
+                        output_entity = join(output_entity, entity);
+                        changes.outputs.push_back(fact.other_id);
+                    }
+                }
+                else
+                {
+                    auto output_entity = entity_in(fact.other_id);
+                    if(entity != output_entity && entity != conflict && output_entity != conflict)
+                        diagnostic(*fact.node, "entity type mismatch");
+                }
+                break;
+            }
+
+            default:
+                Unreachable();
+        }
+    }
+
+    std::sort(written.begin(), written.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+}
+
+void EntityInference::solve(ProgramContext& program)
+{
+    number_vars();
+    FlowBuilder(*this).build();
+
+    // The blocks to evaluate again whenever a summary about a variable changes.
+    std::vector<std::vector<uint32_t>> readers(this->vars.size());
+    std::vector<std::vector<uint32_t>> input_blocks(this->vars.size());
+    for(uint32_t b = 0; b < this->blocks.size(); ++b)
+    {
+        auto& block = this->blocks[b];
+        for(size_t i = block.begin; i < block.end; ++i)
+        {
+            auto& fact = this->facts[block.script][i];
+            if(fact.type == FactType::Copy || fact.type == FactType::Input || fact.type == FactType::Output)
+                readers[fact.other_id].push_back(b);
+            else if(fact.type == FactType::Return)
+                readers[fact.var_id].push_back(b);
+        }
+
+        for(auto var : block.inputs)
+            input_blocks[var].push_back(b);
+    }
+
+    // Blocks are mostly numbered in program order, so visiting the lowest first finds the earliest calls first.
+    std::set<uint32_t> worklist;
+
+    auto enter = [&](uint32_t b, const HeldVars* delta) {
+        State state { true, {} };
+        for(auto var : this->blocks[b].inputs)
+        {
+            auto it = this->inputs.find(var);
+            if(it != this->inputs.end())
+                state.vars.emplace_back(var, Held { it->second.entity, false });
+        }
+        std::sort(state.vars.begin(), state.vars.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+        if(flow_into(b, state, delta? &state.vars : nullptr))
+            worklist.emplace(b);
+    };
+
+    if(!this->blocks.empty())
+    {
+        flow_into(0, State(), nullptr);
+        worklist.emplace(0);
+    }
+
+    for(uint32_t b = 0; b < this->blocks.size(); ++b)
+    {
+        if(this->blocks[b].is_entry)
+            enter(b, nullptr);
+    }
+
+    HeldVars written, delta;
+    State out;
+
+    while(!worklist.empty())
+    {
+        auto b = *worklist.begin();
+        worklist.erase(worklist.begin());
+
+        auto& block = this->blocks[b];
+        if(!block.reached)
+            continue;
+
+        Changes changes;
+        evaluate(b, block.in, written, changes, nullptr, program.commands);
+
+        // The entities changed at the end of the block, from the ones changed at its beginning or written by it.
+        delta.clear();
+        if(!block.changed_all)
+        {
+            std::sort(block.changed.begin(), block.changed.end());
+            block.changed.erase(std::unique(block.changed.begin(), block.changed.end()), block.changed.end());
+
+            const Held absent { 0, block.in.elsewhere };
+            for(auto var : block.changed)
+            {
+                if(held_in(written, var, absent) == absent && held_in(block.written, var, absent) == absent)
+                    delta.emplace_back(var, held_in(block.in.vars, var, absent));
+            }
+
+            for(auto& pair : written)
+            {
+                if(held_in(block.written, pair.first, Held { conflict, true }) != pair.second)
+                    delta.emplace_back(pair.first, pair.second);
+            }
+
+            for(auto& pair : block.written)
+            {
+                if(held_in(written, pair.first, Held { conflict, true }) == Held { conflict, true })
+                    delta.emplace_back(pair.first, held_in(block.in.vars, pair.first, absent));
+            }
+        }
+
+        const bool full = block.changed_all;
+        block.changed.clear();
+        block.changed_all = false;
+        std::swap(block.written, written);
+
+        // The whole state at the end of the block is only needed by successors not joined with it before.
+        bool out_built = false;
+        for(auto to : block.next)
+        {
+            auto& succ = this->blocks[to];
+            const bool flow_all = full || !succ.reached || (block.in.elsewhere && !succ.in.elsewhere);
+            if(!flow_all && delta.empty())
+                continue;
+
+            if(flow_all && !out_built)
+            {
+                out.elsewhere = block.in.elsewhere;
+                out.vars.clear();
+                std::merge(block.written.begin(), block.written.end(), block.in.vars.begin(), block.in.vars.end(),
+                           std::back_inserter(out.vars), [](const auto& a, const auto& b) { return a.first < b.first; });
+                out.vars.erase(std::unique(out.vars.begin(), out.vars.end(), [](const auto& a, const auto& b) {
+                    return a.first == b.first;
+                }), out.vars.end());
+                out_built = true;
+            }
+
+            if(flow_into(to, flow_all? out : block.in, flow_all? nullptr : &delta))
+                worklist.emplace(to);
+        }
+
+        for(auto var : changes.globals)
+            worklist.insert(readers[var].begin(), readers[var].end());
+
+        for(auto var : changes.outputs)
+            worklist.insert(readers[var].begin(), readers[var].end());
+
+        for(auto var : changes.inputs)
+        {
+            for(auto entry : input_blocks[var])
+                enter(entry, &delta);
+        }
+    }
+
+    // Now that every summary is known, report the conflicts in program order.
+    std::vector<uint32_t> order;
+    for(uint32_t b = 0; b < this->blocks.size(); ++b)
+    {
+        if(this->blocks[b].reached)
+            order.push_back(b);
+    }
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        return std::tie(blocks[a].script, blocks[a].begin) < std::tie(blocks[b].script, blocks[b].begin);
+    });
+
+    std::vector<Diagnostic> diagnostics;
+    std::vector<EntityType> entities = this->globals;
+    for(auto b : order)
+    {
+        Changes changes;
+        evaluate(b, this->blocks[b].in, written, changes, &diagnostics, program.commands);
+
+        for(auto& pair : this->blocks[b].in.vars)
+            entities[pair.first] = join(entities[pair.first], entity_of(pair.second, pair.first));
+        for(auto& pair : written)
+            entities[pair.first] = join(entities[pair.first], pair.second.entity);
+    }
+
+    for(auto& diag : diagnostics)
+        program.error(*diag.node, "{}", diag.message);
+
+    for(uint32_t var = 0; var < this->vars.size(); ++var)
+        this->vars[var]->entity = (entities[var] != conflict? entities[var] : 0);
+}
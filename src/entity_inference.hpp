@@ -0,0 +1,207 @@
+///
+/// Entity Type Inference
+///
+/// Infers the entity type (e.g. CAR, CHAR) that each variable holds when `-fentity-tracking` is enabled.
+///
+/// While special commands are handled (see `Script::handle_special_commands`), facts about variables are collected
+/// in program order: entity definitions, entity uses, copies, arithmetic and the bindings of call scopes.
+///
+/// The statements of the scripts are then split into basic blocks, with edges for the fall through, `GOTO`s, labels,
+/// `IF`/`WHILE`/`REPEAT`/`SWITCH` statements, `GOSUB`s and for each `RETURN` back into the statement after every
+/// `GOSUB` into its subroutine. The entity types flow along those edges, so a variable created in a subroutine or
+/// below a `GOTO` is known where the flow of execution reaches it.
+///
+/// Some blocks are entered from elsewhere rather than by an edge: the beginning of the scripts other than the main one,
+/// the targets of `START_NEW_SCRIPT` and `CLEO_CALL`, and any block without predecessors. These begin with:
+///
+///  + The inputs of their call scope, given by the earliest `START_NEW_SCRIPT` or `CLEO_CALL` into it.
+///  + The entities stored into the global variables anywhere in the program.
+///
+/// The outputs of `CLEO_RETURN` flow into the outputs of every `CLEO_CALL` into its scope.
+///
+/// At a merge of paths, a variable holding different entities is taken as holding a conflict, which is never reported
+/// again (the conflicting creation has already been). The states only grow in such a lattice, thus the worklist reaches
+/// a fixpoint after visiting each block a few times. Only then the conflicts are reported, once each.
+///
+/// To keep this fast on large scripts, a state only stores the variables it knows something about, and the entities
+/// stored into globals anywhere are kept in a single summary referenced by the states entered from elsewhere. Once a
+/// block has been reached, only the variables which changed at its end are joined into its successors.
+///
+#pragma once
+#include <stdinc.h>
+#include "symtable.hpp"
+
+class EntityInference
+{
+public:
+    /// Creates a inference engine for `scripts`. Scripts are identified by their indices in it,
+    /// which must follow the order on which they are handled.
+    explicit EntityInference(const std::vector<shared_ptr<Script>>& scripts);
+
+    /// `node` creates a entity of type `entity` into `var` (i.e. output argument of e.g. `CREATE_CAR`).
+    void add_def(size_t script, const SyntaxTree& node, const shared_ptr<Var>& var, EntityType entity);
+
+    /// `node` expects a entity of type `entity` in `var` (i.e. input argument of e.g. `EXPLODE_CAR`).
+    void add_use(size_t script, const SyntaxTree& node, const shared_ptr<Var>& var, EntityType entity);
+
+    /// `node` copies the entity in `src` into `dest` (i.e. `dest = src`).
+    void add_copy(size_t script, const SyntaxTree& node, const shared_ptr<Var>& dest, const shared_ptr<Var>& src);
+
+    /// `node` stores into `dest` the result of arithmetic on it or on `src`, if not null (i.e. `dest = src + c` or `dest += c`).
+    ///
+    /// The result is a plain number, thus neither of them is expected to hold a entity.
+    void add_arithmetic(size_t script, const SyntaxTree& node, const shared_ptr<Var>& dest, const shared_ptr<Var>& src);
+
+    /// `label` is entered from elsewhere, with the inputs of its call scope (i.e. target of `START_NEW_SCRIPT` and `CLEO_CALL`).
+    void add_entry(const Label& label);
+
+    /// `node` sends the entity in `arg` to the variable `lvar` of the call scope at `label`
+    /// (i.e. inputs of `START_NEW_SCRIPT` and `CLEO_CALL`).
+    void add_input(size_t script, const SyntaxTree& node, const Label& label,
+                   const shared_ptr<Var>& lvar, const shared_ptr<Var>& arg);
+
+    /// `node` receives into `var` the entity returned through the call scope output `output` (i.e. outputs of `CLEO_CALL`).
+    void add_output(size_t script, const SyntaxTree& node, const shared_ptr<Var>& var, const shared_ptr<Var>& output);
+
+    /// `node` returns the entity in `var` through the call scope output `output` (i.e. arguments of `CLEO_RETURN`).
+    void add_return(size_t script, const SyntaxTree& node, const shared_ptr<Var>& var, const shared_ptr<Var>& output);
+
+    /// Propagates the entity types up to a fixpoint, reports the conflicts, and stores the inferred types in `Var::entity`.
+    void solve(ProgramContext& program);
+
+private:
+    class FlowBuilder;
+
+    static constexpr uint32_t no_block = UINT32_MAX;
+
+    /// Entity of a variable holding different entities depending on the path taken.
+    static constexpr EntityType conflict = UINT16_MAX;
+
+    enum class FactType
+    {
+        Def,
+        Use,
+        Copy,
+        Arithmetic,
+        Input,
+        Output,
+        Return,
+    };
+
+    struct Fact
+    {
+        FactType            type;
+        const SyntaxTree*   node;
+        shared_ptr<Var>     var;
+        shared_ptr<Var>     other;  //< Source var for Copy, Arithmetic and Input, call scope output for Output and Return.
+        EntityType          entity; //< Entity for Def and Use.
+        const Label*        label;  //< Call scope for Input.
+        uint32_t            var_id = 0;
+        uint32_t            other_id = 0;
+    };
+
+    /// Where an input entity comes from. The earliest call in program order wins.
+    struct InputSummary
+    {
+        EntityType                  entity;
+        std::pair<size_t, size_t>   origin; //< (script, fact)
+    };
+
+    /// What a variable holds at some point.
+    struct Held
+    {
+        EntityType  entity = 0;
+        bool        elsewhere = false;  //< Whether it also holds whatever is stored into it anywhere (see `globals`).
+
+        bool operator==(const Held& other) const { return entity == other.entity && elsewhere == other.elsewhere; }
+        bool operator!=(const Held& other) const { return !(*this == other); }
+    };
+
+    using HeldVars = std::vector<std::pair<uint32_t, Held>>;
+
+    /// The variables at some point. Only the ones not holding `Held { 0, elsewhere }` are in it, sorted by id.
+    struct State
+    {
+        bool        elsewhere = false;
+        HeldVars    vars;
+    };
+
+    struct Block
+    {
+        size_t                  script = 0;
+        size_t                  begin = 0;      //< Facts of the block, in `facts[script]`.
+        size_t                  end = 0;
+        std::vector<uint32_t>   next;
+        uint32_t                continuation = no_block;    //< Block after the GOSUB ending this one.
+        bool                    is_return = false;          //< Whether it ends on a RETURN.
+        bool                    is_entry = false;           //< Whether it's entered from elsewhere.
+        std::vector<uint32_t>   inputs;                     //< Call scope variables it's entered with.
+
+        bool                    reached = false;
+        State                   in;                         //< Entities at the beginning of the block.
+        HeldVars                written;                    //< Entities written by the block, sorted by id.
+        std::vector<uint32_t>   changed;                    //< Variables changed in `in` since the last evaluation.
+        bool                    changed_all = false;        //< Whether all of them may have.
+    };
+
+    struct Diagnostic
+    {
+        const SyntaxTree*   node;
+        std::string         message;
+    };
+
+    /// Changes to the summaries during an evaluation of a block.
+    struct Changes
+    {
+        std::vector<uint32_t>   globals;
+        std::vector<uint32_t>   inputs;
+        std::vector<uint32_t>   outputs;
+    };
+
+    void add_fact(size_t script, Fact fact);
+
+    /// \returns the entity held by a variable holding either `a` or `b`.
+    static EntityType join(EntityType a, EntityType b)
+    {
+        return (a == b || b == 0)? a : (a == 0)? b : conflict;
+    }
+
+    static Held join(const Held& a, const Held& b)
+    {
+        return Held { join(a.entity, b.entity), a.elsewhere || b.elsewhere };
+    }
+
+    /// \returns what `var` holds in `vars`, or `absent` if not in it.
+    static Held held_in(const HeldVars& vars, uint32_t var, const Held& absent);
+
+    /// \returns the entity in `var` if it holds `held`.
+    EntityType entity_of(const Held& held, uint32_t var) const
+    {
+        return held.elsewhere? join(held.entity, this->globals[var]) : held.entity;
+    }
+
+    /// Numbers the variables in the facts.
+    void number_vars();
+
+    /// Evaluates the facts of `block` from the state `in` into `written`, updating the summaries.
+    ///
+    /// The conflicts are appended into `diagnostics`, if not null.
+    void evaluate(uint32_t block, const State& in, HeldVars& written, Changes& changes,
+                  std::vector<Diagnostic>* diagnostics, const Commands& commands);
+
+    /// Joins the state `from` into the beginning of `block`, or only the variables in `delta` if not null.
+    /// \returns whether it changed.
+    bool flow_into(uint32_t block, const State& from, const HeldVars* delta);
+
+private:
+    std::vector<const SyntaxTree*>      script_trees;
+    std::vector<std::vector<Fact>>      facts;          //< Facts of each script, in program order.
+    std::vector<const Label*>           entry_labels;
+    std::vector<Block>                  blocks;
+
+    std::vector<Var*>                   vars;           //< Variables by id.
+    std::vector<EntityType>             globals;        //< Entities stored into each variable anywhere, if global.
+    std::vector<EntityType>             outputs;        //< Entity each call scope output returns.
+    std::vector<EntityType>             first_defs;     //< Entity each variable is first created as.
+    std::unordered_map<uint32_t, InputSummary> inputs;  //< Call scope variable -> Entity it is called with.
+};
@@ -0,0 +1,321 @@
+#include <stdinc.h>
+#include "entity_leaks.hpp"
+
+using EdgeKind = CodeGraph::EdgeKind;
+
+static constexpr uint32_t no_node = CodeGraph::no_node;
+
+namespace
+{
+    /// An entity created into a variable.
+    struct Acquire
+    {
+        uint32_t    local;      //< The command creating it.
+        const Var*  var;
+        EntityType  type;
+    };
+
+    /// The commands run by a mission, indexed in the order they are reached from its beginning.
+    struct Mission
+    {
+        std::vector<uint32_t>                   nodes;          //< Graph node of each command.
+        std::vector<std::vector<uint32_t>>      next;           //< Commands each command continues into.
+        std::vector<uint32_t>                   continuation;   //< Command after each GOSUB, or `no_node`.
+        std::vector<std::vector<uint32_t>>      acquires;       //< Indices into `entities` created by each command.
+        std::vector<std::vector<const Var*>>    releases;       //< Variables released by each command.
+        std::vector<Acquire>                    entities;
+        std::unordered_map<const Var*, std::vector<uint32_t>> var_entities; //< Entities created into each variable.
+
+        uint32_t size() const { return static_cast<uint32_t>(nodes.size()); }
+    };
+}
+
+/// Collects the commands of the mission starting at `entry`.
+///
+/// \param local the index of each graph node into the mission, or `no_node`. The nodes of the mission are given back
+///              as `no_node` when it's done with.
+static Mission collect_mission(const CodeGraph& graph, uint32_t entry, std::vector<uint32_t>& local)
+{
+    Mission mission;
+
+    auto visit = [&](uint32_t node) {
+        if(local[node] == no_node)
+        {
+            local[node] = mission.size();
+            mission.nodes.push_back(node);
+        }
+        return local[node];
+    };
+
+    visit(entry);
+    for(uint32_t i = 0; i < mission.size(); ++i)
+    {
+        // CLEO_CALL subroutines create into their own local variables, so they are left out.
+        for(auto edge = graph.begin(mission.nodes[i]); edge != graph.end(mission.nodes[i]); ++edge)
+        {
+            if(edge->kind != EdgeKind::Call)
+                visit(edge->to);
+        }
+    }
+
+    const auto size = mission.size();
+    mission.next.resize(size);
+    mission.continuation.assign(size, no_node);
+    mission.acquires.resize(size);
+    mission.releases.resize(size);
+
+    std::vector<std::pair<uint32_t, uint32_t>> calls; // Subroutine and the command after the GOSUB into it.
+
+    for(uint32_t i = 0; i < size; ++i)
+    {
+        const auto node = mission.nodes[i];
+        const auto& compiled = graph.command(node);
+
+        bool is_gosub = std::any_of(graph.begin(node), graph.end(node), [](const CodeGraph::Edge& edge) {
+            return edge.kind == EdgeKind::Gosub;
+        });
+
+        for(auto edge = graph.begin(node); edge != graph.end(node); ++edge)
+        {
+            if(edge->kind == EdgeKind::Call)
+                continue;
+
+            if(is_gosub && edge->kind == EdgeKind::Flow)
+                mission.continuation[i] = local[edge->to];
+            else
+                mission.next[i].push_back(local[edge->to]);
+        }
+
+        if(mission.continuation[i] != no_node)
+        {
+            for(auto callee : mission.next[i])
+                calls.emplace_back(callee, mission.continuation[i]);
+        }
+
+        for(size_t a = 0; a < compiled.args.size(); ++a)
+        {
+            auto arginfo = compiled.command.arg(a);
+            if(!arginfo || !is<CompiledVar>(compiled.args[a]))
+                continue;
+
+            const Var* var = get<CompiledVar>(compiled.args[a]).var.get();
+            if(arginfo->acquires)
+            {
+                auto id = static_cast<uint32_t>(mission.entities.size());
+                mission.entities.push_back(Acquire { i, var, arginfo->entity_type });
+                mission.acquires[i].push_back(id);
+                mission.var_entities[var].push_back(id);
+            }
+            else if(arginfo->releases)
+            {
+                mission.releases[i].push_back(var);
+            }
+        }
+    }
+
+    for(auto node : mission.nodes)
+        local[node] = no_node;
+
+    // Each RETURN continues into every command after a GOSUB into its subroutine.
+    std::sort(calls.begin(), calls.end());
+    calls.erase(std::unique(calls.begin(), calls.end()), calls.end());
+
+    std::vector<uint32_t> visited_by(size, no_node);
+    std::vector<uint32_t> stack;
+    std::vector<uint32_t> returns;
+
+    for(auto it = calls.begin(); it != calls.end(); )
+    {
+        const auto callee = it->first;
+        auto it_end = std::find_if(it, calls.end(), [&](const auto& call) { return call.first != callee; });
+
+        returns.clear();
+        stack.assign(1, callee);
+        visited_by[callee] = callee;
+        while(!stack.empty())
+        {
+            auto i = stack.back();
+            stack.pop_back();
+
+            if(graph.command(mission.nodes[i]).command.has_flow(ControlFlow::Return))
+            {
+                returns.push_back(i);
+                continue;
+            }
+
+            // Nested calls are stepped over.
+            auto step = [&](uint32_t to) {
+                if(visited_by[to] != callee)
+                {
+                    visited_by[to] = callee;
+                    stack.push_back(to);
+                }
+            };
+
+            if(mission.continuation[i] != no_node)
+                step(mission.continuation[i]);
+            else
+                std::for_each(mission.next[i].begin(), mission.next[i].end(), step);
+        }
+
+        for(auto ret : returns)
+        {
+            for(auto call = it; call != it_end; ++call)
+                mission.next[ret].push_back(call->second);
+        }
+
+        it = it_end;
+    }
+
+    return mission;
+}
+
+/// \returns the entities each command of `mission` may be reached with, not released yet, `words` per command.
+static std::vector<uint64_t> compute_unreleased(const Mission& mission, size_t words, std::vector<bool>& reached)
+{
+    std::vector<uint64_t> unreleased(mission.size() * words);
+    std::vector<uint64_t> out(words);
+    std::vector<bool> queued(mission.size());
+    std::vector<uint32_t> worklist;
+
+    auto kill = [&](const Var* var) {
+        for(auto id : mission.var_entities.at(var))
+            out[id / 64] &= ~(uint64_t(1) << (id % 64));
+    };
+
+    reached.assign(mission.size(), false);
+    reached[0] = true;
+    worklist.push_back(0);
+
+    while(!worklist.empty())
+    {
+        auto i = worklist.back();
+        worklist.pop_back();
+        queued[i] = false;
+
+        std::copy_n(unreleased.begin() + i * words, words, out.begin());
+
+        for(auto var : mission.releases[i])
+        {
+            if(mission.var_entities.count(var))
+                kill(var);
+        }
+
+        for(auto id : mission.acquires[i])
+        {
+            kill(mission.entities[id].var);
+            out[id / 64] |= uint64_t(1) << (id % 64);
+        }
+
+        for(auto to : mission.next[i])
+        {
+            bool changed = !reached[to];
+            for(size_t w = 0; w < words; ++w)
+            {
+                auto& word = unreleased[to * words + w];
+                changed = changed || (out[w] & ~word) != 0;
+                word |= out[w];
+            }
+
+            reached[to] = true;
+            if(changed && !queued[to])
+            {
+                queued[to] = true;
+                worklist.push_back(to);
+            }
+        }
+    }
+
+    return unreleased;
+}
+
+static void check_mission(const CodeGraph& graph, uint32_t entry, std::vector<uint32_t>& local, ProgramContext& program)
+{
+    auto mission = collect_mission(graph, entry, local);
+    if(mission.entities.empty())
+        return;
+
+    const size_t words = (mission.entities.size() + 63) / 64;
+
+    std::vector<bool> reached;
+    auto unreleased = compute_unreleased(mission, words, reached);
+
+    auto is_unreleased = [&](uint32_t i, uint32_t id) {
+        return (unreleased[i * words + id / 64] & (uint64_t(1) << (id % 64))) != 0;
+    };
+
+    // The first termination of the mission each entity may reach unreleased.
+    std::vector<uint32_t> leaked_at(mission.entities.size(), no_node);
+    for(uint32_t i = 0; i < mission.size(); ++i)
+    {
+        if(!reached[i] || !graph.command(mission.nodes[i]).command.has_flow(ControlFlow::Terminator))
+            continue;
+
+        for(uint32_t id = 0; id < mission.entities.size(); ++id)
+        {
+            if(leaked_at[id] == no_node && is_unreleased(i, id))
+                leaked_at[id] = i;
+        }
+    }
+
+    auto where = [&](uint32_t i) {
+        return graph.command(mission.nodes[i]).where;
+    };
+
+    auto diagnose = [&](bool is_note, const SyntaxTree* where, const std::string& message) {
+        if(is_note)
+            where? program.note(*where, "{}", message) : program.note(nocontext, "{}", message);
+        else
+            where? program.warning(*where, "{}", message) : program.warning(nocontext, "{}", message);
+    };
+
+    for(uint32_t id = 0; id < mission.entities.size(); ++id)
+    {
+        auto& entity = mission.entities[id];
+        auto name = program.commands.find_entity_name(entity.type).value_or("entity");
+
+        if(reached[entity.local])
+        {
+            auto& others = mission.var_entities.at(entity.var);
+            auto it = std::find_if(others.begin(), others.end(), [&](uint32_t other) {
+                return is_unreleased(entity.local, other);
+            });
+            if(it != others.end())
+            {
+                diagnose(false, where(entity.local),
+                         fmt::format("{} created here may overwrite the handle of another one not released yet "
+                                     "[-Wentity-leak]", name));
+                diagnose(true, where(mission.entities[*it].local),
+                         fmt::format("previous {} created here", name));
+            }
+        }
+
+        if(leaked_at[id] != no_node)
+        {
+            diagnose(false, where(entity.local),
+                     fmt::format("{} created here may not be released before the mission ends [-Wentity-leak]", name));
+            diagnose(true, where(leaked_at[id]), "mission ends here");
+        }
+    }
+}
+
+void check_entity_leaks(const CodeGraph& graph, ProgramContext& program)
+{
+    if(!program.opt.warn_entity_leak)
+        return;
+
+    std::vector<uint32_t> local(graph.size(), no_node);
+    std::vector<bool> checked(graph.size());
+
+    for(auto& entry : graph.entries())
+    {
+        if(entry.label || !entry.script || checked[entry.node])
+            continue;
+
+        if(entry.script->type == ScriptType::Mission || entry.script->type == ScriptType::CustomMission)
+        {
+            checked[entry.node] = true;
+            check_mission(graph, entry.node, local, program);
+        }
+    }
+}
@@ -0,0 +1,25 @@
+///
+/// Entity Leaks
+///
+/// The entities a mission creates (cars, chars, objects, blips, pickups...) take slots from fixed pools of the game,
+/// which are exhausted if missions keep creating entities they never release, with slowdowns and crashes far from
+/// the mission at fault. This warns about the entities a mission may not release before it ends (`-Wentity-leak`).
+///
+/// The commands creating and releasing entities are given by the `Acquire` and `Release` attributes of their
+/// entity arguments in the config (e.g. `CREATE_CAR` and `DELETE_CAR`, or `MARK_CAR_AS_NO_LONGER_NEEDED`).
+///
+/// The analysis runs on the graph of the compiled IR (see code_graph.hpp), from the beginning of each mission, with
+/// GOSUB edges returning into every command after a GOSUB to the same subroutine. It computes the handles each command
+/// may be reached with, still unreleased, from the commands which created them. A handle is released by a release of
+/// the same variable. As usual for such analyses, the states from every path into a command are merged, so each
+/// command is visited a few times at most, and the analysis takes about linear time in the size of each mission.
+///
+/// A mission is warned about the handles which may be unreleased when it terminates, and about the handles which may
+/// be overwritten by another creation before being released (e.g. creating a car inside a loop).
+///
+#pragma once
+#include <stdinc.h>
+#include "code_graph.hpp"
+
+/// Warns about the entities the missions in `graph` may not release, if `program.opt.warn_entity_leak`.
+void check_entity_leaks(const CodeGraph& graph, ProgramContext& program);
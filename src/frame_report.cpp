@@ -0,0 +1,326 @@
+#include <stdinc.h>
+#include "frame_report.hpp"
+
+/// Number of arrays given for each frame.
+static constexpr size_t max_listed = 3;
+
+namespace
+{
+    struct FrameInfo
+    {
+        const Script*           script;
+        const Scope*            scope;
+        std::string             label;          //< First label in the scope, if any.
+        size_t                  line = 0;
+        size_t                  column = 0;
+        uint32_t                begin;          //< Local index the frame starts at.
+        uint32_t                end;            //< Local index after the highest variable.
+        size_t                  num_vars = 0;
+        int64_t                 headroom;       //< Slots left until the local variable limit.
+        optional<int64_t>       timer_headroom; //< Slots left until the timers, if the frame is below them.
+        std::vector<std::pair<std::string, uint32_t>> arrays; //< Largest arrays and their slots.
+
+        uint32_t slots() const { return end - begin; }
+    };
+}
+
+static std::vector<FrameInfo> collect_frames(const std::vector<shared_ptr<Script>>& scripts, const SymTable& symbols,
+                                             const ProgramContext& program)
+{
+    auto& opt = program.opt;
+    std::vector<FrameInfo> frames;
+
+    // The first label of each scope names its frame.
+    std::unordered_map<const Scope*, std::pair<size_t, std::string>> scope_labels;
+    for(auto& pair : symbols.labels)
+    {
+        auto& label = *pair.second;
+        auto where = label.where.lock();
+        if(!label.scope || !where || !where->has_text())
+            continue;
+
+        auto position = where->get_token().begin;
+        auto it = scope_labels.find(label.scope.get());
+        if(it == scope_labels.end() || position < it->second.first)
+            scope_labels[label.scope.get()] = std::make_pair(position, pair.first);
+    }
+
+    for(auto& script : scripts)
+    {
+        const bool is_mission = script->is_child_of_mission();
+
+        for(auto& scope : script->scopes)
+        {
+            FrameInfo frame;
+            frame.script = script.get();
+            frame.scope = scope.get();
+
+            auto it_label = scope_labels.find(scope.get());
+            if(it_label != scope_labels.end())
+                frame.label = it_label->second.second;
+
+            if(auto node = scope->node())
+            {
+                if(node->has_text())
+                {
+                    if(auto tstream = node->token_stream().lock())
+                        std::tie(frame.line, frame.column) = tstream->text.linecol_from_offset(node->get_token().begin);
+                }
+            }
+
+            // Call scopes of missions are moved to the beginning of the local space by `fix_call_scope_variables`,
+            // but the limit is checked before that.
+            const bool is_moved = (is_mission && scope->is_call_scope() && opt.mission_var_begin != 0);
+            const uint32_t shift = is_moved? opt.mission_var_begin : 0;
+
+            frame.begin = (is_mission && !is_moved)? opt.mission_var_begin : 0;
+            frame.end = frame.begin;
+
+            for(auto& pair : scope->vars)
+            {
+                auto& var = *pair.second;
+                if(var.where.expired()) // TIMERA and TIMERB
+                    continue;
+
+                ++frame.num_vars;
+                frame.end = std::max(frame.end, var.end_offset() / 4);
+
+                if(var.count)
+                    frame.arrays.emplace_back(pair.first, var.space_taken());
+            }
+
+            auto limit = is_mission? opt.mission_var_limit.value_or(opt.local_var_limit) : opt.local_var_limit;
+            frame.headroom = int64_t(limit) - int64_t(frame.end + shift);
+
+            if(frame.begin <= uint32_t(opt.timer_index))
+                frame.timer_headroom = int64_t(opt.timer_index) - int64_t(frame.end);
+
+            std::sort(frame.arrays.begin(), frame.arrays.end(), [](const auto& a, const auto& b) {
+                return a.second > b.second || (a.second == b.second && a.first < b.first);
+            });
+            if(frame.arrays.size() > max_listed)
+                frame.arrays.resize(max_listed);
+
+            frames.emplace_back(std::move(frame));
+        }
+    }
+
+    return frames;
+}
+
+namespace
+{
+    /// Deepest chain of `CLEO_CALL`s from an entry (a scope which isn't a call scope, or the code outside of any scope).
+    struct CallChain
+    {
+        const Script*       script;
+        optional<size_t>    entry;      //< Frame of the entry, or nullopt if outside of any scope.
+        std::vector<size_t> calls;      //< Frames of the call scopes in the chain, outermost first.
+        uint32_t            slots = 0;  //< Slots taken by the entry and every call frame in the chain.
+    };
+}
+
+/// Finds the deepest call chain from each entry calling any call scope, deepest first.
+///
+/// Recursive calls are not followed, as their depth depends on the values of the variables.
+static std::vector<CallChain> deepest_call_chains(const std::vector<shared_ptr<Script>>& scripts,
+                                                  const std::vector<FrameInfo>& frames)
+{
+    using Chain = std::pair<std::vector<size_t>, uint32_t>; // Frames and the slots taken by them.
+
+    std::unordered_map<const Scope*, size_t> frame_of_scope;
+    for(size_t i = 0; i < frames.size(); ++i)
+        frame_of_scope.emplace(frames[i].scope, i);
+
+    // The deepest chain from each call scope, itself included. Chains cut at a recursive call depend on the
+    // path taken into the recursion, thus those aren't remembered.
+    std::unordered_map<const Scope*, Chain> deepest;
+    std::set<const Scope*> visiting;
+
+    std::function<Chain(const Scope*, bool&)> deepest_from;
+    auto deepest_of = [&](const std::vector<const Scope*>& scopes, bool& is_cut)
+    {
+        Chain best;
+        for(auto callee : scopes)
+        {
+            if(!callee->is_call_scope())
+                continue;
+
+            if(visiting.count(callee))
+            {
+                is_cut = true;
+                continue;
+            }
+
+            auto chain = deepest_from(callee, is_cut);
+            if(chain.first.size() > best.first.size()
+                || (chain.first.size() == best.first.size() && chain.second > best.second))
+                best = std::move(chain);
+        }
+        return best;
+    };
+
+    deepest_from = [&](const Scope* scope, bool& is_cut) -> Chain
+    {
+        auto it = deepest.find(scope);
+        if(it != deepest.end())
+            return it->second;
+
+        auto frame = frame_of_scope.at(scope);
+
+        bool is_chain_cut = false;
+        visiting.emplace(scope);
+        auto chain = deepest_of(scope->cleo_callees, is_chain_cut);
+        visiting.erase(scope);
+
+        chain.first.insert(chain.first.begin(), frame);
+        chain.second += frames[frame].slots();
+
+        if(is_chain_cut)
+            is_cut = true;
+        else
+            deepest.emplace(scope, chain);
+
+        return chain;
+    };
+
+    std::vector<CallChain> chains;
+    for(auto& script : scripts)
+    {
+        bool is_cut = false;
+        auto best = deepest_of(script->cleo_callees, is_cut);
+        if(!best.first.empty())
+            chains.emplace_back(CallChain { script.get(), nullopt, std::move(best.first), best.second });
+    }
+
+    for(size_t i = 0; i < frames.size(); ++i)
+    {
+        if(frames[i].scope->is_call_scope())
+            continue;
+
+        bool is_cut = false;
+        auto best = deepest_of(frames[i].scope->cleo_callees, is_cut);
+        if(!best.first.empty())
+            chains.emplace_back(CallChain { frames[i].script, i, std::move(best.first), best.second + frames[i].slots() });
+    }
+
+    std::stable_sort(chains.begin(), chains.end(), [](const CallChain& a, const CallChain& b) {
+        return a.calls.size() > b.calls.size() || (a.calls.size() == b.calls.size() && a.slots > b.slots);
+    });
+
+    return chains;
+}
+
+void print_frame_report(const std::vector<shared_ptr<Script>>& scripts, const SymTable& symbols,
+                        const ProgramContext& program, const TextSink& sink)
+{
+    auto frames = collect_frames(scripts, symbols, program);
+    auto chains = deepest_call_chains(scripts, frames);
+
+    auto where = [](const FrameInfo& frame) {
+        return fmt::format("{}:{}:{}", frame.script->path.filename().generic_u8string(), frame.line, frame.column);
+    };
+
+    if(program.opt.frame_report == Options::ReportFormat::Table)
+    {
+        auto row = "{:<32} {:<5} {:<24} {:>5} {:>5} {:>8} {:>6}  {}\n";
+
+        std::string out = fmt::format(row, "SCOPE", "KIND", "LABEL", "VARS", "SLOTS", "HEADROOM", "TIMERS", "LARGEST ARRAYS");
+        for(auto& frame : frames)
+        {
+            std::string arrays;
+            for(auto& array : frame.arrays)
+                arrays += fmt::format("{}{}[{}]", arrays.empty()? "" : " ", array.first, array.second);
+
+            out += fmt::format(row, where(frame), frame.scope->is_call_scope()? "call" : "scope",
+                               frame.label.empty()? "-" : frame.label, frame.num_vars, frame.slots(), frame.headroom,
+                               frame.timer_headroom? std::to_string(*frame.timer_headroom) : "-", arrays);
+        }
+
+        if(!chains.empty())
+        {
+            auto chain_row = "{:<32} {:<24} {:>5} {:>5}  {}\n";
+
+            out += "\n";
+            out += fmt::format(chain_row, "ENTRY", "LABEL", "DEPTH", "SLOTS", "DEEPEST CALL CHAIN");
+            for(auto& chain : chains)
+            {
+                std::string calls;
+                for(auto i : chain.calls)
+                    calls += fmt::format("{}{}", calls.empty()? "" : " > ", frames[i].label.empty()? where(frames[i]) : frames[i].label);
+
+                if(chain.entry)
+                {
+                    auto& entry = frames[*chain.entry];
+                    out += fmt::format(chain_row, where(entry), entry.label.empty()? "-" : entry.label,
+                                       chain.calls.size(), chain.slots, calls);
+                }
+                else
+                {
+                    out += fmt::format(chain_row, chain.script->path.filename().generic_u8string(), "-",
+                                       chain.calls.size(), chain.slots, calls);
+                }
+            }
+        }
+
+        sink(out);
+    }
+    else if(program.opt.frame_report == Options::ReportFormat::JSON)
+    {
+        /*
+            {
+                "frames": [{
+                    "file": string, "line": integer, "column": integer,
+                    "kind": "scope" | "call",
+                    "label": string | null,
+                    "vars": integer, "begin": integer, "end": integer, "slots": integer,
+                    "headroom": integer,                // to the local variable limit
+                    "timer_headroom": integer | null,   // null if the frame is above the timers
+                    "arrays": [{"name": string, "slots": integer}],
+                }],
+                "call_chains": [{                       // deepest first
+                    "file": string,
+                    "entry": integer | null,            // index into frames, null if outside of any scope
+                    "calls": [integer],                 // indices into frames, outermost first
+                    "slots": integer,                   // of the entry and every call frame
+                }],
+            }
+        */
+        std::string out = "{\"frames\": [";
+        for(size_t i = 0; i < frames.size(); ++i)
+        {
+            auto& frame = frames[i];
+
+            std::string arrays;
+            for(auto& array : frame.arrays)
+                arrays += fmt::format(R"({}{{"name": {}, "slots": {}}})", arrays.empty()? "" : ", ",
+                                      make_quoted(array.first), array.second);
+
+            out += fmt::format(R"({}{{"file": {}, "line": {}, "column": {}, "kind": "{}", "label": {}, )"
+                               R"("vars": {}, "begin": {}, "end": {}, "slots": {}, "headroom": {}, "timer_headroom": {}, )"
+                               R"("arrays": [{}]}})",
+                               i? ", " : "", make_quoted(frame.script->path.generic_u8string()), frame.line, frame.column,
+                               frame.scope->is_call_scope()? "call" : "scope",
+                               frame.label.empty()? "null" : make_quoted(frame.label),
+                               frame.num_vars, frame.begin, frame.end, frame.slots(), frame.headroom,
+                               frame.timer_headroom? std::to_string(*frame.timer_headroom) : "null", arrays);
+        }
+
+        out += "], \"call_chains\": [";
+        for(size_t i = 0; i < chains.size(); ++i)
+        {
+            auto& chain = chains[i];
+
+            std::string calls;
+            for(auto frame : chain.calls)
+                calls += fmt::format("{}{}", calls.empty()? "" : ", ", frame);
+
+            out += fmt::format(R"({}{{"file": {}, "entry": {}, "calls": [{}], "slots": {}}})",
+                               i? ", " : "", make_quoted(chain.script->path.generic_u8string()),
+                               chain.entry? std::to_string(*chain.entry) : "null", calls, chain.slots);
+        }
+        out += "]}\n";
+
+        sink(out);
+    }
+}
@@ -0,0 +1,23 @@
+///
+/// Frame Report
+///
+/// Describes the local variable frame of every scope (`--frame-report`), so the scripts getting close to the local
+/// variable limits can be spotted before any of them is exceeded.
+///
+/// For each scope it gives the slots (words) taken by its variables, its largest arrays and the headroom to the local
+/// variable limit (`-flocal-var-limit`, or `-fmission-var-limit` in missions) and to the timers (`-ftimer-index`),
+/// when the frame lies below them. Call scopes (CLEO_CALL frames) are listed as well. Since each CLEO_CALL keeps the
+/// frame of its caller alive, the deepest chain of calls from each scope is given with the slots taken by all of its frames.
+///
+/// It's computed from the variables of the scopes and the `CLEO_CALL` targets recorded while annotating the tree
+/// (`Scope::cleo_callees`) without walking it again, thus it is cheap enough to be run on every build. It's given
+/// after the variables are scanned and the call scopes fixed (see `Script::fix_call_scope_variables`).
+///
+#pragma once
+#include <stdinc.h>
+#include "symtable.hpp"
+#include "program.hpp"
+
+/// Prints the frame report of `scripts` in the `program.opt.frame_report` format into `sink`.
+void print_frame_report(const std::vector<shared_ptr<Script>>& scripts, const SymTable& symbols,
+                        const ProgramContext& program, const TextSink& sink);
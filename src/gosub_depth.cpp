@@ -0,0 +1,145 @@
+#include <stdinc.h>
+#include "gosub_depth.hpp"
+
+/// Depth of the components which may recurse.
+static constexpr uint32_t unbounded = UINT32_MAX;
+
+namespace
+{
+    using Edge = CodeGraph::Edge;
+
+    /// The depth reached from each component of a graph.
+    struct Depths
+    {
+        std::vector<uint32_t>                       depth;      //< Possibly `unbounded`.
+        std::vector<std::pair<uint32_t, const Edge*>> witness;  //< The edge (and its node) leaving each component into
+                                                                //< its deepest path, if it reaches any call.
+        std::vector<std::pair<uint32_t, const Edge*>> recursion;//< A GOSUB edge inside each component, if any.
+    };
+}
+
+static uint32_t weight(const Edge& edge)
+{
+    return edge.kind == CodeGraph::EdgeKind::Gosub? 1 : 0;
+}
+
+static Depths compute_depths(const CodeGraph& graph, const CodeGraph::Components& components)
+{
+    Depths result;
+    result.depth.reserve(components.size());
+    result.witness.reserve(components.size());
+    result.recursion.reserve(components.size());
+
+    // The components reachable from a component are numbered before it, so their depth is known.
+    for(uint32_t id = 0; id < components.size(); ++id)
+    {
+        uint32_t depth = 0;
+        std::pair<uint32_t, const Edge*> witness(CodeGraph::no_node, nullptr);
+        std::pair<uint32_t, const Edge*> recursion(CodeGraph::no_node, nullptr);
+
+        for(auto member = components.begin(id); member != components.end(id); ++member)
+        {
+            for(auto edge = graph.begin(*member); edge != graph.end(*member); ++edge)
+            {
+                auto to_component = components.component[edge->to];
+                if(to_component == id)
+                {
+                    if(weight(*edge) && !recursion.second)
+                        recursion = std::make_pair(*member, edge);
+                    continue;
+                }
+
+                auto to_depth = result.depth[to_component];
+                auto edge_depth = (to_depth == unbounded)? unbounded : to_depth + weight(*edge);
+                if(edge_depth > depth || (edge_depth == depth && weight(*edge) && !witness.second))
+                {
+                    depth = edge_depth;
+                    witness = std::make_pair(*member, edge);
+                }
+            }
+        }
+
+        result.depth.push_back(recursion.second? unbounded : depth);
+        result.witness.push_back(witness);
+        result.recursion.push_back(recursion);
+    }
+
+    return result;
+}
+
+void check_gosub_depth(const CodeGraph& graph, const SymTable& symbols, ProgramContext& program)
+{
+    if(!program.opt.gosub_depth_limit)
+        return;
+
+    const uint32_t limit = *program.opt.gosub_depth_limit;
+
+    auto& components = graph.components();
+    auto depths = compute_depths(graph, components);
+
+    std::unordered_map<const Label*, string_view> label_names;
+    for(auto& pair : symbols.labels)
+        label_names.emplace(pair.second.get(), pair.first);
+
+    auto target_name = [&](uint32_t node) -> std::string {
+        for(auto& arg : graph.command(node).args)
+        {
+            if(is<shared_ptr<Label>>(arg))
+            {
+                auto it = label_names.find(get<shared_ptr<Label>>(arg).get());
+                if(it != label_names.end())
+                    return it->second.to_string();
+            }
+        }
+        return "?";
+    };
+
+    auto diagnose = [&](bool is_note, const SyntaxTree* where, const std::string& message) {
+        if(is_note)
+            where? program.note(*where, "{}", message) : program.note(nocontext, "{}", message);
+        else
+            where? program.warning(*where, "{}", message) : program.warning(nocontext, "{}", message);
+    };
+
+    for(auto& recursion : depths.recursion)
+    {
+        if(recursion.second)
+        {
+            auto from = recursion.first;
+            diagnose(false, graph.command(from).where,
+                     fmt::format("GOSUB to '{}' may call itself again before returning, overflowing the GOSUB stack "
+                                 "[-fgosub-depth-limit]", target_name(from)));
+        }
+    }
+
+    std::vector<bool> reported(graph.size());
+    for(auto& entry : graph.entries())
+    {
+        auto component = components.component[entry.node];
+        auto depth = depths.depth[component];
+        if(depth == unbounded || depth <= limit || reported[entry.node])
+            continue;
+
+        reported[entry.node] = true;
+
+        auto message = fmt::format("GOSUB calls may nest {} deep in the script started here, but there's only room for {} "
+                                   "[-fgosub-depth-limit]", depth, limit);
+        if(auto label = entry.label? entry.label->where.lock() : nullptr)
+            program.warning(*label, "{}", message);
+        else
+            diagnose(false, entry.where, message);
+
+        for(uint32_t nesting = 0; depths.witness[component].second; )
+        {
+            auto from = depths.witness[component].first;
+            auto edge = depths.witness[component].second;
+            if(weight(*edge))
+            {
+                nesting += weight(*edge);
+                diagnose(true, graph.command(from).where,
+                         fmt::format("GOSUB to '{}' nests {} deep", target_name(from), nesting));
+            }
+            component = components.component[edge->to];
+        }
+    }
+}
@@ -0,0 +1,24 @@
+///
+/// GOSUB Depth
+///
+/// The script engine stores the return addresses of GOSUB in a small fixed stack per script thread (6 entries in III
+/// and Vice City, 8 in San Andreas), which is silently overrun if the calls nest any deeper. This verifies, statically,
+/// that no script thread may nest its GOSUB calls deeper than `-fgosub-depth-limit`.
+///
+/// The analysis runs on the graph of the compiled IR of all scripts (see code_graph.hpp), where the GOSUB edges add
+/// one to the depth. Calls which don't take a return address from the GOSUB stack (`CLEO_CALL`) are followed, but
+/// add nothing.
+///
+/// The depth a command may reach is the heaviest path from it, which is memoized per strongly connected component of
+/// the graph, so every label is solved once and the whole analysis is linear in the size of the program. A component
+/// containing a GOSUB edge is a recursion, and has no bounded depth.
+///
+/// Each script thread is given a warning if its depth is over the limit, followed by the chain of calls reaching such
+/// depth.
+///
+#pragma once
+#include <stdinc.h>
+#include "code_graph.hpp"
+
+/// Verifies the GOSUB nesting depth of every script thread in `graph` is within `program.opt.gosub_depth_limit`.
+void check_gosub_depth(const CodeGraph& graph, const SymTable& symbols, ProgramContext& program);
@@ -0,0 +1,336 @@
+#include <stdinc.h>
+#include "layout_lock.hpp"
+
+/// Indices at the beginning of the global variable space taken by the GOTO over it.
+static constexpr uint32_t reserved_indices = 2;
+
+/// Size of the global variable space, in bytes, as its offsets are encoded in 16 bits.
+static constexpr uint64_t global_space_size = 0x10000;
+
+namespace
+{
+    struct LockedVar
+    {
+        std::string         name;
+        VarType             type;
+        uint32_t            index;
+        optional<uint32_t>  count;
+        bool                declared = false;
+
+        uint32_t space_taken() const { return Var::space_taken(type, count.value_or(1)); }
+    };
+}
+
+static const char* to_string(VarType type)
+{
+    switch(type)
+    {
+        case VarType::Int:          return "INT";
+        case VarType::Float:        return "FLOAT";
+        case VarType::TextLabel:    return "TEXT_LABEL";
+        case VarType::TextLabel16:  return "TEXT_LABEL16";
+        default:                    Unreachable();
+    }
+}
+
+static optional<VarType> var_type_from_string(const string_view& name)
+{
+    for(auto type : { VarType::Int, VarType::Float, VarType::TextLabel, VarType::TextLabel16 })
+    {
+        if(name == to_string(type))
+            return type;
+    }
+    return nullopt;
+}
+
+static optional<uint32_t> parse_uint(const string_view& string)
+{
+    uint32_t value;
+    auto result = from_chars(string.begin(), string.end(), value);
+    if(string.empty() || result.ec != std::errc() || result.ptr != string.end())
+        return nullopt;
+    return value;
+}
+
+/// Parses a `<offset> <type> <name>[<count>]` line of the lock file.
+static optional<LockedVar> parse_locked_var(const string_view& line)
+{
+    std::vector<string_view> words;
+    for(auto it = line.begin(); it != line.end(); )
+    {
+        auto is_space = [](char c) { return c == ' ' || c == '\t'; };
+        auto beg_word = std::find_if_not(it, line.end(), is_space);
+        auto end_word = std::find_if(beg_word, line.end(), is_space);
+        if(beg_word != end_word)
+            words.emplace_back(beg_word, end_word - beg_word);
+        it = end_word;
+    }
+
+    if(words.size() != 3)
+        return nullopt;
+
+    auto opt_offset = parse_uint(words[0]);
+    auto opt_type = var_type_from_string(words[1]);
+    if(!opt_offset || *opt_offset % 4 != 0 || !opt_type)
+        return nullopt;
+
+    LockedVar var;
+    var.index = *opt_offset / 4;
+    var.type = *opt_type;
+
+    auto name = words[2];
+    auto bracket = std::find(name.begin(), name.end(), '[');
+    if(bracket != name.end())
+    {
+        if(name.back() != ']' || bracket == name.begin())
+            return nullopt;
+
+        var.count = parse_uint(string_view(bracket + 1, name.end() - bracket - 2));
+        if(!var.count || *var.count == 0)
+            return nullopt;
+
+        name = string_view(name.begin(), bracket - name.begin());
+    }
+
+    if(uint64_t(var.index) * 4 + uint64_t(var.space_taken()) * 4 > global_space_size)
+        return nullopt;
+
+    var.name = name.to_string();
+    return var;
+}
+
+static std::vector<LockedVar> read_layout_lock(const fs::path& path, ProgramContext& program)
+{
+    auto opt_text = read_file_utf8(path);
+    if(!opt_text)
+        program.fatal_error(nocontext, "failed to read layout lock '{}'", path.u8string());
+
+    std::vector<LockedVar> locked;
+    string_view text = *opt_text;
+    size_t lineno = 1;
+    for(auto it = text.begin(); it != text.end(); ++lineno)
+    {
+        auto end_line = std::find(it, text.end(), '\n');
+        string_view line(it, end_line - it);
+        it = (end_line == text.end())? end_line : std::next(end_line);
+
+        if(!line.empty() && line.back() == '\r')
+            line.remove_suffix(1);
+
+        auto first = std::find_if(line.begin(), line.end(), [](char c) { return c != ' ' && c != '\t'; });
+        if(first == line.end() || *first == '#')
+            continue;
+
+        auto opt_var = parse_locked_var(line);
+        if(!opt_var)
+            program.fatal_error(nocontext, "{}:{}: malformed layout lock entry", path.u8string(), lineno);
+
+        locked.emplace_back(std::move(*opt_var));
+    }
+
+    return locked;
+}
+
+void apply_layout_lock(SymTable& symbols, ProgramContext& program)
+{
+    if(!program.opt.layout_lock || !fs::exists(*program.opt.layout_lock))
+        return;
+
+    const auto& path = *program.opt.layout_lock;
+    auto locked = read_layout_lock(path, program);
+
+    std::unordered_map<string_view, LockedVar*, ihash, iequal_to> locked_by_name;
+    locked_by_name.reserve(locked.size());
+    for(auto& var : locked)
+    {
+        if(!locked_by_name.emplace(var.name, &var).second)
+            program.fatal_error(nocontext, "layout lock '{}' has '{}' more than once", path.u8string(), var.name);
+    }
+
+    std::vector<std::pair<string_view, Var*>> globals;
+    globals.reserve(symbols.global_vars.size());
+    for(auto& pair : symbols.global_vars)
+        globals.emplace_back(pair.first, pair.second.get());
+
+    // The declaration order.
+    std::sort(globals.begin(), globals.end(), [](const auto& a, const auto& b) {
+        return a.second->index < b.second->index;
+    });
+
+    std::vector<bool> used(reserved_indices, true);
+    auto take = [&](uint32_t index, uint32_t space) {
+        if(used.size() < index + space)
+            used.resize(index + space, false);
+        for(auto i = index; i < index + space; ++i)
+            used[i] = true;
+    };
+
+    auto is_free = [&](uint32_t index, uint32_t space) {
+        return index >= reserved_indices
+            && std::none_of(used.begin() + std::min<size_t>(index, used.size()),
+                            used.begin() + std::min<size_t>(index + space, used.size()),
+                            [](bool b) { return b; });
+    };
+
+    auto check_type = [&](const string_view& name, const Var& var, const LockedVar& lock) {
+        if(lock.type != var.type)
+        {
+            program.warning(var.where, "global variable '{}' was locked as {}, thus its value in older saves is "
+                                       "taken as {}", name.to_string(), to_string(lock.type), to_string(var.type));
+        }
+    };
+
+    std::vector<Var*> pending;
+    std::vector<std::tuple<string_view, Var*, LockedVar*>> resized;
+    for(auto& global : globals)
+    {
+        auto& name = global.first;
+        auto& var = *global.second;
+
+        auto it = locked_by_name.find(name);
+        if(it == locked_by_name.end())
+        {
+            pending.push_back(&var);
+            continue;
+        }
+
+        auto& lock = *it->second;
+        lock.declared = true;
+
+        if(lock.index < reserved_indices)
+        {
+            program.fatal_error(nocontext, "layout lock '{}' has '{}' overlapping other variables",
+                                path.u8string(), lock.name);
+        }
+
+        if(lock.space_taken() != var.space_taken())
+        {
+            resized.emplace_back(name, &var, &lock);
+            continue;
+        }
+
+        check_type(name, var, lock);
+
+        if(!is_free(lock.index, lock.space_taken()))
+        {
+            program.fatal_error(nocontext, "layout lock '{}' has '{}' overlapping other variables",
+                                path.u8string(), lock.name);
+        }
+
+        var.index = lock.index;
+        take(var.index, var.space_taken());
+    }
+
+    // The resized variables stay at their locked offset if the space after it is free once the others are placed.
+    // Their locked spaces are kept for themselves, so a variable can't grow into the one of another.
+    auto release = [&](uint32_t index, uint32_t space) {
+        for(auto i = index; i < index + space && i < used.size(); ++i)
+            used[i] = false;
+    };
+
+    for(auto& resize : resized)
+        take(std::get<2>(resize)->index, std::get<2>(resize)->space_taken());
+
+    for(auto& resize : resized)
+    {
+        auto& var = *std::get<1>(resize);
+        auto& lock = *std::get<2>(resize);
+        const auto locked_space = lock.space_taken();
+        const auto space = var.space_taken();
+
+        if(space < locked_space)
+        {
+            release(lock.index + space, locked_space - space);
+            var.index = lock.index;
+            check_type(std::get<0>(resize), var, lock);
+            continue;
+        }
+
+        if(is_free(lock.index + locked_space, space - locked_space)
+        && uint64_t(lock.index + space) * 4 <= global_space_size)
+        {
+            var.index = lock.index;
+            take(var.index, space);
+            check_type(std::get<0>(resize), var, lock);
+            continue;
+        }
+
+        release(lock.index, locked_space);
+        program.warning(var.where, "global variable '{}' doesn't fit its locked space at offset {}, thus it's moved "
+                                   "and loses its value in older saves", std::get<0>(resize).to_string(), lock.index * 4);
+        pending.push_back(&var);
+    }
+
+    // The variables not placed yet still have their index in declaration order.
+    std::stable_sort(pending.begin(), pending.end(), [](const Var* a, const Var* b) {
+        return a->index < b->index;
+    });
+
+    for(auto& lock : locked)
+    {
+        if(!lock.declared)
+        {
+            program.warning(nocontext, "global variable '{}' locked at offset {} is not declared anymore, thus its "
+                                       "space is given to other variables", lock.name, lock.index * 4);
+        }
+    }
+
+    // The free space is searched from the last variable placed, so the new variables keep their declaration order.
+    uint32_t cursor = reserved_indices;
+    for(auto var : pending)
+    {
+        const auto space = var->space_taken();
+        for(uint32_t i = cursor; ; ++i)
+        {
+            if(i >= used.size() || !used[i])
+            {
+                if(i - cursor + 1 >= space)
+                {
+                    var->index = i + 1 - space;
+                    take(var->index, space);
+                    cursor = i + 1;
+                    break;
+                }
+            }
+            else
+            {
+                cursor = i + 1;
+            }
+        }
+    }
+
+    symbols.highest_gvar = nullptr;
+    for(auto& global : symbols.global_vars)
+    {
+        auto& var = global.second;
+        if(!symbols.highest_gvar || var->end_offset() > symbols.highest_gvar->end_offset())
+            symbols.highest_gvar = var;
+    }
+}
+
+void write_layout_lock(const SymTable& symbols, ProgramContext& program)
+{
+    if(!program.opt.layout_lock)
+        return;
+
+    std::vector<std::pair<string_view, const Var*>> globals;
+    globals.reserve(symbols.global_vars.size());
+    for(auto& pair : symbols.global_vars)
+        globals.emplace_back(pair.first, pair.second.get());
+
+    std::sort(globals.begin(), globals.end(), [](const auto& a, const auto& b) {
+        return a.second->index < b.second->index;
+    });
+
+    std::string out = "# Global variable layout, kept by gta3sc --layout-lock.\n"
+                      "# <offset> <type> <name>[<count>]\n";
+    for(auto& global : globals)
+    {
+        auto& var = *global.second;
+        out += fmt::format("{} {} {}", var.index * 4, to_string(var.type), global.first.to_string());
+        out += var.count? fmt::format("[{}]\n", *var.count) : "\n";
+    }
+
+    if(!write_file(*program.opt.layout_lock, out.data(), out.size()))
+        program.error(nocontext, "failed to write layout lock '{}'", program.opt.layout_lock->u8string());
+}
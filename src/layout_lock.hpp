@@ -0,0 +1,29 @@
+///
+/// Layout Lock
+///
+/// The savegames store the global variable space as is, thus a global variable moving to another offset (e.g. because
+/// a VAR_INT was inserted into an earlier include) takes the value of another variable once an older save is loaded.
+/// The layout lock (`--layout-lock=<file>`) keeps the offsets of the global variables the same across builds.
+///
+/// The lock file has a line for each global variable, as in `<offset> <type> <name>` or `<offset> <type> <name>[<count>]`
+/// for arrays, where the offset is in bytes and the type is one of `INT`, `FLOAT`, `TEXT_LABEL` or `TEXT_LABEL16`.
+/// Empty lines and lines beginning with `#` are ignored.
+///
+/// Once the symbols are scanned, the locked variables are moved back into their offsets, and the others fill the space
+/// left free by them, in the order they are declared. The locked variables which aren't declared anymore, or which
+/// changed their type, are reported. A variable whose size changed can't keep its offset, and is moved like a new one.
+///
+/// The variables are looked up in the lock by hashing, and the free space is searched from the last variable placed,
+/// so a lock with thousands of variables costs close to nothing. After a successful build, the lock file is rewritten
+/// with the resulting layout, including the new variables.
+///
+#pragma once
+#include <stdinc.h>
+#include "symtable.hpp"
+#include "program.hpp"
+
+/// Moves the global variables of `symbols` into the layout in the `program.opt.layout_lock` file, if it exists.
+void apply_layout_lock(SymTable& symbols, ProgramContext& program);
+
+/// Writes the layout of the global variables of `symbols` into the `program.opt.layout_lock` file.
+void write_layout_lock(const SymTable& symbols, ProgramContext& program);
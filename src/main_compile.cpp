@@ -3,7 +3,15 @@
 #include "parser.hpp"
 #include "symtable.hpp"
 #include "codegen.hpp"
+#include "codegen_ir2.hpp"
 #include "cdimage.hpp"
+#include "debug_map.hpp"
+#include "frame_report.hpp"
+#include "gosub_depth.hpp"
+#include "wait_loops.hpp"
+#include "shared_globals.hpp"
+#include "entity_leaks.hpp"
+#include "layout_lock.hpp"
 
 using RequiredFrom = std::vector<weak_ptr<const Script>>;
 using IncluderPair = std::pair<shared_ptr<Script>, IncluderTable>;
@@ -48,9 +56,11 @@ namespace
                          ProgramContext& program);
 
     void check_expect_vars(const Script& main, const SymTable&, ProgramContext&);
+
+    void check_half_floats(const std::vector<shared_ptr<Script>>& scripts, ProgramContext&);
 }
 
-int compile(fs::path input, fs::path output, ProgramContext& program)
+int compile(fs::path input, fs::path output, ProgramContext& program, const TextSink& stdout_sink)
 {
     if(output.empty())
     {
@@ -78,6 +88,8 @@ int compile(fs::path input, fs::path output, ProgramContext& program)
 
         const auto use_script_img = (program.opt.streamed_scripts && !program.opt.headerless);
 
+        program.begin_stage("parse");
+
         shared_ptr<Script> main = Script::create(input, main_type, program);
 
         if(!main)
@@ -93,20 +105,29 @@ int compile(fs::path input, fs::path output, ProgramContext& program)
         if(program.has_error())
             throw ProgramFailure();
 
+        program.begin_stage("symbols");
+
         SymTable symbols = scan_symbols(std::move(ictable), scripts, program);
         symbols.check_scope_collisions(program);
         symbols.check_constant_collisions(program);
+        apply_layout_lock(symbols, program);
 
         if(program.has_error())
             throw ProgramFailure();
 
+        program.begin_stage("annotate");
+
         std::for_each(scripts.begin(), scripts.end(), [&](const auto& script) {
             script->annotate_tree(symbols, program);
         });
 
+        check_half_floats(scripts, program);
+
         if(program.has_error())
             throw ProgramFailure();
 
+        program.begin_stage("scopes");
+
         std::for_each(scripts.begin(), scripts.end(), [&](const auto& script) {
             script->compute_scope_outputs(symbols, program);
             script->fix_call_scope_variables(program);
@@ -115,6 +136,9 @@ int compile(fs::path input, fs::path output, ProgramContext& program)
         if(program.has_error())
             throw ProgramFailure();
 
+        if(program.opt.frame_report != Options::ReportFormat::None)
+            print_frame_report(scripts, symbols, program, stdout_sink);
+
         check_expect_vars(*main, symbols, program);
 
         Script::handle_special_commands(scripts, symbols, program);
@@ -129,13 +153,32 @@ int compile(fs::path input, fs::path output, ProgramContext& program)
                 program.error(nocontext, "use of non-default model {} in custom script", model);
         }
 
+        program.begin_stage("codegen");
+
         auto gens = generate_ir(symbols, scripts, program);
 
+        if(program.opt.gosub_depth_limit || program.opt.warn_wait_free_loop || program.opt.warn_entity_leak
+        || program.opt.shared_globals_report != Options::ReportFormat::None)
+        {
+            auto graph = CodeGraph::from_ir(gens);
+            check_gosub_depth(graph, symbols, program);
+            check_wait_free_loops(graph, program);
+            check_entity_leaks(graph, program);
+
+            if(program.opt.shared_globals_report != Options::ReportFormat::None)
+                print_shared_globals_report(graph, symbols, program, stdout_sink);
+        }
+
         if(program.has_error())
             throw ProgramFailure();
 
         if(program.opt.fsyntax_only)
+        {
+            program.end_stage();
             return EXIT_SUCCESS;
+        }
+
+        program.begin_stage("layout");
 
         auto multi_headers = build_headers(gens, symbols, models, main, scripts, program);
 
@@ -146,6 +189,8 @@ int compile(fs::path input, fs::path output, ProgramContext& program)
         if(program.has_error())
             throw ProgramFailure();
 
+        program.begin_stage("output");
+
         if(program.opt.emit_ir2)
         {
             FILE *outstream = 0;
@@ -153,17 +198,25 @@ int compile(fs::path input, fs::path output, ProgramContext& program)
             std::vector<uint8_t> script_img;
 
             auto guard = make_scope_guard([&] {
-                if(outstream && outstream != stdout) fclose(outstream);
+                if(outstream) fclose(outstream);
             });
 
-            outstream = (output != "-"? u8fopen(output, "wb") : stdout);
-            if(outstream == nullptr)
-                program.fatal_error(nocontext, "failed to open output for writing");
+            if(output != "-")
+            {
+                outstream = u8fopen(output, "wb");
+                if(outstream == nullptr)
+                    program.fatal_error(nocontext, "failed to open output for writing");
+            }
 
             bool is_first_line = true;
             auto print_ir2_line = [&](const std::string& line)
             {
-                if(is_first_line)
+                if(!outstream)
+                {
+                    stdout_sink(is_first_line? line : '\n' + line);
+                    is_first_line = false;
+                }
+                else if(is_first_line)
                 {
                     is_first_line = false;
                     fprintf(outstream, "%s", line.c_str());
@@ -174,13 +227,17 @@ int compile(fs::path input, fs::path output, ProgramContext& program)
                 }
             };
 
-            generate_output(gens, multi_headers, main_scm, script_img, use_script_img, program);
-
-            auto status = decompile(main_scm.data(), main_scm.size(),
-                                    script_img.data(), script_img.size(), program,
-                                    Options::Lang::IR2, print_ir2_line);
-            if(!status)
-                throw ProgramFailure();
+            if(!generate_ir2(gens, multi_headers, program, print_ir2_line))
+            {
+                // the IR cannot be printed without knowing how the bytecode disassembles, so take the long path.
+                generate_output(gens, multi_headers, main_scm, script_img, use_script_img, program);
+
+                auto status = decompile(main_scm.data(), main_scm.size(),
+                                        script_img.data(), script_img.size(), program,
+                                        Options::Lang::IR2, print_ir2_line);
+                if(!status)
+                    throw ProgramFailure();
+            }
         }
         else
         {
@@ -203,7 +260,20 @@ int compile(fs::path input, fs::path output, ProgramContext& program)
             }
 
             generate_output(gens, multi_headers, main_scm, script_img, use_script_img, program);
+
+            if(program.opt.debug_map)
+            {
+                auto map = DebugMap::from_generators(gens, symbols, output.filename().u8string(), input.parent_path());
+                auto data = map.encode();
+                if(!write_file(fs::path(output) += ".dbg", data.data(), data.size()))
+                    program.error(nocontext, "failed to write debug map");
+            }
         }
+
+        if(!program.has_error())
+            write_layout_lock(symbols, program);
+
+        program.end_stage();
         
         if(program.has_error())
             throw ProgramFailure();
@@ -212,7 +282,7 @@ int compile(fs::path input, fs::path output, ProgramContext& program)
     }
     catch(const ProgramFailure&)
     {
-        fprintf(stderr, "gta3sc: compilation failed\n");
+        program.puts("gta3sc: compilation failed");
         return EXIT_FAILURE;
     }
 }
@@ -548,7 +618,7 @@ void generate_output(const std::vector<CodeGenerator>& gens,
         if(!gen.script->is_child_of(ScriptType::StreamedScript))
         {
             write_headers(main_scm, gen.script->base.value(), gen.script);
-            write_file(main_scm, gen.script->code_offset.value(), gen.buffer(), gen.buffer_size());
+            gen.write_code(main_scm, gen.script->code_offset.value());
         }
         else
         {
@@ -634,15 +704,13 @@ void generate_output(const std::vector<CodeGenerator>& gens,
             size_t offset = directory[1+i].offset * 2048;
             offset += write_headers(script_img, offset, gen.script);
 
-            write_file(script_img, offset, gen.buffer(), gen.buffer_size());
-            offset += gen.buffer_size();
+            offset += gen.write_code(script_img, offset);
 
             for(auto& weakp : gen.script->children_scripts)
             {
                 auto required_script = weakp.lock();
                 auto& required_gen = *std::find_if(gens.begin(), gens.end(), [&](const auto& g) { return g.script == required_script; });
-                write_file(script_img, offset, required_gen.buffer(), required_gen.buffer_size());
-                offset += required_gen.buffer_size();
+                offset += required_gen.write_code(script_img, offset);
             }
         }
 
@@ -690,4 +758,53 @@ void check_expect_vars(const Script& main, const SymTable& symbols, ProgramConte
     }
 }
 
+void check_half_floats(const std::vector<shared_ptr<Script>>& scripts, ProgramContext& program)
+{
+    if(!program.opt.use_half_float)
+        return;
+
+    for(auto& script : scripts)
+    {
+        size_t num_floats = 0;
+        size_t num_inexact = 0;
+        float max_error = 0.0f;
+        double sum_error = 0.0;
+
+        script->tree->depth_first([&](const SyntaxTree& node)
+        {
+            auto opt_value = node.maybe_annotation<float>();
+            if(!opt_value)
+                return true;
+
+            ++num_floats;
+
+            auto fixed = to_half_float(*opt_value);
+            if(!fixed)
+            {
+                program.error(node, "float {} is out of the q11.4 range [-2048.0, 2047.9375]", *opt_value);
+                return false;
+            }
+
+            float encoded = *fixed / 16.0f;
+            float error = std::fabs(*opt_value - encoded);
+            if(error != 0.0f)
+            {
+                ++num_inexact;
+                max_error = std::max(max_error, error);
+                sum_error += error;
+
+                if(program.opt.warn_precision_loss && error > *program.opt.warn_precision_loss)
+                    program.warning(node, "float {} is encoded as {} in q11.4, losing {}", *opt_value, encoded, error);
+            }
+            return false;
+        });
+
+        if(program.opt.warn_precision_loss && num_inexact > 0)
+        {
+            program.note(*script, "{} of {} floats lose precision in q11.4, by up to {} (mean {})",
+                         num_inexact, num_floats, max_error, static_cast<float>(sum_error / num_inexact));
+        }
+    }
+}
+
 }
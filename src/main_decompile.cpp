@@ -1,9 +1,11 @@
 #include <stdinc.h>
 #include "program.hpp"
+#include "system.hpp"
 #include "disassembler.hpp"
 #include "decompiler_ir2.hpp"
+#include "decompiler_gta3.hpp"
 
-int decompile(fs::path input, fs::path output, ProgramContext& program)
+int decompile(fs::path input, fs::path output, ProgramContext& program, const TextSink& stdout_sink)
 {
     if(output.empty())
     {
@@ -15,44 +17,50 @@ int decompile(fs::path input, fs::path output, ProgramContext& program)
     {
         const Commands& commands = program.commands;
 
-        FILE* outstream;
+        FILE* outstream = nullptr;
 
         auto lang = (program.opt.emit_ir2? Options::Lang::IR2 : Options::Lang::GTA3Script);
 
         auto guard = make_scope_guard([&] {
-            if(outstream != stdout) fclose(outstream);
+            if(outstream) fclose(outstream);
         });
 
-        if(lang == Options::Lang::GTA3Script)
-            program.fatal_error(nocontext, "GTA3script output is disabled, please use -emit-ir2 for IR2 output");
-
-        outstream = (output != "-"? u8fopen(output, "wb") : stdout);
-        if(!outstream)
-            program.fatal_error(nocontext, "could not open file '{}' for writing", output.generic_u8string());
+        if(output != "-")
+        {
+            outstream = u8fopen(output, "wb");
+            if(!outstream)
+                program.fatal_error(nocontext, "could not open file '{}' for writing", output.generic_u8string());
+        }
 
         auto opt_bytecode = read_file_binary(input);
         if(!opt_bytecode)
             program.fatal_error(nocontext, "file '{}' does not exist", input.generic_u8string());
 
-        std::vector<uint8_t> script_img;
+        optional<MappedFile> script_img;
         if(program.opt.streamed_scripts)
         {
             auto img_path = fs::path(input).replace_filename("script.img");
-            if(auto opt = read_file_binary(img_path))
-                script_img = std::move(*opt);
-            else
+            script_img = MappedFile::open(img_path);
+            if(!script_img)
                 program.fatal_error(nocontext, "file '{}' does not exist", img_path.generic_u8string());
         }
 
-        auto println = [&](const std::string& line) { fprintf(outstream, "%s\n", line.c_str()); }; 
-        if(!decompile(opt_bytecode->data(), opt_bytecode->size(), script_img.data(), script_img.size(), program, lang, println))
+        auto println = [&](const std::string& line) {
+            if(outstream)
+                fprintf(outstream, "%s\n", line.c_str());
+            else
+                stdout_sink(line + '\n');
+        };
+        if(!decompile(opt_bytecode->data(), opt_bytecode->size(),
+                      script_img? script_img->data() : nullptr, script_img? script_img->size() : 0,
+                      program, lang, println))
             throw ProgramFailure();
 
         return 0;
     }
     catch(const ProgramFailure&)
     {
-        fprintf(stderr, "gta3sc: decompilation failed\n");
+        program.puts("gta3sc: decompilation failed");
         return EXIT_FAILURE;
     }
 }
@@ -163,8 +171,35 @@ bool decompile(const void* bytecode, size_t bytecode_size,
         if(program.has_error())
             throw ProgramFailure();
 
-        if(lang == Options::Lang::IR2)
+        if(lang == Options::Lang::IR2 || lang == Options::Lang::GTA3Script)
         {
+            // The segments are structured all at once, since each of them can be structured concurrently.
+            std::vector<std::vector<StructuredStatement>> structured;
+            size_t segment_id = 0;
+
+            if(lang == Options::Lang::GTA3Script)
+            {
+                std::vector<const std::vector<DecompiledData>*> segments;
+                segments.emplace_back(&main_segment_asm.get_data());
+                for(auto& mission_asm : mission_segments_asm)
+                    segments.emplace_back(&mission_asm.get_data());
+                for(size_t i = 0; i < stream_segments_asm.size(); ++i)
+                {
+                    if(i != ignore_stream_id)
+                        segments.emplace_back(&stream_segments_asm[i].get_data());
+                }
+                structured = structure_segments(segments, program.commands);
+            }
+
+            auto decompile_segment = [&](DecompilerIR2& ir2, const std::vector<DecompiledData>& data)
+            {
+                if(lang == Options::Lang::GTA3Script)
+                    decompile_gta3script(structured[segment_id], data, ir2, callback);
+                else
+                    ir2.decompile(callback);
+                ++segment_id;
+            };
+
             if(!program.opt.headerless)
             {
                 std::string temp_string;
@@ -188,14 +223,15 @@ bool decompile(const void* bytecode, size_t bytecode_size,
             }
 
             auto main_ir2 = DecompilerIR2(program.commands, main_segment_asm.get_data(), 0, main_segment.size, "MAIN", true);
-            main_ir2.decompile(callback);
+            decompile_segment(main_ir2, main_segment_asm.get_data());
 
             for(size_t i = 0; i < mission_segments_asm.size(); ++i)
             {
                 auto& mission_asm = mission_segments_asm[i];
                 auto script_name = fmt::format("MISSION_{}", i);
                 callback(fmt::format("#MISSION_BLOCK_START {}", (int)(i)));
-                DecompilerIR2(program.commands, mission_asm.get_data(), 0, mission_segments[i].size, std::move(script_name), false, main_ir2).decompile(callback);
+                DecompilerIR2 mission_ir2(program.commands, mission_asm.get_data(), 0, mission_segments[i].size, std::move(script_name), false, main_ir2);
+                decompile_segment(mission_ir2, mission_asm.get_data());
                 callback("#MISSION_BLOCK_END");
             }
 
@@ -206,7 +242,8 @@ bool decompile(const void* bytecode, size_t bytecode_size,
                     auto& stream_asm = stream_segments_asm[i];
                     auto script_name = fmt::format("STREAM_{}", i);
                     callback(fmt::format("#STREAMED_BLOCK_START {}", (int)(i)));
-                    DecompilerIR2(program.commands, stream_asm.get_data(), 0, stream_segments[i].size, std::move(script_name), false, main_ir2).decompile(callback);
+                    DecompilerIR2 stream_ir2(program.commands, stream_asm.get_data(), 0, stream_segments[i].size, std::move(script_name), false, main_ir2);
+                    decompile_segment(stream_ir2, stream_asm.get_data());
                     callback("#STREAMED_BLOCK_END");
                 }
             }
@@ -386,8 +386,6 @@ static void lex_dump(LexerContext& lexer, const char* begin, const char* end, si
 {
     auto it = begin;
 
-    lexer.hint_will_push_tokens(std::distance(begin, end) / 3);
-
     while(auto next_token = lex_gettok(it, end))
     {
         size_t tok_begin = begin_pos + std::distance(begin, next_token->first);
@@ -408,18 +406,9 @@ static void lex_dump(LexerContext& lexer, const char* begin, const char* end, si
         }
         else
         {
-            for(size_t xpos = 0; xpos < next_token->second; xpos += 2)
-            {
-                auto xpair = next_token->first + xpos;
-                if(!lex_isxdigit(xpair[0]) || !lex_isxdigit(xpair[1]))
-                {
-                    lexer.error({ tok_begin + xpos, tok_begin + xpos + 2 }, "invalid hexadecimal token");
-                }
-                else
-                {
-                    lexer.add_token(Token::Hexadecimal, tok_begin + xpos, 2);
-                }
-            }
+            // A single token for the whole run of digits, the parser splits it into bytes. A token per byte would
+            // take many times the memory of the blob itself on large dumps.
+            lexer.add_token(Token::Hexadecimal, tok_begin, next_token->second);
         }
 
         it = std::find_if_not(next_token->first + next_token->second, end, lex_iswhite);
@@ -771,13 +760,11 @@ TokenStream::TextStream::TextStream(std::string data_, std::string name_)
         // pushes first line offset
         this->line_offset.emplace_back(0);
 
-        for(const char* it = this->data.c_str(); *it; ++it)
+        // The data may contain null characters, thus it's walked up to its size.
+        for(size_t pos = 0; pos < this->data.size(); ++pos)
         {
-            if(*it == '\n')
-            {
-                size_t pos = (it - this->data.c_str());
+            if(this->data[pos] == '\n')
                 this->line_offset.emplace_back(pos + 1);
-            }
         }
 
         this->line_offset.shrink_to_fit();
@@ -789,9 +776,10 @@ std::string TokenStream::TextStream::get_line(size_t lineno) const
     size_t offset = offset_for_line(lineno);
 
     const char* start = this->data.c_str() + offset;
+    const char* data_end = this->data.c_str() + this->data.size();
     const char* end;
 
-    for(end = start; *end && *end != '\n' && *end != '\r'; ++end) {
+    for(end = start; end != data_end && *end != '\n' && *end != '\r'; ++end) {
     }
 
     return std::string(start, end);
@@ -808,12 +796,14 @@ size_t TokenStream::TextStream::offset_for_line(size_t lineno) const
 
 auto TokenStream::TextStream::linecol_from_offset(size_t offset) const -> std::pair<size_t, size_t>
 {
-    for(auto it = line_offset.begin(), end = line_offset.end(); it != end; ++it)
+    // line_offset is sorted, so the line is the last one starting at or before offset.
+    auto next_it = std::upper_bound(line_offset.begin(), line_offset.end(), offset);
+    if(next_it != line_offset.begin())
     {
-        auto next_it = std::next(it);
-        size_t next_line_offset = (next_it != end)? *next_it : this->max_offset;
+        auto it = std::prev(next_it);
+        size_t next_line_offset = (next_it != line_offset.end())? *next_it : this->max_offset;
 
-        if(offset >= *it && offset < next_line_offset)
+        if(offset < next_line_offset)
         {
             size_t lineno = size_t(std::distance(line_offset.begin(), it) + 1);
             size_t colno = (offset - *it) + 1;
@@ -863,24 +853,22 @@ auto Miss2Identifier::match(const string_view& value, const Options& options) ->
         {
             auto ident = value.substr(0, begin_index);
             auto index = value.substr(begin_index + 1, i - (begin_index + 1));
-            try
+            using index_type = decltype(Miss2Identifier::index);
+            if(is_number_index)
             {
-                using index_type = decltype(Miss2Identifier::index);
-                if(is_number_index)
-                {
-                    int index_value = std::stoi(index.to_string());
-                    if(index_value >= 0)
-                        return Miss2Identifier{ ident, index_type(index_value) };
-                    else
-                        return make_unexpected(Miss2Identifier::NegativeIndex);
-                }
+                int index_value;
+                auto result = from_chars(index.data(), index.data() + index.size(), index_value);
+                if(result.ec == std::errc::result_out_of_range)
+                    return make_unexpected(Miss2Identifier::OutOfRange);
+                else if(result.ec != std::errc())
+                    return make_unexpected(Miss2Identifier::InvalidIdentifier);
+                else if(index_value >= 0)
+                    return Miss2Identifier{ ident, index_type(index_value) };
                 else
-                    return Miss2Identifier{ ident, index_type(index) };
-            }
-            catch(const std::out_of_range&)
-            {
-                return make_unexpected(Miss2Identifier::OutOfRange);
+                    return make_unexpected(Miss2Identifier::NegativeIndex);
             }
+            else
+                return Miss2Identifier{ ident, index_type(index) };
         }
         else if(begin_index != std::string::npos)
         {
@@ -909,55 +897,46 @@ optional<int32_t> to_integer(const SyntaxTree& node, ProgramContext& program)
 {
     Expects(node.type() == NodeType::Integer);
 
-    try
-    {
-        auto number = node.text();
-
-        if(number.size() > 2+7 && number[0] == '0' && (number[1] == 'x' || number[1] == 'X'))
-        {
-            auto ll = std::stoll(number.to_string(), 0, 0);
-            static_assert(sizeof(ll) == sizeof(int32_t) * 2, "");
+    auto number = node.text();
+    bool is_hexadecimal = (number.size() > 2 && number[0] == '0' && (number[1] == 'x' || number[1] == 'X'));
 
-            if(ll > std::numeric_limits<int32_t>::max())
-            {
-                if(ll > std::numeric_limits<uint32_t>::max())
-                    throw std::out_of_range("out of range");
-
-                // long long is inside the unsigned int range
-                return static_cast<int32_t>(static_cast<uint32_t>(ll));
-            }
-            else
-            {
-                if(ll < std::numeric_limits<int32_t>::min())
-                    throw std::out_of_range("out of range");
-
-                // long long is inside the signed int range.
-                return static_cast<int32_t>(ll);
-            }
-        }
-        else
-        {
-            return std::stoi(number.to_string(), 0, 0);
-        }
+    // Hexadecimal literals may represent the whole unsigned int range (e.g. 0xFFFFFFFF means -1).
+    int64_t value;
+    auto result = from_chars_prefixed(number.data(), number.data() + number.size(), value);
+    if(result.ec == std::errc::invalid_argument)
+    {
+        program.error(node, "invalid integer literal");
+        return nullopt;
     }
-    catch(const std::out_of_range&)
+    else if(result.ec == std::errc::result_out_of_range
+        || value < std::numeric_limits<int32_t>::min()
+        || value > (is_hexadecimal? int64_t(std::numeric_limits<uint32_t>::max()) : std::numeric_limits<int32_t>::max()))
     {
         program.error(node, "integer is out of range");
         return nullopt;
     }
+
+    return static_cast<int32_t>(static_cast<uint32_t>(value));
 }
 
 optional<float> to_float(const SyntaxTree& node, ProgramContext& program)
 {
     Expects(node.type() == NodeType::Float);
 
-    try
+    auto number = node.text();
+
+    float value;
+    auto result = from_chars(number.data(), number.data() + number.size(), value);
+    if(result.ec == std::errc::invalid_argument)
     {
-        return std::stof(node.text().to_string());
+        program.error(node, "invalid float literal");
+        return nullopt;
     }
-    catch(const std::out_of_range&)
+    else if(result.ec == std::errc::result_out_of_range)
     {
         program.error(node, "float is out of range");
         return nullopt;
     }
+
+    return value;
 }
@@ -17,6 +17,7 @@ struct ParserContext
     ProgramContext&                      program;
     const TokenStream&                   tstream;
     shared_ptr<SyntaxTree::InputStream>  instream;
+    uint32_t                             depth = 0;     //< Statements being parsed, one inside the other.
 
     ParserContext(ProgramContext& program, const TokenStream& tstream) :
         program(program), tstream(tstream)
@@ -515,6 +516,8 @@ static ParserResult parse_expression_statement(ParserContext& parser, token_iter
                     auto id_it = (begin->type != Token::Text? second : begin);
 
                     std::tie(std::ignore, ident) = parse_identifier(parser, id_it, end);
+                    if(!is<ParserSuccess>(ident)) // e.g. `-- #x`
+                        return std::make_pair(it, std::move(ident));
 
                     shared_ptr<SyntaxTree> tree(new SyntaxTree(opa.value(), parser.instream, *op_it));
                     tree->add_child(get<ParserSuccess>(ident).tree);
@@ -1273,25 +1276,42 @@ static ParserResult parse_dump_statement(ParserContext& parser, token_iterator b
     if(begin != end && begin->type == Token::DUMP)
     {
         ParserState state = ParserSuccess(nullptr);
-        std::vector<uint8_t> bytes;
+        auto bytes = std::make_shared<std::vector<uint8_t>>();
 
         auto it = std::next(begin);
 
         expect_newline(state, it, end);
         it = parser_aftertoken(it, end, Token::NewLine);
 
+        // Sizes the blob beforehand, so large dumps are not reallocated while parsed.
+        size_t num_bytes = 0;
+        for(auto size_it = it; size_it != end && size_it->type != Token::ENDDUMP; ++size_it)
+        {
+            if(size_it->type == Token::Hexadecimal)
+                num_bytes += (size_it->end - size_it->begin) / 2;
+            else if(size_it->type == Token::String)
+                num_bytes += (size_it->end - size_it->begin) - 2;
+        }
+        bytes->reserve(num_bytes);
+
         for(; it != end && it->type != Token::ENDDUMP; ++it)
         {
             if(it->type == Token::Hexadecimal)
             {
-                bytes.emplace_back(std::stoi(parser.get_text(*it).to_string(), nullptr, 16));
+                auto text = parser.get_text(*it);
+                for(size_t i = 0; i + 1 < text.size(); i += 2)
+                {
+                    uint8_t byte = 0;
+                    from_chars(text.data() + i, text.data() + i + 2, byte, 16);
+                    bytes->emplace_back(byte);
+                }
             }
             else if(it->type == Token::String)
             {
                 auto text = parser.get_text(*it);
 
                 std::copy(std::next(text.begin()), std::prev(text.end()),
-                          std::back_inserter(bytes));
+                          std::back_inserter(*bytes));
             }
             else if(it->type != Token::NewLine)
             {
@@ -1336,6 +1356,20 @@ static ParserResult parse_dump_statement(ParserContext& parser, token_iterator b
 */
 static ParserResult parse_statement(ParserContext& parser, token_iterator begin, token_iterator end)
 {
+    if(begin != end)
+    {
+        TokenStream::TokenInfo token_info(parser.tstream.text, *begin);
+
+        parser.program.check_budget(token_info);
+
+        if(parser.program.opt.max_nesting && parser.depth > *parser.program.opt.max_nesting)
+            parser.program.fatal_error(token_info, "statement nested deeper than {} levels [-fmax-nesting]",
+                                       *parser.program.opt.max_nesting);
+    }
+
+    ++parser.depth;
+    auto guard = make_scope_guard([&] { --parser.depth; });
+
     auto result = parse_oneof(parser, begin, end,
                               parse_scope_statement,
                               parse_if_statement,
@@ -1393,15 +1427,34 @@ std::shared_ptr<SyntaxTree> SyntaxTree::compile(ProgramContext& program, const T
 
     ParserState statement;
     bool any_error = false; // if any error, stop building AST
+    size_t num_nodes = 0;
 
     for(auto it = tokens_begin; it != tokens_end; )
     {
+        auto statement_begin = it;
         std::tie(it, statement) = parse_statement(parser, it, tokens_end);
         if(is<ParserSuccess>(statement))
         {
+            auto& statement_tree = get<ParserSuccess>(statement).tree;
+
+            if(program.opt.max_nodes && statement_tree)
+            {
+                statement_tree->depth_first([&](const SyntaxTree&) {
+                    ++num_nodes;
+                    return true;
+                });
+
+                if(num_nodes > *program.opt.max_nodes)
+                {
+                    TokenStream::TokenInfo token_info(tstream.text, *statement_begin);
+                    program.fatal_error(token_info, "script has more than {} syntax nodes [-fmax-nodes]",
+                                        *program.opt.max_nodes);
+                }
+            }
+
             if(!any_error)
             {
-                tree->add_child(get<ParserSuccess>(statement).tree);
+                tree->add_child(statement_tree);
             }
         }
         else
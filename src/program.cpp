@@ -1,5 +1,6 @@
 #include <stdinc.h>
 #include "program.hpp"
+#include "system.hpp"
 
 enum class Section
 {
@@ -93,7 +94,6 @@ void load_ide(const fs::path& filepath, bool is_default_ide, std::map<std::strin
 
             case Section::SomeReadable:
             {
-                char model_name[64];
                 unsigned int id;
 
                 if(!strncmp(buffer, "end", 3))
@@ -102,13 +102,15 @@ void load_ide(const fs::path& filepath, bool is_default_ide, std::map<std::strin
                     break;
                 }
 
-                if(sscanf(buffer, "%u %63s", &id, model_name) != EOF)
+                // buffer is in the form "id model_name ...", see nextline.
+                const char* buffer_end = buffer + strlen(buffer);
+                auto result = from_chars(buffer, buffer_end, id);
+                if(result.ec == std::errc() && result.ptr != buffer_end && *result.ptr == ' ')
                 {
-                    output.emplace(model_name, id);
-                }
-                else
-                {
-                    __debugbreak();
+                    auto name_begin = std::find_if(result.ptr, buffer_end, [](char c) { return c != ' '; });
+                    auto name_end = std::find(name_begin, buffer_end, ' ');
+                    if(name_begin != name_end)
+                        output.emplace(std::string(name_begin, name_end), id);
                 }
                 break;
             }
@@ -161,6 +163,31 @@ auto load_dat(const fs::path& filepath, bool is_default_dat) -> std::map<std::st
     return output;
 }
 
+optional<std::string> ProgramContext::exhausted_budget(bool always_memory)
+{
+    if(this->opt.max_stage_time)
+    {
+        auto elapsed = std::chrono::steady_clock::now() - this->stage_start;
+        auto elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count();
+        if(elapsed_ms > *this->opt.max_stage_time)
+            return fmt::format("stage '{}' took longer than {} ms [-fmax-stage-time]",
+                               this->stage_name, *this->opt.max_stage_time);
+    }
+
+    if(this->opt.max_memory && (always_memory || (++this->budget_samples % memory_interval) == 0))
+    {
+        if(auto resident = resident_memory_size())
+        {
+            auto resident_mb = *resident / (1024 * 1024);
+            if(resident_mb > *this->opt.max_memory)
+                return fmt::format("stage '{}' is using {} MB of memory, more than {} MB [-fmax-memory]",
+                                   this->stage_name, resident_mb, *this->opt.max_memory);
+        }
+    }
+
+    return nullopt;
+}
+
 bool ProgramContext::is_model_from_ide(const string_view& name) const
 {
     if(!this->default_models.empty() || !this->level_models.empty())
@@ -196,29 +223,25 @@ bool Options::push_expect_var(const string_view& info)
     std::vector<std::string> names;
     optional<uint32_t> index;
 
-    try
+    for(auto it = info.begin(); it != info.end(); )
     {
-        for(auto it = info.begin(); it != info.end(); )
-        {
-            auto beg_name = it;
-            auto end_name = std::find_if(beg_name, info.end(), [](char c) { return c == ',' || c == ':'; });
-
-            if(end_name == info.end() || beg_name == end_name)
-                return false;
+        auto beg_name = it;
+        auto end_name = std::find_if(beg_name, info.end(), [](char c) { return c == ',' || c == ':'; });
 
-            names.emplace_back(std::string(beg_name, end_name));
-            if(*end_name == ':')
-            {
-                index = std::stoi(std::string(end_name+1, info.end()));
-                break;
-            }
+        if(end_name == info.end() || beg_name == end_name)
+            return false;
 
-            it = std::next(end_name);
+        names.emplace_back(std::string(beg_name, end_name));
+        if(*end_name == ':')
+        {
+            int index_value;
+            if(from_chars(std::next(end_name), info.end(), index_value).ec != std::errc())
+                return false;
+            index = index_value;
+            break;
         }
-    }
-    catch(const std::logic_error&)
-    {
-        return false;
+
+        it = std::next(end_name);
     }
 
     if(index)
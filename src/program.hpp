@@ -5,6 +5,7 @@
 ///
 #pragma once
 #include <stdinc.h>
+#include <chrono>
 #include "parser.hpp"
 #include "symtable.hpp"
 #include "commands.hpp"
@@ -72,6 +73,13 @@ public:
         JSON,
     };
 
+    enum class ReportFormat : uint8_t
+    {
+        None,
+        Table,
+        JSON,
+    };
+
     /// General
     bool help = false;
     bool version = false;
@@ -105,15 +113,21 @@ public:
     bool oatc = false;
     bool allow_underscore_identifiers = false;
     bool constant_checks = true;
+    bool debug_map = false;
 
     // Warning flags
     bool warning_is_error = false;
     bool warn_conflict_text_label_var = false;
     bool warn_expect_var = true;
+    bool warn_wait_free_loop = true;
+    bool warn_entity_leak = false;
+    optional<float> warn_precision_loss; //< Warns on q11.4 floats which lose more than this by their encoding.
 
     // 8 bit stuff
     HeaderVersion header = HeaderVersion::None;
     ErrorFormat error_format = ErrorFormat::Default;
+    ReportFormat frame_report = ReportFormat::None;
+    ReportFormat shared_globals_report = ReportFormat::None;
     optional<uint8_t> cleo;
 
     // 32 bit stuff
@@ -123,6 +137,13 @@ public:
     optional<uint32_t> mission_var_limit;
     optional<uint32_t> switch_case_limit;
     optional<uint32_t> array_elem_limit;
+    optional<uint32_t> gosub_depth_limit;
+
+    // Budgets, to bound the resources used by pathological inputs.
+    optional<uint32_t> max_nodes;       //< Syntax tree nodes in a script.
+    optional<uint32_t> max_nesting;     //< Statements nested in statements.
+    optional<uint32_t> max_stage_time;  //< Milliseconds taken by each compilation stage.
+    optional<uint32_t> max_memory;      //< Megabytes of resident memory of the process.
 
     /// Parses and pushes a --expect-var entry.
     bool push_expect_var(const string_view& info);
@@ -166,18 +187,33 @@ private:
     transparent_map<std::string, std::string> defines;
 public:
     std::vector<std::pair<std::vector<std::string>, uint32_t>> expect_vars;
+    optional<fs::path> layout_lock; //< The file locking the layout of the global variables (--layout-lock).
 };
 
+/// Receives a line of log or a piece of output text.
+using TextSink = std::function<void(const std::string&)>;
+
 class ProgramContext
 {
 public:
     const Options opt;          ///< Compiler options / flags.
-    const Commands commands;    ///< Commands, Entities and Enums
+    const Commands& commands;   ///< Commands, Entities and Enums
 
 public:
     /// If `logstream` is `nullptr`, does not perform logging.
     explicit ProgramContext(Options opt, Commands commands, FILE* logstream = stderr) :
-        opt(std::move(opt)), commands(std::move(commands)), logstream(logstream)
+        ProgramContext(std::move(opt), std::make_shared<const Commands>(std::move(commands)),
+                       logstream? TextSink([logstream](const std::string& msg) { std::fprintf(logstream, "%s\n", msg.c_str()); })
+                                : TextSink())
+    {
+    }
+
+    /// Shares `commands` with other contexts, which may be running in other threads.
+    ///
+    /// The lines of log are sent to `logger`, without the line terminator. If `logger` is empty, does not perform logging.
+    explicit ProgramContext(Options opt, shared_ptr<const Commands> commands, TextSink logger) :
+        opt(std::move(opt)), commands(*commands), shared_commands(std::move(commands)), logger(std::move(logger)),
+        has_budget(this->opt.max_stage_time || this->opt.max_memory)
     {
     }
 
@@ -218,7 +254,7 @@ public:
     template<typename Context, typename... Args>
     void error(const Context& context, const char* msg, Args&&... args)
     {
-        if(logstream) this->puts(format_error(this->opt, "error", context, msg, std::forward<Args>(args)...));
+        if(logger) this->puts(format_error(this->opt, "error", context, msg, std::forward<Args>(args)...));
 
         if(++error_count >= max_error)
             this->fatal_error(nocontext, "too many errors");
@@ -227,7 +263,7 @@ public:
     template<typename Context, typename... Args>
     void note(const Context& context, const char* msg, Args&&... args)
     {
-        if(logstream) this->puts(format_error(this->opt, "note", context, msg, std::forward<Args>(args)...));
+        if(logger) this->puts(format_error(this->opt, "note", context, msg, std::forward<Args>(args)...));
     }
 
     template<typename Context, typename... Args>
@@ -240,7 +276,7 @@ public:
         else
         {
             ++warn_count;
-            if(logstream) this->puts(format_error(this->opt, "warning", context, msg, std::forward<Args>(args)...));
+            if(logger) this->puts(format_error(this->opt, "warning", context, msg, std::forward<Args>(args)...));
         }
     }
 
@@ -248,7 +284,7 @@ public:
     void fatal_error [[noreturn]] (const Context& context, const char* msg, Args&&... args)
     {
         ++fatal_count;
-        if(logstream) this->puts(format_error(this->opt, "fatal error", context, msg, std::forward<Args>(args)...));
+        if(logger) this->puts(format_error(this->opt, "fatal error", context, msg, std::forward<Args>(args)...));
         throw ProgramFailure();
     }
 
@@ -282,10 +318,44 @@ public:
         return *opt;
     }
 
-private:
+    /// Enters the compilation stage `name` (e.g. "annotate"), after checking the budgets at the end of the previous one.
+    ///
+    /// Each stage has its own `-fmax-stage-time` budget, while `-fmax-memory` bounds the whole process.
+    void begin_stage(const char* name)
+    {
+        this->end_stage();
+        this->stage_name = name;
+        this->stage_start = std::chrono::steady_clock::now();
+    }
+
+    /// Checks the budgets at the end of the current stage, if any.
+    void end_stage()
+    {
+        if(this->stage_name)
+        {
+            if(auto exhausted = this->exhausted_budget(true))
+                this->fatal_error(nocontext, "{}", *exhausted);
+            this->stage_name = nullptr;
+        }
+    }
+
+    /// Checks the time and memory budgets of the current stage, giving a fatal error on `context` if any is exhausted.
+    ///
+    /// This is cheap enough to be called on every node of a tree walk, as the budgets are only sampled every so often.
+    template<typename Context>
+    void check_budget(const Context& context)
+    {
+        if(this->has_budget && this->stage_name && (++this->budget_ticks % budget_interval) == 0)
+        {
+            if(auto exhausted = this->exhausted_budget(false))
+                this->fatal_error(context, "{}", *exhausted);
+        }
+    }
+
+    /// Logs a line which isn't a diagnostic (e.g. "gta3sc: compilation failed").
     void puts(const std::string& msg)
     {
-        std::fprintf(logstream, "%s\n", msg.c_str());
+        if(logger) logger(msg);
     }
 
 private:
@@ -293,13 +363,27 @@ private:
     std::atomic<uint32_t> fatal_count {0};
     std::atomic<uint32_t> warn_count  {0};
 
-    FILE*     logstream {nullptr};
+    shared_ptr<const Commands> shared_commands;
+    TextSink  logger;
     uint32_t  max_error {UINT_MAX};
 
+    /// Calls to `check_budget` between samples of the clock. The memory is sampled every `memory_interval` samples.
+    static constexpr uint32_t budget_interval = 1024;
+    static constexpr uint32_t memory_interval = 16;
+
+    const bool  has_budget;
+    uint32_t    budget_ticks = 0;
+    uint32_t    budget_samples = 0;
+    const char* stage_name = nullptr;
+    std::chrono::steady_clock::time_point stage_start;
+
+    /// \returns the description of the exhausted budget of the current stage, if any. The memory is only sampled
+    /// every so often, unless `always_memory`.
+    optional<std::string> exhausted_budget(bool always_memory);
+
 
 protected:
     friend class Commands;
-    friend int main(int argc, char** argv);
     insensitive_map<std::string, uint32_t> default_models;
     insensitive_map<std::string, uint32_t> level_models;
 };
@@ -308,8 +392,9 @@ protected:
 
 // from main_compile.cpp and main_decompile.cpp
 
-extern int compile(fs::path input, fs::path output, ProgramContext&);
-extern int decompile(fs::path input, fs::path output, ProgramContext&);
+/// Compiles or decompiles `input` into `output`. When `output` is `-`, the output is sent into `stdout_sink`.
+extern int compile(fs::path input, fs::path output, ProgramContext&, const TextSink& stdout_sink);
+extern int decompile(fs::path input, fs::path output, ProgramContext&, const TextSink& stdout_sink);
 
 extern bool decompile(const void* bytecode, size_t bytecode_size,
                       const void* script_img, size_t script_img_size,
@@ -334,7 +419,7 @@ inline std::string format_error(const Options& options,
         arrow_line.reserve(colno + length);
 
         for(size_t i = 0; i < colno; ++i)
-            arrow_line.push_back(line[i] != '\t'? ' ' : '\t');
+            arrow_line.push_back(i < line.size() && line[i] == '\t'? '\t' : ' ');
         arrow_line.back() = '^';
 
         for(size_t i = 1; i < length; ++i)
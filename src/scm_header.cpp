@@ -0,0 +1,351 @@
+#include <stdinc.h>
+#include "scm_header.hpp"
+
+using Field = ScmHeaderLayout::Field;
+using Type = ScmHeaderLayout::Type;
+using F = ScmHeaderField;
+
+static constexpr uint16_t goto_opcode = 0x0002;
+static constexpr uint8_t  int32_datatype = 0x01;
+
+static size_t size_of(const std::vector<Field>& fields)
+{
+    size_t size = 0;
+    for(auto& field : fields) size += field.size;
+    return size;
+}
+
+/// \returns whether the fields of `segment` are padded up to a certain offset.
+static bool has_padding(const ScmHeaderLayout::Segment& segment)
+{
+    return std::any_of(segment.fields.begin(), segment.fields.end(), [](const Field& f) {
+        return f.type == Type::Padding;
+    });
+}
+
+/// \returns the value of a integer field of type `type` at `offset`.
+static optional<uint32_t> fetch_field(const BinaryFetcher& bf, size_t offset, Type type)
+{
+    switch(type)
+    {
+        case Type::U8:
+            if(auto opt = bf.fetch_u8(offset)) return *opt;
+            return nullopt;
+        case Type::U16:
+            if(auto opt = bf.fetch_u16(offset)) return *opt;
+            return nullopt;
+        case Type::U32:
+        case Type::I32:
+            return bf.fetch_u32(offset);
+        default:
+            Unreachable();
+    }
+}
+
+/// The segments common to every game, up to the mission offsets.
+///
+/// Only San Andreas numbers its segments, and stores the maximum number of mission locals.
+static std::vector<ScmHeaderLayout::Segment> common_segments(char target_id, bool is_sa)
+{
+    std::vector<Field> info {
+        { F::None, Type::U8, 1, is_sa? 1u : 0u },
+        { F::MainSize, Type::U32, 4 },
+        { F::LargestMission, Type::U32, 4 },
+        { F::NumMissions, Type::U16, 2 },
+        { F::NumExclusiveMissions, Type::U16, 2 },
+    };
+
+    if(is_sa)
+        info.push_back({ F::MaxMissionLocals, Type::U32, 4 });
+
+    return {
+        { "variables", {
+            { F::None, Type::U8, 1, uint32_t(uint8_t(target_id)) },
+            { F::GlobalsSize, Type::Padding, 0 },
+        }, F::None, {} },
+        { "models", {
+            { F::None, Type::U8, 1, 0 },
+            { F::NumModels, Type::U32, 4 },
+        }, F::NumModels, {
+            { F::ModelName, Type::Chars, 24 },
+        } },
+        { "info", std::move(info), F::NumMissions, {
+            { F::MissionOffset, Type::I32, 4 },
+        } },
+    };
+}
+
+const ScmHeaderLayout& ScmHeaderLayout::liberty()
+{
+    // original III main.scm doesn't use 'l' as target yet
+    static const ScmHeaderLayout layout { common_segments('\0', false) };
+    return layout;
+}
+
+const ScmHeaderLayout& ScmHeaderLayout::miami()
+{
+    static const ScmHeaderLayout layout { common_segments('m', false) };
+    return layout;
+}
+
+const ScmHeaderLayout& ScmHeaderLayout::san_andreas()
+{
+    static const ScmHeaderLayout layout = [] {
+        ScmHeaderLayout layout { common_segments('s', true) };
+        layout.segments.push_back({ "streamed", {
+            { F::None, Type::U8, 1, 2 },
+            { F::LargestStreamed, Type::U32, 4 },
+            { F::NumStreamed, Type::U32, 4 },
+        }, F::NumStreamed, {
+            { F::StreamedName, Type::Chars, 20 },
+            { F::StreamedOffset, Type::U32, 4 },
+            { F::StreamedSize, Type::U32, 4 },
+        } });
+        layout.segments.push_back({ "unknown", {
+            { F::None, Type::U8, 1, 3 },
+            { F::None, Type::U32, 4, 0 },
+        }, F::None, {} });
+        layout.segments.push_back({ "globals", {
+            { F::None, Type::U8, 1, 4 },
+            { F::VarsSize, Type::U32, 4 },
+            { F::None, Type::U8, 1, 62 }, // Unknown / Unused
+            { F::None, Type::U8, 1, 2 },  // Unknown / Unused
+            { F::None, Type::U16, 2, 0 }, // Unknown / Unused
+        }, F::None, {} });
+        return layout;
+    }();
+    return layout;
+}
+
+size_t ScmHeaderLayout::Segment::fields_size() const
+{
+    return size_of(this->fields);
+}
+
+size_t ScmHeaderLayout::Segment::record_size() const
+{
+    return size_of(this->record);
+}
+
+auto ScmHeaderLayout::find(ScmHeaderField field) const -> optional<Location>
+{
+    Expects(field != ScmHeaderField::None);
+
+    for(size_t i = 0; i < segments.size(); ++i)
+    {
+        size_t offset = jump_size;
+        for(auto& f : segments[i].fields)
+        {
+            if(f.id == field)
+                return Location { i, false, offset, f.type, f.size };
+            offset += f.size;
+        }
+
+        offset = 0;
+        for(auto& f : segments[i].record)
+        {
+            if(f.id == field)
+                return Location { i, true, offset, f.type, f.size };
+            offset += f.size;
+        }
+    }
+
+    return nullopt;
+}
+
+size_t ScmHeaderLayout::size(uint32_t size_globals, const std::function<size_t(ScmHeaderField)>& count) const
+{
+    size_t size = 0;
+    for(auto& segment : segments)
+    {
+        // The only padding (i.e. the variables space) goes up to `size_globals`.
+        if(has_padding(segment))
+            size = size_globals;
+        else
+        {
+            size += jump_size + segment.fields_size();
+            if(segment.count != ScmHeaderField::None)
+                size += count(segment.count) * segment.record_size();
+        }
+    }
+    return size;
+}
+
+size_t ScmHeaderLayout::size(const ScmHeaderData& data) const
+{
+    return this->size(data.size_globals, [&](ScmHeaderField count) { return data.value(count); });
+}
+
+void ScmHeaderLayout::write(const ScmHeaderData& data, BinaryWriter& bw, uint32_t base) const
+{
+    const size_t header_begin = bw.current_offset();
+
+    auto write_field = [&](const Field& field, size_t index)
+    {
+        switch(field.type)
+        {
+            case Type::Chars:
+            {
+                auto chars = data.chars(field.id, index);
+                bw.emplace_chars(field.size, std::string(chars.begin(), chars.end()).c_str(), true);
+                return;
+            }
+            case Type::Padding:
+                bw.emplace_fill(header_begin + data.value(field.id) - bw.current_offset(), 0);
+                return;
+            default:
+                break;
+        }
+
+        auto value = (field.id == ScmHeaderField::None? field.constant : data.value(field.id, index));
+        switch(field.type)
+        {
+            case Type::U8:  bw.emplace_u8(static_cast<uint8_t>(value)); break;
+            case Type::U16: bw.emplace_u16(static_cast<uint16_t>(value)); break;
+            case Type::U32: bw.emplace_u32(value); break;
+            case Type::I32: bw.emplace_u32(value); break;
+            default:        Unreachable();
+        }
+    };
+
+    for(auto& segment : segments)
+    {
+        auto num_records = segment.count != ScmHeaderField::None? data.value(segment.count) : 0;
+
+        size_t end = has_padding(segment)? header_begin + data.size_globals :
+                     bw.current_offset() + jump_size + segment.fields_size() + num_records * segment.record_size();
+
+        bw.emplace_u16(goto_opcode);
+        bw.emplace_u8(int32_datatype);
+        bw.emplace_i32(static_cast<int32_t>(base + end));
+
+        for(auto& field : segment.fields)
+            write_field(field, 0);
+
+        for(size_t i = 0; i < num_records; ++i)
+        {
+            for(auto& field : segment.record)
+                write_field(field, i);
+        }
+
+        assert(bw.current_offset() == end);
+    }
+}
+
+uint32_t ScmHeaderData::value(ScmHeaderField field, size_t index) const
+{
+    switch(field)
+    {
+        case F::GlobalsSize:            return size_globals;
+        case F::VarsSize:               return size_globals - 8;
+        case F::NumModels:              return static_cast<uint32_t>(models.size());
+        case F::MainSize:               return main_size;
+        case F::LargestMission:         return largest_mission;
+        case F::NumMissions:            return static_cast<uint32_t>(mission_offsets.size());
+        case F::NumExclusiveMissions:   return num_exclusive_missions;
+        case F::MaxMissionLocals:       return max_mission_locals;
+        case F::MissionOffset:          return static_cast<uint32_t>(mission_offsets[index]);
+        case F::LargestStreamed:        return largest_streamed;
+        case F::NumStreamed:            return static_cast<uint32_t>(streamed_scripts.size());
+        case F::StreamedOffset:         return streamed_scripts[index].offset;
+        case F::StreamedSize:           return streamed_scripts[index].size;
+        default:                        Unreachable();
+    }
+}
+
+string_view ScmHeaderData::chars(ScmHeaderField field, size_t index) const
+{
+    switch(field)
+    {
+        case F::ModelName:      return models[index];
+        case F::StreamedName:   return streamed_scripts[index].name;
+        default:                Unreachable();
+    }
+}
+
+optional<ScmHeaderView> ScmHeaderView::from_bytecode(const void* bytecode, size_t bytecode_size,
+                                                     const ScmHeaderLayout& layout)
+{
+    ScmHeaderView view(bytecode, bytecode_size, layout);
+    auto& bf = view.bf;
+
+    view.segments.reserve(layout.segments.size());
+
+    size_t offset = 0;
+    for(auto& segment : layout.segments)
+    {
+        auto opcode = bf.fetch_u16(offset);
+        auto datatype = bf.fetch_u8(offset + 2);
+        auto target = bf.fetch_u32(offset + 3);
+        if(!opcode || !datatype || !target || *opcode != goto_opcode || *datatype != int32_datatype)
+            return nullopt;
+
+        SegmentView seg { offset, *target, 0 };
+
+        if(seg.end > bytecode_size || seg.end < offset + ScmHeaderLayout::jump_size + segment.fields_size())
+            return nullopt;
+
+        if(segment.count != ScmHeaderField::None)
+        {
+            auto loc = layout.find(segment.count).value();
+            auto count = fetch_field(bf, offset + loc.offset, loc.type).value();
+
+            // every record must fit in the segment
+            auto records_begin = offset + ScmHeaderLayout::jump_size + segment.fields_size();
+            if(uint64_t(count) * segment.record_size() > seg.end - records_begin)
+                return nullopt;
+
+            seg.count = count;
+        }
+
+        view.segments.push_back(seg);
+        offset = seg.end;
+    }
+
+    view.header_size = offset;
+    return view;
+}
+
+size_t ScmHeaderView::offset_of(const ScmHeaderLayout::Location& loc, size_t index) const
+{
+    auto& seg = this->segments[loc.segment];
+    if(!loc.in_record)
+        return seg.begin + loc.offset;
+
+    Expects(index < seg.count);
+    auto& layout_seg = this->layout->segments[loc.segment];
+    return seg.begin + ScmHeaderLayout::jump_size + layout_seg.fields_size()
+         + (index * layout_seg.record_size()) + loc.offset;
+}
+
+size_t ScmHeaderView::count(ScmHeaderField field) const
+{
+    auto loc = this->layout->find(field).value();
+    return this->segments[loc.segment].count;
+}
+
+size_t ScmHeaderView::offset(ScmHeaderField field, size_t index) const
+{
+    return this->offset_of(this->layout->find(field).value(), index);
+}
+
+uint32_t ScmHeaderView::value(ScmHeaderField field, size_t index) const
+{
+    auto loc = this->layout->find(field).value();
+
+    if(loc.type == Type::Padding)
+        return static_cast<uint32_t>(this->segments[loc.segment].end);
+
+    // The view was validated to hold every field, thus the fetch can't fail.
+    return fetch_field(bf, this->offset_of(loc, index), loc.type).value();
+}
+
+string_view ScmHeaderView::chars(ScmHeaderField field, size_t index) const
+{
+    auto loc = this->layout->find(field).value();
+    Expects(loc.type == Type::Chars);
+
+    auto begin = reinterpret_cast<const char*>(bf.bytes + this->offset_of(loc, index));
+    auto end = std::find(begin, begin + loc.size, '\0');
+    return string_view(begin, end - begin);
+}
@@ -0,0 +1,203 @@
+///
+/// SCM Header Layout
+///
+/// The header of a multifile (main.scm) is a sequence of segments. Each segment begins with a jump over itself (`GOTO`,
+/// 7 bytes), followed by its fields and then by its records:
+///
+///     Variables   u8:target_id, then zeros up to the end of the global variables space.
+///     Models      u8:segment_id u32:num_models { char[24]:name }          -- the first model is unused
+///     SCM Info    u8:segment_id u32:main_size u32:largest_mission u16:num_missions u16:num_exclusive_missions
+///                 [SA: u32:max_mission_locals] { i32:mission_offset }
+///     Streamed    (SA) u8:segment_id u32:largest_streamed u32:num_streamed { char[20]:name u32:offset u32:size }
+///                 -- the last streamed script is always AAA
+///     Unknown     (SA) u8:segment_id u32:0
+///     Globals     (SA) u8:segment_id u32:vars_size u8:62 u8:2 u16:0
+///
+/// The layout of each game is described once in a table (`ScmHeaderLayout::of`), from which the header is both written
+/// (`ScmHeaderLayout::write`) and read back (`ScmHeaderView::from_bytecode`), so the two can't get out of sync.
+///
+#pragma once
+#include <stdinc.h>
+#include "binary_fetcher.hpp"
+#include "binary_writer.hpp"
+
+/// The meaningful fields of a header.
+enum class ScmHeaderField : uint8_t
+{
+    None,                   //< A field of constant value (e.g. the segment ids).
+    GlobalsSize,            //< Size of the global variables space, including the jump over it.
+    VarsSize,               //< Size of the global variables space, excluding the jump over it.
+    NumModels,
+    ModelName,
+    MainSize,
+    LargestMission,
+    NumMissions,
+    NumExclusiveMissions,
+    MaxMissionLocals,
+    MissionOffset,
+    LargestStreamed,
+    NumStreamed,
+    StreamedName,
+    StreamedOffset,
+    StreamedSize,
+};
+
+/// The values of the fields of a header.
+struct ScmHeaderData
+{
+    struct StreamedScript
+    {
+        std::string name;
+        uint32_t    offset;     //< Offset in the virtual file made of the multifile and the streamed scripts.
+        uint32_t    size;
+    };
+
+    uint32_t                    size_globals = 0;           //< Includes the jump over the variables.
+    std::vector<std::string>    models;                     //< Includes the first unused model.
+    uint32_t                    main_size = 0;
+    uint32_t                    largest_mission = 0;
+    uint32_t                    num_exclusive_missions = 0;
+    uint32_t                    max_mission_locals = 0;
+    std::vector<int32_t>        mission_offsets;
+    uint32_t                    largest_streamed = 0;
+    std::vector<StreamedScript> streamed_scripts;           //< Includes the AAA script.
+
+    /// \returns the value of the integer `field` in the record `index` of its segment.
+    uint32_t value(ScmHeaderField field, size_t index = 0) const;
+
+    /// \returns the value of the string `field` in the record `index` of its segment.
+    string_view chars(ScmHeaderField field, size_t index) const;
+};
+
+class ScmHeaderLayout
+{
+public:
+    enum class Type : uint8_t
+    {
+        U8,
+        U16,
+        U32,
+        I32,
+        Chars,      //< Upper case, padded with zeros, not necessarily null terminated.
+        Padding,    //< Zeros up to the offset (from the beginning of the header) given by the value of the field.
+    };
+
+    struct Field
+    {
+        ScmHeaderField  id;
+        Type            type;
+        uint8_t         size;           //< Size in bytes, zero for padding.
+        uint32_t        constant = 0;   //< The value of the field if `id` is `None`.
+    };
+
+    struct Segment
+    {
+        const char*         name;
+        std::vector<Field>  fields;     //< The fields after the jump over the segment.
+        ScmHeaderField      count;      //< The field with the number of records, or `None` if there are no records.
+        std::vector<Field>  record;     //< The fields of each record.
+
+        /// \returns the size of the fields, excluding the padding.
+        size_t fields_size() const;
+
+        /// \returns the size of a record.
+        size_t record_size() const;
+    };
+
+    /// Where a field is found in the layout.
+    struct Location
+    {
+        size_t  segment;    //< Index into `segments`.
+        bool    in_record;  //< Whether the field is part of each record, or of the fixed fields.
+        size_t  offset;     //< Offset from the beginning of the segment or of the record.
+        Type    type;
+        uint8_t size;
+    };
+
+    std::vector<Segment> segments;
+
+    /// Size of the jump over each segment.
+    static constexpr size_t jump_size = 7;
+
+public:
+    /// \returns the layout of the III, Vice City and San Andreas headers.
+    static const ScmHeaderLayout& liberty();
+    static const ScmHeaderLayout& miami();
+    static const ScmHeaderLayout& san_andreas();
+
+    /// \returns the layout for `version` (a `CompiledScmHeader::Version` or a `DecompiledScmHeader::Version`).
+    template<typename TEnum>
+    static const ScmHeaderLayout& of(TEnum version)
+    {
+        switch(version)
+        {
+            case TEnum::Liberty: return liberty();
+            case TEnum::Miami: return miami();
+            case TEnum::SanAndreas: return san_andreas();
+            default: Unreachable();
+        }
+    }
+
+    /// Finds the first occurrence of `field` in the layout.
+    optional<Location> find(ScmHeaderField field) const;
+
+    /// \returns the size of a header with `size_globals` bytes of variables space and `count(field)` records in the
+    /// segments whose number of records is given by `field`.
+    size_t size(uint32_t size_globals, const std::function<size_t(ScmHeaderField)>& count) const;
+
+    /// \returns the size of the header with the values in `data`.
+    size_t size(const ScmHeaderData& data) const;
+
+    /// Writes the header with the values in `data` into `bw`.
+    ///
+    /// `base` is the offset of the beginning of `bw` in the multifile, which the jumps over the segments are relative to.
+    void write(const ScmHeaderData& data, BinaryWriter& bw, uint32_t base = 0) const;
+};
+
+/// A validated header in a buffer, whose fields are fetched on demand.
+class ScmHeaderView
+{
+public:
+    /// Validates the header at the beginning of `bytecode`, walking its segments once.
+    ///
+    /// \returns `nullopt` if any segment is malformed or goes past the end of `bytecode`.
+    static optional<ScmHeaderView> from_bytecode(const void* bytecode, size_t bytecode_size,
+                                                 const ScmHeaderLayout& layout);
+
+    /// \returns the size of the header, that is, the offset to the code after it.
+    size_t size() const { return this->header_size; }
+
+    /// \returns the number of records in the segment containing `field`.
+    size_t count(ScmHeaderField field) const;
+
+    /// \returns the offset in the buffer of `field` in the record `index` of its segment.
+    size_t offset(ScmHeaderField field, size_t index = 0) const;
+
+    /// \returns the value of the integer `field` in the record `index` of its segment.
+    uint32_t value(ScmHeaderField field, size_t index = 0) const;
+
+    /// \returns the value of the string `field` in the record `index` of its segment, up to the first null.
+    ///
+    /// The view points into the buffer.
+    string_view chars(ScmHeaderField field, size_t index = 0) const;
+
+private:
+    struct SegmentView
+    {
+        size_t begin;       //< Offset of the jump over the segment.
+        size_t end;         //< Offset the jump goes into.
+        size_t count;       //< Number of records.
+    };
+
+    explicit ScmHeaderView(const void* bytecode, size_t bytecode_size, const ScmHeaderLayout& layout) :
+        bf(bytecode, bytecode_size), layout(&layout)
+    {}
+
+    /// \returns the offset of `field` in the record `index` of its segment.
+    size_t offset_of(const ScmHeaderLayout::Location& loc, size_t index) const;
+
+    BinaryFetcher               bf;
+    const ScmHeaderLayout*      layout;
+    std::vector<SegmentView>    segments;
+    size_t                      header_size = 0;
+};
@@ -3,6 +3,8 @@
 #include "commands.hpp"
 #include "program.hpp"
 #include "codegen.hpp"
+#include "entity_inference.hpp"
+#include "value_tracking.hpp"
 
 shared_ptr<Script> Script::create(fs::path path, ScriptType type, ProgramContext& program)
 {
@@ -81,40 +83,61 @@ auto Scope::output_type_from_node(const SyntaxTree& node) -> optional<OutputType
         return nullopt;
 }
 
-shared_ptr<Var> Scope::var_at(size_t index) const
+auto Scope::add_var(std::string name, shared_ptr<Var> var) -> std::pair<shared_ptr<Var>, bool>
+{
+    auto pair = this->vars.emplace(std::move(name), std::move(var));
+    if(pair.second)
+    {
+        auto& added = pair.first->second;
+        this->vars_by_index.emplace(added->index, added);
+        this->frame_end = std::max(this->frame_end, added->end_offset() / 4);
+    }
+    return { pair.first->second, pair.second };
+}
+
+void Scope::reindex_vars()
 {
-    size_t offset = index * 4;
-    for(auto& vpair : vars)
+    this->vars_by_index.clear();
+    this->frame_end = 0;
+    for(auto& vpair : this->vars)
     {
-        if(offset >= vpair.second->offset()
-            && offset < vpair.second->end_offset())
-            return vpair.second;
+        this->vars_by_index.emplace(vpair.second->index, vpair.second);
+        this->frame_end = std::max(this->frame_end, vpair.second->end_offset() / 4);
     }
+}
+
+shared_ptr<Var> Scope::var_at(size_t index) const
+{
+    // The variables of a scope never overlap, so the only candidate is the last one starting at or before `index`.
+    auto it = this->vars_by_index.upper_bound(uint32_t(index));
+    if(it == this->vars_by_index.begin())
+        return nullptr;
+
+    auto& var = std::prev(it)->second;
+    if(index * 4 < var->end_offset())
+        return var;
     return nullptr;
 }
 
 auto Script::find_maximum_locals() const -> std::pair<uint32_t, uint32_t>
 {
-    uint32_t highest_offset_genl = 0;
-    uint32_t highest_offset_call = 0;
+    uint32_t highest_index_genl = 0;
+    uint32_t highest_index_call = 0;
 
     for(auto& scope : this->scopes)
     {
-        auto highest_offset = scope->is_call_scope()? std::ref(highest_offset_call) : std::ref(highest_offset_genl);
-        for(auto& var : scope->vars)
-        {
-            highest_offset.get() = std::max(highest_offset.get(), var.second->end_offset());
-        }
+        auto& highest_index = scope->is_call_scope()? highest_index_call : highest_index_genl;
+        highest_index = std::max(highest_index, scope->frame_size());
     }
 
     for(auto& child : this->children_scripts)
     {
         auto pair = child.lock()->find_maximum_locals();
-        highest_offset_genl = std::max(highest_offset_genl, pair.first * 4);
-        highest_offset_call = std::max(highest_offset_call, pair.second * 4);
+        highest_index_genl = std::max(highest_index_genl, pair.first);
+        highest_index_call = std::max(highest_index_call, pair.second);
     }
 
-    return { highest_offset_genl / 4, highest_offset_call / 4 };
+    return { highest_index_genl, highest_index_call };
 }
 
 void Script::add_children(shared_ptr<Script> script)
@@ -307,7 +330,12 @@ void Script::handle_special_commands(const std::vector<shared_ptr<Script>>& scri
     int32_t count_progress = 0;
     int32_t count_respect = 0;
 
-    auto handle_script_input = [&program](const SyntaxTree& arg_node, const shared_ptr<Var>& lvar, bool is_cleo_call) -> bool
+    EntityInference entities(scripts);
+    ValueTracker values;
+    size_t script_index = 0;
+
+    auto handle_script_input = [&](const SyntaxTree& arg_node, const Label& target_label, const shared_ptr<Var>& lvar,
+                                   bool is_cleo_call) -> bool
     {
         if(auto opt_arg_var = get_base_var_annotation(arg_node))
         {
@@ -321,14 +349,9 @@ void Script::handle_special_commands(const std::vector<shared_ptr<Script>>& scri
                 return false;
             }
 
-            if(lvar->entity && argvar->entity != lvar->entity)
-            {
-                program.error(arg_node, "entity type mismatch in target label");
-                // TODO more info
-                return false;
-            }
+            if(program.opt.entity_tracking)
+                entities.add_input(script_index, arg_node, target_label, lvar, argvar);
 
-            lvar->entity = argvar->entity;
             return true;
         }
         else
@@ -341,8 +364,9 @@ void Script::handle_special_commands(const std::vector<shared_ptr<Script>>& scri
 
     auto send_input_vars = [&](const SyntaxTree::const_iterator& input_begin,
         const SyntaxTree::const_iterator& input_end,
-        shared_ptr<const Scope>& target_scope, bool is_cleo_call)
+        const Label& target_label, bool is_cleo_call)
     {
+        auto& target_scope = target_label.scope;
         size_t target_var_index = 0;
         for(auto arginput = input_begin; arginput != input_end; ++arginput)
         {
@@ -365,13 +389,13 @@ void Script::handle_special_commands(const std::vector<shared_ptr<Script>>& scri
                         program.error(**arginput, "CLEO_CALL semantics for TEXT_LABEL inputs are still unspecified");
                         break;
                     }
-                    handle_script_input(**arginput, lvar, is_cleo_call);
+                    handle_script_input(**arginput, target_label, lvar, is_cleo_call);
                     break;
                 case VarType::Float:
                     ++target_var_index;
                     if((**arginput).maybe_annotation<const float&>())
                         break;
-                    handle_script_input(**arginput, lvar, is_cleo_call);
+                    handle_script_input(**arginput, target_label, lvar, is_cleo_call);
                     break;
                 case VarType::TextLabel:
                     target_var_index += 2;
@@ -401,7 +425,6 @@ void Script::handle_special_commands(const std::vector<shared_ptr<Script>>& scri
                 auto& outvar = *opt_outvar;
                 auto& scope_output = (*target_scope->outputs)[i];
                 auto output_type = scope_output.first;
-                auto output_entity = scope_output.second.expired()? 0 : scope_output.second.lock()->entity;
 
                 assert(output_type == Scope::OutputType::Int || output_type == Scope::OutputType::Float);
 
@@ -412,14 +435,8 @@ void Script::handle_special_commands(const std::vector<shared_ptr<Script>>& scri
                     continue;
                 }
 
-                if(outvar->entity && output_entity != outvar->entity)
-                {
-                    program.error(**argoutput, "entity type mismatch");
-                    // TODO more info
-                    continue;
-                }
-
-                outvar->entity = output_entity;
+                if(program.opt.entity_tracking && !scope_output.second.expired())
+                    entities.add_output(script_index, **argoutput, outvar, scope_output.second.lock());
             }
             else
             {
@@ -451,7 +468,8 @@ void Script::handle_special_commands(const std::vector<shared_ptr<Script>>& scri
             return;
         }
 
-        send_input_vars(std::next(node.begin(), 2), node.end(), target_scope, false);
+        entities.add_entry(**opt_target_label);
+        send_input_vars(std::next(node.begin(), 2), node.end(), **opt_target_label, false);
     };
 
     auto handle_start_new_streamed_script = [&](const SyntaxTree& node, const Command& command)
@@ -476,27 +494,10 @@ void Script::handle_special_commands(const std::vector<shared_ptr<Script>>& scri
             {
                 if(auto opt_argvar = get_base_var_annotation(**it))
                 {
-                    auto& argvar = **opt_argvar;
                     if(arginfo.is_output)
-                    {
-                        if(argvar.entity && argvar.entity != arginfo.entity_type)
-                        {
-                            auto type_old = program.commands.find_entity_name(argvar.entity).value();
-                            auto type_new = program.commands.find_entity_name(arginfo.entity_type).value();
-                            program.error(**it, "variable has already been used to create a entity of type {}", type_old);
-                        }
-
-                        argvar.entity = arginfo.entity_type;
-                    }
+                        entities.add_def(script_index, **it, *opt_argvar, arginfo.entity_type);
                     else
-                    {
-                        if(argvar.entity != arginfo.entity_type)
-                        {
-                            auto expect = program.commands.find_entity_name(arginfo.entity_type).value();
-                            auto got = program.commands.find_entity_name(argvar.entity).value();
-                            program.error(**it, "expected variable of type {} but got {}", expect, got);
-                        }
-                    }
+                        entities.add_use(script_index, **it, *opt_argvar, arginfo.entity_type);
                 }
             }
         }
@@ -566,7 +567,10 @@ void Script::handle_special_commands(const std::vector<shared_ptr<Script>>& scri
             return;
         }
 
-        send_input_vars(std::next(node.begin(), 3), std::next(node.begin(), 3 + num_inputs), target_scope, true);
+        if(program.opt.entity_tracking)
+            entities.add_entry(**opt_target_label);
+
+        send_input_vars(std::next(node.begin(), 3), std::next(node.begin(), 3 + num_inputs), **opt_target_label, true);
         recv_output_vars(std::next(node.begin(), 3 + num_inputs), node.end(), target_scope, true);
 
         argcount_node.set_annotation(int32_t(num_inputs));
@@ -614,18 +618,8 @@ void Script::handle_special_commands(const std::vector<shared_ptr<Script>>& scri
 
                 if(auto opt_var = get_base_var_annotation(**it))
                 {
-                    if(!output.second.expired())
-                    {
-                        auto output_var = output.second.lock();
-                        auto& return_var = *opt_var;
-
-                        if(output_var->entity != return_var->entity)
-                        {
-                            program.error(**it, "entity type mismatch");
-                            // TODO more info
-                            continue;
-                        }
-                    }
+                    if(program.opt.entity_tracking && !output.second.expired())
+                        entities.add_return(script_index, **it, *opt_var, output.second.lock());
                 }
             }
             else
@@ -654,24 +648,17 @@ void Script::handle_special_commands(const std::vector<shared_ptr<Script>>& scri
         }
     };
 
-    auto try_handle_set_total = [&](SyntaxTree& node, const Command& command,
-                                   const optional<const Command&>& expected,
-                                   shared_ptr<SyntaxTree>& had_node)
+    auto handle_set_total = [&](SyntaxTree& node, const Command& command, shared_ptr<SyntaxTree>& had_node)
     {
-        if(program.commands.equal(command, expected))
+        if(had_node)
         {
-            if(had_node)
-            {
-                program.error(node, "{} happens multiple times", command.name);
-                program.note(*had_node, "previously seen here");
-            }
-            else
-            {
-                had_node = node.shared_from_this();
-            }
-            return true;
+            program.error(node, "{} happens multiple times", command.name);
+            program.note(*had_node, "previously seen here");
+        }
+        else
+        {
+            had_node = node.shared_from_this();
         }
-        return false;
     };
 
     auto set_total_annotation = [&](shared_ptr<SyntaxTree>& node, int32_t count)
@@ -688,26 +675,23 @@ void Script::handle_special_commands(const std::vector<shared_ptr<Script>>& scri
         }
     };
 
-    auto try_handle_increase_counter = [&](SyntaxTree& node, const Command& command,
-                                           const optional<const Command&>& expected,
-                                           int32_t& counter)
+    auto handle_increase_counter = [&](SyntaxTree& node, int32_t& counter)
     {
-        if(program.commands.equal(command, expected))
+        if(node.child_count() >= 2)
         {
-            if(node.child_count() >= 2)
-            {
-                if(auto inc = node.child(1).maybe_annotation<int32_t>())
-                    counter += *inc;
-                else
-                    program.warning(node, "value is not a constant");
-            }
-            return true;
+            if(auto inc = node.child(1).maybe_annotation<int32_t>())
+                counter += *inc;
+            else if(auto value = values.constant_at(node.child(1)))
+                counter += *value;
+            else
+                program.warning(node, "value is not a constant");
         }
-        return false;
     };
 
-    for(auto& script : scripts)
+    for(script_index = 0; script_index < scripts.size(); ++script_index)
     {
+        auto& script = scripts[script_index];
+        values.track(*script, program.commands);
         script->tree->depth_first([&](SyntaxTree& node)
         {
             switch(node.type())
@@ -721,62 +705,74 @@ void Script::handle_special_commands(const std::vector<shared_ptr<Script>>& scri
 
                 case NodeType::Command:
                 {
+                    program.check_budget(node);
+
                     if(auto opt_command = node.maybe_annotation<std::reference_wrapper<const Command>>())
                     {
                         const bool is_child_of_custom = script->is_child_of_custom();
                         const bool is_child_of_custom_script = script->is_child_of(ScriptType::CustomScript);
 
                         auto& command = (*opt_command).get();
-                        if(program.commands.equal(command, program.commands.script_name))
-                        {
-                            handle_script_name(node, command);
-                        }
-                        else if(try_handle_set_total(node, command, program.commands.set_progress_total, node_set_progress_total)
-                             || try_handle_set_total(node, command, program.commands.set_total_number_of_missions, node_set_total_number_of_missions)
-                             || try_handle_set_total(node, command, program.commands.set_collectable1_total, node_set_collectable1_total)
-                             || try_handle_set_total(node, command, program.commands.set_mission_respect_total, node_set_mission_respect_total))
-                            {}
-                        else if(program.commands.equal(command, program.commands.register_mission_passed)
-                             || program.commands.equal(command, program.commands.register_oddjob_mission_passed))
-                            { ++count_mission_passed; }
-                        else if(program.commands.equal(command, program.commands.create_collectable1))
-                            { ++count_collectable1; }
-                        else if(try_handle_increase_counter(node, command, program.commands.player_made_progress, count_progress)
-                             || try_handle_increase_counter(node, command, program.commands.award_player_mission_respect, count_respect))
-                            {}
-                        else if(is_child_of_custom && program.commands.equal(command, program.commands.start_new_script))
-                        {
-                            program.error(node, "this command is not allowed in {} scripts", to_string(script->type));
-                        }
-                        else if(is_child_of_custom_script
-                            && program.commands.equal(command, program.commands.terminate_this_script))
-                        {
-                            program.error(node, "this command is not allowed in {} scripts", to_string(script->type));
-                        }
-                        else if(!is_child_of_custom_script
-                            && program.commands.equal(command, program.commands.terminate_this_custom_script))
-                        {
-                            program.error(node, "this command is not allowed in {} scripts", to_string(script->type));
-                        }
-                        else if(program.commands.equal(command, program.commands.start_new_script))
+                        switch(command.special)
                         {
-                            handle_start_new_script(node, command);
-                        }
-                        else if(program.commands.equal(command, program.commands.start_new_streamed_script))
-                        {
-                            handle_start_new_streamed_script(node, command);
-                        }
-                        else if(program.commands.equal(command, program.commands.cleo_call))
-                        {
-                            handle_cleo_call(node, command);
-                        }
-                        else if(program.commands.equal(command, program.commands.cleo_return))
-                        {
-                            handle_cleo_return(node, command);
-                        }
-                        else
-                        {
-                            handle_entity_command(node, command);
+                            case SpecialCommand::ScriptName:
+                                handle_script_name(node, command);
+                                break;
+                            case SpecialCommand::SetProgressTotal:
+                                handle_set_total(node, command, node_set_progress_total);
+                                break;
+                            case SpecialCommand::SetTotalNumberOfMissions:
+                                handle_set_total(node, command, node_set_total_number_of_missions);
+                                break;
+                            case SpecialCommand::SetCollectable1Total:
+                                handle_set_total(node, command, node_set_collectable1_total);
+                                break;
+                            case SpecialCommand::SetMissionRespectTotal:
+                                handle_set_total(node, command, node_set_mission_respect_total);
+                                break;
+                            case SpecialCommand::RegisterMissionPassed:
+                            case SpecialCommand::RegisterOddjobMissionPassed:
+                                ++count_mission_passed;
+                                break;
+                            case SpecialCommand::CreateCollectable1:
+                                ++count_collectable1;
+                                break;
+                            case SpecialCommand::PlayerMadeProgress:
+                                handle_increase_counter(node, count_progress);
+                                break;
+                            case SpecialCommand::AwardPlayerMissionRespect:
+                                handle_increase_counter(node, count_respect);
+                                break;
+                            case SpecialCommand::StartNewScript:
+                                if(is_child_of_custom)
+                                    program.error(node, "this command is not allowed in {} scripts", to_string(script->type));
+                                else
+                                    handle_start_new_script(node, command);
+                                break;
+                            case SpecialCommand::TerminateThisScript:
+                                if(is_child_of_custom_script)
+                                    program.error(node, "this command is not allowed in {} scripts", to_string(script->type));
+                                else
+                                    handle_entity_command(node, command);
+                                break;
+                            case SpecialCommand::TerminateThisCustomScript:
+                                if(!is_child_of_custom_script)
+                                    program.error(node, "this command is not allowed in {} scripts", to_string(script->type));
+                                else
+                                    handle_entity_command(node, command);
+                                break;
+                            case SpecialCommand::StartNewStreamedScript:
+                                handle_start_new_streamed_script(node, command);
+                                break;
+                            case SpecialCommand::CleoCall:
+                                handle_cleo_call(node, command);
+                                break;
+                            case SpecialCommand::CleoReturn:
+                                handle_cleo_return(node, command);
+                                break;
+                            default:
+                                handle_entity_command(node, command);
+                                break;
                         }
                     }
                     return false;
@@ -787,28 +783,35 @@ void Script::handle_special_commands(const std::vector<shared_ptr<Script>>& scri
                     auto& a = node.child(0);
                     auto& b = node.child(1);
 
-                    // handle only a = b, not a = b op c (TODO that should be handled as well).
                     if(!b.maybe_annotation<std::reference_wrapper<const Command>>())
                     {
+                        // a = b
                         auto& command = node.annotation<std::reference_wrapper<const Command>>().get();
                         if(program.commands.is_alternator(command, program.commands.set))
                         {
                             auto opt_avar = get_base_var_annotation(a);
                             auto opt_bvar = get_base_var_annotation(b);
-                            if(opt_avar && opt_bvar)
+                            if(opt_avar && opt_bvar && program.opt.entity_tracking)
+                                entities.add_copy(script_index, node, *opt_avar, *opt_bvar);
+                        }
+                    }
+                    else if(program.opt.entity_tracking)
+                    {
+                        // a = b op c, or a op= c
+                        if(auto opt_avar = get_base_var_annotation(a))
+                        {
+                            bool has_operand = false;
+                            for(auto& operand : b)
                             {
-                                auto& avar = **opt_avar;
-                                auto& bvar = **opt_bvar;
-
-                                if(avar.entity && avar.entity != bvar.entity)
+                                auto opt_var = get_base_var_annotation(*operand);
+                                if(opt_var && *opt_var != *opt_avar)
                                 {
-                                    auto type_a = program.commands.find_entity_name(avar.entity).value();
-                                    auto type_b = program.commands.find_entity_name(bvar.entity).value();
-                                    program.error(node, "assignment of variable of type {} into one of type {}", type_b, type_a);
+                                    entities.add_arithmetic(script_index, node, *opt_avar, *opt_var);
+                                    has_operand = true;
                                 }
-
-                                avar.entity = bvar.entity;
                             }
+                            if(!has_operand)
+                                entities.add_arithmetic(script_index, node, *opt_avar, nullptr);
                         }
                     }
 
@@ -821,6 +824,9 @@ void Script::handle_special_commands(const std::vector<shared_ptr<Script>>& scri
         });
     }
 
+    if(program.opt.entity_tracking)
+        entities.solve(program);
+
     set_total_annotation(node_set_collectable1_total, count_collectable1);
     set_total_annotation(node_set_total_number_of_missions, count_mission_passed);
     set_total_annotation(node_set_progress_total, count_progress);
@@ -844,9 +850,11 @@ void Script::compute_scope_outputs(const SymTable& symbols, ProgramContext& prog
             {
                 case NodeType::Command:
                 {
+                    program.check_budget(node);
+
                     if(auto opt_command = node.maybe_annotation<std::reference_wrapper<const Command>>())
                     {
-                        if(!program.commands.equal(*opt_command, program.commands.cleo_return))
+                        if(opt_command->get().special != SpecialCommand::CleoReturn)
                             return false;
 
                         if(node.child_count() < 2)
@@ -936,6 +944,8 @@ void Script::fix_call_scope_variables(ProgramContext& program)
                 assert(var_index >= program.opt.mission_var_begin);
                 var_index -= program.opt.mission_var_begin;
             }
+
+            scope->reindex_vars();
         }
     }
 }
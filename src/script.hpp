@@ -169,6 +169,10 @@ public:
     /// All the scopes within this script.
     std::vector<shared_ptr<Scope>> scopes;
 
+    /// The scopes called by `CLEO_CALL` from outside of any scope of this script.
+    /// This value is made available after the AST annotation step.
+    std::vector<const Scope*> cleo_callees;
+
     // Required scripts.
     std::vector<weak_ptr<const Script>> children_scripts;   //< Required scripts.
     weak_ptr<const Script>              parent_script;      //< Parent of required script.
@@ -193,7 +197,7 @@ struct Var
     weak_ptr<const SyntaxTree>where; //< Declaration node or expired() if none.
     const bool                global;
     const VarType             type;
-    EntityType                entity;///< The entity type of this variable. \note only avaiabile after Script::verify_special_commands(...). 
+    EntityType                entity;///< The entity type of this variable. \note only avaiabile after Script::handle_special_commands(...), see *entity_inference.hpp*.
     uint32_t                  index; ///< Variable index (not offset). \note this value is not well-defined until the ir-generation step.
     const optional<uint32_t>  count; ///< If an array, the number of elements of it.
 
@@ -235,7 +239,8 @@ public:
     using OutputVector = std::vector<std::pair<OutputType, weak_ptr<Var>>>;
 
 public:
-    insensitive_map<std::string, shared_ptr<Var>>   vars;       //< The variables in this scope.
+    insensitive_map<std::string, shared_ptr<Var>>   vars;       //< The variables in this scope (added by `add_var`).
+    std::vector<const Scope*>   cleo_callees;   //< The scopes called by `CLEO_CALL` from this scope (by `Script::annotate_tree`).
     
     explicit Scope(weak_ptr<SyntaxTree> tree) :
         tree(std::move(tree))
@@ -244,15 +249,31 @@ public:
     /// Whether this is a call scope.
     bool is_call_scope() const { return this->outputs != nullopt; }
 
+    /// Adds the variable `var` named `name` into this scope, unless the name exists already.
+    /// \returns the variable named `name`, and whether `var` was added.
+    std::pair<shared_ptr<Var>, bool> add_var(std::string name, shared_ptr<Var> var);
+
     /// Returns the variable at the specified local index.
     shared_ptr<Var> var_at(size_t index) const;
 
+    /// \returns the scope node (of type NodeType::Scope), or null if it does not exist anymore.
+    shared_ptr<const SyntaxTree> node() const { return this->tree.lock(); }
+
+    /// \returns the local index after the highest variable of this scope (i.e. the frame size, in words).
+    uint32_t frame_size() const { return this->frame_end; }
+
 protected:
     weak_ptr<SyntaxTree>    tree;       //< The scope node (of type NodeType::Scope)
     optional<OutputVector>  outputs;    //< If this is a call scope, the outputs of the scope.
 
+    std::map<uint32_t, shared_ptr<Var>> vars_by_index;  //< The variables in this scope sorted by index.
+    uint32_t                            frame_end = 0;  //< The highest `end_offset()/4` of the variables.
+
     static optional<OutputType> output_type_from_node(const SyntaxTree& node);
 
+    /// Rebuilds `vars_by_index` and `frame_end` after the indices of the variables changed.
+    void reindex_vars();
+
     friend class Script;
 };
 
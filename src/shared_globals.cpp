@@ -0,0 +1,320 @@
+#include <stdinc.h>
+#include "shared_globals.hpp"
+
+/// Number of threads named in each row of the table.
+static constexpr size_t max_listed = 8;
+
+namespace
+{
+    /// A set of threads for each of a number of rows, packed 64 threads in each word.
+    class ThreadSets
+    {
+    public:
+        explicit ThreadSets(size_t num_rows, size_t num_threads)
+            : words((num_threads + 63) / 64), bits(num_rows * words)
+        {}
+
+        void set(size_t row, uint32_t thread)
+        {
+            bits[row * words + thread / 64] |= uint64_t(1) << (thread % 64);
+        }
+
+        bool test(size_t row, uint32_t thread) const
+        {
+            return (bits[row * words + thread / 64] & (uint64_t(1) << (thread % 64))) != 0;
+        }
+
+        bool any(size_t row) const
+        {
+            auto first = bits.begin() + row * words;
+            return std::any_of(first, first + words, [](uint64_t word) { return word != 0; });
+        }
+
+        /// Adds the threads of `other[other_row]` into `row`.
+        void merge(size_t row, const ThreadSets& other, size_t other_row)
+        {
+            for(size_t i = 0; i < words; ++i)
+                bits[row * words + i] |= other.bits[other_row * other.words + i];
+        }
+
+    private:
+        size_t                  words;  //< Words in each row.
+        std::vector<uint64_t>   bits;
+    };
+
+    struct Thread
+    {
+        uint32_t    node;
+        std::string name;       //< The label it's started at, or the filename of its script.
+        std::string file;
+        size_t      line = 0;
+        size_t      column = 0;
+    };
+
+    struct SharedGlobal
+    {
+        std::string             name;
+        std::vector<uint32_t>   writers;
+        std::vector<uint32_t>   readers;
+    };
+}
+
+static std::vector<Thread> collect_threads(const CodeGraph& graph, const SymTable& symbols)
+{
+    std::unordered_map<const Label*, string_view> label_names;
+    for(auto& pair : symbols.labels)
+        label_names.emplace(pair.second.get(), pair.first);
+
+    std::vector<Thread> threads;
+    std::vector<bool> seen(graph.size());
+
+    // Many START_NEW_SCRIPT may start the same thread.
+    for(auto& entry : graph.entries())
+    {
+        if(seen[entry.node])
+            continue;
+        seen[entry.node] = true;
+
+        Thread thread;
+        thread.node = entry.node;
+
+        const SyntaxTree* where = entry.where;
+        shared_ptr<const SyntaxTree> label_where;
+
+        auto it = entry.label? label_names.find(entry.label.get()) : label_names.end();
+        if(it != label_names.end())
+        {
+            thread.name = it->second.to_string();
+            label_where = entry.label->where.lock();
+            where = label_where.get();
+        }
+        else if(entry.script)
+        {
+            thread.name = entry.script->path.filename().generic_u8string();
+        }
+
+        if(entry.script)
+            thread.file = entry.script->path.generic_u8string();
+
+        if(where && where->has_text())
+        {
+            if(auto tstream = where->token_stream().lock())
+                std::tie(thread.line, thread.column) = tstream->text.linecol_from_offset(where->get_token().begin);
+        }
+
+        threads.emplace_back(std::move(thread));
+    }
+
+    return threads;
+}
+
+/// \returns the threads which may run each component of `graph`.
+static ThreadSets compute_reach(const CodeGraph& graph, const std::vector<Thread>& threads)
+{
+    auto& components = graph.components();
+    ThreadSets reach(components.size(), threads.size());
+
+    for(uint32_t i = 0; i < threads.size(); ++i)
+        reach.set(components.component[threads[i].node], i);
+
+    // Every component reaching another is numbered after it, so it's complete once visited in decreasing order.
+    for(uint32_t id = components.size(); id-- > 0; )
+    {
+        if(!reach.any(id))
+            continue;
+
+        for(auto member = components.begin(id); member != components.end(id); ++member)
+        {
+            for(auto edge = graph.begin(*member); edge != graph.end(*member); ++edge)
+            {
+                auto to_component = components.component[edge->to];
+                if(to_component != id)
+                    reach.merge(to_component, reach, id);
+            }
+        }
+    }
+
+    return reach;
+}
+
+static std::vector<SharedGlobal> find_shared_globals(const CodeGraph& graph, const SymTable& symbols,
+                                                     const std::vector<Thread>& threads, const Commands& commands)
+{
+    // The alternators whose first argument is assigned, and whether its former value is used as well.
+    std::unordered_map<const Command*, bool> assignments;
+    for(auto& alternator : { commands.set, commands.cset })
+    {
+        if(alternator)
+        {
+            for(auto command : *alternator)
+                assignments.emplace(command, false);
+        }
+    }
+    for(auto& alternator : { commands.add_thing_to_thing, commands.sub_thing_from_thing,
+                             commands.mult_thing_by_thing, commands.div_thing_by_thing,
+                             commands.add_thing_to_thing_timed, commands.sub_thing_from_thing_timed })
+    {
+        if(alternator)
+        {
+            for(auto command : *alternator)
+                assignments.emplace(command, true);
+        }
+    }
+
+    std::vector<std::pair<string_view, const Var*>> globals;
+    globals.reserve(symbols.global_vars.size());
+    for(auto& pair : symbols.global_vars)
+        globals.emplace_back(pair.first, pair.second.get());
+
+    std::sort(globals.begin(), globals.end(), [](const auto& a, const auto& b) {
+        return a.second->index < b.second->index;
+    });
+
+    std::unordered_map<const Var*, size_t> rows;
+    for(size_t i = 0; i < globals.size(); ++i)
+        rows.emplace(globals[i].second, i);
+
+    auto& components = graph.components();
+    auto reach = compute_reach(graph, threads);
+
+    ThreadSets writers(globals.size(), threads.size());
+    ThreadSets readers(globals.size(), threads.size());
+
+    auto use = [&](const shared_ptr<Var>& var, uint32_t component, bool is_write, bool is_read) {
+        if(!var->global)
+            return;
+
+        auto it = rows.find(var.get());
+        if(it == rows.end())
+            return;
+
+        if(is_write) writers.merge(it->second, reach, component);
+        if(is_read) readers.merge(it->second, reach, component);
+    };
+
+    for(uint32_t node = 0; node < graph.size(); ++node)
+    {
+        auto component = components.component[node];
+        if(!reach.any(component))
+            continue;
+
+        auto& compiled = graph.command(node);
+        auto it_assignment = assignments.find(&compiled.command);
+
+        for(size_t i = 0; i < compiled.args.size(); ++i)
+        {
+            if(!is<CompiledVar>(compiled.args[i]))
+                continue;
+
+            auto& cvar = get<CompiledVar>(compiled.args[i]);
+            auto arginfo = compiled.command.arg(i);
+
+            bool is_assigned = (i == 0 && it_assignment != assignments.end());
+            bool is_write = is_assigned || (arginfo && arginfo->is_output);
+            bool is_read = !is_write || (is_assigned && it_assignment->second);
+            use(cvar.var, component, is_write, is_read);
+
+            if(cvar.index && is<shared_ptr<Var>>(*cvar.index))
+                use(get<shared_ptr<Var>>(*cvar.index), component, false, true);
+        }
+    }
+
+    std::vector<SharedGlobal> result;
+    for(size_t row = 0; row < globals.size(); ++row)
+    {
+        SharedGlobal global;
+        bool is_read_elsewhere = false;
+
+        for(uint32_t thread = 0; thread < threads.size(); ++thread)
+        {
+            bool is_writer = writers.test(row, thread);
+            bool is_reader = readers.test(row, thread);
+
+            if(is_writer)
+                global.writers.push_back(thread);
+            if(is_reader)
+                global.readers.push_back(thread);
+            if(is_reader && !is_writer)
+                is_read_elsewhere = true;
+        }
+
+        if(global.writers.size() >= 2 || (global.writers.size() == 1 && is_read_elsewhere))
+        {
+            global.name = globals[row].first.to_string();
+            result.emplace_back(std::move(global));
+        }
+    }
+
+    return result;
+}
+
+void print_shared_globals_report(const CodeGraph& graph, const SymTable& symbols, const ProgramContext& program,
+                                 const TextSink& sink)
+{
+    auto threads = collect_threads(graph, symbols);
+    auto globals = find_shared_globals(graph, symbols, threads, program.commands);
+
+    if(program.opt.shared_globals_report == Options::ReportFormat::Table)
+    {
+        auto row = "{:<24} {:>7} {:>7}  {}\n";
+
+        auto names = [&](const std::vector<uint32_t>& indices) {
+            std::string list;
+            for(size_t i = 0; i < indices.size() && i < max_listed; ++i)
+                list += fmt::format("{}{}", i? " " : "", threads[indices[i]].name);
+            if(indices.size() > max_listed)
+                list += fmt::format(" (+{})", indices.size() - max_listed);
+            return list;
+        };
+
+        std::string out = fmt::format(row, "GLOBAL", "WRITERS", "READERS", "WRITTEN BY / READ BY");
+        for(auto& global : globals)
+        {
+            out += fmt::format(row, global.name, global.writers.size(), global.readers.size(),
+                               names(global.writers) + " / " + (global.readers.empty()? "-" : names(global.readers)));
+        }
+
+        sink(out);
+    }
+    else if(program.opt.shared_globals_report == Options::ReportFormat::JSON)
+    {
+        /*
+            {
+                "threads": [{
+                    "name": string,                     // the label it's started at, or its script filename
+                    "file": string, "line": integer, "column": integer,
+                }],
+                "globals": [{
+                    "name": string,
+                    "writers": [integer],               // indices into threads
+                    "readers": [integer],               // ditto
+                }],
+            }
+        */
+        auto indices = [](const std::vector<uint32_t>& list) {
+            std::string out;
+            for(size_t i = 0; i < list.size(); ++i)
+                out += fmt::format("{}{}", i? ", " : "", list[i]);
+            return out;
+        };
+
+        std::string out = "{\"threads\": [";
+        for(size_t i = 0; i < threads.size(); ++i)
+        {
+            out += fmt::format(R"({}{{"name": {}, "file": {}, "line": {}, "column": {}}})",
+                               i? ", " : "", make_quoted(threads[i].name), make_quoted(threads[i].file),
+                               threads[i].line, threads[i].column);
+        }
+
+        out += "], \"globals\": [";
+        for(size_t i = 0; i < globals.size(); ++i)
+        {
+            out += fmt::format(R"({}{{"name": {}, "writers": [{}], "readers": [{}]}})",
+                               i? ", " : "", make_quoted(globals[i].name),
+                               indices(globals[i].writers), indices(globals[i].readers));
+        }
+        out += "]}\n";
+
+        sink(out);
+    }
+}
@@ -0,0 +1,26 @@
+///
+/// Shared Globals
+///
+/// Every script thread (the main script, missions, streamed scripts and the labels given to START_NEW_SCRIPT) shares
+/// the same global variable block. A global written by a thread and used by another one may change under the latter
+/// whenever it waits, which is a common source of bugs hard to reproduce. This reports such globals
+/// (`--shared-globals-report`), so the scripts may be checked for it.
+///
+/// The commands a thread may run are the ones reachable from where it starts in the graph of the compiled IR (see
+/// code_graph.hpp), following the GOSUB and CLEO_CALL edges as well. The set of threads reaching each strongly connected
+/// component is a bitset, propagated once per component in their topological order, and then added into the writers or
+/// readers bitset of each global the commands of the component use. Thus the analysis takes linear time in the size of
+/// the program for every 64 threads, which scales fine into thousands of globals.
+///
+/// A global is written by the assignments into it (`SET`, `ADD_VAL_TO_INT_VAR` and the like) and by the output
+/// arguments of commands. It's read everywhere else, including when used as an array index.
+///
+/// The report gives the globals written by more than a thread, and the globals written by a thread and read by another.
+///
+#pragma once
+#include <stdinc.h>
+#include "code_graph.hpp"
+
+/// Prints the shared globals report of `graph` in the `program.opt.shared_globals_report` format into `sink`.
+void print_shared_globals_report(const CodeGraph& graph, const SymTable& symbols, const ProgramContext& program,
+                                 const TextSink& sink);
@@ -30,6 +30,7 @@
 #include "cpp/string_view.hpp"
 #include "cpp/small_vector.hpp"
 #include "cpp/icompare.hpp"
+#include "cpp/charconv.hpp"
 #include "cpp/contracts.hpp"
 #include "cpp/file.hpp"
 
@@ -158,22 +158,25 @@ bool IncluderTable::add_script(ScriptType type, const SyntaxTree& command, Progr
 
 optional<shared_ptr<Var>> SymTable::highest_global_var() const
 {
-    auto fn_comp = [](const auto& apair, const auto& bpair)
-    {
-        const shared_ptr<Var>& a = apair.second;
-        const shared_ptr<Var>& b = bpair.second;
-        if(a->index < b->index)
-            return true;
-        else if(a->index != b->index)
-            return false;
-        else
-            return a->space_taken() < b->space_taken();
-    };
+    if(this->highest_gvar)
+        return this->highest_gvar;
+    return nullopt;
+}
 
-    auto it = std::max_element(this->global_vars.begin(), this->global_vars.end(), fn_comp);
-    if(it == this->global_vars.end())
-        return nullopt;
-    return it->second;
+auto SymTable::add_global_var(std::string name, shared_ptr<Var> var) -> std::pair<shared_ptr<Var>, bool>
+{
+    auto pair = this->global_vars.emplace(std::move(name), std::move(var));
+    if(pair.second)
+    {
+        auto& added = pair.first->second;
+        if(!this->highest_gvar
+            || added->index > this->highest_gvar->index
+            || (added->index == this->highest_gvar->index && added->space_taken() > this->highest_gvar->space_taken()))
+        {
+            this->highest_gvar = added;
+        }
+    }
+    return { pair.first->second, pair.second };
 }
 
 void SymTable::build_script_table(const std::vector<shared_ptr<Script>>& scripts)
@@ -251,6 +254,10 @@ void SymTable::merge(SymTable&& t2, ProgramContext& program)
     t1.global_vars.insert(std::make_move_iterator(t2.global_vars.begin()),
         std::make_move_iterator(t2.global_vars.end()));
 
+    // the variables of t2 were shifted after the ones of t1
+    if(t2.highest_gvar)
+        t1.highest_gvar = std::move(t2.highest_gvar);
+
     t1.local_scopes.reserve(t1.local_scopes.size() + t2.local_scopes.size());
     std::move(t2.local_scopes.begin(), t2.local_scopes.end(), std::back_inserter(t1.local_scopes));
 
@@ -396,6 +403,8 @@ void IncluderTable::scan_for_includers(const Script& script, ProgramContext& pro
         {
             case NodeType::Command:
             {
+                program.check_budget(node);
+
                 auto command_name = node.child(0).text();
 
                 if(iequal_to()(command_name, "GOSUB_FILE"))
@@ -504,8 +513,8 @@ void SymTable::scan_symbols(Script& script, ProgramContext& program)
                 {
                     local_index = (!script.is_child_of_mission()? 0 : program.opt.mission_var_begin);
                     current_scope = this->add_scope(node);
-                    current_scope->vars.emplace("TIMERA", std::make_shared<Var>(false, VarType::Int, program.opt.timer_index + 0, nullopt));
-                    current_scope->vars.emplace("TIMERB", std::make_shared<Var>(false, VarType::Int, program.opt.timer_index + 1, nullopt));
+                    current_scope->add_var("TIMERA", std::make_shared<Var>(false, VarType::Int, program.opt.timer_index + 0, nullopt));
+                    current_scope->add_var("TIMERB", std::make_shared<Var>(false, VarType::Int, program.opt.timer_index + 1, nullopt));
                     script.scopes.emplace_back(current_scope);
                 }
                 else
@@ -548,7 +557,6 @@ void SymTable::scan_symbols(Script& script, ProgramContext& program)
                     return false;
                 }
 
-                auto& target = global? this->global_vars : current_scope->vars;
                 auto& index = global? global_index : local_index;
 
                 size_t max_index = [&] {
@@ -606,8 +614,10 @@ void SymTable::scan_symbols(Script& script, ProgramContext& program)
                             continue;
                         }
 
-                        auto pair = target.emplace(name, std::make_shared<Var>(varnode, global, vartype, index, count));
-                        auto var = pair.first->second;
+                        auto new_var = std::make_shared<Var>(varnode, global, vartype, index, count);
+                        auto pair = global? this->add_global_var(name.to_string(), std::move(new_var))
+                                          : current_scope->add_var(name.to_string(), std::move(new_var));
+                        auto var = pair.first;
 
                         if(!pair.second)
                         {
@@ -661,6 +671,10 @@ void SymTable::scan_symbols(Script& script, ProgramContext& program)
                 return false;
             }
 
+            case NodeType::Command:
+                program.check_budget(node);
+                return true;
+
             default:
                 return true;
         }
@@ -885,6 +899,8 @@ void Script::annotate_tree(const SymTable& symbols, ProgramContext& program)
 
             case NodeType::Command:
             {
+                program.check_budget(node);
+
                 auto command_name = node.child(0).text();
                 auto use_filenames = (this->type == ScriptType::Main || this->type == ScriptType::MainExtension);
 
@@ -945,7 +961,7 @@ void Script::annotate_tree(const SymTable& symbols, ProgramContext& program)
                         commands.annotate(node, command, symbols, current_scope, *this, program);
                         node.set_annotation(std::cref(command));
 
-                        if(commands.equal(command, commands.skip_cutscene_start))
+                        if(command.special == SpecialCommand::SkipCutsceneStart)
                         {
                             const Command& internal = program.supported_or_fatal(node, commands.skip_cutscene_start_internal,
                                                                                  "SKIP_CUTSCENE_START_INTERNAL");
@@ -963,18 +979,30 @@ void Script::annotate_tree(const SymTable& symbols, ProgramContext& program)
                                 node.set_annotation(ReplacedCommandAnnotation { internal, {cutscene_skip} } );
                             }
                         }
-                        else if(commands.equal(command, commands.skip_cutscene_end))
+                        else if(command.special == SpecialCommand::SkipCutsceneEnd)
                         {
                             if(!cutscene_skip)
                                 program.error(node, "{} without SKIP_CUTSCENE_START", command_name);
                             else
                                 cutscene_skip = nullptr;
                         }
-                        else if(commands.equal(command, commands.cleo_return))
+                        else if(command.special == SpecialCommand::CleoReturn)
                         {
                             if(!current_scope)
                                 program.error(node, "CLEO_RETURN must be inside a scope");
                         }
+                        else if(command.special == SpecialCommand::CleoCall && node.child_count() >= 2)
+                        {
+                            if(auto opt_label = node.child(1).maybe_annotation<const shared_ptr<Label>&>())
+                            {
+                                if(auto callee = (*opt_label)->scope.get())
+                                {
+                                    auto& callees = current_scope? current_scope->cleo_callees : this->cleo_callees;
+                                    if(std::find(callees.begin(), callees.end(), callee) == callees.end())
+                                        callees.push_back(callee);
+                                }
+                            }
+                        }
                     }
                     else
                     {
@@ -108,6 +108,10 @@ protected:
 
     bool add_script(ScriptType type, const SyntaxTree& command, ProgramContext& program);
 
+    /// Adds the global variable `var` named `name`, unless the name exists already.
+    /// \returns the variable named `name`, and whether `var` was added.
+    std::pair<shared_ptr<Var>, bool> add_global_var(std::string name, shared_ptr<Var> var);
+
     shared_ptr<Scope> add_scope(SyntaxTree& tree)
     {
         return *local_scopes.emplace(local_scopes.end(), new Scope(tree.shared_from_this()));
@@ -143,6 +147,7 @@ public:
     IncluderTable ictable;
 
     uint32_t offset_global_vars = 0;
+    shared_ptr<Var> highest_gvar;       //< The highest variable in `global_vars`, see `highest_global_var`.
 };
 
 inline auto get_base_var_annotation(const SyntaxTree& var_node) -> optional<shared_ptr<Var>>
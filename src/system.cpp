@@ -4,10 +4,14 @@
 
 #if defined(_WIN32)
 #include <windows.h>
+#include <psapi.h>
 #include <io.h>
 #elif defined(__unix__)
 #include <unistd.h>
 #include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
 #endif
 
 static fs::path find_config_path()
@@ -102,3 +106,119 @@ bool allocate_file(FILE* f, uint64_t size)
 #   error allocate_file not implemented for this platform.
 #endif
 }
+
+optional<size_t> resident_memory_size()
+{
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+    if(GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return counters.WorkingSetSize;
+    return nullopt;
+#elif defined(__linux__)
+    // the second field of statm is the number of resident pages.
+    unsigned long size, resident;
+    FILE* f = fopen("/proc/self/statm", "r");
+    if(f == nullptr)
+        return nullopt;
+    auto guard = make_scope_guard([&] { fclose(f); });
+    if(fscanf(f, "%lu %lu", &size, &resident) != 2)
+        return nullopt;
+    return size_t(resident) * size_t(sysconf(_SC_PAGESIZE));
+#elif defined(__unix__)
+    // not the current resident size, but the peak one, which is good enough to bound it.
+    struct rusage usage;
+    if(getrusage(RUSAGE_SELF, &usage) != 0)
+        return nullopt;
+    return size_t(usage.ru_maxrss) * 1024;
+#else
+#   error resident_memory_size not implemented for this platform.
+#endif
+}
+
+optional<MappedFile> MappedFile::open(const fs::path& path)
+{
+#if defined(_WIN32)
+    HANDLE hFile = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if(hFile == INVALID_HANDLE_VALUE)
+        return nullopt;
+
+    auto guard = make_scope_guard([&] { CloseHandle(hFile); });
+
+    LARGE_INTEGER ll;
+    if(!GetFileSizeEx(hFile, &ll))
+        return nullopt;
+
+    MappedFile file;
+    if(ll.QuadPart == 0)
+        return file; // CreateFileMapping does not accept empty files.
+
+    file.mapping = CreateFileMappingW(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    if(file.mapping == NULL)
+        return nullopt;
+
+    file.bytes = reinterpret_cast<const uint8_t*>(MapViewOfFile(file.mapping, FILE_MAP_READ, 0, 0, 0));
+    file.length = static_cast<size_t>(ll.QuadPart);
+    if(file.bytes == nullptr)
+        return nullopt; // destructor closes the mapping
+
+    return file;
+
+#elif defined(__unix__)
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd == -1)
+        return nullopt;
+
+    auto guard = make_scope_guard([&] { close(fd); }); // the mapping is kept after the descriptor is closed
+
+    struct stat st;
+    if(fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+        return nullopt;
+
+    MappedFile file;
+    if(st.st_size == 0)
+        return file; // mmap does not accept empty mappings.
+
+    void* addr = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    if(addr == MAP_FAILED)
+        return nullopt;
+
+    file.bytes = reinterpret_cast<const uint8_t*>(addr);
+    file.length = static_cast<size_t>(st.st_size);
+    return file;
+#else
+#   error MappedFile::open not implemented for this platform.
+#endif
+}
+
+MappedFile::MappedFile(MappedFile&& rhs) :
+    bytes(rhs.bytes), length(rhs.length)
+#if defined(_WIN32)
+    , mapping(rhs.mapping)
+#endif
+{
+    rhs.bytes = nullptr;
+    rhs.length = 0;
+#if defined(_WIN32)
+    rhs.mapping = nullptr;
+#endif
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& rhs)
+{
+    std::swap(this->bytes, rhs.bytes);
+    std::swap(this->length, rhs.length);
+#if defined(_WIN32)
+    std::swap(this->mapping, rhs.mapping);
+#endif
+    return *this;
+}
+
+MappedFile::~MappedFile()
+{
+#if defined(_WIN32)
+    if(this->bytes) UnmapViewOfFile(this->bytes);
+    if(this->mapping) CloseHandle(this->mapping);
+#elif defined(__unix__)
+    if(this->bytes) munmap(const_cast<uint8_t*>(this->bytes), this->length);
+#endif
+}
@@ -3,6 +3,7 @@
 ///
 #pragma once
 #include "cpp/filesystem.hpp"
+#include "cpp/optional.hpp"
 
 /// Returns the path that static configuration is in.
 extern const fs::path& config_path();
@@ -11,3 +12,34 @@ extern const fs::path& config_path();
 /// \warning the behaviour is undefined if the file isn't empty.
 /// \note the file offset after this call is at the top of the file.
 extern bool allocate_file(FILE*, uint64_t);
+
+/// Returns the resident memory of this process, in bytes.
+/// \returns nullopt if it could not be queried.
+extern optional<size_t> resident_memory_size();
+
+/// Read-only view of a file mapped into memory.
+class MappedFile
+{
+public:
+    MappedFile(MappedFile&&);
+    MappedFile& operator=(MappedFile&&);
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+
+    /// Maps the file at the specified path.
+    /// \returns nullopt if the file does not exist or could not be mapped.
+    static optional<MappedFile> open(const fs::path&);
+
+    const uint8_t* data() const { return this->bytes; }
+    size_t size() const { return this->length; }
+
+private:
+    MappedFile() = default;
+
+    const uint8_t* bytes = nullptr;
+    size_t         length = 0;
+#if defined(_WIN32)
+    void*          mapping = nullptr;
+#endif
+};
@@ -0,0 +1,365 @@
+#include <stdinc.h>
+#include "value_tracking.hpp"
+#include "commands.hpp"
+#include "program.hpp"
+
+/// Walks a script in program order.
+///
+/// The script is walked twice. The first walk only counts the assignments of each variable, which the second uses to
+/// know which values survive the back edge of loops.
+class ValueTracker::Walker
+{
+public:
+    explicit Walker(ValueTracker& tracker, const Commands& commands) :
+        tracker(tracker), commands(commands)
+    {}
+
+    void walk(const SyntaxTree& tree, bool counting)
+    {
+        this->counting = counting;
+        this->state.clear();
+        this->exits.clear();
+        statement(tree);
+    }
+
+private:
+    using State = std::vector<std::pair<const Var*, int32_t>>;
+
+    /// Where a `BREAK` jumps into.
+    struct Exit
+    {
+        bool            is_switch;  //< Loops need no exit state, see `loop_head`.
+        optional<State> state;      //< Intersection of the states of every `BREAK` so far.
+    };
+
+    ValueTracker&                           tracker;
+    const Commands&                         commands;
+    bool                                    counting = false;
+    State                                   state;
+    std::vector<Exit>                       exits;
+    std::unordered_map<const Var*, size_t>  assignments;
+
+    /// \returns the variable in `node` if its value can be tracked.
+    static const Var* tracked_var(const SyntaxTree& node)
+    {
+        if(auto opt_var = node.maybe_annotation<const shared_ptr<Var>&>())
+        {
+            auto& var = **opt_var;
+            if(!var.global && var.type == VarType::Int && !var.count && !var.where.expired())
+                return &var;
+        }
+        return nullptr;
+    }
+
+    optional<int32_t> value_of(const Var* var) const
+    {
+        auto it = std::find_if(state.begin(), state.end(), [&](const auto& pair) { return pair.first == var; });
+        if(it != state.end())
+            return it->second;
+        return nullopt;
+    }
+
+    /// \returns the value of the argument `node`, if known.
+    optional<int32_t> eval(const SyntaxTree& node) const
+    {
+        if(auto opt_value = node.maybe_annotation<int32_t>())
+            return *opt_value;
+        else if(auto var = tracked_var(node))
+            return value_of(var);
+        else
+            return nullopt;
+    }
+
+    /// \returns the result of the arithmetic `op` on `a` and `b`, if known.
+    optional<int32_t> arith(const Command& op, optional<int32_t> a, optional<int32_t> b) const
+    {
+        if(!a || !b)
+            return nullopt;
+
+        // Wraps around just like the script engine does.
+        auto ua = static_cast<uint32_t>(*a), ub = static_cast<uint32_t>(*b);
+
+        if(commands.is_alternator(op, commands.add_thing_to_thing))
+            return static_cast<int32_t>(ua + ub);
+        else if(commands.is_alternator(op, commands.sub_thing_from_thing))
+            return static_cast<int32_t>(ua - ub);
+        else if(commands.is_alternator(op, commands.mult_thing_by_thing))
+            return static_cast<int32_t>(ua * ub);
+        else if(commands.is_alternator(op, commands.div_thing_by_thing) && *b != 0
+                && !(*a == std::numeric_limits<int32_t>::min() && *b == -1))
+            return *a / *b;
+        else
+            return nullopt;
+    }
+
+    /// `node` stores `value` (or something unknown) into the variable in it.
+    void write(const SyntaxTree& node, optional<int32_t> value)
+    {
+        auto var = tracked_var(node);
+        if(!var)
+            return;
+
+        if(counting)
+            ++assignments[var];
+
+        auto it = std::find_if(state.begin(), state.end(), [&](const auto& pair) { return pair.first == var; });
+        if(it != state.end())
+            state.erase(it);
+
+        if(value)
+        {
+            if(state.size() >= max_tracked_vars)
+                state.erase(state.begin());
+            state.emplace_back(var, *value);
+        }
+    }
+
+    /// Keeps in `state` only the values which are the same in `other`.
+    void meet(State& state, const State& other) const
+    {
+        state.erase(std::remove_if(state.begin(), state.end(), [&](const auto& pair) {
+            return std::find(other.begin(), other.end(), pair) == other.end();
+        }), state.end());
+    }
+
+    /// The state at the head of a loop must hold on every iteration, thus only variables assigned once
+    /// (i.e. before the loop) may keep their values.
+    void loop_head()
+    {
+        state.erase(std::remove_if(state.begin(), state.end(), [&](const auto& pair) {
+            auto it = assignments.find(pair.first);
+            return it == assignments.end() || it->second > 1;
+        }), state.end());
+    }
+
+    void statements(const SyntaxTree& parent)
+    {
+        for(auto& child : parent)
+            statement(*child);
+    }
+
+    void statement(const SyntaxTree& node)
+    {
+        switch(node.type())
+        {
+            case NodeType::Block:
+            case NodeType::ELSE:
+                statements(node);
+                break;
+            case NodeType::Scope:
+                statements(node.child(0));
+                break;
+            case NodeType::Label:
+                state.clear();
+                break;
+            case NodeType::Command:
+                command(node);
+                break;
+            case NodeType::Equal:
+                assignment(node);
+                break;
+            case NodeType::Cast:
+                write(node.child(0), nullopt);
+                break;
+            case NodeType::Increment:
+            case NodeType::Decrement:
+            {
+                auto& var = node.child(0);
+                auto& op = node.annotation<const IncDecAnnotation&>().op_var_with_one;
+                write(var, arith(op, eval(var), 1));
+                break;
+            }
+            case NodeType::IF:
+            {
+                condition(node.child(0));
+                State entry = state;
+                statements(node.child(1));
+                State case_true = std::move(state);
+                state = std::move(entry);
+                if(node.child_count() == 3)
+                    statements(node.child(2));
+                meet(state, case_true);
+                break;
+            }
+            case NodeType::WHILE:
+            {
+                loop_head();
+                condition(node.child(0));
+                State head = state;
+                exits.emplace_back(Exit { false, nullopt });
+                statements(node.child(1));
+                exits.pop_back();
+                state = std::move(head);
+                break;
+            }
+            case NodeType::REPEAT:
+            {
+                // The counter is set to zero, then increased on each iteration.
+                write(node.child(1), nullopt);
+                loop_head();
+                State head = state;
+                exits.emplace_back(Exit { false, nullopt });
+                statements(node.child(2));
+                exits.pop_back();
+                write(node.child(1), nullopt);
+                state = std::move(head);
+                break;
+            }
+            case NodeType::SWITCH:
+                switch_(node);
+                break;
+            case NodeType::BREAK:
+            {
+                if(!exits.empty() && exits.back().is_switch)
+                {
+                    auto& exit = exits.back();
+                    if(exit.state)
+                        meet(*exit.state, state);
+                    else
+                        exit.state = state;
+                }
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
+    void switch_(const SyntaxTree& switch_node)
+    {
+        State entry = state;
+        exits.emplace_back(Exit { true, nullopt });
+
+        for(auto& child : switch_node.child(1))
+        {
+            switch(child->type())
+            {
+                case NodeType::CASE:
+                case NodeType::DEFAULT:
+                    // Either jumped into from the SWITCH or fell through from the previous case.
+                    meet(state, entry);
+                    break;
+                default:
+                    statement(*child);
+                    break;
+            }
+        }
+
+        if(auto& exit_state = exits.back().state)
+            meet(state, *exit_state);
+        meet(state, entry); // no case may have matched
+        exits.pop_back();
+    }
+
+    void condition(const SyntaxTree& node)
+    {
+        switch(node.type())
+        {
+            case NodeType::Command:
+                command(node);
+                break;
+            case NodeType::Equal:
+            case NodeType::Greater:
+            case NodeType::GreaterEqual:
+            case NodeType::Lesser:
+            case NodeType::LesserEqual:
+                break;
+            default: // NOT, AND, OR
+                for(auto& child : node)
+                    condition(*child);
+                break;
+        }
+    }
+
+    void assignment(const SyntaxTree& eq_node)
+    {
+        auto& a = eq_node.child(0);
+        auto& b = eq_node.child(1);
+
+        if(auto opt_op = b.maybe_annotation<std::reference_wrapper<const Command>>())
+        {
+            // 'a = b OP c' or 'a OP= c'
+            write(a, arith(*opt_op, eval(b.child(0)), eval(b.child(1))));
+        }
+        else
+        {
+            auto opt_set = eq_node.maybe_annotation<std::reference_wrapper<const Command>>();
+            if(opt_set && commands.is_alternator(*opt_set, commands.set))
+                write(a, eval(b));
+            else
+                write(a, nullopt);
+        }
+    }
+
+    void command(const SyntaxTree& node)
+    {
+        auto opt_command = node.maybe_annotation<std::reference_wrapper<const Command>>();
+        if(!opt_command)
+            return;
+
+        const Command& command = *opt_command;
+
+        if(!counting)
+        {
+            for(auto it = std::next(node.begin()); it != node.end(); ++it)
+            {
+                if(auto var = tracked_var(**it))
+                {
+                    if(auto value = value_of(var))
+                        tracker.constants[it->get()] = *value;
+                }
+            }
+        }
+
+        if(command.has_flow(ControlFlow::Call))
+        {
+            // The callee may change any local variable (e.g. GOSUB), or output into the arguments (e.g. CLEO_CALL).
+            for(auto it = std::next(node.begin()); it != node.end(); ++it)
+                write(**it, nullopt);
+            state.clear();
+        }
+        else if(node.child_count() >= 3 && commands.is_alternator(command, commands.set))
+        {
+            write(node.child(1), eval(node.child(2)));
+        }
+        else if(node.child_count() >= 3 && is_arith(command))
+        {
+            write(node.child(1), arith(command, eval(node.child(1)), eval(node.child(2))));
+        }
+        else
+        {
+            size_t i = 0;
+            for(auto it = std::next(node.begin()); it != node.end(); ++it, ++i)
+            {
+                auto arginfo = command.arg(i);
+                if(!arginfo || arginfo->is_output || arginfo->is_ref)
+                    write(**it, nullopt);
+            }
+        }
+    }
+
+    bool is_arith(const Command& command) const
+    {
+        return commands.is_alternator(command, commands.add_thing_to_thing)
+            || commands.is_alternator(command, commands.sub_thing_from_thing)
+            || commands.is_alternator(command, commands.mult_thing_by_thing)
+            || commands.is_alternator(command, commands.div_thing_by_thing)
+            || commands.is_alternator(command, commands.add_thing_to_thing_timed)
+            || commands.is_alternator(command, commands.sub_thing_from_thing_timed);
+    }
+};
+
+void ValueTracker::track(const Script& script, const Commands& commands)
+{
+    Walker walker(*this, commands);
+    walker.walk(*script.tree, true);
+    walker.walk(*script.tree, false);
+}
+
+optional<int32_t> ValueTracker::constant_at(const SyntaxTree& node) const
+{
+    auto it = this->constants.find(&node);
+    if(it != this->constants.end())
+        return it->second;
+    return nullopt;
+}
@@ -0,0 +1,42 @@
+///
+/// Value Tracking
+///
+/// Finds the constant values that local INT variables hold on the places they are read, so the special commands
+/// taking counters (e.g. `PLAYER_MADE_PROGRESS`) may be given a variable whose value is known at compile time:
+///
+///     LVAR_INT progress
+///     progress = 2
+///     progress += 1
+///     PLAYER_MADE_PROGRESS progress   // 3
+///
+/// Each script is walked once in program order, following its structured control flow. The known values flow through
+/// assignments and arithmetic, are intersected at the end of IF and SWITCH statements, and are forgotten whenever the
+/// flow isn't known:
+///
+///  + All of them at labels, since any jump may land there, and at calls (e.g. `GOSUB`), since the callee may change them.
+///  + At the head of loops, all but the variables assigned only once in the script.
+///
+/// Global variables, timers and arrays are never tracked, as those may change behind the back of the script. At most
+/// `max_tracked_vars` variables are known at once, which keeps the pass linear in the size of the script.
+///
+#pragma once
+#include <stdinc.h>
+#include "symtable.hpp"
+
+class ValueTracker
+{
+public:
+    /// Maximum number of variables with known values at any point of a script.
+    static constexpr size_t max_tracked_vars = 32;
+
+    /// Tracks the values in the variables of `script`.
+    void track(const Script& script, const Commands& commands);
+
+    /// \returns the value of the variable in the argument `node` of a command, if known to be constant.
+    optional<int32_t> constant_at(const SyntaxTree& node) const;
+
+private:
+    class Walker;
+
+    std::unordered_map<const SyntaxTree*, int32_t> constants;   //< Variable arguments -> Value they are known to hold.
+};
@@ -0,0 +1,125 @@
+#include <stdinc.h>
+#include "wait_loops.hpp"
+#include <unordered_set>
+
+using EdgeKind = CodeGraph::EdgeKind;
+
+namespace
+{
+    /// What may happen from each component of a graph onwards.
+    struct Effects
+    {
+        std::vector<bool> may_yield;
+        std::vector<bool> may_write;    //< Changes any variable.
+    };
+}
+
+/// \returns the commands assigning into their first argument (e.g. `SET_VAR_INT`, `ADD_VAL_TO_INT_VAR`).
+static std::unordered_set<const Command*> assignment_commands(const Commands& commands)
+{
+    std::unordered_set<const Command*> result;
+    for(auto& alternator : { commands.set, commands.cset,
+                             commands.add_thing_to_thing, commands.sub_thing_from_thing,
+                             commands.mult_thing_by_thing, commands.div_thing_by_thing,
+                             commands.add_thing_to_thing_timed, commands.sub_thing_from_thing_timed })
+    {
+        if(alternator)
+            result.insert(alternator->begin(), alternator->end());
+    }
+    return result;
+}
+
+static bool writes_var(const CompiledCommand& compiled, const std::unordered_set<const Command*>& assignments)
+{
+    if(assignments.count(&compiled.command))
+        return true;
+
+    for(size_t i = 0; i < compiled.args.size(); ++i)
+    {
+        if(is<CompiledVar>(compiled.args[i]))
+        {
+            auto arginfo = compiled.command.arg(i);
+            if(arginfo && arginfo->is_output)
+                return true;
+        }
+    }
+    return false;
+}
+
+void check_wait_free_loops(const CodeGraph& graph, ProgramContext& program)
+{
+    if(!program.opt.warn_wait_free_loop)
+        return;
+
+    auto& components = graph.components();
+    auto assignments = assignment_commands(program.commands);
+
+    Effects effects;
+    effects.may_yield.reserve(components.size());
+    effects.may_write.reserve(components.size());
+
+    // The components reachable from a component are numbered before it, so their effects are known.
+    for(uint32_t id = 0; id < components.size(); ++id)
+    {
+        bool loop_yields = false;   // any command in the loop, or any subroutine it calls, yields
+        bool loop_writes = false;
+        bool may_yield = false;     // any command from here onwards yields
+        bool may_write = false;
+        bool has_exit = false;
+        bool is_cycle = (components.end(id) - components.begin(id)) > 1;
+
+        for(auto member = components.begin(id); member != components.end(id); ++member)
+        {
+            auto& compiled = graph.command(*member);
+
+            if(compiled.command.has_flow(ControlFlow::Yield))
+                loop_yields = true;
+
+            if(writes_var(compiled, assignments))
+                loop_writes = true;
+
+            for(auto edge = graph.begin(*member); edge != graph.end(*member); ++edge)
+            {
+                auto to_component = components.component[edge->to];
+                if(to_component == id)
+                {
+                    is_cycle = true;
+                    continue;
+                }
+
+                may_yield = may_yield || effects.may_yield[to_component];
+                may_write = may_write || effects.may_write[to_component];
+
+                if(edge->kind == EdgeKind::Flow)
+                {
+                    has_exit = true;
+                }
+                else
+                {
+                    // the callee is run as part of the loop.
+                    loop_yields = loop_yields || effects.may_yield[to_component];
+                    loop_writes = loop_writes || effects.may_write[to_component];
+                }
+            }
+        }
+
+        effects.may_yield.push_back(may_yield || loop_yields);
+        effects.may_write.push_back(may_write || loop_writes);
+
+        if(!is_cycle || loop_yields)
+            continue;
+
+        auto header = *std::min_element(components.begin(id), components.end(id));
+        auto warning = [&](const char* message) {
+            if(auto where = graph.command(header).where)
+                program.warning(*where, "{}", message);
+            else
+                program.warning(nocontext, "{}", message);
+        };
+
+        if(!has_exit)
+            warning("infinite loop without WAIT freezes the game [-Wwait-free-loop]");
+        else if(!loop_writes)
+            warning("loop without WAIT changes no variable, thus may never end and freeze the game [-Wwait-free-loop]");
+    }
+}
@@ -0,0 +1,24 @@
+///
+/// WAIT-free Loops
+///
+/// The script threads are cooperatively scheduled, thus a loop which never gives way to the other scripts (by the means
+/// of WAIT, or any other command whose `Flow` is `Yield`) freezes the game. This warns about such loops
+/// (`-Wwait-free-loop`).
+///
+/// The loops are the cyclic strongly connected components of the graph of the compiled IR (see code_graph.hpp), be
+/// them from WHILE, REPEAT or a plain GOTO to a label behind. A loop waits if any command in it yields, or calls a
+/// subroutine which may yield. Whether a subroutine may yield is memoized per component, in the order they are
+/// numbered, so the analysis is linear in the size of the program and cheap enough to be run on every build.
+///
+/// Not every loop without WAIT freezes the game though, as many of them count up to a bound (e.g. looping through an
+/// array). So only the loops which can't ever end are warned about: those with no way out of them, and those which
+/// change no variable (e.g. `WHILE NOT HAS_MODEL_LOADED ...`), as nothing else may change until the script waits.
+///
+/// The diagnostics point at the first command of the loop, which is usually its header.
+///
+#pragma once
+#include <stdinc.h>
+#include "code_graph.hpp"
+
+/// Warns about the loops in `graph` which never wait, if `program.opt.warn_wait_free_loop`.
+void check_wait_free_loops(const CodeGraph& graph, ProgramContext& program);
@@ -0,0 +1,23 @@
+// RUN: mkdir "%/T/debug_map" || echo _
+// RUN: %gta3sc %s --config=gta3 -g -o "%/T/debug_map/main.scm"
+// RUN: %symbolize "%/T/debug_map/main.scm" 0x0 0x44 0x4C 0x66 main.scm:0x6C 0x72 0x76 0x77 | %FileCheck %s
+{
+LVAR_INT x
+LOAD_AND_LAUNCH_MISSION mission.sc
+main_loop:
+WAIT 0
+x = 1
+IF x = 1
+    GOTO main_loop
+ENDIF
+}
+TERMINATE_THIS_SCRIPT
+
+// CHECK-L: main.scm:0x0 ??
+// CHECK-NEXT-L: main.scm:0x44 debug_map.sc:6:1 in debug_map.sc+0x0 (scope at debug_map.sc:4:1)
+// CHECK-NEXT-L: main.scm:0x4C debug_map.sc:9:1 in main_loop+0x4 (scope at debug_map.sc:4:1)
+// CHECK-NEXT-L: main.scm:0x66 debug_map.sc:11:5 in main_loop+0x1E (scope at debug_map.sc:4:1)
+// CHECK-NEXT-L: main.scm:0x6C debug_map.sc:14:1 in main_loop+0x24
+// CHECK-NEXT-L: main.scm:0x72 debug_map/mission.sc:4:1 in mission.sc+0x4 (scope at debug_map/mission.sc:2:1)
+// CHECK-NEXT-L: main.scm:0x76 debug_map/mission.sc:6:1 in mission.sc+0x8
+// CHECK-NEXT-L: main.scm:0x77 ??
@@ -0,0 +1,6 @@
+MISSION_START
+{
+LVAR_INT y
+y = 2
+}
+MISSION_END
@@ -0,0 +1,14 @@
+// Decompiles ill-formed bytecode, which used to crash the decompiler.
+//
+// # A GOTO into the middle of a WAIT, whose argument is a WAIT going past the end of the first one
+// RUN: %decompile "Inputs/overlapping_opcodes.scm" --config=gta3 --recursive-traversal -o - | %FileCheck %s
+//
+// # A mission offset past the end of the file
+// RUN: %not %decompile "Inputs/mission_past_eof.scm" --config=gta3 -o - 2>&1 | grep "corrupted scm header"
+
+// CHECK-L: GOTO_IF_FALSE @MAIN_1
+// CHECK-NEXT-L: GOTO 87i32
+// CHECK-NEXT-L: MAIN_1:
+// CHECK-NEXT-L: WAIT 65536i32
+// CHECK-NEXT-L: IR2_HEX 1i8 127i8 0i8 0i8 0i8
+// CHECK-NEXT-L: TERMINATE_THIS_SCRIPT
@@ -0,0 +1,24 @@
+// RUN: %gta3sc %s --config=gtasa --guesser -emit-ir2 -o - | %FileCheck %s
+
+VAR_FLOAT f
+
+// CHECK-L: SET_VAR_FLOAT &8 0x1.99999ap-4f
+f = 0.1
+// CHECK-NEXT-L: SET_VAR_FLOAT &8 -0x1.371200p+11f
+f = -2488.5625
+// CHECK-NEXT-L: SET_VAR_FLOAT &8 0x1.000000p+24f
+f = 16777217.0
+// CHECK-NEXT-L: SET_VAR_FLOAT &8 0x1.000004p+24f
+f = 16777219.0
+// CHECK-NEXT-L: SET_VAR_FLOAT &8 0x1.000002p+0f
+f = 1.0000000596046448
+// CHECK-NEXT-L: SET_VAR_FLOAT &8 0x1.99999ap-4f
+f = 0.1000000000000000055511151231257827021181583404541015625
+// CHECK-NEXT-L: SET_VAR_FLOAT &8 0x1.fffffep+127f
+f = 340282346638528859811704183484516925440.0
+// CHECK-NEXT-L: SET_VAR_FLOAT &8 0x1.000000p-126f
+f = 0.0000000000000000000000000000000000000117549435
+// CHECK-NEXT-L: SET_VAR_FLOAT &8 0x1.000000p+0f
+f = 1.f
+
+TERMINATE_THIS_SCRIPT
@@ -0,0 +1,49 @@
+// RUN: %dis %gta3sc %s --config=gtasa --guesser --add-config=./progress_values/commands.xml -fsyntax-only 2>&1 | %verify %s
+// RUN: %gta3sc %s --config=gtasa --guesser --add-config=./progress_values/commands.xml -emit-ir2 -o - | %FileCheck %s
+// Counters given in local variables are summed when their values are known at compile time.
+
+// CHECK-L: SET_PROGRESS_TOTAL 12i8
+SET_PROGRESS_TOTAL 0
+// CHECK-L: SET_MISSION_RESPECT_TOTAL 7i8
+SET_MISSION_RESPECT_TOTAL 0
+
+{
+	LVAR_INT a b c flag respect
+
+	a = 2
+	a += 1
+	b = a * 2
+	c = 3
+	PLAYER_MADE_PROGRESS a
+
+	IF flag = 0
+		b = 6
+	ELSE
+		flag = 1
+	ENDIF
+	PLAYER_MADE_PROGRESS b
+
+	WHILE flag = 0
+		WAIT 0
+		PLAYER_MADE_PROGRESS c
+		PLAYER_MADE_PROGRESS a		// expected-warning {{value is not a constant}}
+		a++
+	ENDWHILE
+
+	respect = 10
+	respect -= 3
+	AWARD_PLAYER_MISSION_RESPECT respect
+
+	GOSUB sub
+	AWARD_PLAYER_MISSION_RESPECT respect	// expected-warning {{value is not a constant}}
+
+	b = 1
+	label:
+	PLAYER_MADE_PROGRESS b		// expected-warning {{value is not a constant}}
+
+	TERMINATE_THIS_SCRIPT
+
+	sub:
+	respect = 2
+	RETURN
+}
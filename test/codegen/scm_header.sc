@@ -0,0 +1,37 @@
+// Round-trips the SCM header of each game: the header written by the compiler is read back by the decompiler.
+//
+// RUN: mkdir "%/T/scm_header" || echo _
+// RUN: %gta3sc %s --config=gta3 -o "%/T/scm_header/main3.scm"
+// RUN: %decompile "%/T/scm_header/main3.scm" --config=gta3 -o - | %FileCheck %s
+// RUN: %gta3sc %s --config=gtavc -o "%/T/scm_header/mainvc.scm"
+// RUN: %decompile "%/T/scm_header/mainvc.scm" --config=gtavc -o - | %FileCheck %s
+// RUN: %gta3sc %s --config=gtasa --guesser -D SA -o "%/T/scm_header/main.scm"
+// RUN: %decompile "%/T/scm_header/main.scm" --config=gtasa --guesser -o - | %FileCheck %s
+// RUN: %decompile "%/T/scm_header/main.scm" --config=gtasa --guesser -o - | grep "REGISTER_STREAMED_SCRIPT_INTERNAL 0i8"
+//
+// # A file without a header is rejected
+// RUN: %not %decompile "%s" --config=gta3 -o - 2>&1 | grep "corrupted scm header"
+// RUN: %not %decompile "%s" --config=gtavc -o - 2>&1 | grep "corrupted scm header"
+
+VAR_INT obj
+
+// CHECK-L: #DEFINE_MODEL LHOUSE -1
+// CHECK-NEXT-L: #DEFINE_MODEL BARRIER1 -2
+// CHECK-L: CREATE_OBJECT -1i8
+CREATE_OBJECT lhouse 0.0 0.0 0.0 obj
+// CHECK-NEXT-L: CREATE_OBJECT -2i8
+CREATE_OBJECT barrier1 0.0 0.0 0.0 obj
+
+LOAD_AND_LAUNCH_MISSION mission1.sc
+LOAD_AND_LAUNCH_MISSION mission2.sc
+
+#ifdef SA
+REGISTER_STREAMED_SCRIPT stream1 stream1.sc
+#endif
+
+TERMINATE_THIS_SCRIPT
+
+// CHECK-L: #MISSION_BLOCK_START 0
+// CHECK-NEXT-L: WAIT 1i8
+// CHECK-L: #MISSION_BLOCK_START 1
+// CHECK-NEXT-L: WAIT 2i8
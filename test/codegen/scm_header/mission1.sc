@@ -0,0 +1,3 @@
+MISSION_START
+WAIT 1
+MISSION_END
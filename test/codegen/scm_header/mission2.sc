@@ -0,0 +1,6 @@
+MISSION_START
+{
+LVAR_INT a b c
+WAIT 2
+}
+MISSION_END
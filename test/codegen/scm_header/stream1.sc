@@ -0,0 +1,3 @@
+SCRIPT_START
+WAIT 3
+SCRIPT_END
@@ -7,6 +7,9 @@
 // RUN: %checksum "%T/streaming/main.scm" 7e303e984e8f73d891177e540204fb1b
 // RUN: %checksum "%T/streaming/script.img" 564ae9d8f8acca1df2e9ddb41deee9eb
 //
+// # Check IMG Reading
+// RUN: %decompile "%/T/streaming/main.scm" --config=gtasa --guesser -emit-ir2 -o - | %FileCheck %s
+//
 
 VAR_INT n
 
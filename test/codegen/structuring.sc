@@ -0,0 +1,71 @@
+// RUN: mkdir "%/T/structuring" || echo _
+// RUN: %gta3sc %s --config=gtavc -fbreak-continue -o "%/T/structuring/main.scm"
+// RUN: %decompile "%/T/structuring/main.scm" --config=gtavc -o - | %FileCheck %s
+
+VAR_INT x y
+
+// CHECK-NEXT-L: MAIN_1:
+// CHECK-NEXT-L: WAIT 0i8
+main_loop:
+WAIT 0
+
+// CHECK-NEXT-L: IF IS_INT_VAR_EQUAL_TO_NUMBER &8 0i8
+// CHECK-NEXT-L: AND IS_INT_VAR_EQUAL_TO_NUMBER &12 1i8
+IF x = 0
+AND y = 1
+    // CHECK-NEXT-L: WHILE IS_INT_VAR_GREATER_THAN_NUMBER &8 2i8
+    // CHECK-NEXT-L: OR IS_INT_VAR_GREATER_THAN_NUMBER &12 3i8
+    WHILE x > 2
+    OR y > 3
+        // CHECK-NEXT-L: IF IS_INT_VAR_EQUAL_TO_NUMBER &8 5i8
+        // CHECK-NEXT-L: BREAK
+        // CHECK-NEXT-L: ENDIF
+        IF x = 5
+            BREAK
+        ENDIF
+        // CHECK-NEXT-L: IF IS_INT_VAR_EQUAL_TO_NUMBER &12 6i8
+        // CHECK-NEXT-L: CONTINUE
+        // CHECK-NEXT-L: ELSE
+        // CHECK-NEXT-L: WAIT 7i8
+        // CHECK-NEXT-L: ENDIF
+        IF y = 6
+            CONTINUE
+        ELSE
+            WAIT 7
+        ENDIF
+        // CHECK-NEXT-L: SET_VAR_INT &8 1i8
+        x = 1
+    // CHECK-NEXT-L: ENDWHILE
+    ENDWHILE
+// CHECK-NEXT-L: ENDIF
+ENDIF
+
+// CHECK-NEXT-L: REPEAT 4i8 &12
+REPEAT 4 y
+    // CHECK-NEXT-L: IF IS_INT_VAR_EQUAL_TO_NUMBER &8 1i8
+    // CHECK-NEXT-L: CONTINUE
+    // CHECK-NEXT-L: ENDIF
+    IF x = 1
+        CONTINUE
+    ENDIF
+    // CHECK-NEXT-L: GOSUB @MAIN_11
+    GOSUB sub
+// CHECK-NEXT-L: ENDREPEAT
+ENDREPEAT
+
+// CHECK-NEXT-L: IF NOT IS_INT_VAR_EQUAL_TO_NUMBER &8 3i8
+// CHECK-NEXT-L: TERMINATE_THIS_SCRIPT
+// CHECK-NEXT-L: ENDIF
+IF NOT x = 3
+    TERMINATE_THIS_SCRIPT
+ENDIF
+
+// CHECK-NEXT-L: GOTO @MAIN_1
+GOTO main_loop
+
+// CHECK-NEXT-L: MAIN_11:
+// CHECK-NEXT-L: WAIT 1i8
+// CHECK-NEXT-L: RETURN
+sub:
+WAIT 1
+RETURN
@@ -0,0 +1,38 @@
+// RUN: mkdir "%/T/structuring_sa" || echo _
+// RUN: %gta3sc %s --config=gtasa --guesser -o "%/T/structuring_sa/main.scm"
+// RUN: %decompile "%/T/structuring_sa/main.scm" --config=gtasa --guesser -o - | %FileCheck %s
+
+VAR_INT n
+
+// CHECK-L: WAIT 0i8
+WAIT 0
+
+// CHECK-NEXT-L: SWITCH &8
+SWITCH n
+    // CHECK-NEXT-L: CASE 1
+    // CHECK-NEXT-L: WAIT 1i8
+    // CHECK-NEXT-L: BREAK
+    CASE 1
+        WAIT 1
+        BREAK
+    // CHECK-NEXT-L: CASE 2
+    // CHECK-NEXT-L: CASE 3
+    // CHECK-NEXT-L: WAIT 2i8
+    // CHECK-NEXT-L: BREAK
+    CASE 2
+    CASE 3
+        WAIT 2
+        BREAK
+    // CHECK-NEXT-L: DEFAULT
+    // CHECK-NEXT-L: WAIT 4i8
+    // CHECK-NEXT-L: BREAK
+    DEFAULT
+        WAIT 4
+        BREAK
+// CHECK-NEXT-L: ENDSWITCH
+ENDSWITCH
+
+// CHECK-NEXT-L: WAIT 5i8
+// CHECK-NEXT-L: TERMINATE_THIS_SCRIPT
+WAIT 5
+TERMINATE_THIS_SCRIPT
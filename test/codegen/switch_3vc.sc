@@ -105,6 +105,36 @@ VAR_INT n
     ENDSWITCH
 }
 
-// CHECK-NEXT-L: MAIN_12:
+// Empty cases at the end, with no body after them
+{
+    // CHECK-NEXT-L: MAIN_12:
+    SWITCH n
+        // CHECK-NEXT-L: IS_INT_VAR_EQUAL_TO_NUMBER &8 1i8
+        // CHECK-NEXT-L: GOTO_IF_FALSE @MAIN_13
+        CASE 1
+            // CHECK-NEXT-L: WAIT 100i8
+            // CHECK-NEXT-L: GOTO @MAIN_16
+            WAIT 100
+            BREAK
+        DEFAULT
+            WAIT 200
+            BREAK
+        // CHECK-NEXT-L: MAIN_13:
+        // CHECK-NEXT-L: IS_INT_VAR_EQUAL_TO_NUMBER &8 2i8
+        // CHECK-NEXT-L: GOTO_IF_FALSE @MAIN_14
+        // CHECK-NEXT-L: GOTO @MAIN_16
+        CASE 2
+        // CHECK-NEXT-L: MAIN_14:
+        // CHECK-NEXT-L: IS_INT_VAR_EQUAL_TO_NUMBER &8 3i8
+        // CHECK-NEXT-L: GOTO_IF_FALSE @MAIN_15
+        // CHECK-NEXT-L: GOTO @MAIN_16
+        CASE 3
+        // CHECK-NEXT-L: MAIN_15:
+        // CHECK-NEXT-L: WAIT 200i16
+        // CHECK-NEXT-L: GOTO @MAIN_16
+    ENDSWITCH
+}
+
+// CHECK-NEXT-L: MAIN_16:
 // CHECK-NEXT-L: TERMINATE_THIS_SCRIPT
 TERMINATE_THIS_SCRIPT
\ No newline at end of file
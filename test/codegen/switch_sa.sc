@@ -153,6 +153,28 @@ NOP
     ENDSWITCH
 }
 
-// CHECK-NEXT-L: MAIN_23:
+// Empty cases at the end, with no body after them
+{
+    // CHECK-NEXT-L: MAIN_23:
+    // CHECK-NEXT-L: SWITCH_START &8 3i8 1i8 @MAIN_25 1i8 @MAIN_24 2i8 @MAIN_26 3i8 @MAIN_26 -1i8 @MAIN_26 -1i8 @MAIN_26 -1i8 @MAIN_26 -1i8 @MAIN_26
+    SWITCH n
+        // CHECK-NEXT-L: MAIN_24:
+        CASE 1
+            // CHECK-NEXT-L: WAIT 100i8
+            // CHECK-NEXT-L: GOTO @MAIN_26
+            WAIT 100
+            BREAK
+        // CHECK-NEXT-L: MAIN_25:
+        DEFAULT
+            // CHECK-NEXT-L: WAIT 200i16
+            // CHECK-NEXT-L: GOTO @MAIN_26
+            WAIT 200
+            BREAK
+        CASE 2
+        CASE 3
+    ENDSWITCH
+}
+
+// CHECK-NEXT-L: MAIN_26:
 // CHECK-NEXT-L: TERMINATE_THIS_SCRIPT
 TERMINATE_THIS_SCRIPT
\ No newline at end of file
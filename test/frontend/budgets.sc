@@ -0,0 +1,23 @@
+// Tests the compile-time budgets.
+// RUN: %gta3sc %s --config=gta3 -fsyntax-only -fmax-nesting=3 -fmax-nodes=100 -fmax-stage-time=60000 -fmax-memory=4096
+// RUN: %not %gta3sc %s --config=gta3 -fsyntax-only -fmax-nesting=2 2>&1 | grep "budgets.sc:17:13: fatal error: statement nested deeper than 2 levels .-fmax-nesting."
+// RUN: %not %gta3sc %s --config=gta3 -fsyntax-only -fmax-nodes=20 2>&1 | grep "budgets.sc:14:1: fatal error: script has more than 20 syntax nodes .-fmax-nodes."
+// RUN: %not %gta3sc %s --config=gta3 -fsyntax-only -fmax-memory=0 2>&1 | grep "fatal error: stage 'parse' is using [0-9]* MB of memory, more than 0 MB .-fmax-memory."
+// RUN: %gta3sc %s --config=gta3 -fsyntax-only -fmax-nodes=-1 -fmax-nesting=-1 -fmax-stage-time=-1 -fmax-memory=-1
+VAR_INT n
+
+n = 0
+WHILE n < 10
+    n += 1
+ENDWHILE
+
+WHILE n > 0
+    IF n = 5
+        IF n = 5
+            n -= 1
+        ENDIF
+    ENDIF
+    n -= 1
+ENDWHILE
+
+TERMINATE_THIS_SCRIPT
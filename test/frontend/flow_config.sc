@@ -0,0 +1,30 @@
+// Tests the control flow of commands declared by the Flow attribute of the config.
+// The data after a unconditional branch or a terminator must not be disassembled as code.
+// RUN: mkdir "%/T/flow_config" || echo _
+// RUN: %gta3sc %s --config=gta3 --add-config=./Inputs/flow.xml -o "%/T/flow_config/main.scm"
+// RUN: %decompile "%/T/flow_config/main.scm" --config=gta3 --add-config=./Inputs/flow.xml --recursive-traversal -o - | %FileCheck %s
+
+// CHECK-NEXT-L: WAIT 0i8
+// CHECK-NEXT-L: TEST_JUMP_IF_FALSE @MAIN_1
+// CHECK-NEXT-L: WAIT 1i8
+// CHECK-NEXT-L: MAIN_1:
+WAIT 0
+TEST_JUMP_IF_FALSE skip
+WAIT 1
+skip:
+
+// CHECK-NEXT-L: TEST_JUMP @MAIN_2
+// CHECK-NEXT-L: IR2_HEX 1i8 0i8 4i8 2i8
+// CHECK-NEXT-L: MAIN_2:
+TEST_JUMP after
+DUMP
+01 00 04 02
+ENDDUMP
+after:
+
+// CHECK-NEXT-L: TEST_TERMINATE
+// CHECK-NEXT-L: IR2_HEX 1i8 0i8 4i8 3i8
+TEST_TERMINATE
+DUMP
+01 00 04 03
+ENDDUMP
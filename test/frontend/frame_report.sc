@@ -0,0 +1,71 @@
+// Tests the --frame-report option.
+// RUN: %gta3sc %s --config=gtasa --guesser -fcleo -Wno-expect-var -fsyntax-only --frame-report=table | %FileCheck %s
+// RUN: %gta3sc %s --config=gtasa --guesser -fcleo -Wno-expect-var -fsyntax-only --frame-report=json | grep "entry.: 0, .calls.: .2, 1., .slots.: 46"
+
+// CHECK: ^SCOPE +KIND +LABEL +VARS +SLOTS +HEADROOM +TIMERS +LARGEST ARRAYS$
+// CHECK-NEXT: ^frame_report.sc:\d+:1 +scope +main_loop +5 +14 +18 +18  arr\[8\] c\[3\]$
+// CHECK-NEXT: ^frame_report.sc:\d+:1 +call +small_proc +1 +1 +31 +31  $
+// CHECK-NEXT: ^frame_report.sc:\d+:1 +call +big_proc +4 +31 +1 +1  z\[28\] w\[1\]$
+// CHECK-NEXT: ^frame_report.sc:\d+:1 +scope +first_entry +0 +0 +32 +32  $
+// CHECK-NEXT: ^frame_report.sc:\d+:1 +scope +second_entry +0 +0 +32 +32  $
+// CHECK-NEXT: ^frame_report.sc:\d+:1 +call +rec_a +0 +0 +32 +32  $
+// CHECK-NEXT: ^frame_report.sc:\d+:1 +call +rec_b +0 +0 +32 +32  $
+// CHECK: ^ENTRY +LABEL +DEPTH +SLOTS  DEEPEST CALL CHAIN$
+// CHECK-NEXT: ^frame_report.sc:\d+:1 +main_loop +2 +46  big_proc > small_proc$
+// CHECK-NEXT: ^frame_report.sc:\d+:1 +first_entry +2 +0  rec_a > rec_b$
+// CHECK-NEXT: ^frame_report.sc:\d+:1 +second_entry +2 +0  rec_b > rec_a$
+// CHECK-NEXT: ^frame_report.sc +- +1 +1  small_proc$
+
+CLEO_CALL small_proc 0 0
+
+{
+	LVAR_INT a b arr[8] c[3]
+	LVAR_FLOAT f
+	main_loop:
+	WAIT 0
+	CLEO_CALL small_proc 0 a
+	CLEO_CALL big_proc 0 a b
+	GOTO main_loop
+}
+
+{
+	small_proc:
+	LVAR_INT x
+	IF x > 0
+		x -= 1
+		CLEO_CALL small_proc 0 x	// recursion is not followed
+	ENDIF
+	CLEO_RETURN 0
+}
+
+{
+	big_proc:
+	LVAR_INT x y z[28] w[1]
+	CLEO_CALL small_proc 0 x
+	CLEO_RETURN 0
+}
+
+// The depth of mutually recursive calls doesn't depend on which of them is reached first.
+{
+	first_entry:
+	CLEO_CALL rec_a 0
+	TERMINATE_THIS_SCRIPT
+}
+
+{
+	second_entry:
+	CLEO_CALL rec_b 0
+	TERMINATE_THIS_SCRIPT
+}
+
+{
+	rec_a:
+	CLEO_CALL rec_b 0
+	CLEO_RETURN 0
+}
+
+{
+	rec_b:
+	CLEO_CALL rec_a 0
+	CLEO_RETURN 0
+}
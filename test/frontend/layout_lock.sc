@@ -0,0 +1,40 @@
+// Tests the --layout-lock option.
+// The first run locks the old layout, which the second run (NEW_LAYOUT) must keep.
+// RUN: mkdir "%/T/layout_lock" || echo _
+// RUN: rm -f "%/T/layout_lock/globals.lock"
+// RUN: %gta3sc %s --config=gtasa --guesser -Wno-expect-var -emit-ir2 -o "%/T/layout_lock/old.ir2" --layout-lock=%/T/layout_lock/globals.lock
+// RUN: %gta3sc %s --config=gtasa --guesser -Wno-expect-var -emit-ir2 -o - --layout-lock=%/T/layout_lock/globals.lock -D NEW_LAYOUT 2>&1 | %FileCheck %s
+// RUN: %not %gta3sc %s --config=gtasa --guesser -Wno-expect-var -fsyntax-only --layout-lock=Inputs/layout_lock_offset.lock 2>&1 | grep "layout_lock_offset.lock:2: malformed layout lock entry"
+#ifdef NEW_LAYOUT
+VAR_INT inserted
+VAR_INT a
+VAR_FLOAT b // CHECK-L: layout_lock.sc:[[@LINE]]:11: warning: global variable 'b' was locked as INT, thus its value in older saves is taken as FLOAT
+VAR_INT d[3] // CHECK-L: layout_lock.sc:[[@LINE]]:9: warning: global variable 'd' doesn't fit its locked space at offset 20
+VAR_INT e[3] // grows into free space, thus it's kept at offset 28
+VAR_INT arr[2]
+// CHECK-L: warning: global variable 'c' locked at offset 16 is not declared anymore
+#else
+VAR_INT a b c d[2] e[2]
+#endif
+
+a = 1
+#ifdef NEW_LAYOUT
+b = 2.0
+inserted = 3
+d[0] = 4
+e[0] = 6
+arr[0] = 5
+#else
+b = 2
+c = 3
+d[0] = 4
+e[0] = 6
+#endif
+TERMINATE_THIS_SCRIPT
+
+// CHECK: ^SET_VAR_INT &8 1i8$
+// CHECK: ^SET_VAR_FLOAT &12 
+// CHECK: ^SET_VAR_INT &16 3i8$
+// CHECK: ^SET_VAR_INT &40 4i8$
+// CHECK: ^SET_VAR_INT &28 6i8$
+// CHECK: ^SET_VAR_INT &52 5i8$
@@ -0,0 +1,72 @@
+// Tests the --shared-globals-report option.
+// RUN: %gta3sc %s --config=gtasa --guesser -fcleo -Wno-expect-var -fsyntax-only --shared-globals-report=table | %FileCheck %s
+// RUN: %gta3sc %s --config=gtasa --guesser -fcleo -Wno-expect-var -fsyntax-only --shared-globals-report=json | grep ".name.: .counter., .writers.: .0, 1., .readers.: .0.}"
+
+// CHECK: ^GLOBAL +WRITERS READERS  WRITTEN BY / READ BY$
+// CHECK-NEXT: ^counter +2 +1  shared_globals.sc worker / shared_globals.sc$
+// CHECK-NEXT: ^flag +1 +2  worker / shared_globals.sc helper$
+// CHECK-NEXT: ^idx +1 +1  shared_globals.sc / watcher$
+// CHECK-NEXT: ^g +1 +1  shared_globals.sc / watcher$
+
+VAR_INT counter flag private idx arr[4] unused g
+
+counter = 0
+private = 1
+idx = 0
+START_NEW_SCRIPT worker
+START_NEW_SCRIPT worker
+START_NEW_SCRIPT helper
+START_NEW_SCRIPT watcher
+
+main_loop:
+WAIT 0
+counter += 1
+IF flag = 1
+    private = 2
+ENDIF
+SWITCH counter
+    CASE 1
+        private = 3
+        BREAK
+    CASE 2
+        g = 5
+        BREAK
+ENDSWITCH
+GOTO main_loop
+
+{
+worker:
+WAIT 0
+GOSUB set_flag
+GOTO worker
+}
+
+set_flag:
+flag = 1
+counter = 0
+RETURN
+
+{
+helper:
+WAIT 0
+CLEO_CALL read_flag 0
+GOTO helper
+}
+
+{
+read_flag:
+LVAR_INT y
+IF flag = 0
+    y = 1
+ENDIF
+CLEO_RETURN 0
+}
+
+{
+watcher:
+LVAR_INT x
+WAIT 0
+x = arr[idx]
+x = g
+GOTO watcher
+}
@@ -8,4 +8,7 @@ y = 4 - -5
 y = 4 +5
 y = 4 /5
 
+-- #x       // expected-error {{expected statement}}
+y --
+
 TERMINATE_THIS_SCRIPT
\ No newline at end of file
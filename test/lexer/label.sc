@@ -1,4 +1,4 @@
-// RUN: %dis %gta3sc %s --config=gta3 -fsyntax-only 2>&1 | %verify %s
+// RUN: %dis %gta3sc %s --config=gta3 -fsyntax-only -Wno-wait-free-loop 2>&1 | %verify %s
 
 // expected-no-diagnostics
 
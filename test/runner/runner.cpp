@@ -0,0 +1,1115 @@
+///
+/// In-process Test Runner
+///
+/// Runs the lit test suite (see *test/README.md*) without spawning any process. The lit files are still the source
+/// of truth, thus their `RUN` lines are interpreted as lit would, except the compiler is called through the driver
+/// library (see *src/driver.hpp*) and the checking tools (`%FileCheck`, `%verify`, `%checksum`, `grep`) are native.
+///
+/// Game configurations are loaded once and shared by all tests using them, and the tests run concurrently in a
+/// pool of threads. Tests using anything this runner doesn't know of (e.g. downloading files) are unsupported and
+/// should be ran by lit.
+///
+/// Usage: gta3sc-test [-j <threads>] [--output-dir=<path>] [paths...]
+///
+#include <stdinc.h>
+#include <chrono>
+#include <mutex>
+#include <regex>
+#include <thread>
+#include "driver.hpp"
+#include "system.hpp"
+#include "md5.hpp"
+
+namespace
+{
+
+/// Thrown when a `RUN` line uses something this runner doesn't know of.
+struct unsupported_error : std::runtime_error
+{
+    using std::runtime_error::runtime_error;
+};
+
+struct TestCase
+{
+    fs::path    path;
+    std::string name;       //< Name relative to the test suite root (e.g. `codegen/andor.sc`).
+    fs::path    temp_dir;   //< Value of `%T`.
+};
+
+/// A command in a pipeline. The first argument is the name of the tool (e.g. `%gta3sc` or `mkdir`).
+struct ShellCommand
+{
+    std::vector<std::string> args;
+    bool merge_stderr = false;  //< Whether `2>&1` was given.
+};
+
+using Pipeline = std::vector<ShellCommand>;
+
+struct RunLine
+{
+    size_t                  lineno;
+    std::string             text;
+    std::vector<Pipeline>   alternatives;   //< Pipelines separated by `||`.
+};
+
+struct ShellResult
+{
+    int         status = 0;
+    std::string out;
+    std::string err;
+};
+
+enum class TestStatus
+{
+    Pass,
+    Fail,
+    Unsupported,
+};
+
+struct TestResult
+{
+    TestStatus  status = TestStatus::Pass;
+    std::string details;
+    double      seconds = 0.0;
+};
+
+/// Objects loaded once by key, even if requested by many threads at once.
+template<typename T>
+class OnceMap
+{
+public:
+    /// \throws ConfigError if `load` (which returns a `shared_ptr<const T>`) throws it.
+    template<typename Loader>
+    auto get(const std::string& key, Loader load) -> shared_ptr<const T>
+    {
+        shared_ptr<Entry> entry;
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            auto& slot = this->entries[key];
+            if(!slot) slot = std::make_shared<Entry>();
+            entry = slot;
+        }
+
+        std::call_once(entry->once, [&] {
+            try
+            {
+                entry->value = load();
+            }
+            catch(const ConfigError& e)
+            {
+                entry->error = e.what();
+            }
+        });
+
+        if(!entry->value)
+            throw ConfigError("{}", entry->error);
+        return entry->value;
+    }
+
+    size_t size() const
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        return this->entries.size();
+    }
+
+private:
+    struct Entry
+    {
+        std::once_flag      once;
+        shared_ptr<const T> value;
+        std::string         error;
+    };
+
+    mutable std::mutex mutex;
+    std::map<std::string, shared_ptr<Entry>> entries;
+};
+
+/// Game configurations loaded by the tests, by `config_key`.
+///
+/// Configurations differing only by `--add-config` files or data directories share the base layer of commands.
+class ConfigCache
+{
+public:
+    /// \throws ConfigError if the configuration fails to load.
+    auto get(const Invocation& invocation) -> shared_ptr<const GameConfig>
+    {
+        return this->configs.get(config_key(invocation), [&] {
+            auto base = this->bases.get(base_config_key(invocation), [&] {
+                return load_base_commands(invocation);
+            });
+            return std::make_shared<const GameConfig>(load_config(invocation, std::move(base)));
+        });
+    }
+
+    /// Number of game configurations loaded.
+    size_t size() const { return this->configs.size(); }
+
+    /// Number of base layers of commands loaded.
+    size_t num_bases() const { return this->bases.size(); }
+
+private:
+    OnceMap<Commands>   bases;
+    OnceMap<GameConfig> configs;
+};
+
+auto split_lines(const std::string& text) -> std::vector<std::string>
+{
+    std::vector<std::string> lines;
+    size_t begin = 0;
+    for(size_t end; (end = text.find('\n', begin)) != std::string::npos; begin = end + 1)
+        lines.emplace_back(text, begin, end - begin);
+    lines.emplace_back(text, begin);
+
+    for(auto& line : lines)
+    {
+        if(!line.empty() && line.back() == '\r')
+            line.pop_back();
+    }
+
+    return lines;
+}
+
+auto trim(const std::string& s) -> std::string
+{
+    auto begin = s.find_first_not_of(" \t\r\n");
+    if(begin == std::string::npos)
+        return std::string();
+    auto end = s.find_last_not_of(" \t\r\n");
+    return s.substr(begin, end - begin + 1);
+}
+
+//
+// RUN lines.
+//
+
+/// Replaces the lit substitutions for paths (e.g. `%s`, `%/T`) and lines (`%(line+1)`) in a word.
+auto substitute(const std::string& word, const TestCase& test, size_t lineno) -> std::string
+{
+    auto generic = [](const fs::path& path) { return path.generic_u8string(); };
+    auto native = [](const fs::path& path) { return fs::path(path).make_preferred().u8string(); };
+
+    auto temp_file = test.temp_dir / (test.path.filename().u8string() + ".tmp");
+
+    const std::pair<const char*, std::string> substitutions[] = {
+        { "%%", "%" },
+        { "%/s", generic(test.path) },
+        { "%/S", generic(test.path.parent_path()) },
+        { "%/p", generic(test.path.parent_path()) },
+        { "%/t", generic(temp_file) },
+        { "%/T", generic(test.temp_dir) },
+        { "%symbolize", "%symbolize" },   // tool name, not `%s` followed by text
+        { "%s", native(test.path) },
+        { "%S", native(test.path.parent_path()) },
+        { "%p", native(test.path.parent_path()) },
+        { "%t", native(temp_file) },
+        { "%T", native(test.temp_dir) },
+    };
+
+    std::string result;
+    for(size_t i = 0; i < word.size(); )
+    {
+        if(word[i] != '%')
+        {
+            result.push_back(word[i++]);
+            continue;
+        }
+
+        if(!word.compare(i, 6, "%(line"))
+        {
+            auto end = word.find(')', i);
+            if(end == std::string::npos)
+                throw unsupported_error(fmt::format("malformed substitution in '{}'", word));
+
+            uint32_t offset = 0;
+            if(end != i + 6)
+            {
+                auto result = from_chars(word.data() + i + 7, word.data() + end, offset);
+                if(!(word[i+6] == '+' || word[i+6] == '-') || result.ec != std::errc() || result.ptr != word.data() + end)
+                    throw unsupported_error(fmt::format("malformed substitution in '{}'", word));
+            }
+
+            result += std::to_string(word[i+6] == '-'? lineno - offset : lineno + offset);
+            i = end + 1;
+            continue;
+        }
+
+        auto it = std::find_if(std::begin(substitutions), std::end(substitutions), [&](const auto& pair) {
+            return !word.compare(i, strlen(pair.first), pair.first);
+        });
+
+        if(it != std::end(substitutions))
+        {
+            result += it->second;
+            i += strlen(it->first);
+        }
+        else
+        {
+            result.push_back(word[i++]); // tool names such as %gta3sc
+        }
+    }
+    return result;
+}
+
+/// Splits a `RUN` line into pipelines of commands, in the way a POSIX shell would for the subset used by the tests.
+auto parse_run_line(size_t lineno, const std::string& text, const TestCase& test) -> RunLine
+{
+    RunLine run { lineno, text, { Pipeline(1) } };
+
+    for(size_t i = 0; i < text.size(); )
+    {
+        if(isspace(static_cast<unsigned char>(text[i])))
+        {
+            ++i;
+        }
+        else if(!text.compare(i, 2, "||"))
+        {
+            run.alternatives.emplace_back(1);
+            i += 2;
+        }
+        else if(text[i] == '|')
+        {
+            run.alternatives.back().emplace_back();
+            i += 1;
+        }
+        else if(!text.compare(i, 4, "2>&1"))
+        {
+            run.alternatives.back().back().merge_stderr = true;
+            i += 4;
+        }
+        else if(strchr("&;<>()`$", text[i]))
+        {
+            throw unsupported_error(fmt::format("unsupported shell syntax '{}'", text[i]));
+        }
+        else
+        {
+            std::string word;
+            while(i < text.size() && !isspace(static_cast<unsigned char>(text[i])) && !strchr("|&;<>()`$", text[i]))
+            {
+                if(text[i] == '"' || text[i] == '\'')
+                {
+                    auto quote = text[i];
+                    auto end = text.find(quote, i + 1);
+                    if(end == std::string::npos)
+                        throw unsupported_error("unterminated quote");
+                    word.append(text, i + 1, end - i - 1);
+                    i = end + 1;
+                }
+                else
+                {
+                    word.push_back(text[i++]);
+                }
+            }
+            run.alternatives.back().back().args.emplace_back(substitute(word, test, lineno));
+        }
+    }
+
+    for(auto& pipeline : run.alternatives)
+    {
+        for(auto& command : pipeline)
+        {
+            if(command.args.empty())
+                throw unsupported_error("empty command in pipeline");
+        }
+    }
+
+    return run;
+}
+
+auto read_run_lines(const TestCase& test) -> std::vector<RunLine>
+{
+    std::vector<RunLine> runs;
+
+    auto source = read_file_utf8(test.path);
+    if(!source)
+        throw std::runtime_error(fmt::format("could not read '{}'", test.path.generic_u8string()));
+
+    auto lines = split_lines(*source);
+    std::string continued;
+    size_t continued_lineno = 0;
+
+    for(size_t i = 0; i < lines.size(); ++i)
+    {
+        auto pos = lines[i].find("RUN:");
+        if(pos == std::string::npos)
+            continue;
+
+        auto text = trim(lines[i].substr(pos + 4));
+        if(continued.empty())
+            continued_lineno = i + 1;
+
+        if(!text.empty() && text.back() == '\\')
+        {
+            text.pop_back();
+            continued += text + ' ';
+            continue;
+        }
+
+        continued += text;
+        runs.emplace_back(parse_run_line(continued_lineno, continued, test));
+        continued.clear();
+    }
+
+    return runs;
+}
+
+//
+// Tools.
+//
+
+/// OutputCheck with `--comment=//`: CHECK, CHECK-NEXT and CHECK-NOT, each having a literal (`-L`) variant.
+bool file_check(const fs::path& check_file, const std::string& input, std::string& err)
+{
+    enum class Kind { Check, Next, Not };
+
+    struct Directive
+    {
+        Kind                kind;
+        bool                literal;
+        std::string         pattern;
+        optional<std::regex> regex;
+        size_t              lineno;
+
+        bool matches(const std::string& line) const
+        {
+            return literal? line.find(pattern) != std::string::npos : std::regex_search(line, *regex);
+        }
+    };
+
+    static const std::regex directive_regex(R"(^\s*//\s*CHECK(-NEXT|-NOT)?(-L)?:\s?(.*?)\s*$)");
+
+    auto source = read_file_utf8(check_file);
+    if(!source)
+    {
+        err += fmt::format("FileCheck: could not read '{}'\n", check_file.generic_u8string());
+        return false;
+    }
+
+    std::vector<Directive> directives;
+    auto check_lines = split_lines(*source);
+    for(size_t i = 0; i < check_lines.size(); ++i)
+    {
+        std::smatch match;
+        if(std::regex_search(check_lines[i], match, directive_regex))
+        {
+            Directive directive;
+            directive.kind = match[1] == "-NEXT"? Kind::Next : match[1] == "-NOT"? Kind::Not : Kind::Check;
+            directive.literal = match[2].matched;
+            directive.pattern = trim(match[3]);
+            directive.lineno = i + 1;
+            if(!directive.literal)
+                directive.regex.emplace(directive.pattern);
+            directives.emplace_back(std::move(directive));
+        }
+    }
+
+    auto lines = split_lines(input);
+    size_t pos = 0; // line after the last match
+    std::vector<const Directive*> pending_not;
+
+    auto check_nots = [&](size_t end) -> bool
+    {
+        for(auto directive : pending_not)
+        {
+            for(size_t i = pos; i < end; ++i)
+            {
+                if(directive->matches(lines[i]))
+                {
+                    err += fmt::format("FileCheck: {}:{}: CHECK-NOT: '{}' found at output line {}: {}\n",
+                                       check_file.filename().u8string(), directive->lineno, directive->pattern,
+                                       i + 1, lines[i]);
+                    return false;
+                }
+            }
+        }
+        pending_not.clear();
+        return true;
+    };
+
+    for(auto& directive : directives)
+    {
+        if(directive.kind == Kind::Not)
+        {
+            pending_not.emplace_back(&directive);
+            continue;
+        }
+
+        optional<size_t> found;
+        if(directive.kind == Kind::Next)
+        {
+            if(pos < lines.size() && directive.matches(lines[pos]))
+                found = pos;
+        }
+        else
+        {
+            for(size_t i = pos; i < lines.size() && !found; ++i)
+            {
+                if(directive.matches(lines[i]))
+                    found = i;
+            }
+        }
+
+        if(!found)
+        {
+            err += fmt::format("FileCheck: {}:{}: {}: '{}' not found{}\n",
+                               check_file.filename().u8string(), directive.lineno,
+                               directive.kind == Kind::Next? "CHECK-NEXT" : "CHECK", directive.pattern,
+                               directive.kind == Kind::Next && pos < lines.size()? ", got: " + lines[pos] : "");
+            return false;
+        }
+
+        if(!check_nots(*found))
+            return false;
+
+        pos = *found + 1;
+    }
+
+    return check_nots(lines.size());
+}
+
+/// Clang's -verify, as in *VerifyDiagnosticConsumer.py*.
+bool verify(const fs::path& source_file, const std::string& input, std::string& err)
+{
+    enum class DiagType { Error, Warning };
+
+    struct Diag
+    {
+        std::vector<std::string>    location;
+        optional<int64_t>           lineno;
+        DiagType                    type;
+        std::string                 text;
+        optional<std::regex>        regex;
+        std::string                 rawtext;
+        bool                        detected = false;
+    };
+
+    auto split_location = [](const std::string& path)
+    {
+        std::vector<std::string> components;
+        size_t begin = 0;
+        for(size_t i = 0; i <= path.size(); ++i)
+        {
+            if(i == path.size() || path[i] == '/' || path[i] == '\\')
+            {
+                auto component = path.substr(begin, i - begin);
+                if(component == ".." && !components.empty() && components.back() != "..")
+                    components.pop_back();
+                else if(!component.empty() && component != ".")
+                    components.emplace_back(std::move(component));
+                begin = i + 1;
+            }
+        }
+        return components;
+    };
+
+    auto matches = [](const Diag& expected, const Diag& given)
+    {
+        if(expected.location.size() > given.location.size())
+            return false;
+        if(!std::equal(expected.location.rbegin(), expected.location.rend(), given.location.rbegin()))
+            return false;
+        if((expected.lineno != given.lineno && expected.lineno != int64_t(0)) || expected.type != given.type)
+            return false;
+        if(expected.regex)
+            return std::regex_search(given.text, *expected.regex);
+        return given.text.find(expected.text) != std::string::npos;
+    };
+
+    static const std::regex comment_regex1(R"(^expected-(error|warning)(-re)?()(@[+-]?\d+)? \{\{(.*)\}\})");
+    static const std::regex comment_regex2(R"(^expected-(error|warning)(-re)?@([^:]+)(:\d+) \{\{(.*)\}\})");
+    static const std::regex ccerror_regex(R"(^((?:\w:[\\/])?[^:]+):(\d+:)?(\d+:)?( (?:(?:error)|(?:warning)):)? (.*)$)");
+
+    auto source = read_file_utf8(source_file);
+    if(!source)
+    {
+        err += fmt::format("verify: error: could not read '{}'\n", source_file.generic_u8string());
+        return false;
+    }
+
+    std::vector<Diag> expected;
+    bool found_nodiag = false;
+
+    auto source_lines = split_lines(*source);
+    for(size_t i = 0; i < source_lines.size(); ++i)
+    {
+        auto comment_pos = source_lines[i].find("//");
+        if(comment_pos == std::string::npos)
+            continue;
+
+        auto comment = trim(source_lines[i].substr(comment_pos + 2));
+
+        std::smatch match;
+        if(!std::regex_search(comment, match, comment_regex1) && !std::regex_search(comment, match, comment_regex2))
+        {
+            if(comment == "expected-no-diagnostics")
+                found_nodiag = true;
+            continue;
+        }
+
+        Diag diag;
+        diag.type = match[1] == "error"? DiagType::Error : DiagType::Warning;
+        diag.text = match[5];
+        diag.rawtext = comment;
+        if(match[2].matched)
+            diag.regex.emplace(diag.text);
+
+        int64_t lineno = i + 1;
+        if(match[4].length())
+        {
+            auto xlineno = match[4].str().substr(1);
+            auto value = std::stoll(xlineno);
+            lineno = (xlineno[0] == '+' || xlineno[0] == '-')? lineno + value : value;
+        }
+        diag.lineno = lineno;
+
+        diag.location = split_location(match[3].length()? match[3].str() : source_file.u8string());
+        expected.emplace_back(std::move(diag));
+    }
+
+    if(found_nodiag && !expected.empty())
+    {
+        err += "verify: error: given 'expected-no-diagnostics' but diagnostics found on source file.\n";
+        return false;
+    }
+    else if(!found_nodiag && expected.empty())
+    {
+        err += "verify: error: no diagnostics found on source file, but 'expected-no-diagnostics' not specified.\n";
+        return false;
+    }
+
+    size_t num_issues = 0;
+
+    for(auto& line : split_lines(input))
+    {
+        std::smatch match;
+        if(!std::regex_search(line, match, ccerror_regex) || !match[4].matched)
+            continue;
+
+        Diag given;
+        given.location = split_location(match[1]);
+        if(match[2].matched)
+            given.lineno = std::stoll(match[2]);
+        given.type = match[4] == " error:"? DiagType::Error : DiagType::Warning;
+        given.text = match[5];
+        given.rawtext = trim(line);
+
+        auto it = std::find_if(expected.begin(), expected.end(), [&](const Diag& diag) {
+            return matches(diag, given);
+        });
+
+        if(it != expected.end())
+        {
+            it->detected = true;
+        }
+        else
+        {
+            ++num_issues;
+            err += fmt::format("verify: error: unexpected compiler diagnostic: {}\n", given.rawtext);
+        }
+    }
+
+    for(auto& diag : expected)
+    {
+        if(!diag.detected)
+        {
+            ++num_issues;
+            err += fmt::format("verify: error: expected compiler diagnostic not given by compiler: {}\n", diag.rawtext);
+        }
+    }
+
+    return num_issues == 0;
+}
+
+bool checksum(const fs::path& file, const std::string& expected_md5, std::string& err)
+{
+    auto bytes = read_file_binary(file);
+    if(!bytes)
+    {
+        err += fmt::format("checksum: could not read file {}\n", file.generic_u8string());
+        return false;
+    }
+
+    Md5 md5;
+    md5.update(bytes->data(), bytes->size());
+    auto digest = md5.hexdigest();
+
+    if(digest != expected_md5)
+    {
+        err += fmt::format("checksum: file {} checksum is not {} (it is {})\n",
+                           file.generic_u8string(), expected_md5, digest);
+        return false;
+    }
+    return true;
+}
+
+//
+// Execution.
+//
+
+class Runner
+{
+public:
+    explicit Runner(ConfigCache& configs) :
+        configs(configs)
+    {}
+
+    /// Checks whether every command of the test is known.
+    static void check_supported(const std::vector<RunLine>& runs)
+    {
+        static const char* tools[] = {
+            "%gta3sc", "%decompile", "%symbolize", "%FileCheck", "%verify", "%checksum", "grep", "mkdir", "rm", "echo",
+        };
+
+        for(auto& run : runs)
+        {
+            for(auto& pipeline : run.alternatives)
+            {
+                for(auto& command : pipeline)
+                {
+                    auto it = std::find_if(command.args.begin(), command.args.end(), [](const std::string& arg) {
+                        return arg != "%not" && arg != "%dis";
+                    });
+
+                    if(it == command.args.end() || std::find(std::begin(tools), std::end(tools), *it) == std::end(tools))
+                        throw unsupported_error(fmt::format("unsupported command '{}'", command.args.back()));
+                }
+            }
+        }
+    }
+
+    auto run_test(const TestCase& test) -> TestResult
+    {
+        TestResult result;
+        this->test = &test;
+
+        auto start = std::chrono::steady_clock::now();
+        try
+        {
+            auto runs = read_run_lines(test);
+            check_supported(runs);
+
+            if(runs.empty())
+                throw std::runtime_error("test has no RUN line");
+
+            fs::create_directories(test.temp_dir);
+
+            for(auto& run : runs)
+            {
+                std::string transcript;
+                if(!run_line(run, transcript))
+                {
+                    result.status = TestStatus::Fail;
+                    result.details = fmt::format("RUN: at line {}: {}\n{}", run.lineno, run.text, transcript);
+                    break;
+                }
+            }
+        }
+        catch(const unsupported_error& e)
+        {
+            result.status = TestStatus::Unsupported;
+            result.details = e.what();
+        }
+        catch(const std::exception& e)
+        {
+            result.status = TestStatus::Fail;
+            result.details = e.what();
+        }
+
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return result;
+    }
+
+private:
+    bool run_line(const RunLine& run, std::string& transcript)
+    {
+        for(auto& pipeline : run.alternatives)
+        {
+            if(run_pipeline(pipeline, transcript))
+                return true;
+        }
+        return false;
+    }
+
+    /// Runs the commands feeding the output of each into the next. Fails if any of them fails (as `set -o pipefail`).
+    bool run_pipeline(const Pipeline& pipeline, std::string& transcript)
+    {
+        bool success = true;
+        std::string input;
+
+        for(auto& command : pipeline)
+        {
+            auto result = execute(command.args.begin(), command.args.end(), input, command.merge_stderr);
+            transcript += result.err;
+            if(result.status != 0)
+            {
+                if(&command == &pipeline.back())
+                    transcript += result.out;
+                transcript += fmt::format("note: '{}' exited with status {}\n", command.args.front(), result.status);
+                success = false;
+            }
+            input = std::move(result.out);
+        }
+
+        return success;
+    }
+
+    using ArgIterator = std::vector<std::string>::const_iterator;
+
+    auto execute(ArgIterator begin, ArgIterator end, const std::string& input, bool merge_stderr) -> ShellResult
+    {
+        ShellResult result;
+        auto tool = *begin++;
+        auto num_args = static_cast<size_t>(end - begin);
+
+        auto expect_args = [&](size_t n)
+        {
+            if(num_args != n)
+                throw std::runtime_error(fmt::format("'{}' expects {} arguments", tool, n));
+        };
+
+        if(tool == "%not" || tool == "%dis")
+        {
+            if(begin == end)
+                throw std::runtime_error(fmt::format("'{}' expects a command", tool));
+            result = execute(begin, end, input, merge_stderr);
+            if(tool == "%not")
+                result.status = (result.status == 1? 0 : 1);
+            else
+                result.status = (result.status > 1? 1 : 0);
+        }
+        else if(tool == "%gta3sc" || tool == "%decompile" || tool == "%symbolize")
+        {
+            std::vector<std::string> args;
+            args.emplace_back(tool == "%gta3sc"? "-Wno-expect-var" : tool == "%decompile"? "decompile" : "symbolize");
+            args.insert(args.end(), begin, end);
+            result = run_compiler(args, merge_stderr);
+        }
+        else if(tool == "%FileCheck")
+        {
+            expect_args(1);
+            result.status = file_check(rebase(*begin), input, result.err)? 0 : 1;
+        }
+        else if(tool == "%verify")
+        {
+            expect_args(1);
+            result.err += input; // as the python script does
+            result.status = verify(rebase(*begin), input, result.err)? 0 : 1;
+        }
+        else if(tool == "%checksum")
+        {
+            expect_args(2);
+            result.status = checksum(rebase(begin[0]), begin[1], result.err)? 0 : 1;
+        }
+        else if(tool == "grep")
+        {
+            expect_args(1);
+            std::regex regex(*begin, std::regex::basic);
+            for(auto& line : split_lines(input))
+            {
+                if(std::regex_search(line, regex))
+                    result.out += line + '\n';
+            }
+            result.status = result.out.empty()? 1 : 0;
+        }
+        else if(tool == "mkdir")
+        {
+            expect_args(1);
+            std::error_code ec;
+            if(!fs::create_directory(rebase(*begin), ec))
+            {
+                result.err += fmt::format("mkdir: cannot create directory '{}'\n", *begin);
+                result.status = 1;
+            }
+        }
+        else if(tool == "rm")
+        {
+            // Only `rm -f <file>`, which succeeds if the file does not exist.
+            expect_args(2);
+            if(begin[0] != "-f")
+                throw std::runtime_error("'rm' expects -f");
+
+            std::error_code ec;
+            fs::remove(rebase(begin[1]), ec);
+            if(ec)
+            {
+                result.err += fmt::format("rm: cannot remove '{}'\n", begin[1]);
+                result.status = 1;
+            }
+        }
+        else if(tool == "echo")
+        {
+            for(auto it = begin; it != end; ++it)
+                result.out += (it == begin? "" : " ") + *it;
+            result.out.push_back('\n');
+        }
+        else
+        {
+            Unreachable();
+        }
+
+        return result;
+    }
+
+    /// Runs the compiler as if `gta3sc args...` was called in the directory of the test.
+    auto run_compiler(std::vector<std::string> args, bool merge_stderr) -> ShellResult
+    {
+        ShellResult result;
+        auto& err = merge_stderr? result.out : result.err;
+
+        auto stdout_sink = [&](const std::string& text) { result.out += text; };
+        auto log = [&](const std::string& msg) { err += msg; err.push_back('\n'); };
+
+        std::vector<char*> argv;
+        for(auto& arg : args) argv.emplace_back(&arg[0]);
+        argv.emplace_back(nullptr);
+
+        try
+        {
+            Invocation invocation;
+
+            if(!parse_invocation(argv.data(), invocation, log))
+            {
+                result.status = EXIT_FAILURE;
+                return result;
+            }
+
+            if(invocation.action == Action::QueryConfigPath)
+            {
+                stdout_sink(config_path().generic_u8string());
+                return result;
+            }
+
+            if(invocation.options.help || invocation.options.version)
+                throw unsupported_error("--help and --version are not supported in-process");
+
+            rebase_invocation(invocation, this->test->path.parent_path());
+
+            if(!validate_invocation(invocation, log))
+            {
+                result.status = EXIT_FAILURE;
+                return result;
+            }
+
+            if(!needs_config(invocation))
+            {
+                result.status = run_invocation(invocation, GameConfig(), stdout_sink, log);
+                return result;
+            }
+
+            shared_ptr<const GameConfig> config;
+            try
+            {
+                config = this->configs.get(invocation);
+            }
+            catch(const ConfigError& e)
+            {
+                log(fmt::format("gta3sc: error: {}", e.what()));
+                result.status = EXIT_FAILURE;
+                return result;
+            }
+
+            result.status = run_invocation(invocation, *config, stdout_sink, log);
+        }
+        catch(const unsupported_error&)
+        {
+            throw;
+        }
+        catch(const std::exception& e)
+        {
+            // as a crash of the compiler process.
+            log(fmt::format("gta3sc-test: compiler crashed: {}", e.what()));
+            result.status = 3;
+        }
+
+        return result;
+    }
+
+    /// Makes paths given to tools relative to the directory of the test, as lit's working directory is.
+    fs::path rebase(const std::string& path) const
+    {
+        fs::path p = fs::u8path(path);
+        return p.is_absolute()? p : this->test->path.parent_path() / p;
+    }
+
+private:
+    ConfigCache&    configs;
+    const TestCase* test = nullptr;
+};
+
+//
+// Discovery.
+//
+
+bool is_test_file(const fs::path& path)
+{
+    auto extension = path.extension().u8string();
+    return fs::is_regular_file(path) && (extension == ".sc" || extension == ".test");
+}
+
+/// Finds the tests in the suite directory `suite`, in the way *GTA3ScriptTest.py* does (no recursion).
+void find_suite_tests(const fs::path& suite, const optional<fs::path>& output_dir, std::vector<TestCase>& tests)
+{
+    auto suite_name = suite.filename().u8string();
+    auto temp_dir = output_dir? *output_dir / suite_name : suite / "Output";
+
+    std::vector<fs::path> paths;
+    for(auto& entry : fs::directory_iterator(suite))
+    {
+        if(is_test_file(entry.path()))
+            paths.emplace_back(entry.path());
+    }
+
+    std::sort(paths.begin(), paths.end());
+
+    for(auto& path : paths)
+        tests.push_back(TestCase { path, suite_name + '/' + path.filename().u8string(), temp_dir });
+}
+
+bool find_tests(const fs::path& arg, const optional<fs::path>& output_dir, std::vector<TestCase>& tests)
+{
+    auto path = fs::absolute(arg);
+
+    if(fs::is_directory(path) && fs::exists(path / "lit.cfg"))
+    {
+        std::vector<fs::path> suites;
+        for(auto& entry : fs::directory_iterator(path))
+        {
+            if(fs::is_directory(entry.path()))
+                suites.emplace_back(entry.path());
+        }
+
+        std::sort(suites.begin(), suites.end());
+
+        for(auto& suite : suites)
+        {
+            auto name = suite.filename().u8string();
+            if(name != "Inputs" && name != "Output")
+                find_suite_tests(suite, output_dir, tests);
+        }
+        return true;
+    }
+    else if(fs::is_directory(path))
+    {
+        find_suite_tests(path, output_dir, tests);
+        return true;
+    }
+    else if(is_test_file(path))
+    {
+        auto suite = path.parent_path();
+        auto suite_name = suite.filename().u8string();
+        auto temp_dir = output_dir? *output_dir / suite_name : suite / "Output";
+        tests.push_back(TestCase { path, suite_name + '/' + path.filename().u8string(), temp_dir });
+        return true;
+    }
+
+    fprintf(stderr, "gta3sc-test: error: '%s' is not a test or test directory\n", arg.generic_u8string().c_str());
+    return false;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    size_t num_threads = std::max(1u, std::thread::hardware_concurrency());
+    optional<fs::path> output_dir;
+    std::vector<fs::path> paths;
+
+    for(int i = 1; i < argc; ++i)
+    {
+        string_view arg = argv[i];
+        if(arg == "-j" && i + 1 < argc)
+        {
+            num_threads = std::max(1, std::atoi(argv[++i]));
+        }
+        else if(arg.substr(0, 2) == "-j" && arg.size() > 2)
+        {
+            num_threads = std::max(1, std::atoi(argv[i] + 2));
+        }
+        else if(arg.substr(0, 13) == "--output-dir=")
+        {
+            output_dir = fs::absolute(fs::u8path(argv[i] + 13));
+        }
+        else if(arg == "-h" || arg == "--help")
+        {
+            fprintf(stdout, "Usage: gta3sc-test [-j <threads>] [--output-dir=<path>] [paths...]\n");
+            return EXIT_SUCCESS;
+        }
+        else if(arg.size() && arg[0] == '-')
+        {
+            fprintf(stderr, "gta3sc-test: error: unrecognized argument '%s'\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+        else
+        {
+            paths.emplace_back(fs::u8path(argv[i]));
+        }
+    }
+
+    if(paths.empty())
+    {
+        fprintf(stderr, "gta3sc-test: error: no test paths given\n");
+        return EXIT_FAILURE;
+    }
+
+    std::vector<TestCase> tests;
+    for(auto& path : paths)
+    {
+        if(!find_tests(path, output_dir, tests))
+            return EXIT_FAILURE;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    ConfigCache configs;
+    std::vector<TestResult> results(tests.size());
+    std::atomic<size_t> next_test {0};
+    std::mutex print_mutex;
+
+    auto worker = [&]
+    {
+        Runner runner(configs);
+        for(size_t i; (i = next_test++) < tests.size(); )
+        {
+            results[i] = runner.run_test(tests[i]);
+
+            static const char* status_names[] = { "PASS", "FAIL", "UNSUPPORTED" };
+            std::lock_guard<std::mutex> lock(print_mutex);
+            fprintf(stdout, "%s: %s (%.3fs)\n", status_names[static_cast<int>(results[i].status)],
+                                                tests[i].name.c_str(), results[i].seconds);
+            if(results[i].status == TestStatus::Fail)
+                fprintf(stdout, "********************\n%s\n********************\n", results[i].details.c_str());
+            fflush(stdout);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    num_threads = std::min(num_threads, std::max<size_t>(1, tests.size()));
+    for(size_t i = 0; i < num_threads; ++i)
+        threads.emplace_back(worker);
+    for(auto& thread : threads)
+        thread.join();
+
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    size_t counts[3] = {};
+    for(auto& result : results)
+        ++counts[static_cast<int>(result.status)];
+
+    std::vector<size_t> slowest(tests.size());
+    std::iota(slowest.begin(), slowest.end(), 0);
+    std::sort(slowest.begin(), slowest.end(), [&](size_t a, size_t b) { return results[a].seconds > results[b].seconds; });
+    slowest.resize(std::min<size_t>(slowest.size(), 10));
+
+    fprintf(stdout, "\nSlowest Tests:\n");
+    for(auto i : slowest)
+        fprintf(stdout, "  %.3fs: %s\n", results[i].seconds, tests[i].name.c_str());
+
+    fprintf(stdout, "\nTesting Time: %.2fs (%zu threads, %zu game configs loaded, %zu shared bases)\n",
+            elapsed, num_threads, configs.size(), configs.num_bases());
+    fprintf(stdout, "  Passed     : %zu\n", counts[static_cast<int>(TestStatus::Pass)]);
+    if(counts[static_cast<int>(TestStatus::Unsupported)])
+        fprintf(stdout, "  Unsupported: %zu\n", counts[static_cast<int>(TestStatus::Unsupported)]);
+    if(counts[static_cast<int>(TestStatus::Fail)])
+        fprintf(stdout, "  Failed     : %zu\n", counts[static_cast<int>(TestStatus::Fail)]);
+
+    return counts[static_cast<int>(TestStatus::Fail)]? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -26,11 +26,11 @@ TERMINATE_THIS_SCRIPT
 	LVAR_INT x y z
 
 	CREATE_CAR 0 .0 .0 .0 x
-	CREATE_CHAR 0 0 .0 .0 .0 y
+	CREATE_CHAR 0 0 .0 .0 .0 y	// expected-error {{variable has already been used to create a entity of type CAR}}
 
 	TERMINATE_THIS_SCRIPT
 }
 
 bottom_of_script:
-START_NEW_SCRIPT script2 car car // expected-error {{entity type mismatch in target label}}
+START_NEW_SCRIPT script2 car car
 RETURN
@@ -0,0 +1,25 @@
+// RUN: %dis %gta3sc %s --config=gtavc -fsyntax-only 2>&1 | %verify %s
+// Entities flow into scripts from their callers, wherever the caller is in the source.
+
+VAR_INT car char
+CREATE_CAR 0 .0 .0 .0 car
+CREATE_CHAR 0 0 .0 .0 .0 char
+
+GOTO main_loop
+
+{
+	script1:
+
+	LVAR_INT x y
+
+	EXPLODE_CAR x
+	EXPLODE_CAR y
+	EXPLODE_CHAR_HEAD y	// expected-error {{expected variable of type CHAR but got CAR}}
+
+	TERMINATE_THIS_SCRIPT
+}
+
+main_loop:
+START_NEW_SCRIPT script1 car car
+START_NEW_SCRIPT script1 car char // expected-error {{entity type mismatch in target label}}
+TERMINATE_THIS_SCRIPT
@@ -0,0 +1,14 @@
+// RUN: %dis %gta3sc %s --config=gtavc -fsyntax-only 2>&1 | %verify %s
+// Arithmetic gives plain numbers, not entities.
+
+VAR_INT car n
+
+CREATE_CAR 0 .0 .0 .0 car
+n = car + 1		// expected-error {{arithmetic on variable of type CAR}}
+n = 2 * car		// expected-error {{arithmetic on variable of type CAR}}
+car += 1		// expected-error {{arithmetic into variable of type CAR}}
+n += 1
+EXPLODE_CAR n	// expected-error {{expected variable of type CAR but got NONE}}
+EXPLODE_CAR car
+
+TERMINATE_THIS_SCRIPT
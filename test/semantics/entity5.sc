@@ -0,0 +1,39 @@
+// RUN: %dis %gta3sc %s --config=gtavc -fsyntax-only 2>&1 | %verify %s
+// Entities flow along GOTOs, GOSUBs and RETURNs, rather than in textual order.
+
+VAR_INT car
+
+GOSUB make_car
+EXPLODE_CAR car
+
+// Loops join the entities of each iteration.
+{
+	LVAR_INT ped i
+	WHILE i < 2
+		IF i = 0
+			CREATE_CHAR 0 0 .0 .0 .0 ped
+		ELSE
+			CREATE_CAR 0 .0 .0 .0 ped	// expected-error {{variable has already been used to create a entity of type CHAR}}
+		ENDIF
+		i += 1
+	ENDWHILE
+	EXPLODE_CHAR_HEAD ped	// not reported again
+}
+
+{
+	LVAR_INT char
+	GOTO create_char
+
+	use_char:
+	EXPLODE_CHAR_HEAD char
+	EXPLODE_CAR char	// expected-error {{expected variable of type CAR but got CHAR}}
+	TERMINATE_THIS_SCRIPT
+
+	create_char:
+	CREATE_CHAR 0 0 .0 .0 .0 char
+	GOTO use_char
+}
+
+make_car:
+CREATE_CAR 0 .0 .0 .0 car
+RETURN
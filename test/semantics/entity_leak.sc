@@ -0,0 +1,45 @@
+// Tests the detection of entities a mission may not release (-Wentity-leak).
+// RUN: %dis %gta3sc %s --config=gtasa --guesser --cm -fsyntax-only -Wentity-leak 2>&1 | %verify %s
+// RUN: %gta3sc %s --config=gtasa --guesser --cm -fsyntax-only -Wentity-leak 2>&1 | %FileCheck %s
+// RUN: %gta3sc %s --config=gtasa --guesser --cm -fsyntax-only 2>&1 | %not grep "entity-leak"
+// CHECK: entity_leak.sc:45:1: note: mission ends here
+// CHECK: entity_leak.sc:16:5: warning: OBJECT created here may overwrite
+// CHECK: entity_leak.sc:16:5: note: previous OBJECT created here
+MISSION_START
+{
+LVAR_INT car blip obj obj2 i passed
+
+CREATE_CAR 400 0.0 0.0 0.0 car
+ADD_BLIP_FOR_CAR car blip // expected-warning {{BLIP created here may not be released before the mission ends}}
+
+WHILE i < 3
+    CREATE_OBJECT 1000 0.0 0.0 0.0 obj // expected-warning {{OBJECT created here may overwrite the handle of another one not released yet}}
+    i += 1
+ENDWHILE
+DELETE_OBJECT obj
+
+SWITCH i
+    CASE 1
+        WAIT 0
+        BREAK
+    CASE 2
+        CREATE_OBJECT 1001 0.0 0.0 0.0 obj2 // expected-warning {{OBJECT created here may not be released before the mission ends}}
+        BREAK
+    DEFAULT
+        BREAK
+ENDSWITCH
+
+WAIT 0
+IF passed = 1
+    REMOVE_BLIP blip
+ENDIF
+GOSUB cleanup
+GOTO mission_done
+
+cleanup:
+MARK_CAR_AS_NO_LONGER_NEEDED car
+RETURN
+
+mission_done:
+}
+MISSION_END
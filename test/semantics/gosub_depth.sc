@@ -0,0 +1,125 @@
+// Tests the static GOSUB nesting depth verifier (-fgosub-depth-limit).
+// RUN: %dis %gta3sc %s --config=gta3 -fsyntax-only 2>&1 | %verify %s
+// RUN: %gta3sc %s --config=gta3 -fsyntax-only 2>&1 | %FileCheck %s
+// RUN: %gta3sc %s --config=gta3 -fsyntax-only -fgosub-depth-limit=7 2>&1 | %not grep "may nest"
+// RUN: %gta3sc %s --config=gtasa --guesser -fno-scope-then-label -D SA -fsyntax-only 2>&1 | grep "gosub_depth.sc:77:1: warning: GOSUB calls may nest 9 deep in the script started here, but there.s only room for 8"
+VAR_INT n
+#ifdef SA
+START_NEW_SCRIPT thread_switch
+#endif
+START_NEW_SCRIPT thread_ok // expected-warning {{GOSUB calls may nest 7 deep in the script started here, but there's only room for 6}}
+START_NEW_SCRIPT thread_rec
+GOSUB sub1
+// CHECK: gosub_depth.sc:12:1: note: GOSUB to 'sub1' nests 1 deep
+TERMINATE_THIS_SCRIPT
+
+thread_ok:
+{
+    GOSUB sub3
+    TERMINATE_THIS_SCRIPT
+}
+
+thread_rec:
+{
+    GOSUB rec
+    TERMINATE_THIS_SCRIPT
+}
+
+rec:
+IF n > 0
+    n -= 1
+    GOSUB rec // expected-warning {{GOSUB to 'rec' may call itself again before returning}}
+ENDIF
+RETURN
+
+sub1:
+GOSUB sub2
+// CHECK: note: GOSUB to 'sub2' nests 2 deep
+RETURN
+
+sub2:
+IF n = 0
+    GOSUB sub3
+    // CHECK: gosub_depth.sc:42:5: note: GOSUB to 'sub3' nests 3 deep
+ELSE
+    GOSUB sub4
+ENDIF
+RETURN
+
+sub3:
+GOSUB sub4
+// CHECK: note: GOSUB to 'sub4' nests 4 deep
+RETURN
+
+sub4:
+GOSUB sub5
+// CHECK: note: GOSUB to 'sub5' nests 5 deep
+RETURN
+
+sub5:
+WHILE n > 0
+    GOSUB sub6
+    // CHECK: note: GOSUB to 'sub6' nests 6 deep
+ENDWHILE
+RETURN
+
+sub6:
+GOSUB sub7
+// CHECK: note: GOSUB to 'sub7' nests 7 deep
+RETURN
+
+sub7:
+n = 1
+RETURN
+
+#ifdef SA
+// The cases of a SWITCH are only reached by its branches.
+thread_switch:
+{
+    SWITCH n
+    CASE 1
+        n = 2
+        BREAK
+    CASE 2
+        GOSUB sa_sub1
+        BREAK
+    ENDSWITCH
+    TERMINATE_THIS_SCRIPT
+}
+
+sa_sub1:
+GOSUB sa_sub2
+RETURN
+
+sa_sub2:
+GOSUB sa_sub3
+RETURN
+
+sa_sub3:
+GOSUB sa_sub4
+RETURN
+
+sa_sub4:
+GOSUB sa_sub5
+RETURN
+
+sa_sub5:
+GOSUB sa_sub6
+RETURN
+
+sa_sub6:
+GOSUB sa_sub7
+RETURN
+
+sa_sub7:
+GOSUB sa_sub8
+RETURN
+
+sa_sub8:
+GOSUB sa_sub9
+RETURN
+
+sa_sub9:
+n = 0
+RETURN
+#endif
@@ -0,0 +1,18 @@
+// RUN: %dis %gta3sc %s --config=gta3 -fsyntax-only -Wprecision-loss=0.01 2>&1 | %verify %s
+// RUN: %not %gta3sc %s --config=gta3 -fsyntax-only -Wprecision-loss=0.01 2>&1 | grep "3 of 9 floats lose precision in q11.4, by up to 0.0525"
+// Floats are encoded in the q11.4 fixed point format of GTA III.
+
+VAR_FLOAT f
+
+f = 1.5
+f = 811.875
+f = 0.99		// expected-warning {{encoded as 0.9375 in q11.4}}
+f = -0.01
+f = 0.05		// expected-warning {{encoded as 0 in q11.4}}
+
+f = 2047.9375
+f = 2048.0		// expected-error {{out of the q11.4 range}}
+f = -2048.0
+f = -2049.0		// expected-error {{out of the q11.4 range}}
+
+TERMINATE_THIS_SCRIPT
@@ -17,5 +17,12 @@ WAIT 0x80000000
 WAIT 0xFFFFFFFF
 WAIT 0x100000000 // expected-error {{out of range}}
 
+VAR_FLOAT f
+f = 340282346638528859811704183484516925440.0 // expected-error {{out of the q11.4 range}}
+f = 340282356779733661637539395458142568448.0 // expected-error {{out of range}}
+f = 0.0000000000000000000000000000000000000117549435
+f = 0.00000000000000000000000000000000000001 // expected-error {{out of range}}
+f = . // expected-error {{invalid float literal}}
+
 
 TERMINATE_THIS_SCRIPT
@@ -0,0 +1,56 @@
+// Tests the detection of loops which never WAIT (-Wwait-free-loop).
+// RUN: %dis %gta3sc %s --config=gtasa --guesser -fsyntax-only 2>&1 | %verify %s
+// RUN: %gta3sc %s --config=gtasa --guesser -fsyntax-only -Wno-wait-free-loop 2>&1 | %not grep "without WAIT"
+VAR_INT n flag arr[4] player
+CREATE_PLAYER 0 0.0 0.0 0.0 player
+
+// Waits on every iteration.
+WHILE flag = 0
+    WAIT 0
+ENDWHILE
+
+// Waits on some iterations only, which is up to the script.
+WHILE flag = 0
+    IF n > 0
+        WAIT 0
+    ENDIF
+ENDWHILE
+
+// Counts up to a bound.
+n = 0
+WHILE n < 4
+    arr[n] = 0
+    n += 1
+ENDWHILE
+
+REPEAT 4 n
+    arr[n] = 1
+ENDREPEAT
+
+// Waits in a subroutine.
+WHILE flag = 0
+    GOSUB wait_a_bit
+ENDWHILE
+
+// Nothing changes until the script waits.
+WHILE flag = 0 // expected-warning {{loop without WAIT changes no variable}}
+ENDWHILE
+
+WHILE NOT IS_PLAYER_PLAYING player // expected-warning {{loop without WAIT changes no variable}}
+    GOSUB do_nothing
+ENDWHILE
+
+// Never ends.
+main_loop:
+n += 1 // expected-warning {{infinite loop without WAIT freezes the game}}
+IF n > 10
+    n = 0
+ENDIF
+GOTO main_loop
+
+wait_a_bit:
+WAIT 100
+RETURN
+
+do_nothing:
+RETURN
@@ -66,6 +66,7 @@ class Command:
         self.supported = False
         self.internal = False
         self.extension = False
+        self.flow = []
         self.args = []
 
     def __eq__(self, other):
@@ -101,6 +102,7 @@ class Command:
         init.supported = _str2bool(node.get("Supported", "true"))
         init.internal = _str2bool(node.get("Internal", "false"))
         init.extension = _str2bool(node.get("Extension", "false"))
+        init.flow = node.get("Flow", "").split()
         init.args = []
         node_args = node.find("Args")
         if node_args is not None:
@@ -121,6 +123,8 @@ class Command:
             node.set("Internal", _bool2str(self.internal))
         if self.extension == True:
             node.set("Extension", _bool2str(self.extension))
+        if len(self.flow) > 0:
+            node.set("Flow", " ".join(self.flow))
         if len(self.args) > 0:
             node_args = etree.SubElement(node, "Args")
             for a in self.args:
@@ -142,6 +146,8 @@ class Argument:
         self.allow_text_label = False # valid only for PARAM types
         self.allow_pointer = False
         self.preserve_case = False
+        self.acquire = False # outputs a new entity handle
+        self.release = False # gives back the entity handle
 
     def __eq__(self, other):
         return self.__dict__ == other.__dict__
@@ -170,6 +176,8 @@ class Argument:
         init.allow_pointer = _str2bool(node.get("AllowPointer", "false"))
         init.preserve_case = _str2bool(node.get("PreserveCase", "false"))
         init.entity = node.get("Entity", None)
+        init.acquire = _str2bool(node.get("Acquire", "false"))
+        init.release = _str2bool(node.get("Release", "false"))
         init.enums = node.get("Enum", None)
         init.enums = [init.enums] if init.enums else []
         return init
@@ -199,6 +207,10 @@ class Argument:
             node.set("PreserveCase", _bool2str(self.preserve_case))
         if self.entity != None:
             node.set("Entity", self.entity)
+        if self.acquire == True:
+            node.set("Acquire", _bool2str(self.acquire))
+        if self.release == True:
+            node.set("Release", _bool2str(self.release))
         if len(self.enums) != 0:
             assert len(self.enums) == 1
             node.set("Enum", self.enums[0])